@@ -11,8 +11,10 @@
 
 #include "bls/bls.h"
 
+void InitBLSTests();
 void CleanupBLSTests();
 void CleanupBLSDkgTests();
+void CleanupLLMQSimTests();
 
 int
 main(int argc, char** argv)
@@ -24,12 +26,14 @@ main(int argc, char** argv)
     ECCVerifyHandle verifyHandle;
 
     BLSInit();
+    InitBLSTests();
     SetupEnvironment();
     fPrintToDebugLog = false; // don't want to write to debug.log file
 
     benchmark::BenchRunner::RunAll();
 
     // need to be called before global destructors kick in (PoolAllocator is needed due to many BLSSecretKeys)
+    CleanupLLMQSimTests();
     CleanupBLSDkgTests();
     CleanupBLSTests();
 
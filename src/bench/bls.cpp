@@ -6,6 +6,8 @@
 
 #include "bench.h"
 #include "random.h"
+#include "bls/bls_batchverifier.h"
+#include "bls/bls_sigcache.h"
 #include "bls/bls_worker.h"
 #include "utiltime.h"
 
@@ -13,6 +15,11 @@
 
 CBLSWorker blsWorker;
 
+void InitBLSTests()
+{
+    blsWorker.Start();
+}
+
 void CleanupBLSTests()
 {
     blsWorker.Stop();
@@ -318,6 +325,8 @@ static void BLSVerify_BatchedParallel(benchmark::State& state)
     size_t i = 0;
     while (state.KeepRunning()) {
         if (futures.size() < 100) {
+            // the same test vectors are verified over and over, which would otherwise be answered from the sig cache
+            ClearBLSSigCache();
             while (futures.size() < 10000) {
                 auto f = blsWorker.AsyncVerifySig(sigs[i], pubKeys[i], msgHashes[i], cancelCond);
                 futures.emplace_back(std::make_pair(i, std::move(f)));
@@ -345,6 +354,47 @@ static void BLSVerify_BatchedParallel(benchmark::State& state)
     }
 }
 
+// 1000 sigs from 100 sources (10 per source), of which invalidCount are invalid
+static void BLSVerify_BatchVerifier(benchmark::State& state, size_t invalidCount, bool parallel)
+{
+    BLSPublicKeyVector pubKeys;
+    BLSSecretKeyVector secKeys;
+    BLSSignatureVector sigs;
+    std::vector<uint256> msgHashes;
+    std::vector<bool> invalid;
+    BuildTestVectors(1000, invalidCount, pubKeys, secKeys, sigs, msgHashes, invalid);
+
+    // Benchmark.
+    while (state.KeepRunning()) {
+        CBLSBatchVerifier<size_t, size_t> batchVerifier(false, true);
+        if (parallel) {
+            batchVerifier.EnableParallelVerification(blsWorker);
+        }
+        for (size_t i = 0; i < sigs.size(); i++) {
+            batchVerifier.PushMessage(i / 10, i, msgHashes[i], sigs[i], pubKeys[i]);
+        }
+        batchVerifier.Verify();
+        assert(batchVerifier.badMessages.size() == invalidCount);
+    }
+}
+
+#define BENCH_BLSVerify_BatchVerifier(invalidCount) \
+    static void BLSVerify_BatchVerifier_Invalid##invalidCount(benchmark::State& state) \
+    { \
+        BLSVerify_BatchVerifier(state, invalidCount, false); \
+    } \
+    static void BLSVerify_BatchVerifier_Invalid##invalidCount##_Parallel(benchmark::State& state) \
+    { \
+        BLSVerify_BatchVerifier(state, invalidCount, true); \
+    } \
+    BENCHMARK(BLSVerify_BatchVerifier_Invalid##invalidCount) \
+    BENCHMARK(BLSVerify_BatchVerifier_Invalid##invalidCount##_Parallel)
+
+BENCH_BLSVerify_BatchVerifier(0)
+BENCH_BLSVerify_BatchVerifier(1)
+BENCH_BLSVerify_BatchVerifier(10)
+BENCH_BLSVerify_BatchVerifier(100)
+
 BENCHMARK(BLSPubKeyAggregate_Normal)
 BENCHMARK(BLSSecKeyAggregate_Normal)
 BENCHMARK(BLSSign_Normal)
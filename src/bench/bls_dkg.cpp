@@ -7,6 +7,7 @@
 #include "bench.h"
 #include "random.h"
 #include "bls/bls_worker.h"
+#include "version.h"
 
 extern CBLSWorker blsWorker;
 
@@ -111,9 +112,66 @@ struct DKG
             memberIdx = (memberIdx + 1) % members.size();
         }
     }
+
+    // Calculates the public key shares of all members, as done by CQuorum::GetPubKeyShare, either member by member
+    // from the quorum vvec or from precomputed tables which are built once per iteration
+    void Bench_BuildPubKeyShares(benchmark::State& state, bool useTable, bool parallel)
+    {
+        ReceiveVvecs();
+
+        while (state.KeepRunning()) {
+            BLSPublicKeyVector pkShares;
+            if (useTable) {
+                auto table = CBLSVerificationVectorTable::Build(*quorumVvec);
+                assert(table != nullptr);
+                pkShares = blsWorker.BuildPubKeyShares(table, ids, parallel);
+            } else {
+                for (auto& id : ids) {
+                    pkShares.emplace_back(blsWorker.BuildPubKeyShare(quorumVvec, id));
+                }
+            }
+            assert(pkShares.size() == ids.size() && pkShares.back().IsValid());
+        }
+    }
+
+    // Simulates the whole contribution phase of a single member: decryption of all received contributions followed by
+    // batched verification of the decrypted shares
+    void Bench_ContributionPhase(benchmark::State& state, int invalidCount)
+    {
+        ReceiveVvecs();
+
+        const size_t whoAmI = 0;
+        CBLSSecretKey operatorKey;
+        operatorKey.MakeNewKey();
+
+        // spread the invalid contributions evenly, so that runs are comparable
+        std::set<size_t> invalidIndexes;
+        for (int i = 0; i < invalidCount; i++) {
+            invalidIndexes.emplace(i * members.size() / invalidCount);
+        }
+
+        std::vector<std::shared_ptr<CBLSIESMultiRecipientObjects<CBLSSecretKey>>> encryptedContributions;
+        for (size_t i = 0; i < members.size(); i++) {
+            auto skContrib = members[i].skShares[whoAmI];
+            if (invalidIndexes.count(i)) {
+                skContrib.MakeNewKey();
+            }
+            // only the share of whoAmI is needed
+            auto enc = std::make_shared<CBLSIESMultiRecipientObjects<CBLSSecretKey>>();
+            enc->InitEncrypt(members.size());
+            enc->Encrypt(whoAmI, operatorKey.GetPublicKey(), skContrib, PROTOCOL_VERSION);
+            encryptedContributions.emplace_back(enc);
+        }
+
+        while (state.KeepRunning()) {
+            receivedSkShares = blsWorker.DecryptContributions(encryptedContributions, whoAmI, operatorKey, PROTOCOL_VERSION);
+            VerifyContributionShares(whoAmI, invalidIndexes, true, true);
+        }
+    }
 };
 
 std::shared_ptr<DKG> dkg10;
+std::shared_ptr<DKG> dkg50;
 std::shared_ptr<DKG> dkg100;
 std::shared_ptr<DKG> dkg400;
 
@@ -122,6 +180,9 @@ void InitIfNeeded()
     if (dkg10 == nullptr) {
         dkg10 = std::make_shared<DKG>(10);
     }
+    if (dkg50 == nullptr) {
+        dkg50 = std::make_shared<DKG>(50);
+    }
     if (dkg100 == nullptr) {
         dkg100 = std::make_shared<DKG>(100);
     }
@@ -133,6 +194,7 @@ void InitIfNeeded()
 void CleanupBLSDkgTests()
 {
     dkg10.reset();
+    dkg50.reset();
     dkg100.reset();
     dkg400.reset();
 }
@@ -181,3 +243,36 @@ BENCH_VerifyContributionShares(parallel, 400, 5, true, false)
 BENCH_VerifyContributionShares(parallel_aggregated, 10, 5, true, true)
 BENCH_VerifyContributionShares(parallel_aggregated, 100, 5, true, true)
 BENCH_VerifyContributionShares(parallel_aggregated, 400, 5, true, true)
+
+#define BENCH_ContributionPhase(name, quorumSize, invalidCount) \
+    static void BLSDKG_ContributionPhase_##name##_##quorumSize(benchmark::State& state) \
+    { \
+        InitIfNeeded(); \
+        dkg##quorumSize->Bench_ContributionPhase(state, invalidCount); \
+    } \
+    BENCHMARK(BLSDKG_ContributionPhase_##name##_##quorumSize)
+
+BENCH_ContributionPhase(valid, 10, 0)
+BENCH_ContributionPhase(valid, 100, 0)
+BENCH_ContributionPhase(valid, 400, 0)
+
+BENCH_ContributionPhase(invalid, 10, 5)
+BENCH_ContributionPhase(invalid, 100, 5)
+BENCH_ContributionPhase(invalid, 400, 5)
+
+///////////////////////////////
+
+#define BENCH_BuildPubKeyShares(name, quorumSize, useTable, parallel) \
+    static void BLSDKG_BuildPubKeyShares_##name##_##quorumSize(benchmark::State& state) \
+    { \
+        InitIfNeeded(); \
+        dkg##quorumSize->Bench_BuildPubKeyShares(state, useTable, parallel); \
+    } \
+    BENCHMARK(BLSDKG_BuildPubKeyShares_##name##_##quorumSize)
+
+BENCH_BuildPubKeyShares(simple, 50, false, false)
+BENCH_BuildPubKeyShares(simple, 400, false, false)
+BENCH_BuildPubKeyShares(table, 50, true, false)
+BENCH_BuildPubKeyShares(table, 400, true, false)
+BENCH_BuildPubKeyShares(table_parallel, 50, true, true)
+BENCH_BuildPubKeyShares(table_parallel, 400, true, true)
@@ -0,0 +1,108 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "chain.h"
+#include "random.h"
+
+#include "bls/bls.h"
+#include "evo/deterministicmns.h"
+#include "evo/evodb.h"
+
+static const size_t MNLIST_MN_COUNT = 2000;
+static const size_t MNLIST_DIFF_COUNT = 10;
+static const size_t MNLIST_DIFF_UPDATES = 20;
+
+// EvoDB keys used by CDeterministicMNManager for compact snapshots and diffs
+static const std::string BENCH_DB_LIST_SNAPSHOT_COMPACT = "dmn_S2";
+static const std::string BENCH_DB_LIST_DIFF_COMPACT = "dmn_D2";
+
+// Writes a snapshot with MNLIST_MN_COUNT masternodes for the first block and diffs with operator key changes for the
+// following blocks, so that GetListForBlock on the last block has to load the snapshot and apply all diffs
+static void BuildMNListChain(CEvoDB& evoDb, std::vector<uint256>& blockHashesRet, std::vector<CBlockIndex>& indexesRet)
+{
+    size_t blockCount = MNLIST_DIFF_COUNT + 1;
+    blockHashesRet.resize(blockCount);
+    indexesRet.resize(blockCount);
+    for (size_t i = 0; i < blockCount; i++) {
+        blockHashesRet[i] = GetRandHash();
+        indexesRet[i].phashBlock = &blockHashesRet[i];
+        indexesRet[i].nHeight = (int)i;
+        indexesRet[i].pprev = i > 0 ? &indexesRet[i - 1] : nullptr;
+    }
+
+    CDeterministicMNList mnList(blockHashesRet[0], 0, 0);
+    std::vector<uint256> proTxHashes;
+    for (size_t i = 0; i < MNLIST_MN_COUNT; i++) {
+        CBLSSecretKey operatorKey;
+        operatorKey.MakeNewKey();
+
+        uint160 ownerKeyHash;
+        GetRandBytes(ownerKeyHash.begin(), ownerKeyHash.size());
+
+        auto dmnState = std::make_shared<CDeterministicMNState>();
+        dmnState->keyIDOwner = CKeyID(ownerKeyHash);
+        dmnState->keyIDVoting = dmnState->keyIDOwner;
+        dmnState->pubKeyOperator.Set(operatorKey.GetPublicKey());
+
+        auto dmn = std::make_shared<CDeterministicMN>();
+        dmn->proTxHash = GetRandHash();
+        dmn->internalId = i;
+        dmn->collateralOutpoint = COutPoint(GetRandHash(), 0);
+        dmn->nOperatorReward = 0;
+        dmn->pdmnState = dmnState;
+        mnList.AddMN(dmn);
+        proTxHashes.emplace_back(dmn->proTxHash);
+    }
+    evoDb.Write(std::make_pair(BENCH_DB_LIST_SNAPSHOT_COMPACT, blockHashesRet[0]), CDeterministicMNListCompact(mnList));
+
+    for (size_t i = 1; i < blockCount; i++) {
+        CDeterministicMNList newList = mnList;
+        newList.SetBlockHash(blockHashesRet[i]);
+        newList.SetHeight((int)i);
+        for (size_t j = 0; j < MNLIST_DIFF_UPDATES; j++) {
+            auto dmn = newList.GetMN(proTxHashes[GetRand(proTxHashes.size())]);
+            CBLSSecretKey operatorKey;
+            operatorKey.MakeNewKey();
+            auto newState = std::make_shared<CDeterministicMNState>(*dmn->pdmnState);
+            newState->pubKeyOperator.Set(operatorKey.GetPublicKey());
+            newList.UpdateMN(dmn->proTxHash, newState);
+        }
+        evoDb.Write(std::make_pair(BENCH_DB_LIST_DIFF_COMPACT, blockHashesRet[i]), CDeterministicMNListDiffCompact(mnList.BuildDiff(newList)));
+        mnList = newList;
+    }
+    evoDb.CommitRootTransaction();
+}
+
+static void DeterministicMNList_GetListForBlock(benchmark::State& state, bool useKeyCache)
+{
+    CBLSPublicKeyCache::SetMaxSize(useKeyCache ? CBLSPublicKeyCache::DEFAULT_MAX_SIZE : 0);
+
+    CEvoDB evoDb(1 << 20, true, true);
+    std::vector<uint256> blockHashes;
+    std::vector<CBlockIndex> indexes;
+    BuildMNListChain(evoDb, blockHashes, indexes);
+
+    while (state.KeepRunning()) {
+        // a fresh manager has no cached lists, so the snapshot and all diffs are loaded from EvoDB every time
+        CDeterministicMNManager mnManager(evoDb);
+        auto mnList = mnManager.GetListForBlock(&indexes.back());
+        assert(mnList.GetAllMNsCount() == MNLIST_MN_COUNT);
+    }
+
+    CBLSPublicKeyCache::SetMaxSize(CBLSPublicKeyCache::DEFAULT_MAX_SIZE);
+}
+
+static void DeterministicMNList_GetListForBlock_KeyCache(benchmark::State& state)
+{
+    DeterministicMNList_GetListForBlock(state, true);
+}
+
+static void DeterministicMNList_GetListForBlock_NoKeyCache(benchmark::State& state)
+{
+    DeterministicMNList_GetListForBlock(state, false);
+}
+
+BENCHMARK(DeterministicMNList_GetListForBlock_KeyCache)
+BENCHMARK(DeterministicMNList_GetListForBlock_NoKeyCache)
@@ -0,0 +1,97 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "random.h"
+#include "sync.h"
+#include "util.h"
+
+#include "llmq/quorums_signing_shares.h"
+
+#include <boost/thread/thread.hpp>
+
+using namespace llmq;
+
+// Simulates a 400 member quorum with hundreds of signing sessions in parallel. Each thread plays the role of a
+// message handler receiving shares from a subset of the members for all sessions.
+static const size_t QUORUM_SIZE = 400;
+static const size_t SESSION_COUNT = 200;
+static const int MIN_CORES = 2;
+
+static std::vector<CSigShare> BuildSigShares()
+{
+    std::vector<CSigShare> ret;
+    ret.reserve(QUORUM_SIZE * SESSION_COUNT);
+
+    uint256 quorumHash = GetRandHash();
+    for (size_t i = 0; i < SESSION_COUNT; i++) {
+        uint256 id = GetRandHash();
+        uint256 msgHash = GetRandHash();
+        for (size_t j = 0; j < QUORUM_SIZE; j++) {
+            CSigShare sigShare;
+            sigShare.llmqType = Consensus::LLMQ_400_60;
+            sigShare.quorumHash = quorumHash;
+            sigShare.quorumMember = (uint16_t)j;
+            sigShare.id = id;
+            sigShare.msgHash = msgHash;
+            sigShare.UpdateKey();
+            ret.emplace_back(sigShare);
+        }
+    }
+    return ret;
+}
+
+template<typename F>
+static void RunThreads(size_t threadCount, F&& f)
+{
+    boost::thread_group tg;
+    for (size_t i = 0; i < threadCount; i++) {
+        tg.create_thread([&, i]{ f(i); });
+    }
+    tg.join_all();
+}
+
+static void SigShares_SingleLock_400x200(benchmark::State& state)
+{
+    auto sigShares = BuildSigShares();
+    size_t threadCount = (size_t)std::max(MIN_CORES, GetNumCores());
+
+    while (state.KeepRunning()) {
+        CCriticalSection cs;
+        SigShareMap<CSigShare> m;
+        RunThreads(threadCount, [&](size_t threadIdx) {
+            for (size_t i = threadIdx; i < sigShares.size(); i += threadCount) {
+                auto& sigShare = sigShares[i];
+                LOCK(cs);
+                if (!m.Has(sigShare.GetKey())) {
+                    m.Add(sigShare.GetKey(), sigShare);
+                    m.CountForSignHash(sigShare.GetSignHash());
+                }
+            }
+        });
+        assert(m.Size() == sigShares.size());
+    }
+}
+
+static void SigShares_Sharded_400x200(benchmark::State& state)
+{
+    auto sigShares = BuildSigShares();
+    size_t threadCount = (size_t)std::max(MIN_CORES, GetNumCores());
+
+    while (state.KeepRunning()) {
+        CSigSharesStore store;
+        RunThreads(threadCount, [&](size_t threadIdx) {
+            for (size_t i = threadIdx; i < sigShares.size(); i += threadCount) {
+                auto& sigShare = sigShares[i];
+                if (!store.Has(sigShare.GetKey())) {
+                    store.Add(sigShare, 0);
+                }
+            }
+        });
+        assert(store.Size() == sigShares.size());
+    }
+}
+
+BENCHMARK(SigShares_SingleLock_400x200)
+BENCHMARK(SigShares_Sharded_400x200)
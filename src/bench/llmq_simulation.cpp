@@ -0,0 +1,752 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "activemasternode.h"
+#include "base58.h"
+#include "chain.h"
+#include "chainparams.h"
+#include "consensus/merkle.h"
+#include "consensus/validation.h"
+#include "hash.h"
+#include "net.h"
+#include "protocol.h"
+#include "spork.h"
+#include "streams.h"
+#include "tinyformat.h"
+#include "util.h"
+#include "utiltime.h"
+#include "validation.h"
+#include "version.h"
+
+#include "bls/bls_worker.h"
+#include "evo/deterministicmns.h"
+#include "evo/evodb.h"
+#include "evo/specialtx.h"
+#include "llmq/quorums.h"
+#include "llmq/quorums_blockprocessor.h"
+#include "llmq/quorums_commitment.h"
+#include "llmq/quorums_dkgsession.h"
+#include "llmq/quorums_dkgsessionhandler.h"
+#include "llmq/quorums_dkgsessionmgr.h"
+#include "llmq/quorums_init.h"
+#include "llmq/quorums_instantsend.h"
+#include "llmq/quorums_signing.h"
+#include "llmq/quorums_signing_shares.h"
+#include "llmq/quorums_utils.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+
+// Simulation of a LLMQ with a local masternode and simulated members, driving the real CDKGSession,
+// CQuorumBlockProcessor, CQuorumManager, CSigningManager, CSigSharesManager and CInstantSendManager against an
+// in-memory EvoDB and a CConnman without connections. The simulated members create their DKG messages and sig shares
+// with their own keys, which are then fed into the managers the same way as messages received from peers.
+// Only the local masternode runs the real code, as the managers are process wide singletons.
+// CChainLocksHandler is not instantiated, as it needs a scheduler and enforces ChainLocks on the chain state. The
+// ChainLock benchmarks sign the same request ids through CSigningManager instead, like the handler does.
+// Besides the usual bench output, latency percentiles of the simulated requests are printed as comment lines.
+
+static const size_t SIM_MN_COUNT = 50;
+static const size_t SIM_ISLOCK_TX_COUNT = 32;
+static const size_t SIM_ISLOCK_TX_INPUTS = 2;
+static const size_t SIM_CHAINLOCK_BLOCK_COUNT = 4;
+
+// Regtest LLMQs start their DKG every 24 blocks and mine the commitment in blocks 10-18 of the interval. The first DKG
+// after DIP3 activation is used for signing, which requires the chain to be SIGN_HEIGHT_OFFSET blocks past the commitment
+static const int SIM_DKG_HEIGHT = 432;
+static const int SIM_MINED_HEIGHT = SIM_DKG_HEIGHT + 10;
+static const int SIM_SIGN_HEIGHT = SIM_MINED_HEIGHT + 18;
+
+static const uint32_t SIM_GENESIS_TIME = 1417713337;
+// Nonces of the blocks used by the DKG benchmarks, which fork off the block before the DKG block
+static const uint32_t SIM_SIDE_BLOCK_NONCE = 0x80000000;
+
+// Same as CDKGSessionHandler
+static const size_t SIM_DKG_MESSAGE_BATCH_SIZE = 8;
+// Same as CSigSharesManager
+static const size_t SIM_MAX_MSGS_CNT_QSIGSESANN = 100;
+
+static const int64_t SIM_WAIT_TIMEOUT = 60;
+
+static const std::string SIM_INPUTLOCK_REQUESTID_PREFIX = "inlock";
+static const std::string SIM_CLSIG_REQUESTID_PREFIX = "clsig";
+
+// EvoDB keys used by CDeterministicMNManager for compact snapshots and diffs
+static const std::string SIM_DB_LIST_SNAPSHOT_COMPACT = "dmn_S2";
+static const std::string SIM_DB_LIST_DIFF_COMPACT = "dmn_D2";
+
+// Waits for recovered sigs and completes the input locks of InstantSend transactions. CInstantSendManager only
+// handles input locks of transactions it has seen through ProcessTx, which needs the UTXO set, so this continues
+// with TrySignInstantSendLock like CInstantSendManager::HandleNewInputLockRecoveredSig does
+class CSimRecoveredSigsListener : public llmq::CRecoveredSigsListener
+{
+private:
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::map<uint256, int64_t> expectedIds;
+    std::map<uint256, CTransactionRef> inputIds;
+
+public:
+    void Expect(const uint256& id, const CTransactionRef& tx = nullptr)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        expectedIds.emplace(id, 0);
+        if (tx) {
+            inputIds.emplace(id, tx);
+        }
+    }
+
+    // Returns the times at which the recovered sigs for all expected ids arrived
+    std::map<uint256, int64_t> Wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        bool done = cond.wait_for(lock, std::chrono::seconds(SIM_WAIT_TIMEOUT), [&]() {
+            for (const auto& p : expectedIds) {
+                if (p.second == 0) {
+                    return false;
+                }
+            }
+            return true;
+        });
+        assert(done);
+
+        std::map<uint256, int64_t> ret;
+        ret.swap(expectedIds);
+        inputIds.clear();
+        return ret;
+    }
+
+    virtual void HandleNewRecoveredSig(const llmq::CRecoveredSig& recoveredSig)
+    {
+        CTransactionRef tx;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = expectedIds.find(recoveredSig.id);
+            if (it == expectedIds.end()) {
+                return;
+            }
+            it->second = GetTimeMicros();
+            auto it2 = inputIds.find(recoveredSig.id);
+            if (it2 != inputIds.end()) {
+                tx = it2->second;
+            }
+        }
+        cond.notify_all();
+
+        if (tx) {
+            llmq::quorumInstantSendManager->TrySignInstantSendLock(*tx);
+        }
+    }
+};
+
+struct CSimSigningRequest
+{
+    uint256 id;
+    uint256 msgHash;
+};
+
+class CLLMQSimEnv
+{
+private:
+    uint64_t nextSimHash{0};
+    uint32_t nextSideBlockNonce{SIM_SIDE_BLOCK_NONCE};
+    uint32_t nextSessionId{0};
+
+    std::deque<uint256> blockHashes;
+    std::deque<CBlockIndex> blockIndexes;
+    std::vector<CBlockIndex*> chain;
+
+    std::map<uint256, CBLSSecretKey> operatorKeys;
+    std::map<uint256, std::unique_ptr<CNode>> nodes;
+    uint256 myProTxHash;
+
+    // secret key shares of the simulated members in the quorums used for signing
+    std::map<Consensus::LLMQType, std::map<uint256, CBLSSecretKey>> skShares;
+
+    CSimRecoveredSigsListener listener;
+
+public:
+    CLLMQSimEnv()
+    {
+        SelectParams(CBaseChainParams::REGTEST);
+
+        // CSigSharesManager::Cleanup deletes the node states of all peers which are not connected through CConnman,
+        // which would drop the sessions announced by the simulated members. With a frozen clock, it only runs once
+        SetMockTime(GetTime());
+
+        evoDb = new CEvoDB(1 << 20, true, true);
+        deterministicMNManager = new CDeterministicMNManager(*evoDb);
+        g_connman = std::unique_ptr<CConnman>(new CConnman(0x1337, 0x1337));
+
+        SetupSporks();
+
+        llmq::InitLLMQSystem(*evoDb, nullptr, true);
+        llmq::blsWorker->Start();
+        llmq::quorumSigSharesManager->RegisterAsRecoveredSigsListener();
+        llmq::quorumSigSharesManager->StartWorkerThread();
+        llmq::quorumInstantSendManager->Start();
+        llmq::quorumSigningManager->RegisterRecoveredSigsListener(&listener);
+
+        CDeterministicMNList mnList = BuildMNList();
+        AppendBlock({});
+        mnList.SetBlockHash(chain[0]->GetBlockHash());
+        evoDb->Write(std::make_pair(SIM_DB_LIST_SNAPSHOT_COMPACT, chain[0]->GetBlockHash()), CDeterministicMNListCompact(mnList));
+        while ((int)chain.size() <= SIM_DKG_HEIGHT) {
+            WriteEmptyMNListDiff(AppendBlock({})->GetBlockHash());
+        }
+
+        // the smallest quorum decides which masternode runs locally
+        auto members = llmq::CLLMQUtils::GetAllQuorumMembers(Consensus::LLMQ_5_60, chain.back());
+        myProTxHash = members[0]->proTxHash;
+        fMasternodeMode = true;
+        activeMasternodeInfo.proTxHash = myProTxHash;
+        activeMasternodeInfo.blsKeyOperator.reset(new CBLSSecretKey(operatorKeys.at(myProTxHash)));
+        activeMasternodeInfo.blsPubKeyOperator.reset(new CBLSPublicKey(operatorKeys.at(myProTxHash).GetPublicKey()));
+
+        std::vector<CMutableTransaction> commitmentTxs;
+        for (const auto& p : Params().GetConsensus().llmqs) {
+            llmq::CFinalCommitment fqc;
+            RunDKG(p.first, chain.back(), fqc, skShares[p.first]);
+
+            llmq::CFinalCommitmentTxPayload qc;
+            qc.nHeight = SIM_MINED_HEIGHT;
+            qc.commitment = fqc;
+            CMutableTransaction tx;
+            tx.nVersion = 3;
+            tx.nType = TRANSACTION_QUORUM_COMMITMENT;
+            SetTxPayload(tx, qc);
+            commitmentTxs.emplace_back(tx);
+        }
+
+        while ((int)chain.size() < SIM_MINED_HEIGHT) {
+            WriteEmptyMNListDiff(AppendBlock({})->GetBlockHash());
+        }
+        CBlock block;
+        auto pindexMined = AppendBlock(commitmentTxs, &block);
+        WriteEmptyMNListDiff(pindexMined->GetBlockHash());
+        {
+            LOCK(cs_main);
+            CValidationState state;
+            bool ok = llmq::quorumBlockProcessor->ProcessBlock(block, pindexMined, state);
+            assert(ok);
+        }
+        while ((int)chain.size() <= SIM_SIGN_HEIGHT) {
+            WriteEmptyMNListDiff(AppendBlock({})->GetBlockHash());
+        }
+
+        mnList.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) {
+            CAddress addr(CService(CNetAddr(), 0), NODE_NETWORK);
+            nodes.emplace(dmn->proTxHash, std::unique_ptr<CNode>(new CNode((NodeId)dmn->internalId, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, "", true)));
+        });
+    }
+
+    ~CLLMQSimEnv()
+    {
+        llmq::quorumSigningManager->UnregisterRecoveredSigsListener(&listener);
+        llmq::quorumSigSharesManager->InterruptWorkerThread();
+        llmq::quorumInstantSendManager->InterruptWorkerThread();
+        llmq::quorumInstantSendManager->Stop();
+        llmq::quorumSigSharesManager->StopWorkerThread();
+        llmq::quorumSigSharesManager->UnregisterAsRecoveredSigsListener();
+        llmq::blsWorker->Stop();
+        llmq::DestroyLLMQSystem();
+
+        nodes.clear();
+        {
+            LOCK(cs_main);
+            for (const auto& hash : blockHashes) {
+                mapBlockIndex.erase(hash);
+            }
+            chainActive.SetTip(nullptr);
+        }
+
+        delete deterministicMNManager;
+        deterministicMNManager = nullptr;
+        delete evoDb;
+        evoDb = nullptr;
+        g_connman.reset();
+
+        fMasternodeMode = false;
+        activeMasternodeInfo.proTxHash = uint256();
+        activeMasternodeInfo.blsKeyOperator.reset();
+        activeMasternodeInfo.blsPubKeyOperator.reset();
+        sporkManager.Clear();
+        SetMockTime(0);
+    }
+
+    // Runs a DKG on a new block at the DKG height and returns the time spent in the local session
+    int64_t RunSideDKG(Consensus::LLMQType llmqType)
+    {
+        const CBlockIndex* pindexQuorum;
+        do {
+            pindexQuorum = AppendSideBlock();
+        } while (!IsQuorumMember(llmqType, pindexQuorum));
+
+        llmq::CFinalCommitment fqc;
+        std::map<uint256, CBLSSecretKey> sideSkShares;
+        return RunDKG(llmqType, pindexQuorum, fqc, sideSkShares);
+    }
+
+    // Returns the latency of each transaction, measured from the start of signing until its ISLOCK is created
+    std::vector<int64_t> RunInstantSend(size_t txCount, size_t inputCount)
+    {
+        auto llmqType = Params().GetConsensus().llmqForInstaEPM;
+
+        std::vector<CTransactionRef> txs;
+        std::vector<CSimSigningRequest> requests;
+        std::vector<uint256> islockIds;
+        for (size_t i = 0; i < txCount; i++) {
+            CMutableTransaction mtx;
+            for (size_t j = 0; j < inputCount; j++) {
+                mtx.vin.emplace_back(COutPoint(MakeSimHash(), 0));
+            }
+            auto tx = MakeTransactionRef(mtx);
+
+            llmq::CInstantSendLock islock;
+            islock.txid = tx->GetHash();
+            for (const auto& in : tx->vin) {
+                auto id = ::SerializeHash(std::make_pair(SIM_INPUTLOCK_REQUESTID_PREFIX, in.prevout));
+                requests.push_back({id, tx->GetHash()});
+                listener.Expect(id, tx);
+                islock.inputs.emplace_back(in.prevout);
+            }
+            requests.push_back({islock.GetRequestId(), tx->GetHash()});
+            listener.Expect(islock.GetRequestId());
+            islockIds.emplace_back(islock.GetRequestId());
+            txs.emplace_back(tx);
+        }
+
+        auto messages = BuildSigShareMessages(llmqType, requests);
+
+        int64_t nStartTime = GetTimeMicros();
+        SendSigShareMessages(messages);
+        for (const auto& tx : txs) {
+            for (const auto& in : tx->vin) {
+                auto id = ::SerializeHash(std::make_pair(SIM_INPUTLOCK_REQUESTID_PREFIX, in.prevout));
+                llmq::quorumSigningManager->AsyncSignIfMember(llmqType, id, tx->GetHash());
+            }
+        }
+        auto times = listener.Wait();
+
+        std::vector<int64_t> latencies;
+        for (size_t i = 0; i < txs.size(); i++) {
+            assert(llmq::quorumInstantSendManager->IsLocked(txs[i]->GetHash()));
+            latencies.emplace_back(times.at(islockIds[i]) - nStartTime);
+        }
+        return latencies;
+    }
+
+    // Returns the latency of each ChainLock signature, measured from the arrival of the new block
+    std::vector<int64_t> RunChainLocks(size_t blockCount)
+    {
+        auto llmqType = Params().GetConsensus().llmqChainLocks;
+
+        std::vector<int64_t> latencies;
+        for (size_t i = 0; i < blockCount; i++) {
+            // MN list diffs are not written for these blocks, as EvoDB is read without locks by the worker threads.
+            // Nothing needs the MN list of blocks after the quorum block
+            auto pindex = AppendBlock({});
+            auto id = ::SerializeHash(std::make_pair(SIM_CLSIG_REQUESTID_PREFIX, pindex->nHeight));
+            listener.Expect(id);
+
+            auto messages = BuildSigShareMessages(llmqType, {{id, pindex->GetBlockHash()}});
+
+            int64_t nStartTime = GetTimeMicros();
+            SendSigShareMessages(messages);
+            llmq::quorumSigningManager->AsyncSignIfMember(llmqType, id, pindex->GetBlockHash());
+            auto times = listener.Wait();
+            latencies.emplace_back(times.at(id) - nStartTime);
+
+            llmq::CRecoveredSig recSig;
+            bool ok = llmq::quorumSigningManager->GetRecoveredSigForId(llmqType, id, recSig);
+            assert(ok);
+            ok = llmq::quorumSigningManager->VerifyRecoveredSig(llmqType, pindex->nHeight, id, pindex->GetBlockHash(), recSig.sig.Get());
+            assert(ok);
+        }
+        return latencies;
+    }
+
+private:
+    uint256 MakeSimHash()
+    {
+        return ::SerializeHash(std::make_pair(std::string("llmqsim"), nextSimHash++));
+    }
+
+    void SetupSporks()
+    {
+        CKey sporkKey;
+        sporkKey.MakeNewKey(false);
+        CBitcoinAddress sporkAddress;
+        sporkAddress.Set(sporkKey.GetPubKey().GetID());
+        sporkManager.SetSporkAddress(sporkAddress.ToString());
+        sporkManager.SetPrivKey(CBitcoinSecret(sporkKey).ToString());
+        sporkManager.UpdateSpork(SPORK_20_INSTANTSEND_LLMQ_BASED, 0, *g_connman);
+    }
+
+    CDeterministicMNList BuildMNList()
+    {
+        CDeterministicMNList mnList(uint256(), 0, SIM_MN_COUNT);
+        for (size_t i = 0; i < SIM_MN_COUNT; i++) {
+            CBLSSecretKey operatorKey;
+            do {
+                uint256 seed = MakeSimHash();
+                operatorKey.SetBuf(seed.begin(), seed.size());
+            } while (!operatorKey.IsValid());
+
+            auto dmn = std::make_shared<CDeterministicMN>();
+            dmn->proTxHash = MakeSimHash();
+            dmn->internalId = i;
+            dmn->collateralOutpoint = COutPoint(MakeSimHash(), 0);
+            dmn->nOperatorReward = 0;
+
+            auto dmnState = std::make_shared<CDeterministicMNState>();
+            uint256 ownerSeed = MakeSimHash();
+            dmnState->keyIDOwner = CKeyID(Hash160(ownerSeed.begin(), ownerSeed.end()));
+            dmnState->keyIDVoting = dmnState->keyIDOwner;
+            dmnState->pubKeyOperator.Set(operatorKey.GetPublicKey());
+            // masternodes without a confirmed hash are not part of any quorum
+            dmnState->UpdateConfirmedHash(dmn->proTxHash, MakeSimHash());
+            dmn->pdmnState = dmnState;
+
+            mnList.AddMN(dmn);
+            operatorKeys.emplace(dmn->proTxHash, operatorKey);
+        }
+        return mnList;
+    }
+
+    void WriteEmptyMNListDiff(const uint256& blockHash)
+    {
+        evoDb->Write(std::make_pair(SIM_DB_LIST_DIFF_COMPACT, blockHash), CDeterministicMNListDiffCompact(CDeterministicMNListDiff()));
+    }
+
+    CBlockIndex* AddBlockIndex(const CBlock& block, CBlockIndex* pprev)
+    {
+        blockHashes.emplace_back(block.GetHash());
+        blockIndexes.emplace_back(block);
+        CBlockIndex* pindex = &blockIndexes.back();
+        pindex->phashBlock = &blockHashes.back();
+        pindex->pprev = pprev;
+        pindex->nHeight = pprev ? pprev->nHeight + 1 : 0;
+        pindex->BuildSkip();
+        return pindex;
+    }
+
+    // Appends a block to the active chain and notifies the signing manager about the new tip
+    CBlockIndex* AppendBlock(const std::vector<CMutableTransaction>& txs, CBlock* blockRet = nullptr)
+    {
+        CBlock block;
+        block.nVersion = 1;
+        block.hashPrevBlock = chain.empty() ? uint256() : chain.back()->GetBlockHash();
+        block.nTime = SIM_GENESIS_TIME + (uint32_t)chain.size() * 150;
+        block.nBits = 0x207fffff;
+        block.nNonce = (uint32_t)chain.size();
+        for (const auto& tx : txs) {
+            block.vtx.emplace_back(MakeTransactionRef(tx));
+        }
+        block.hashMerkleRoot = BlockMerkleRoot(block);
+
+        CBlockIndex* pindex = AddBlockIndex(block, chain.empty() ? nullptr : chain.back());
+        chain.emplace_back(pindex);
+        {
+            LOCK(cs_main);
+            mapBlockIndex.emplace(pindex->GetBlockHash(), pindex);
+            chainActive.SetTip(pindex);
+        }
+        llmq::quorumSigningManager->UpdatedBlockTip(pindex);
+
+        if (blockRet) {
+            *blockRet = block;
+        }
+        return pindex;
+    }
+
+    // Adds a block at the DKG height which is not part of the active chain
+    const CBlockIndex* AppendSideBlock()
+    {
+        CBlockIndex* pprev = chain[SIM_DKG_HEIGHT - 1];
+        CBlock block;
+        block.nVersion = 1;
+        block.hashPrevBlock = pprev->GetBlockHash();
+        block.nTime = SIM_GENESIS_TIME + SIM_DKG_HEIGHT * 150;
+        block.nBits = 0x207fffff;
+        block.nNonce = nextSideBlockNonce++;
+        block.hashMerkleRoot = BlockMerkleRoot(block);
+
+        CBlockIndex* pindex = AddBlockIndex(block, pprev);
+        WriteEmptyMNListDiff(pindex->GetBlockHash());
+        return pindex;
+    }
+
+    bool IsQuorumMember(Consensus::LLMQType llmqType, const CBlockIndex* pindexQuorum)
+    {
+        for (const auto& dmn : llmq::CLLMQUtils::GetAllQuorumMembers(llmqType, pindexQuorum)) {
+            if (dmn->proTxHash == myProTxHash) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Runs all DKG phases of the local session, with the messages of the simulated members pushed in the same way as
+    // messages received from peers. Returns the time spent in the local session, which excludes the work of the
+    // simulated members
+    int64_t RunDKG(Consensus::LLMQType llmqType, const CBlockIndex* pindexQuorum, llmq::CFinalCommitment& fqcRet, std::map<uint256, CBLSSecretKey>& skSharesRet)
+    {
+        const auto& params = Params().GetConsensus().llmqs.at(llmqType);
+        auto members = llmq::CLLMQUtils::GetAllQuorumMembers(llmqType, pindexQuorum);
+
+        size_t myIdx = members.size();
+        BLSIdVector memberIds;
+        for (size_t i = 0; i < members.size(); i++) {
+            if (members[i]->proTxHash == myProTxHash) {
+                myIdx = i;
+            }
+            memberIds.emplace_back(CBLSId::FromHash(members[i]->proTxHash));
+        }
+        assert(myIdx < members.size());
+
+        llmq::CDKGPendingMessages pendingContributions((size_t)params.size * 2);
+        llmq::CDKGPendingMessages pendingComplaints((size_t)params.size * 2);
+        llmq::CDKGPendingMessages pendingJustifications((size_t)params.size * 2);
+        llmq::CDKGPendingMessages pendingPrematureCommitments((size_t)params.size * 2);
+
+        std::vector<BLSVerificationVectorPtr> vvecs(members.size());
+        std::vector<BLSSecretKeyVector> skContributions(members.size());
+        for (size_t i = 0; i < members.size(); i++) {
+            if (i == myIdx) {
+                continue;
+            }
+            bool ok = llmq::blsWorker->GenerateContributions(params.threshold, memberIds, vvecs[i], skContributions[i]);
+            assert(ok);
+
+            llmq::CDKGContribution qc;
+            qc.llmqType = (uint8_t)llmqType;
+            qc.quorumHash = pindexQuorum->GetBlockHash();
+            qc.proTxHash = members[i]->proTxHash;
+            qc.vvec = vvecs[i];
+            qc.contributions = std::make_shared<CBLSIESMultiRecipientObjects<CBLSSecretKey>>();
+            qc.contributions->InitEncrypt(members.size());
+            for (size_t j = 0; j < members.size(); j++) {
+                ok = qc.contributions->Encrypt(j, members[j]->pdmnState->pubKeyOperator.Get(), skContributions[i][j], PROTOCOL_VERSION);
+                assert(ok);
+            }
+            qc.sig = operatorKeys.at(qc.proTxHash).Sign(qc.GetSignHash());
+            pendingContributions.PushPendingMessage((NodeId)i, qc);
+        }
+
+        int64_t nDuration = 0;
+        int64_t nStartTime = GetTimeMicros();
+
+        llmq::CDKGSession session(params, *llmq::blsWorker, *llmq::quorumDKGSessionManager);
+        bool ok = session.Init(pindexQuorum, members, myProTxHash);
+        assert(ok);
+        // the own contribution goes into a separate queue, so that the simulated members can decrypt their share
+        llmq::CDKGPendingMessages ownContribution(1);
+        session.Contribute(ownContribution);
+
+        nDuration += GetTimeMicros() - nStartTime;
+
+        auto ownMsgs = ownContribution.PopAndDeserializeMessages<llmq::CDKGContribution>(1);
+        assert(ownMsgs.size() == 1 && ownMsgs[0].second);
+        auto& ownQc = *ownMsgs[0].second;
+        vvecs[myIdx] = ownQc.vvec;
+        for (size_t j = 0; j < members.size(); j++) {
+            if (j == myIdx) {
+                continue;
+            }
+            CBLSSecretKey skContribution;
+            ok = ownQc.contributions->Decrypt(j, operatorKeys.at(members[j]->proTxHash), skContribution, PROTOCOL_VERSION);
+            assert(ok);
+
+            BLSSecretKeyVector memberSkContributions;
+            for (size_t i = 0; i < members.size(); i++) {
+                memberSkContributions.emplace_back(i == myIdx ? skContribution : skContributions[i][j]);
+            }
+            skSharesRet[members[j]->proTxHash] = llmq::blsWorker->AggregateSecretKeys(memberSkContributions);
+        }
+        auto quorumVvec = llmq::blsWorker->BuildQuorumVerificationVector(vvecs);
+        assert(quorumVvec != nullptr);
+        pendingContributions.PushPendingMessage(-1, ownQc);
+
+        nStartTime = GetTimeMicros();
+
+        while (llmq::ProcessPendingMessageBatch<llmq::CDKGContribution>(session, pendingContributions, SIM_DKG_MESSAGE_BATCH_SIZE)) {}
+        session.VerifyAndComplain(pendingComplaints);
+        while (llmq::ProcessPendingMessageBatch<llmq::CDKGComplaint>(session, pendingComplaints, SIM_DKG_MESSAGE_BATCH_SIZE)) {}
+        session.VerifyAndJustify(pendingJustifications);
+        while (llmq::ProcessPendingMessageBatch<llmq::CDKGJustification>(session, pendingJustifications, SIM_DKG_MESSAGE_BATCH_SIZE)) {}
+        session.VerifyAndCommit(pendingPrematureCommitments);
+
+        nDuration += GetTimeMicros() - nStartTime;
+
+        for (size_t i = 0; i < members.size(); i++) {
+            if (i == myIdx) {
+                continue;
+            }
+            llmq::CDKGPrematureCommitment qc(params);
+            qc.llmqType = (uint8_t)llmqType;
+            qc.quorumHash = pindexQuorum->GetBlockHash();
+            qc.proTxHash = members[i]->proTxHash;
+            for (size_t j = 0; j < members.size(); j++) {
+                qc.validMembers[j] = true;
+            }
+            qc.quorumPublicKey = (*quorumVvec)[0];
+            qc.quorumVvecHash = ::SerializeHash(*quorumVvec);
+            uint256 commitmentHash = qc.GetSignHash();
+            qc.sig = operatorKeys.at(qc.proTxHash).Sign(commitmentHash);
+            qc.quorumSig = skSharesRet.at(qc.proTxHash).Sign(commitmentHash);
+            pendingPrematureCommitments.PushPendingMessage((NodeId)i, qc);
+        }
+
+        nStartTime = GetTimeMicros();
+
+        while (llmq::ProcessPendingMessageBatch<llmq::CDKGPrematureCommitment>(session, pendingPrematureCommitments, SIM_DKG_MESSAGE_BATCH_SIZE)) {}
+        auto fqcs = session.FinalizeCommitments();
+
+        nDuration += GetTimeMicros() - nStartTime;
+
+        assert(fqcs.size() == 1 && fqcs[0].Verify(members, true));
+        fqcRet = fqcs[0];
+        return nDuration;
+    }
+
+    // Builds the QSIGSESANN and QBSIGSHARES messages of threshold-1 simulated members, so that the signatures are only
+    // recovered after the local masternode signed as well
+    std::vector<std::pair<CNode*, std::vector<CDataStream>>> BuildSigShareMessages(Consensus::LLMQType llmqType, const std::vector<CSimSigningRequest>& requests)
+    {
+        const auto& params = Params().GetConsensus().llmqs.at(llmqType);
+        auto quorum = llmq::quorumManager->GetQuorum(llmqType, chain[SIM_DKG_HEIGHT]->GetBlockHash());
+        assert(quorum);
+
+        std::vector<std::pair<CNode*, std::vector<CDataStream>>> ret;
+        for (size_t i = 0; i < quorum->members.size() && (int)ret.size() < params.threshold - 1; i++) {
+            const auto& proTxHash = quorum->members[i]->proTxHash;
+            if (proTxHash == myProTxHash || !quorum->qc.validMembers[i]) {
+                continue;
+            }
+            const auto& skShare = skShares.at(llmqType).at(proTxHash);
+
+            std::vector<CDataStream> msgs;
+            for (size_t start = 0; start < requests.size(); start += SIM_MAX_MSGS_CNT_QSIGSESANN) {
+                std::vector<llmq::CSigSesAnn> anns;
+                std::vector<llmq::CBatchedSigShares> batches;
+                for (size_t j = start; j < std::min(start + SIM_MAX_MSGS_CNT_QSIGSESANN, requests.size()); j++) {
+                    llmq::CSigSesAnn ann;
+                    ann.sessionId = nextSessionId++;
+                    ann.llmqType = (uint8_t)llmqType;
+                    ann.quorumHash = quorum->qc.quorumHash;
+                    ann.id = requests[j].id;
+                    ann.msgHash = requests[j].msgHash;
+                    anns.emplace_back(ann);
+
+                    llmq::CBatchedSigShares batch;
+                    batch.sessionId = ann.sessionId;
+                    CBLSLazySignature sig;
+                    sig.Set(skShare.Sign(llmq::CLLMQUtils::BuildSignHash(ann)));
+                    batch.sigShares.emplace_back((uint16_t)i, sig);
+                    batches.emplace_back(batch);
+                }
+                msgs.emplace_back(SER_NETWORK, PROTOCOL_VERSION);
+                msgs.back() << anns;
+                msgs.emplace_back(SER_NETWORK, PROTOCOL_VERSION);
+                msgs.back() << batches;
+            }
+            ret.emplace_back(nodes.at(proTxHash).get(), std::move(msgs));
+        }
+        return ret;
+    }
+
+    void SendSigShareMessages(std::vector<std::pair<CNode*, std::vector<CDataStream>>>& messages)
+    {
+        for (auto& p : messages) {
+            for (size_t i = 0; i < p.second.size(); i += 2) {
+                llmq::quorumSigSharesManager->ProcessMessage(p.first, NetMsgType::QSIGSESANN, p.second[i], *g_connman);
+                llmq::quorumSigSharesManager->ProcessMessage(p.first, NetMsgType::QBSIGSHARES, p.second[i + 1], *g_connman);
+            }
+        }
+    }
+};
+
+static std::unique_ptr<CLLMQSimEnv> simEnv;
+
+// Building the chain and running the initial DKGs is expensive, so the environment is shared by all benchmarks
+static CLLMQSimEnv& GetSimEnv()
+{
+    if (!simEnv) {
+        simEnv.reset(new CLLMQSimEnv());
+    }
+    return *simEnv;
+}
+
+static void PrintLatencies(const std::string& name, std::vector<int64_t> latencies)
+{
+    if (latencies.empty()) {
+        return;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](size_t p) {
+        return latencies[std::min(latencies.size() - 1, latencies.size() * p / 100)];
+    };
+    std::cout << strprintf("# %s latency (us): count=%d, p50=%d, p90=%d, p99=%d, max=%d",
+                           name, latencies.size(), percentile(50), percentile(90), percentile(99), latencies.back()) << std::endl;
+}
+
+static void LLMQSim_DKG(benchmark::State& state, Consensus::LLMQType llmqType, size_t quorumSize)
+{
+    auto& env = GetSimEnv();
+    std::vector<int64_t> durations;
+    while (state.KeepRunning()) {
+        durations.emplace_back(env.RunSideDKG(llmqType));
+    }
+    PrintLatencies(strprintf("LLMQSim_DKG_%d", quorumSize), durations);
+}
+
+static void LLMQSim_ISLock(benchmark::State& state, Consensus::LLMQType llmqType, size_t quorumSize)
+{
+    auto& env = GetSimEnv();
+    UpdateRegtestLLMQTypes(Consensus::LLMQ_5_60, llmqType);
+    std::vector<int64_t> latencies;
+    while (state.KeepRunning()) {
+        auto l = env.RunInstantSend(SIM_ISLOCK_TX_COUNT, SIM_ISLOCK_TX_INPUTS);
+        latencies.insert(latencies.end(), l.begin(), l.end());
+    }
+    UpdateRegtestLLMQTypes(Consensus::LLMQ_5_60, Consensus::LLMQ_5_60);
+    PrintLatencies(strprintf("LLMQSim_ISLock_%d", quorumSize), latencies);
+}
+
+static void LLMQSim_ChainLock(benchmark::State& state, Consensus::LLMQType llmqType, size_t quorumSize)
+{
+    auto& env = GetSimEnv();
+    UpdateRegtestLLMQTypes(llmqType, Consensus::LLMQ_5_60);
+    std::vector<int64_t> latencies;
+    while (state.KeepRunning()) {
+        auto l = env.RunChainLocks(SIM_CHAINLOCK_BLOCK_COUNT);
+        latencies.insert(latencies.end(), l.begin(), l.end());
+    }
+    UpdateRegtestLLMQTypes(Consensus::LLMQ_5_60, Consensus::LLMQ_5_60);
+    PrintLatencies(strprintf("LLMQSim_ChainLock_%d", quorumSize), latencies);
+}
+
+void CleanupLLMQSimTests()
+{
+    simEnv.reset();
+}
+
+#define BENCH_LLMQSim(name, llmqType, quorumSize) \
+    static void LLMQSim_##name##_##quorumSize(benchmark::State& state) \
+    { \
+        LLMQSim_##name(state, llmqType, quorumSize); \
+    } \
+    BENCHMARK(LLMQSim_##name##_##quorumSize)
+
+BENCH_LLMQSim(DKG, Consensus::LLMQ_5_60, 3);
+BENCH_LLMQSim(DKG, Consensus::LLMQ_50_60, 50);
+BENCH_LLMQSim(ISLock, Consensus::LLMQ_5_60, 3);
+BENCH_LLMQSim(ISLock, Consensus::LLMQ_50_60, 50);
+BENCH_LLMQSim(ChainLock, Consensus::LLMQ_5_60, 3);
+BENCH_LLMQSim(ChainLock, Consensus::LLMQ_50_60, 50);
@@ -0,0 +1,105 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "checkqueue.h"
+#include "consensus/validation.h"
+#include "random.h"
+#include "util.h"
+#include "validation.h"
+
+#include "evo/deterministicmns.h"
+#include "evo/providertx.h"
+#include "evo/specialtx.h"
+
+#include <boost/thread/thread.hpp>
+
+static const size_t PROTX_COUNT = 2000;
+static const int MIN_CORES = 2;
+
+// Builds a synthetic block with one ProUpServTx per masternode of the returned list
+static void BuildProUpServBlock(size_t count, CDeterministicMNList& mnListRet, CBlock& blockRet)
+{
+    mnListRet = CDeterministicMNList(uint256(), 0, 0);
+    blockRet.vtx.clear();
+
+    for (size_t i = 0; i < count; i++) {
+        CBLSSecretKey operatorKey;
+        operatorKey.MakeNewKey();
+
+        uint160 ownerKeyHash;
+        GetRandBytes(ownerKeyHash.begin(), ownerKeyHash.size());
+
+        auto dmnState = std::make_shared<CDeterministicMNState>();
+        dmnState->keyIDOwner = CKeyID(ownerKeyHash);
+        dmnState->pubKeyOperator.Set(operatorKey.GetPublicKey());
+
+        auto dmn = std::make_shared<CDeterministicMN>();
+        dmn->proTxHash = GetRandHash();
+        dmn->internalId = i;
+        dmn->collateralOutpoint = COutPoint(GetRandHash(), 0);
+        dmn->nOperatorReward = 0;
+        dmn->pdmnState = dmnState;
+        mnListRet.AddMN(dmn);
+
+        CMutableTransaction tx;
+        tx.nVersion = 3;
+        tx.nType = TRANSACTION_PROVIDER_UPDATE_SERVICE;
+        tx.vin.emplace_back(COutPoint(GetRandHash(), 0));
+
+        CProUpServTx ptx;
+        ptx.proTxHash = dmn->proTxHash;
+        ptx.inputsHash = CalcTxInputsHash(tx);
+        ptx.sig = operatorKey.Sign(::SerializeHash(ptx));
+        SetTxPayload(tx, ptx);
+
+        blockRet.vtx.emplace_back(MakeTransactionRef(tx));
+    }
+}
+
+static void SpecialTxChecks_Serial2000(benchmark::State& state)
+{
+    CDeterministicMNList mnList;
+    CBlock block;
+    BuildProUpServBlock(PROTX_COUNT, mnList, block);
+
+    // Benchmark.
+    while (state.KeepRunning()) {
+        ClearProTxSigCache();
+        CValidationState validationState;
+        bool ok = CheckSpecialTxsInBlock(block, nullptr, mnList, validationState, nullptr);
+        assert(ok);
+    }
+}
+
+static void SpecialTxChecks_Parallel2000(benchmark::State& state)
+{
+    CDeterministicMNList mnList;
+    CBlock block;
+    BuildProUpServBlock(PROTX_COUNT, mnList, block);
+
+    CCheckQueue<CScriptCheck> queue(128);
+    boost::thread_group tg;
+    for (auto x = 0; x < std::max(MIN_CORES, GetNumCores()) - 1; ++x) {
+        tg.create_thread([&]{queue.Thread();});
+    }
+
+    // Benchmark.
+    while (state.KeepRunning()) {
+        ClearProTxSigCache();
+        CCheckQueueControl<CScriptCheck> control(&queue);
+        CValidationState validationState;
+        std::vector<CScriptCheck> vChecks;
+        bool ok = CheckSpecialTxsInBlock(block, nullptr, mnList, validationState, &vChecks);
+        assert(ok);
+        control.Add(vChecks);
+        ok = control.Wait();
+        assert(ok);
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+BENCHMARK(SpecialTxChecks_Serial2000)
+BENCHMARK(SpecialTxChecks_Parallel2000)
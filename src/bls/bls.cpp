@@ -14,8 +14,14 @@
 #include "support/allocators/mt_pooled_secure.h"
 #endif
 
+#include "unordered_lru_cache.h"
+
+#include <algorithm>
 #include <assert.h>
+#include <atomic>
+#include <random>
 #include <string.h>
+#include <vector>
 
 bool CBLSId::InternalSetBuf(const void* buf)
 {
@@ -174,14 +180,110 @@ CBLSSignature CBLSSecretKey::Sign(const uint256& hash) const
     return sigRet;
 }
 
+typedef std::array<uint8_t, BLS_CURVE_PUBKEY_SIZE> BLSPublicKeyBuf;
+
+struct BLSPublicKeyBufHasher
+{
+    uint64_t k0, k1;
+
+    BLSPublicKeyBufHasher()
+    {
+        // the serialized keys come from the network, so salt the hashes to avoid maliciously crafted collisions
+        std::random_device rd;
+        k0 = ((uint64_t)rd() << 32) | rd();
+        k1 = ((uint64_t)rd() << 32) | rd();
+    }
+
+    std::size_t operator()(const BLSPublicKeyBuf& buf) const
+    {
+        return CSipHasher(k0, k1).Write(buf.data(), buf.size()).Finalize();
+    }
+};
+
+typedef unordered_lru_cache<BLSPublicKeyBuf, std::shared_ptr<const bls::PublicKey>, BLSPublicKeyBufHasher> BLSPublicKeyLRUCache;
+
+static std::mutex blsPublicKeyCacheMutex;
+static std::unique_ptr<BLSPublicKeyLRUCache> blsPublicKeyCache(new BLSPublicKeyLRUCache(CBLSPublicKeyCache::DEFAULT_MAX_SIZE));
+static size_t blsPublicKeyCacheMaxSize{CBLSPublicKeyCache::DEFAULT_MAX_SIZE};
+static std::atomic<uint64_t> blsPublicKeyCacheHits{0};
+static std::atomic<uint64_t> blsPublicKeyCacheMisses{0};
+
+static BLSPublicKeyBuf MakePublicKeyBuf(const void* buf)
+{
+    BLSPublicKeyBuf ret;
+    memcpy(ret.data(), buf, ret.size());
+    return ret;
+}
+
+bool CBLSPublicKeyCache::Get(const void* buf, bls::PublicKey& pkRet)
+{
+    std::shared_ptr<const bls::PublicKey> pk;
+    {
+        std::unique_lock<std::mutex> l(blsPublicKeyCacheMutex);
+        if (!blsPublicKeyCache) {
+            return false;
+        }
+        if (!blsPublicKeyCache->get(MakePublicKeyBuf(buf), pk)) {
+            blsPublicKeyCacheMisses++;
+            return false;
+        }
+    }
+    blsPublicKeyCacheHits++;
+    pkRet = *pk;
+    return true;
+}
+
+void CBLSPublicKeyCache::Put(const void* buf, const bls::PublicKey& pk)
+{
+    // non-canonical encodings are rejected as malleable later, so there is no point in caching them
+    BLSPublicKeyBuf buf2;
+    pk.Serialize(buf2.data());
+    if (memcmp(buf, buf2.data(), buf2.size()) != 0) {
+        return;
+    }
+
+    auto sharedPk = std::make_shared<const bls::PublicKey>(pk);
+
+    std::unique_lock<std::mutex> l(blsPublicKeyCacheMutex);
+    if (blsPublicKeyCache) {
+        blsPublicKeyCache->insert(buf2, sharedPk);
+    }
+}
+
+void CBLSPublicKeyCache::SetMaxSize(size_t maxSize)
+{
+    std::unique_lock<std::mutex> l(blsPublicKeyCacheMutex);
+    blsPublicKeyCacheMaxSize = maxSize;
+    if (maxSize == 0) {
+        blsPublicKeyCache.reset();
+    } else {
+        blsPublicKeyCache.reset(new BLSPublicKeyLRUCache(maxSize));
+    }
+}
+
+CBLSPublicKeyCache::Stats CBLSPublicKeyCache::GetStats()
+{
+    std::unique_lock<std::mutex> l(blsPublicKeyCacheMutex);
+    Stats stats;
+    stats.entries = blsPublicKeyCache ? blsPublicKeyCache->size() : 0;
+    stats.maxSize = blsPublicKeyCacheMaxSize;
+    stats.hits = blsPublicKeyCacheHits;
+    stats.misses = blsPublicKeyCacheMisses;
+    return stats;
+}
+
 bool CBLSPublicKey::InternalSetBuf(const void* buf)
 {
+    if (CBLSPublicKeyCache::Get(buf, impl)) {
+        return true;
+    }
     try {
         impl = bls::PublicKey::FromBytes((const uint8_t*)buf);
-        return true;
     } catch (...) {
         return false;
     }
+    CBLSPublicKeyCache::Put(buf, impl);
+    return true;
 }
 
 bool CBLSPublicKey::InternalGetBuf(void* buf) const
@@ -246,6 +348,47 @@ bool CBLSPublicKey::PublicKeyShare(const std::vector<CBLSPublicKey>& mpk, const
     return true;
 }
 
+bool CBLSPublicKey::PublicKeyShares(const std::vector<CBLSPublicKey>& mpk, const std::vector<CBLSId>& ids, std::vector<CBLSPublicKey>& sharesRet)
+{
+    sharesRet.clear();
+    sharesRet.resize(ids.size());
+
+    if (ids.size() > 1) {
+        // building the tables costs about as much as a single PublicKeyShare call
+        auto table = CBLSVerificationVectorTable::Build(mpk);
+        if (table) {
+            for (size_t i = 0; i < ids.size(); i++) {
+                table->Evaluate(ids[i], sharesRet[i]);
+            }
+            return true;
+        }
+    }
+
+    std::vector<bls::PublicKey> mpkVec;
+    mpkVec.reserve(mpk.size());
+    for (const CBLSPublicKey& pk : mpk) {
+        if (!pk.IsValid()) {
+            return false;
+        }
+        mpkVec.emplace_back(pk.impl);
+    }
+
+    for (size_t i = 0; i < ids.size(); i++) {
+        if (!ids[i].IsValid()) {
+            continue;
+        }
+        auto& share = sharesRet[i];
+        try {
+            share.impl = bls::BLS::PublicKeyShare(mpkVec, (const uint8_t*)ids[i].impl.begin());
+        } catch (...) {
+            continue;
+        }
+        share.fValid = true;
+        share.UpdateHash();
+    }
+    return true;
+}
+
 bool CBLSPublicKey::DHKeyExchange(const CBLSSecretKey& sk, const CBLSPublicKey& pk)
 {
     fValid = false;
@@ -260,6 +403,165 @@ bool CBLSPublicKey::DHKeyExchange(const CBLSSecretKey& sk, const CBLSPublicKey&
     return true;
 }
 
+// relic doesn't throw on errors, it only records them in its context (e.g. when g1_read_bin gets a point which is not on
+// the curve). This returns true if any relic call failed since the last check and resets the error state
+static bool CheckRelicError()
+{
+    return err_get_code() != STS_OK;
+}
+
+// bn_t needs bn_new/bn_free pairs, which this takes care of on all return paths
+struct CRelicBigNum
+{
+    bn_t v;
+    CRelicBigNum() { bn_new(v); }
+    ~CRelicBigNum() { bn_free(v); }
+};
+
+// chiabls serializes G1 points in relic's compressed form without the leading tag byte. The sign of y is moved into
+// the highest bit of the first byte instead
+static void ReadG1(g1_t p, const uint8_t* buf)
+{
+    uint8_t tmp[BLS_CURVE_PUBKEY_SIZE + 1];
+    tmp[0] = (buf[0] & 0x80) ? 0x03 : 0x02;
+    memcpy(tmp + 1, buf, BLS_CURVE_PUBKEY_SIZE);
+    tmp[1] &= 0x7f;
+    g1_read_bin(p, tmp, sizeof(tmp));
+}
+
+static void WriteG1(uint8_t* buf, const g1_t p)
+{
+    uint8_t tmp[BLS_CURVE_PUBKEY_SIZE + 1];
+    g1_write_bin(tmp, sizeof(tmp), p, 1);
+    memcpy(buf, tmp + 1, BLS_CURVE_PUBKEY_SIZE);
+    if (tmp[0] == 0x03) {
+        buf[0] |= 0x80;
+    }
+}
+
+CBLSVerificationVectorTable::CBLSVerificationVectorTable(size_t _coefficientCount) :
+    coefficientCount(_coefficientCount),
+    points(new g1_t[_coefficientCount * WINDOW_COUNT])
+{
+}
+
+BLSVerificationVectorTablePtr CBLSVerificationVectorTable::Build(const BLSVerificationVector& vvec)
+{
+    if (vvec.empty()) {
+        return nullptr;
+    }
+    for (const auto& pk : vvec) {
+        if (!pk.IsValid()) {
+            return nullptr;
+        }
+    }
+
+    std::shared_ptr<CBLSVerificationVectorTable> table(new CBLSVerificationVectorTable(vvec.size()));
+    // don't let errors of earlier, unrelated relic calls make us fail
+    CheckRelicError();
+    for (size_t i = 0; i < vvec.size(); i++) {
+        uint8_t buf[BLS_CURVE_PUBKEY_SIZE];
+        uint8_t buf2[BLS_CURVE_PUBKEY_SIZE];
+        vvec[i].GetBuf(buf, sizeof(buf));
+
+        g1_t* row = &table->points[i * WINDOW_COUNT];
+        ReadG1(row[0], buf);
+        if (CheckRelicError()) {
+            return nullptr;
+        }
+
+        // make sure we agree with chiabls about the encoding. If not, callers fall back to PublicKeyShare
+        WriteG1(buf2, row[0]);
+        if (memcmp(buf, buf2, sizeof(buf)) != 0) {
+            return nullptr;
+        }
+
+        for (int w = 1; w < WINDOW_COUNT; w++) {
+            g1_dbl(row[w], row[w - 1]);
+            for (int j = 1; j < WINDOW_BITS; j++) {
+                g1_dbl(row[w], row[w]);
+            }
+        }
+        // normalized entries allow mixed additions in Evaluate. One inversion per row instead of one per entry
+        g1_norm_sim(row, row, WINDOW_COUNT);
+    }
+    if (CheckRelicError()) {
+        return nullptr;
+    }
+    return table;
+}
+
+bool CBLSVerificationVectorTable::Evaluate(const CBLSId& id, CBLSPublicKey& pkShareRet) const
+{
+    static_assert(WINDOW_BITS == 8, "digits are extracted bytewise");
+    static_assert(WINDOW_COUNT <= BLS_CURVE_ID_SIZE, "scalars must fit into BLS_CURVE_ID_SIZE bytes");
+
+    pkShareRet = CBLSPublicKey();
+    if (!id.IsValid()) {
+        return false;
+    }
+
+    const int bucketCount = (1 << WINDOW_BITS) - 1;
+    std::unique_ptr<g1_t[]> buckets(new g1_t[bucketCount]);
+
+    CheckRelicError();
+
+    CRelicBigNum ord, x, s, t;
+
+    // same interpretation of the id as in bls::BLS::PublicKeyShare
+    g1_get_ord(ord.v);
+    bn_read_bin(t.v, (const uint8_t*)id.impl.begin(), BLS_CURVE_ID_SIZE);
+    bn_mod(x.v, t.v, ord.v);
+    bn_set_dig(s.v, 1);
+
+    for (int d = 0; d < bucketCount; d++) {
+        g1_set_infty(buckets[d]);
+    }
+
+    // Each coefficient i is multiplied with s = x^i. Split s into WINDOW_BITS sized digits and add the table entry
+    // of each window into the bucket of its digit, so that the result is the sum of d * buckets[d - 1]
+    uint8_t digits[BLS_CURVE_ID_SIZE];
+    for (size_t i = 0; i < coefficientCount; i++) {
+        if (i != 0) {
+            bn_mul(t.v, s.v, x.v);
+            bn_mod(s.v, t.v, ord.v);
+        }
+        bn_write_bin(digits, sizeof(digits), s.v);
+
+        const g1_t* row = &points[i * WINDOW_COUNT];
+        for (int w = 0; w < WINDOW_COUNT; w++) {
+            uint8_t d = digits[sizeof(digits) - 1 - w];
+            if (d != 0) {
+                g1_add(buckets[d - 1], buckets[d - 1], row[w]);
+            }
+        }
+    }
+
+    g1_t sum, result;
+    g1_set_infty(sum);
+    g1_set_infty(result);
+    for (int d = bucketCount; d >= 1; d--) {
+        g1_add(sum, sum, buckets[d - 1]);
+        g1_add(result, result, sum);
+    }
+
+    if (CheckRelicError() || g1_is_infty(result)) {
+        return false;
+    }
+
+    uint8_t buf[BLS_CURVE_PUBKEY_SIZE];
+    WriteG1(buf, result);
+    try {
+        pkShareRet.impl = bls::PublicKey::FromBytes(buf);
+    } catch (...) {
+        return false;
+    }
+
+    pkShareRet.fValid = true;
+    pkShareRet.UpdateHash();
+    return true;
+}
+
 bool CBLSSignature::InternalSetBuf(const void* buf)
 {
     try {
@@ -20,6 +20,7 @@
 #undef DOUBLE
 
 #include <array>
+#include <memory>
 #include <mutex>
 #include <unistd.h>
 
@@ -31,6 +32,7 @@
 
 class CBLSSignature;
 class CBLSPublicKey;
+class CBLSVerificationVectorTable;
 
 template <typename ImplType, size_t _SerSize, typename C>
 class CBLSWrapper
@@ -38,6 +40,7 @@ class CBLSWrapper
     friend class CBLSSecretKey;
     friend class CBLSPublicKey;
     friend class CBLSSignature;
+    friend class CBLSVerificationVectorTable;
 
 protected:
     ImplType impl;
@@ -266,6 +269,7 @@ class CBLSPublicKey : public CBLSWrapper<bls::PublicKey, BLS_CURVE_PUBKEY_SIZE,
 {
     friend class CBLSSecretKey;
     friend class CBLSSignature;
+    friend class CBLSVerificationVectorTable;
 
 public:
     using CBLSWrapper::operator=;
@@ -278,6 +282,9 @@ public:
     static CBLSPublicKey AggregateInsecure(const std::vector<CBLSPublicKey>& pks);
 
     bool PublicKeyShare(const std::vector<CBLSPublicKey>& mpk, const CBLSId& id);
+    // Evaluates mpk for multiple ids. Uses CBLSVerificationVectorTable if there is more than one id. Entries for
+    // invalid ids are left invalid
+    static bool PublicKeyShares(const std::vector<CBLSPublicKey>& mpk, const std::vector<CBLSId>& ids, std::vector<CBLSPublicKey>& sharesRet);
     bool DHKeyExchange(const CBLSSecretKey& sk, const CBLSPublicKey& pk);
 
 protected:
@@ -316,6 +323,33 @@ protected:
     bool InternalGetBuf(void* buf) const;
 };
 
+// Process-wide cache of decoded public keys, keyed by their serialized form. Decoding a public key decompresses and
+// validates a G1 point, while the same few thousand operator keys are deserialized over and over (MN list snapshots
+// and diffs, mnauth, DKG messages, final commitments). CBLSPublicKey::InternalSetBuf consults this cache, so it is
+// used transparently by all deserialization paths, including CBLSLazyPublicKey. Only valid keys in their canonical
+// encoding are cached. The cache is bounded and evicts least recently used keys.
+class CBLSPublicKeyCache
+{
+public:
+    static const size_t DEFAULT_MAX_SIZE = 20000;
+
+    struct Stats
+    {
+        size_t entries;
+        size_t maxSize;
+        uint64_t hits;
+        uint64_t misses;
+    };
+
+public:
+    static bool Get(const void* buf, bls::PublicKey& pkRet);
+    static void Put(const void* buf, const bls::PublicKey& pk);
+
+    // A maxSize of 0 disables the cache. Changing the size clears the cache
+    static void SetMaxSize(size_t maxSize);
+    static Stats GetStats();
+};
+
 #ifndef BUILD_BITCOIN_INTERNAL
 template<typename BLSObject>
 class CBLSLazyWrapper
@@ -475,6 +509,38 @@ typedef std::shared_ptr<BLSPublicKeyVector> BLSPublicKeyVectorPtr;
 typedef std::shared_ptr<BLSSecretKeyVector> BLSSecretKeyVectorPtr;
 typedef std::shared_ptr<BLSSignatureVector> BLSSignatureVectorPtr;
 
+// Fixed-base precomputation tables for evaluating a verification vector (a polynomial with public key coefficients)
+// at many ids, e.g. to calculate the public key shares of all members of a quorum. Each coefficient is multiplied
+// with all powers 2^(WINDOW_BITS * w) once, so that an evaluation is a single Pippenger style bucket accumulation
+// over the table entries, without any point doublings. Building the tables costs about as much as one evaluation
+// with CBLSPublicKey::PublicKeyShare, while every following evaluation is roughly an order of magnitude cheaper
+class CBLSVerificationVectorTable
+{
+public:
+    static const int WINDOW_BITS = 8;
+    // the group order has 255 bits
+    static const int WINDOW_COUNT = (255 + WINDOW_BITS - 1) / WINDOW_BITS;
+
+private:
+    size_t coefficientCount;
+    // WINDOW_COUNT entries per coefficient
+    std::unique_ptr<g1_t[]> points;
+
+    explicit CBLSVerificationVectorTable(size_t _coefficientCount);
+
+public:
+    // Returns nullptr if vvec is empty or contains invalid public keys
+    static std::shared_ptr<const CBLSVerificationVectorTable> Build(const BLSVerificationVector& vvec);
+
+    // Gives the same result as CBLSPublicKey::PublicKeyShare. Thread safe, as the tables are only read
+    bool Evaluate(const CBLSId& id, CBLSPublicKey& pkShareRet) const;
+
+    size_t GetCoefficientCount() const { return coefficientCount; }
+    size_t GetMemoryUsage() const { return coefficientCount * WINDOW_COUNT * sizeof(g1_t); }
+};
+
+typedef std::shared_ptr<const CBLSVerificationVectorTable> BLSVerificationVectorTablePtr;
+
 bool BLSInit();
 
 #endif // EPM_CRYPTO_BLS_H
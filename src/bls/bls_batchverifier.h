@@ -8,13 +8,20 @@
 #define EPMCOIN_CRYPTO_BLS_BATCHVERIFIER_H
 
 #include "bls.h"
+#include "bls_worker.h"
 
+#include <algorithm>
+#include <future>
 #include <map>
+#include <set>
 #include <vector>
 
 template<typename SourceId, typename MessageId>
 class CBLSBatchVerifier
 {
+public:
+    static const size_t DEFAULT_MIN_PARALLEL_MESSAGES = 64;
+
 private:
     struct Message {
         MessageId msgId;
@@ -26,11 +33,20 @@ private:
     typedef std::map<MessageId, Message> MessageMap;
     typedef typename MessageMap::iterator MessageMapIterator;
     typedef std::map<SourceId, std::vector<MessageMapIterator>> MessagesBySourceMap;
+    typedef typename MessagesBySourceMap::const_iterator SourceMapIterator;
+
+    struct VerifyResult {
+        std::set<SourceId> badSources;
+        std::set<MessageId> badMessages;
+    };
 
     bool secureVerification;
     bool perMessageFallback;
     size_t subBatchSize;
 
+    CBLSWorker* worker{nullptr};
+    size_t minParallelMessages{DEFAULT_MIN_PARALLEL_MESSAGES};
+
     MessageMap messages;
     MessagesBySourceMap messagesBySource;
 
@@ -65,62 +81,146 @@ public:
         messagesBySource.clear();
     }
 
+    // Enables parallel verification. Sources are split into one chunk per worker thread and the chunks are verified
+    // (and bisected on failure) in parallel. Batches with less than minParallelMessages messages are still verified
+    // on the calling thread. This must not be used from inside BLS worker threads
+    void EnableParallelVerification(CBLSWorker& _worker, size_t _minParallelMessages = DEFAULT_MIN_PARALLEL_MESSAGES)
+    {
+        worker = &_worker;
+        minParallelMessages = _minParallelMessages;
+    }
+
+    // Verifies all messages with one aggregated verification. If that fails, the invalid messages are isolated by
+    // bisection. Sources are bisected first, so that invalid sources are found with O(k * log(sources)) verifications
+    // instead of one per source. If perMessageFallback is set, the messages of each invalid source are then bisected
+    // as well, instead of verifying each message individually
     void Verify()
     {
-        std::map<uint256, std::vector<MessageMapIterator>> byMessageHash;
+        std::vector<SourceMapIterator> sources;
+        sources.reserve(messagesBySource.size());
+        for (auto it = messagesBySource.begin(); it != messagesBySource.end(); ++it) {
+            sources.emplace_back(it);
+        }
+        if (sources.empty()) {
+            return;
+        }
+
+        size_t chunkCount = 1;
+        if (worker && messages.size() >= minParallelMessages) {
+            chunkCount = std::min(sources.size(), (size_t)std::max(1, worker->GetWorkerCount()));
+        }
 
-        for (auto it = messages.begin(); it != messages.end(); ++it) {
-            byMessageHash[it->second.msgHash].emplace_back(it);
+        std::vector<VerifyResult> results(chunkCount);
+        std::vector<std::future<void>> futures;
+        futures.reserve(chunkCount);
+        size_t chunkSize = (sources.size() + chunkCount - 1) / chunkCount;
+        for (size_t i = 1; i < chunkCount; i++) {
+            size_t start = std::min(sources.size(), i * chunkSize);
+            size_t end = std::min(sources.size(), start + chunkSize);
+            auto result = &results[i];
+            futures.emplace_back(worker->AsyncRun([this, &sources, start, end, result]() {
+                VerifySourcesBisect(sources, start, end, false, *result);
+            }));
+        }
+        // the first chunk is verified on the calling thread
+        VerifySourcesBisect(sources, 0, std::min(sources.size(), chunkSize), false, results[0]);
+        for (auto& f : futures) {
+            f.get();
         }
 
-        if (VerifyBatch(byMessageHash)) {
-            // full batch is valid
+        for (auto& r : results) {
+            badSources.insert(r.badSources.begin(), r.badSources.end());
+            badMessages.insert(r.badMessages.begin(), r.badMessages.end());
+        }
+    }
+
+private:
+    // knownInvalid is set when the caller already knows that sources [start, end) contain at least one invalid message
+    void VerifySourcesBisect(const std::vector<SourceMapIterator>& sources, size_t start, size_t end, bool knownInvalid, VerifyResult& result) const
+    {
+        if (start == end) {
+            return;
+        }
+        if (!knownInvalid && VerifySources(sources, start, end)) {
+            return;
+        }
+        if (end - start == 1) {
+            result.badSources.emplace(sources[start]->first);
+            if (perMessageFallback) {
+                VerifyMessagesOfBadSource(sources[start]->second, result);
+            }
             return;
         }
 
-        // revert to per-source verification
-        for (const auto& p : messagesBySource) {
-            bool batchValid = false;
+        size_t mid = start + (end - start) / 2;
+        bool leftValid = VerifySources(sources, start, mid);
+        if (!leftValid) {
+            VerifySourcesBisect(sources, start, mid, true, result);
+        }
+        // if the left half is valid, the invalid message(s) must be in the right half
+        VerifySourcesBisect(sources, mid, end, leftValid, result);
+    }
 
-            // no need to verify it again if there was just one source
-            if (messagesBySource.size() != 1) {
-                byMessageHash.clear();
-                for (auto it = p.second.begin(); it != p.second.end(); ++it) {
-                    byMessageHash[(*it)->second.msgHash].emplace_back(*it);
-                }
-                batchValid = VerifyBatch(byMessageHash);
+    void VerifyMessagesOfBadSource(const std::vector<MessageMapIterator>& sourceMessages, VerifyResult& result) const
+    {
+        // same message might be invalid from different source, so no need to re-verify it
+        std::vector<MessageMapIterator> pending;
+        pending.reserve(sourceMessages.size());
+        for (const auto& msgIt : sourceMessages) {
+            if (!result.badMessages.count(msgIt->first)) {
+                pending.emplace_back(msgIt);
             }
-            if (!batchValid) {
-                badSources.emplace(p.first);
-
-                if (perMessageFallback) {
-                    // revert to per-message verification
-                    if (p.second.size() == 1) {
-                        // no need to re-verify a single message
-                        badMessages.emplace(p.second[0]->second.msgId);
-                    } else {
-                        for (const auto& msgIt : p.second) {
-                            if (badMessages.count(msgIt->first)) {
-                                // same message might be invalid from different source, so no need to re-verify it
-                                continue;
-                            }
-
-                            const auto& msg = msgIt->second;
-                            if (!msg.sig.VerifyInsecure(msg.pubKey, msg.msgHash)) {
-                                badMessages.emplace(msg.msgId);
-                            }
-                        }
-                    }
-                }
+        }
+        // if no message was skipped, the invalid message(s) must be in pending
+        bool knownInvalid = pending.size() == sourceMessages.size();
+        VerifyMessagesBisect(pending, 0, pending.size(), knownInvalid, result);
+    }
+
+    void VerifyMessagesBisect(const std::vector<MessageMapIterator>& msgs, size_t start, size_t end, bool knownInvalid, VerifyResult& result) const
+    {
+        if (start == end) {
+            return;
+        }
+        if (!knownInvalid && VerifyMessages(msgs, start, end)) {
+            return;
+        }
+        if (end - start == 1) {
+            result.badMessages.emplace(msgs[start]->first);
+            return;
+        }
+
+        size_t mid = start + (end - start) / 2;
+        bool leftValid = VerifyMessages(msgs, start, mid);
+        if (!leftValid) {
+            VerifyMessagesBisect(msgs, start, mid, true, result);
+        }
+        VerifyMessagesBisect(msgs, mid, end, leftValid, result);
+    }
+
+    bool VerifySources(const std::vector<SourceMapIterator>& sources, size_t start, size_t end) const
+    {
+        std::map<uint256, std::vector<MessageMapIterator>> byMessageHash;
+        for (size_t i = start; i < end; i++) {
+            for (const auto& msgIt : sources[i]->second) {
+                byMessageHash[msgIt->second.msgHash].emplace_back(msgIt);
             }
         }
+        return VerifyBatch(byMessageHash);
+    }
+
+    bool VerifyMessages(const std::vector<MessageMapIterator>& msgs, size_t start, size_t end) const
+    {
+        std::map<uint256, std::vector<MessageMapIterator>> byMessageHash;
+        for (size_t i = start; i < end; i++) {
+            byMessageHash[msgs[i]->second.msgHash].emplace_back(msgs[i]);
+        }
+        return VerifyBatch(byMessageHash);
     }
 
-private:
     // All Verify methods take ownership of the passed byMessageHash map and thus might modify the map. This is to avoid
     // unnecessary copies
 
-    bool VerifyBatch(std::map<uint256, std::vector<MessageMapIterator>>& byMessageHash)
+    bool VerifyBatch(std::map<uint256, std::vector<MessageMapIterator>>& byMessageHash) const
     {
         if (secureVerification) {
             return VerifyBatchSecure(byMessageHash);
@@ -129,7 +229,7 @@ private:
         }
     }
 
-    bool VerifyBatchInsecure(const std::map<uint256, std::vector<MessageMapIterator>>& byMessageHash)
+    bool VerifyBatchInsecure(const std::map<uint256, std::vector<MessageMapIterator>>& byMessageHash) const
     {
         CBLSSignature aggSig;
         std::vector<uint256> msgHashes;
@@ -180,7 +280,7 @@ private:
         return aggSig.VerifyInsecureAggregated(pubKeys, msgHashes);
     }
 
-    bool VerifyBatchSecure(std::map<uint256, std::vector<MessageMapIterator>>& byMessageHash)
+    bool VerifyBatchSecure(std::map<uint256, std::vector<MessageMapIterator>>& byMessageHash) const
     {
         // Loop until the byMessageHash map is empty, which means that all messages were verified
         // The secure form of verification will only aggregate one message for the same message hash, even if multiple
@@ -194,7 +294,7 @@ private:
         return true;
     }
 
-    bool VerifyBatchSecureStep(std::map<uint256, std::vector<MessageMapIterator>>& byMessageHash)
+    bool VerifyBatchSecureStep(std::map<uint256, std::vector<MessageMapIterator>>& byMessageHash) const
     {
         CBLSSignature aggSig;
         std::vector<uint256> msgHashes;
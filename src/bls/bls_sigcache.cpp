@@ -0,0 +1,69 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bls_sigcache.h"
+
+#include "cuckoosigcache.h"
+#include "hash.h"
+
+// BLS entries are SHA256(nonce || domain || message hash || public key(s) hash || signature hash)
+
+namespace {
+
+static uint256 HashPubKeys(const std::vector<CBLSPublicKey>& pubKeys)
+{
+    CHashWriter hw(SER_GETHASH, 0);
+    for (auto& pubKey : pubKeys) {
+        hw << pubKey.GetHash();
+    }
+    return hw.GetHash();
+}
+}
+
+bool IsBLSSigCached(const CBLSSignature& sig, const CBLSPublicKey& pubKey, const uint256& msgHash)
+{
+    uint256 entry;
+    sharedSigCache.ComputeEntry(entry, CCuckooSigCache::BLS_VERIFY_INSECURE, msgHash, pubKey.GetHash(), sig.GetHash());
+    return sharedSigCache.Get(entry, false);
+}
+
+void AddBLSSigToCache(const CBLSSignature& sig, const CBLSPublicKey& pubKey, const uint256& msgHash)
+{
+    uint256 entry;
+    sharedSigCache.ComputeEntry(entry, CCuckooSigCache::BLS_VERIFY_INSECURE, msgHash, pubKey.GetHash(), sig.GetHash());
+    sharedSigCache.Set(entry);
+}
+
+bool VerifyBLSSigCached(const CBLSSignature& sig, const CBLSPublicKey& pubKey, const uint256& msgHash)
+{
+    uint256 entry;
+    sharedSigCache.ComputeEntry(entry, CCuckooSigCache::BLS_VERIFY_INSECURE, msgHash, pubKey.GetHash(), sig.GetHash());
+    if (sharedSigCache.Get(entry, false)) {
+        return true;
+    }
+    if (!sig.VerifyInsecure(pubKey, msgHash)) {
+        return false;
+    }
+    sharedSigCache.Set(entry);
+    return true;
+}
+
+bool VerifySecureAggregatedBLSSigCached(const CBLSSignature& sig, const std::vector<CBLSPublicKey>& pubKeys, const uint256& msgHash)
+{
+    uint256 entry;
+    sharedSigCache.ComputeEntry(entry, CCuckooSigCache::BLS_VERIFY_SECURE_AGGREGATED, msgHash, HashPubKeys(pubKeys), sig.GetHash());
+    if (sharedSigCache.Get(entry, false)) {
+        return true;
+    }
+    if (!sig.VerifySecureAggregated(pubKeys, msgHash)) {
+        return false;
+    }
+    sharedSigCache.Set(entry);
+    return true;
+}
+
+void ClearBLSSigCache()
+{
+    sharedSigCache.Clear();
+}
@@ -0,0 +1,30 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef EPMCOIN_CRYPTO_BLS_SIGCACHE_H
+#define EPMCOIN_CRYPTO_BLS_SIGCACHE_H
+
+#include "bls.h"
+
+#include <vector>
+
+/**
+ * Valid BLS signature cache, to avoid doing the expensive pairings twice for the same (public key, message hash,
+ * signature) triple. This happens when the same recovered sig, ISLOCK or CLSIG arrives from multiple peers, when an
+ * ISLOCK is handed over to the signing manager as recovered sig, and when final commitments are verified on relay and
+ * again at block connect. Only verified signatures may be added. Signature shares are not added, as each of them is
+ * verified only once. The entries live in the signature cache shared with provider txs (see cuckoosigcache.h).
+ */
+bool IsBLSSigCached(const CBLSSignature& sig, const CBLSPublicKey& pubKey, const uint256& msgHash);
+void AddBLSSigToCache(const CBLSSignature& sig, const CBLSPublicKey& pubKey, const uint256& msgHash);
+
+// Same as CBLSSignature::VerifyInsecure, but consults the cache first and adds valid signatures to it
+bool VerifyBLSSigCached(const CBLSSignature& sig, const CBLSPublicKey& pubKey, const uint256& msgHash);
+// Same as CBLSSignature::VerifySecureAggregated, but consults the cache first and adds valid signatures to it
+bool VerifySecureAggregatedBLSSigCached(const CBLSSignature& sig, const std::vector<CBLSPublicKey>& pubKeys, const uint256& msgHash);
+
+// Clears the shared signature cache, so the cached provider tx signatures as well
+void ClearBLSSigCache();
+
+#endif // EPMCOIN_CRYPTO_BLS_SIGCACHE_H
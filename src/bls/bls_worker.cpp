@@ -5,6 +5,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "bls_worker.h"
+#include "bls_sigcache.h"
 #include "hash.h"
 #include "serialize.h"
 
@@ -403,13 +404,6 @@ struct ContributionVerifier {
         size_t start;
         size_t count;
 
-        BLSVerificationVectorPtr vvec;
-        CBLSSecretKey skShare;
-
-        // starts with 0 and is incremented if either vvec or skShare aggregation finishs. If it reaches 2, we know
-        // that aggregation for this batch is fully done. We can then start verification.
-        std::unique_ptr<std::atomic<int> > aggDone;
-
         // we can't directly update a vector<bool> in parallel
         // as vector<bool> is not thread safe (uses bitsets internally)
         // so we must use vector<char> temporarely and concatenate/convert
@@ -417,6 +411,16 @@ struct ContributionVerifier {
         std::vector<char> verifyResults;
     };
 
+    // aggregation state of a (sub-)range of a batch
+    struct RangeState {
+        BLSVerificationVectorPtr vvec;
+        CBLSSecretKey skShare;
+
+        // starts with 0 and is incremented if either vvec or skShare aggregation finishs. If it reaches 2, we know
+        // that aggregation for this range is fully done. We can then start verification.
+        std::atomic<int> aggDone{0};
+    };
+
     CBLSId forId;
     const std::vector<BLSVerificationVectorPtr>& vvecs;
     const BLSSecretKeyVector& skShares;
@@ -463,7 +467,6 @@ struct ContributionVerifier {
         for (size_t i = 0; i < batchCount; i++) {
             auto& batchState = batchStates[i];
 
-            batchState.aggDone.reset(new std::atomic<int>(0));
             batchState.start = i * batchSize;
             batchState.count = std::min(batchSize, vvecs.size() - batchState.start);
             batchState.verifyResults.assign(batchState.count, 0);
@@ -472,7 +475,8 @@ struct ContributionVerifier {
         if (aggregated) {
             size_t batchCount2 = batchCount; // 'this' might get deleted while we're still looping
             for (size_t i = 0; i < batchCount2; i++) {
-                AsyncAggregate(i);
+                auto& batchState = batchStates[i];
+                AsyncAggregatedVerifyRange(i, batchState.start, batchState.count);
             }
         } else {
             // treat all inputs as a single batch and verify one-by-one
@@ -494,35 +498,6 @@ struct ContributionVerifier {
         delete this;
     }
 
-    void AsyncAggregate(size_t batchIdx)
-    {
-        auto& batchState = batchStates[batchIdx];
-
-        // aggregate vvecs and skShares of batch in parallel
-        auto vvecAgg = new VectorAggregator<CBLSPublicKey>(vvecs, batchState.start, batchState.count, parallel, workerPool, std::bind(&ContributionVerifier::HandleAggVvecDone, this, batchIdx, std::placeholders::_1));
-        auto skShareAgg = new Aggregator<CBLSSecretKey>(skShares, batchState.start, batchState.count, parallel, workerPool, std::bind(&ContributionVerifier::HandleAggSkShareDone, this, batchIdx, std::placeholders::_1));
-
-        vvecAgg->Start();
-        skShareAgg->Start();
-    }
-
-    void HandleAggVvecDone(size_t batchIdx, const BLSVerificationVectorPtr& vvec)
-    {
-        auto& batchState = batchStates[batchIdx];
-        batchState.vvec = vvec;
-        if (++(*batchState.aggDone) == 2) {
-            HandleAggDone(batchIdx);
-        }
-    }
-    void HandleAggSkShareDone(size_t batchIdx, const CBLSSecretKey& skShare)
-    {
-        auto& batchState = batchStates[batchIdx];
-        batchState.skShare = skShare;
-        if (++(*batchState.aggDone) == 2) {
-            HandleAggDone(batchIdx);
-        }
-    }
-
     void HandleVerifyDone(size_t batchIdx, size_t count)
     {
         size_t c = verifyDoneCount += count;
@@ -531,49 +506,80 @@ struct ContributionVerifier {
         }
     }
 
-    void HandleAggDone(size_t batchIdx)
+    // Aggregates the vvecs and skShares of the range (in parallel) and verifies the aggregated result. If this fails,
+    // the range is split into halves which are verified the same way. This way, only O(k * log(n)) verifications are
+    // needed to find k invalid contributions in a batch of n
+    void AsyncAggregatedVerifyRange(size_t batchIdx, size_t start, size_t count)
     {
-        auto& batchState = batchStates[batchIdx];
-
-        if (batchState.vvec == nullptr || batchState.vvec->empty() || !batchState.skShare.IsValid()) {
-            // something went wrong while aggregating and there is nothing we can do now except mark the whole batch as failed
-            // this can only happen if inputs were invalid in some way
-            batchState.verifyResults.assign(batchState.count, 0);
-            HandleVerifyDone(batchIdx, batchState.count);
+        if (count == 1) {
+            AsyncVerifyOne(batchIdx, start);
             return;
         }
 
-        AsyncAggregatedVerifyBatch(batchIdx);
+        auto rangeState = std::make_shared<RangeState>();
+        auto vvecAgg = new VectorAggregator<CBLSPublicKey>(vvecs, start, count, parallel, workerPool, [this, batchIdx, start, count, rangeState](const BLSVerificationVectorPtr& vvec) {
+            rangeState->vvec = vvec;
+            if (++rangeState->aggDone == 2) {
+                HandleRangeAggDone(batchIdx, start, count, rangeState);
+            }
+        });
+        auto skShareAgg = new Aggregator<CBLSSecretKey>(skShares, start, count, parallel, workerPool, [this, batchIdx, start, count, rangeState](const CBLSSecretKey& skShare) {
+            rangeState->skShare = skShare;
+            if (++rangeState->aggDone == 2) {
+                HandleRangeAggDone(batchIdx, start, count, rangeState);
+            }
+        });
+
+        vvecAgg->Start();
+        skShareAgg->Start();
     }
 
-    void AsyncAggregatedVerifyBatch(size_t batchIdx)
+    void HandleRangeAggDone(size_t batchIdx, size_t start, size_t count, const std::shared_ptr<RangeState>& rangeState)
     {
-        auto f = [this, batchIdx](int threadId) {
-            auto& batchState = batchStates[batchIdx];
-            bool result = Verify(batchState.vvec, batchState.skShare);
-            if (result) {
-                // whole batch is valid
-                batchState.verifyResults.assign(batchState.count, 1);
-                HandleVerifyDone(batchIdx, batchState.count);
+        if (rangeState->vvec == nullptr || rangeState->vvec->empty() || !rangeState->skShare.IsValid()) {
+            // something went wrong while aggregating, which can only happen if some inputs were invalid in some way
+            // split the range so that the invalid inputs are found
+            AsyncBisect(batchIdx, start, count);
+            return;
+        }
+
+        auto f = [this, batchIdx, start, count, rangeState](int threadId) {
+            if (Verify(rangeState->vvec, rangeState->skShare)) {
+                // whole range is valid
+                auto& batchState = batchStates[batchIdx];
+                std::fill_n(batchState.verifyResults.begin() + (start - batchState.start), count, 1);
+                HandleVerifyDone(batchIdx, count);
             } else {
-                // at least one entry in the batch is invalid, revert to per-contribution verification (but parallelized)
-                AsyncVerifyBatchOneByOne(batchIdx);
+                AsyncBisect(batchIdx, start, count);
             }
         };
         PushOrDoWork(std::move(f));
     }
 
+    void AsyncBisect(size_t batchIdx, size_t start, size_t count)
+    {
+        // the second half is not done before it is started, so 'this' can't get deleted in-between
+        size_t half = count / 2;
+        AsyncAggregatedVerifyRange(batchIdx, start, half);
+        AsyncAggregatedVerifyRange(batchIdx, start + half, count - half);
+    }
+
+    void AsyncVerifyOne(size_t batchIdx, size_t idx)
+    {
+        auto f = [this, batchIdx, idx](int threadId) {
+            auto& batchState = batchStates[batchIdx];
+            batchState.verifyResults[idx - batchState.start] = Verify(vvecs[idx], skShares[idx]);
+            HandleVerifyDone(batchIdx, 1);
+        };
+        PushOrDoWork(std::move(f));
+    }
+
     void AsyncVerifyBatchOneByOne(size_t batchIdx)
     {
+        size_t start = batchStates[batchIdx].start;
         size_t count = batchStates[batchIdx].count;
-        batchStates[batchIdx].verifyResults.assign(count, 0);
         for (size_t i = 0; i < count; i++) {
-            auto f = [this, i, batchIdx](int threadId) {
-                auto& batchState = batchStates[batchIdx];
-                batchState.verifyResults[i] = Verify(vvecs[batchState.start + i], skShares[batchState.start + i]);
-                HandleVerifyDone(batchIdx, 1);
-            };
-            PushOrDoWork(std::move(f));
+            AsyncVerifyOne(batchIdx, start + i);
         }
     }
 
@@ -725,6 +731,58 @@ CBLSPublicKey CBLSWorker::BuildPubKeyShare(const BLSVerificationVectorPtr& vvec,
     return pkShare;
 }
 
+BLSPublicKeyVector CBLSWorker::BuildPubKeyShares(const BLSVerificationVectorPtr& vvec, const BLSIdVector& ids)
+{
+    BLSPublicKeyVector pkShares;
+    CBLSPublicKey::PublicKeyShares(*vvec, ids, pkShares);
+    return pkShares;
+}
+
+void CBLSWorker::AsyncBuildPubKeyShares(const BLSVerificationVectorPtr& vvec, const BLSIdVector& ids, std::function<void(const BLSPublicKeyVector&)> doneCallback)
+{
+    workerPool.push([this, vvec, ids, doneCallback](int threadId) {
+        doneCallback(BuildPubKeyShares(vvec, ids));
+    });
+}
+
+void CBLSWorker::AsyncBuildPubKeyShares(const BLSVerificationVectorTablePtr& table, const BLSIdVector& ids, bool parallel, std::function<void(const BLSPublicKeyVector&)> doneCallback)
+{
+    struct State {
+        BLSPublicKeyVector pkShares;
+        std::atomic<size_t> chunksLeft;
+        std::function<void(const BLSPublicKeyVector&)> doneCallback;
+    };
+
+    size_t chunkCount = parallel ? std::max<size_t>(1, std::min<size_t>(ids.size(), workerPool.size())) : 1;
+    size_t chunkSize = (ids.size() + chunkCount - 1) / chunkCount;
+
+    auto state = std::make_shared<State>();
+    state->pkShares.resize(ids.size());
+    state->chunksLeft = chunkCount;
+    state->doneCallback = std::move(doneCallback);
+
+    auto idsPtr = std::make_shared<BLSIdVector>(ids);
+    for (size_t i = 0; i < chunkCount; i++) {
+        size_t start = i * chunkSize;
+        size_t end = std::min(start + chunkSize, ids.size());
+        workerPool.push([table, idsPtr, state, start, end](int threadId) {
+            for (size_t j = start; j < end; j++) {
+                table->Evaluate((*idsPtr)[j], state->pkShares[j]);
+            }
+            if (--state->chunksLeft == 0) {
+                state->doneCallback(state->pkShares);
+            }
+        });
+    }
+}
+
+BLSPublicKeyVector CBLSWorker::BuildPubKeyShares(const BLSVerificationVectorTablePtr& table, const BLSIdVector& ids, bool parallel)
+{
+    auto p = BuildFutureDoneCallback<BLSPublicKeyVector>();
+    AsyncBuildPubKeyShares(table, ids, parallel, std::move(p.first));
+    return p.second.get();
+}
+
 void CBLSWorker::AsyncVerifyContributionShares(const CBLSId& forId, const std::vector<BLSVerificationVectorPtr>& vvecs, const BLSSecretKeyVector& skShares,
                                                bool parallel, bool aggregated, std::function<void(const std::vector<bool>&)> doneCallback)
 {
@@ -787,6 +845,29 @@ bool CBLSWorker::VerifyContributionShare(const CBLSId& forId, const BLSVerificat
     return pk1 == pk2;
 }
 
+BLSSecretKeyVector CBLSWorker::DecryptContributions(const std::vector<std::shared_ptr<CBLSIESMultiRecipientObjects<CBLSSecretKey> > >& encryptedContributions,
+                                                   size_t idx, const CBLSSecretKey& sk, int nVersion)
+{
+    std::vector<std::future<CBLSSecretKey> > futures;
+    futures.reserve(encryptedContributions.size());
+    for (const auto& enc : encryptedContributions) {
+        futures.emplace_back(workerPool.push([&enc, idx, &sk, nVersion](int threadId) {
+            CBLSSecretKey skContribution;
+            if (enc == nullptr || !enc->Decrypt(idx, sk, skContribution, nVersion)) {
+                return CBLSSecretKey();
+            }
+            return skContribution;
+        }));
+    }
+
+    BLSSecretKeyVector result;
+    result.reserve(futures.size());
+    for (auto& f : futures) {
+        result.emplace_back(f.get());
+    }
+    return result;
+}
+
 bool CBLSWorker::VerifyVerificationVector(const BLSVerificationVector& vvec, size_t start, size_t count)
 {
     return VerifyVectorHelper(vvec, start, count);
@@ -846,6 +927,89 @@ std::future<CBLSSignature> CBLSWorker::AsyncSign(const CBLSSecretKey& secKey, co
     return std::move(p.second);
 }
 
+void CBLSWorker::AsyncRecoverSig(const BLSSignatureVector& sigShares, const BLSIdVector& ids, CBLSWorker::SignDoneCallback doneCallback)
+{
+    workerPool.push([sigShares, ids, doneCallback](int threadId) {
+        // Recover() leaves the signature invalid on failure
+        CBLSSignature sig;
+        sig.Recover(sigShares, ids);
+        doneCallback(sig);
+    });
+}
+
+std::future<CBLSSignature> CBLSWorker::AsyncRecoverSig(const BLSSignatureVector& sigShares, const BLSIdVector& ids)
+{
+    auto p = BuildFutureDoneCallback<CBLSSignature>();
+    AsyncRecoverSig(sigShares, ids, std::move(p.first));
+    return std::move(p.second);
+}
+
+static bool VerifySigsAggregated(const BLSSignatureVector& sigs, const BLSPublicKeyVector& pubKeys, const std::vector<uint256>& msgHashes,
+                                 size_t start, size_t end)
+{
+    if (end - start == 1) {
+        return sigs[start].VerifyInsecure(pubKeys[start], msgHashes[start]);
+    }
+
+    CBLSSignature aggSig = sigs[start];
+    for (size_t i = start + 1; i < end; i++) {
+        aggSig.AggregateInsecure(sigs[i]);
+    }
+    std::vector<CBLSPublicKey> pubKeysPart(pubKeys.begin() + start, pubKeys.begin() + end);
+    std::vector<uint256> msgHashesPart(msgHashes.begin() + start, msgHashes.begin() + end);
+    return aggSig.VerifyInsecureAggregated(pubKeysPart, msgHashesPart);
+}
+
+// knownInvalid is set when the caller already knows that [start, end) contains at least one invalid sig
+static void VerifySigsBisect(const BLSSignatureVector& sigs, const BLSPublicKeyVector& pubKeys, const std::vector<uint256>& msgHashes,
+                             size_t start, size_t end, bool knownInvalid, std::vector<bool>& result)
+{
+    if (!knownInvalid && VerifySigsAggregated(sigs, pubKeys, msgHashes, start, end)) {
+        std::fill(result.begin() + start, result.begin() + end, true);
+        return;
+    }
+    if (end - start == 1) {
+        result[start] = false;
+        return;
+    }
+
+    size_t mid = start + (end - start) / 2;
+    bool leftValid = VerifySigsAggregated(sigs, pubKeys, msgHashes, start, mid);
+    if (leftValid) {
+        std::fill(result.begin() + start, result.begin() + mid, true);
+    } else {
+        VerifySigsBisect(sigs, pubKeys, msgHashes, start, mid, true, result);
+    }
+    // if the left half is valid, the invalid sig(s) must be in the right half
+    VerifySigsBisect(sigs, pubKeys, msgHashes, mid, end, leftValid, result);
+}
+
+std::vector<bool> CBLSWorker::VerifySigsBisect(const BLSSignatureVector& sigs, const BLSPublicKeyVector& pubKeys, const std::vector<uint256>& msgHashes)
+{
+    assert(sigs.size() == pubKeys.size() && sigs.size() == msgHashes.size());
+
+    std::vector<bool> result(sigs.size(), false);
+    if (!sigs.empty()) {
+        ::VerifySigsBisect(sigs, pubKeys, msgHashes, 0, sigs.size(), false, result);
+    }
+    return result;
+}
+
+void CBLSWorker::AsyncVerifySigsBisect(const BLSSignatureVector& sigs, const BLSPublicKeyVector& pubKeys, const std::vector<uint256>& msgHashes,
+                                       std::function<void(const std::vector<bool>&)> doneCallback)
+{
+    workerPool.push([sigs, pubKeys, msgHashes, doneCallback](int threadId) {
+        doneCallback(VerifySigsBisect(sigs, pubKeys, msgHashes));
+    });
+}
+
+std::future<std::vector<bool> > CBLSWorker::AsyncVerifySigsBisect(const BLSSignatureVector& sigs, const BLSPublicKeyVector& pubKeys, const std::vector<uint256>& msgHashes)
+{
+    auto p = BuildFutureDoneCallback<std::vector<bool> >();
+    AsyncVerifySigsBisect(sigs, pubKeys, msgHashes, std::move(p.first));
+    return std::move(p.second);
+}
+
 void CBLSWorker::AsyncVerifySig(const CBLSSignature& sig, const CBLSPublicKey& pubKey, const uint256& msgHash,
                                 CBLSWorker::SigVerifyDoneCallback doneCallback, CancelCond cancelCond)
 {
@@ -853,6 +1017,10 @@ void CBLSWorker::AsyncVerifySig(const CBLSSignature& sig, const CBLSPublicKey& p
         doneCallback(false);
         return;
     }
+    if (IsBLSSigCached(sig, pubKey, msgHash)) {
+        doneCallback(true);
+        return;
+    }
 
     std::unique_lock<std::mutex> l(sigVerifyMutex);
 
@@ -897,7 +1065,7 @@ void CBLSWorker::PushSigVerifyBatch()
         if (jobs.size() == 1) {
             auto& job = jobs[0];
             if (!job.cancelCond()) {
-                bool valid = job.sig.VerifyInsecure(job.pubKey, job.msgHash);
+                bool valid = VerifyBLSSigCached(job.sig, job.pubKey, job.msgHash);
                 job.doneCallback(valid);
             }
             std::unique_lock<std::mutex> l(sigVerifyMutex);
@@ -908,11 +1076,12 @@ void CBLSWorker::PushSigVerifyBatch()
             return;
         }
 
-        CBLSSignature aggSig;
         std::vector<size_t> indexes;
+        BLSSignatureVector sigs;
         std::vector<CBLSPublicKey> pubKeys;
         std::vector<uint256> msgHashes;
         indexes.reserve(jobs.size());
+        sigs.reserve(jobs.size());
         pubKeys.reserve(jobs.size());
         msgHashes.reserve(jobs.size());
         for (size_t i = 0; i < jobs.size(); i++) {
@@ -920,30 +1089,20 @@ void CBLSWorker::PushSigVerifyBatch()
             if (job.cancelCond()) {
                 continue;
             }
-            if (pubKeys.empty()) {
-                aggSig = job.sig;
-            } else {
-                aggSig.AggregateInsecure(job.sig);
-            }
             indexes.emplace_back(i);
+            sigs.emplace_back(job.sig);
             pubKeys.emplace_back(job.pubKey);
             msgHashes.emplace_back(job.msgHash);
         }
 
         if (!pubKeys.empty()) {
-            bool allValid = aggSig.VerifyInsecureAggregated(pubKeys, msgHashes);
-            if (allValid) {
-                for (size_t i = 0; i < pubKeys.size(); i++) {
-                    jobs[indexes[i]].doneCallback(true);
-                }
-            } else {
-                // one or more sigs were not valid, revert to per-sig verification
-                // TODO this could be improved if we would cache pairing results in some way as the previous aggregated verification already calculated all the pairings for the hashes
-                for (size_t i = 0; i < pubKeys.size(); i++) {
-                    auto& job = jobs[indexes[i]];
-                    bool valid = job.sig.VerifyInsecure(job.pubKey, job.msgHash);
-                    job.doneCallback(valid);
+            // if one or more sigs are invalid, this bisects the batch instead of reverting to per-sig verification
+            auto valid = VerifySigsBisect(sigs, pubKeys, msgHashes);
+            for (size_t i = 0; i < pubKeys.size(); i++) {
+                if (valid[i]) {
+                    AddBLSSigToCache(sigs[i], pubKeys[i], msgHashes[i]);
                 }
+                jobs[indexes[i]].doneCallback(valid[i]);
             }
         }
 
@@ -8,6 +8,7 @@
 #define EPMCOIN_CRYPTO_BLS_WORKER_H
 
 #include "bls.h"
+#include "bls_ies.h"
 
 #include "ctpl.h"
 
@@ -58,6 +59,16 @@ public:
     void Start();
     void Stop();
 
+    int GetWorkerCount() { return workerPool.size(); }
+
+    // Runs a job on the worker pool. This allows code outside of CBLSWorker (e.g. CBLSBatchVerifier) to spread its BLS
+    // work over the same threads. Waiting for the returned future from inside a worker thread can deadlock
+    template<typename F>
+    std::future<void> AsyncRun(F&& f)
+    {
+        return workerPool.push([f](int threadId) { f(); });
+    }
+
     bool GenerateContributions(int threshold, const BLSIdVector& ids, BLSVerificationVectorPtr& vvecRet, BLSSecretKeyVector& skShares);
 
     // The following functions are all used to aggregate verification (public key) vectors
@@ -109,13 +120,22 @@ public:
 
     // Calculate public key share from public key vector and id. Not parallelized
     CBLSPublicKey BuildPubKeyShare(const BLSVerificationVectorPtr& vvec, const CBLSId& id);
+    // Builds the public key shares of multiple ids. The vvec is only unpacked once for all ids, which makes this much
+    // cheaper than calling BuildPubKeyShare for each id. Entries are invalid for ids which failed
+    BLSPublicKeyVector BuildPubKeyShares(const BLSVerificationVectorPtr& vvec, const BLSIdVector& ids);
+    void AsyncBuildPubKeyShares(const BLSVerificationVectorPtr& vvec, const BLSIdVector& ids, std::function<void(const BLSPublicKeyVector&)> doneCallback);
+    // Same as above, but evaluates the precomputed tables of a vvec (see CBLSVerificationVectorTable). If parallel is true,
+    // the ids are split into one chunk per worker thread. Otherwise all ids are evaluated in a single job
+    BLSPublicKeyVector BuildPubKeyShares(const BLSVerificationVectorTablePtr& table, const BLSIdVector& ids, bool parallel = false);
+    void AsyncBuildPubKeyShares(const BLSVerificationVectorTablePtr& table, const BLSIdVector& ids, bool parallel, std::function<void(const BLSPublicKeyVector&)> doneCallback);
 
     // The following functions verify multiple verification vectors and contributions for the same id
     // This is parallelized by performing batched verification. The verification vectors and the contributions of
     // a batch are aggregated (in parallel, see AsyncBuildQuorumVerificationVector and AsyncBuildSecretKeyShare). The
     // result per batch is a single aggregated verification vector and a single aggregated contribution, which are then
     // verified with VerifyContributionShare. If verification of the aggregated inputs is successful, the whole batch
-    // is marked as valid. If the batch verification fails, the individual entries are verified in a non-aggregated manner
+    // is marked as valid. If the batch verification fails, the batch is split into halves which are verified in the same
+    // aggregated manner, until the invalid entries are found
     void AsyncVerifyContributionShares(const CBLSId& forId, const std::vector<BLSVerificationVectorPtr>& vvecs, const BLSSecretKeyVector& skShares,
                                        bool parallel, bool aggregated, std::function<void(const std::vector<bool>&)> doneCallback);
     std::future<std::vector<bool> > AsyncVerifyContributionShares(const CBLSId& forId, const std::vector<BLSVerificationVectorPtr>& vvecs, const BLSSecretKeyVector& skShares,
@@ -128,6 +148,11 @@ public:
     // Non paralellized verification of a single contribution
     bool VerifyContributionShare(const CBLSId& forId, const BLSVerificationVectorPtr& vvec, const CBLSSecretKey& skContribution);
 
+    // Decrypts the contributions for recipient idx from multiple encrypted contribution sets in parallel
+    // Entries are invalid for contributions that could not be decrypted
+    BLSSecretKeyVector DecryptContributions(const std::vector<std::shared_ptr<CBLSIESMultiRecipientObjects<CBLSSecretKey> > >& encryptedContributions,
+                                            size_t idx, const CBLSSecretKey& sk, int nVersion);
+
     // Simple verification of vectors. Checks x.IsValid() for every entry and checks for duplicate entries
     bool VerifyVerificationVector(const BLSVerificationVector& vvec, size_t start = 0, size_t count = 0);
     bool VerifyVerificationVectors(const std::vector<BLSVerificationVectorPtr>& vvecs, size_t start = 0, size_t count = 0);
@@ -137,6 +162,17 @@ public:
     // Internally batched signature signing and verification
     void AsyncSign(const CBLSSecretKey& secKey, const uint256& msgHash, SignDoneCallback doneCallback);
     std::future<CBLSSignature> AsyncSign(const CBLSSecretKey& secKey, const uint256& msgHash);
+
+    // Threshold recovery of a signature from signature shares. The result is invalid if recovery failed
+    void AsyncRecoverSig(const BLSSignatureVector& sigShares, const BLSIdVector& ids, SignDoneCallback doneCallback);
+    std::future<CBLSSignature> AsyncRecoverSig(const BLSSignatureVector& sigShares, const BLSIdVector& ids);
+    // Verifies multiple sigs with one aggregated verification. If that fails, the sigs are split in halves which are
+    // verified recursively, so that k invalid sigs out of n are found with O(k * log(n)) verifications instead of n.
+    // All msgHashes must be distinct
+    static std::vector<bool> VerifySigsBisect(const BLSSignatureVector& sigs, const BLSPublicKeyVector& pubKeys, const std::vector<uint256>& msgHashes);
+    void AsyncVerifySigsBisect(const BLSSignatureVector& sigs, const BLSPublicKeyVector& pubKeys, const std::vector<uint256>& msgHashes,
+                               std::function<void(const std::vector<bool>&)> doneCallback);
+    std::future<std::vector<bool> > AsyncVerifySigsBisect(const BLSSignatureVector& sigs, const BLSPublicKeyVector& pubKeys, const std::vector<uint256>& msgHashes);
     void AsyncVerifySig(const CBLSSignature& sig, const CBLSPublicKey& pubKey, const uint256& msgHash, SigVerifyDoneCallback doneCallback, CancelCond cancelCond = [] { return false; });
     std::future<bool> AsyncVerifySig(const CBLSSignature& sig, const CBLSPublicKey& pubKey, const uint256& msgHash, CancelCond cancelCond = [] { return false; });
     bool IsAsyncVerifyInProgress();
@@ -158,6 +194,7 @@ private:
     std::map<uint256, std::shared_future<BLSVerificationVectorPtr> > vvecCache;
     std::map<uint256, std::shared_future<CBLSSecretKey> > secretKeyShareCache;
     std::map<uint256, std::shared_future<CBLSPublicKey> > publicKeyShareCache;
+    std::map<uint256, std::shared_future<BLSVerificationVectorTablePtr> > vvecTableCache;
 
 public:
     CBLSWorkerCache(CBLSWorker& _worker) :
@@ -181,6 +218,40 @@ public:
             return worker.BuildPubKeyShare(vvec, id);
         });
     }
+    // Precomputed tables for the vvec of a quorum, keyed by the quorum hash. Returns nullptr if the tables can't be built
+    BLSVerificationVectorTablePtr BuildVerificationVectorTable(const uint256& cacheKey, const BLSVerificationVectorPtr& vvec)
+    {
+        return GetOrBuild(cacheKey, vvecTableCache, [&]() {
+            return CBLSVerificationVectorTable::Build(*vvec);
+        });
+    }
+    // Drops the tables when all shares of interest are known, as they are much larger than the vvec itself
+    void EraseVerificationVectorTable(const uint256& cacheKey)
+    {
+        std::unique_lock<std::mutex> l(cacheCs);
+        vvecTableCache.erase(cacheKey);
+    }
+    // Same as above, but evaluates the tables cached under tableCacheKey instead of unpacking the vvec on every miss
+    CBLSPublicKey BuildPubKeyShare(const uint256& cacheKey, const uint256& tableCacheKey, const BLSVerificationVectorPtr& vvec, const CBLSId& id)
+    {
+        return GetOrBuild(cacheKey, publicKeyShareCache, [&]() {
+            auto table = BuildVerificationVectorTable(tableCacheKey, vvec);
+            if (!table) {
+                return worker.BuildPubKeyShare(vvec, id);
+            }
+            CBLSPublicKey pkShare;
+            table->Evaluate(id, pkShare);
+            return pkShare;
+        });
+    }
+    // Seeds the cache with an already known public key share. Does nothing if the share is already cached or building
+    void SetPubKeyShare(const uint256& cacheKey, const CBLSPublicKey& pkShare)
+    {
+        std::promise<CBLSPublicKey> p;
+        p.set_value(pkShare);
+        std::unique_lock<std::mutex> l(cacheCs);
+        publicKeyShareCache.emplace(cacheKey, p.get_future());
+    }
 
 private:
     template <typename T, typename Builder>
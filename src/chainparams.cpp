@@ -928,6 +928,12 @@ public:
 		consensus.nBudgetPaymentsStartBlock = nBudgetPaymentsStartBlock;
 		consensus.nSuperblockStartBlock = nSuperblockStartBlock;
 	}
+
+	void UpdateLLMQTypes(Consensus::LLMQType llmqTypeChainLocks, Consensus::LLMQType llmqTypeInstantSend)
+	{
+		consensus.llmqChainLocks = llmqTypeChainLocks;
+		consensus.llmqForInstaEPM = llmqTypeInstantSend;
+	}
 };
 static CRegTestParams regTestParams;
 
@@ -981,6 +987,11 @@ void UpdateRegtestBudgetParameters(int nMasternodePaymentsStartBlock, int nBudge
 	regTestParams.UpdateBudgetParameters(nMasternodePaymentsStartBlock, nBudgetPaymentsStartBlock, nSuperblockStartBlock);
 }
 
+void UpdateRegtestLLMQTypes(Consensus::LLMQType llmqTypeChainLocks, Consensus::LLMQType llmqTypeInstantSend)
+{
+	regTestParams.UpdateLLMQTypes(llmqTypeChainLocks, llmqTypeInstantSend);
+}
+
 void UpdateDevnetSubsidyAndDiffParams(int nMinimumDifficultyBlocks, int nHighSubsidyBlocks, int nHighSubsidyFactor)
 {
 	assert(devNetParams);
@@ -159,6 +159,11 @@ void UpdateRegtestDIP3Parameters(int nActivationHeight, int nEnforcementHeight);
  */
 void UpdateRegtestBudgetParameters(int nMasternodePaymentsStartBlock, int nBudgetPaymentsStartBlock, int nSuperblockStartBlock);
 
+/**
+ * Allows modifying the LLMQ types used for ChainLocks and InstantSend on regtest.
+ */
+void UpdateRegtestLLMQTypes(Consensus::LLMQType llmqTypeChainLocks, Consensus::LLMQType llmqTypeInstantSend);
+
 /**
  * Allows modifying the subsidy and difficulty devnet parameters.
  */
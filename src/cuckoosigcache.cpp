@@ -0,0 +1,7 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "cuckoosigcache.h"
+
+CCuckooSigCache sharedSigCache(SHARED_SIG_CACHE_SIZE);
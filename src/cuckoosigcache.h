@@ -0,0 +1,130 @@
+// Copyright (c) 2009-2015 The Bitcoin Core developers
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef EPMCOIN_CUCKOOSIGCACHE_H
+#define EPMCOIN_CUCKOOSIGCACHE_H
+
+#include "crypto/sha256.h"
+#include "cuckoocache.h"
+#include "random.h"
+#include "uint256.h"
+
+#include <memory>
+
+#include <boost/thread.hpp>
+
+/**
+ * We're hashing a nonce into the entries themselves, so we don't need extra
+ * blinding in the set hash computation.
+ *
+ * This may exhibit platform endian dependent behavior but because these are
+ * nonced hashes (random) and this state is only ever used locally it is safe.
+ * All that matters is local consistency.
+ */
+class SignatureCacheHasher
+{
+public:
+    template <uint8_t hash_select>
+    uint32_t operator()(const uint256& key) const
+    {
+        static_assert(hash_select <8, "SignatureCacheHasher only has 8 hashes available.");
+        uint32_t u;
+        std::memcpy(&u, key.begin()+4*hash_select, 4);
+        return u;
+    }
+};
+
+/**
+ * Set of valid signatures, shared by the BLS signature checks and the payload signatures of provider txs.
+ * Entries are SHA256(nonce || domain || data...), where data is whatever identifies a valid signature of the domain.
+ * The nonce is chosen once and never changes, so computing entries doesn't need to lock anything.
+ */
+class CCuckooSigCache
+{
+public:
+    enum Domain : uint8_t {
+        BLS_VERIFY_INSECURE = 0,
+        BLS_VERIFY_SECURE_AGGREGATED = 1,
+        PROTX_ECDSA = 2,
+    };
+
+private:
+    const uint256 nonce;
+    const size_t nBytes;
+    typedef CuckooCache::cache<uint256, SignatureCacheHasher> map_type;
+    // replaced as a whole by Clear(), as CuckooCache can't drop its entries
+    std::unique_ptr<map_type> setValid;
+    boost::shared_mutex cs_sigcache;
+
+    static uint256 MakeNonce()
+    {
+        uint256 ret;
+        GetRandBytes(ret.begin(), 32);
+        return ret;
+    }
+
+    static void WriteEntryData(CSHA256& hasher) {}
+
+    template<typename T, typename... Args>
+    static void WriteEntryData(CSHA256& hasher, const T& data, const Args&... args)
+    {
+        WriteData(hasher, data);
+        WriteEntryData(hasher, args...);
+    }
+
+    static void WriteData(CSHA256& hasher, const std::vector<unsigned char>& data) { hasher.Write(data.data(), data.size()); }
+    // hashes, key ids and public keys
+    template<typename T>
+    static void WriteData(CSHA256& hasher, const T& data) { hasher.Write(data.begin(), data.size()); }
+
+public:
+    explicit CCuckooSigCache(size_t _nBytes) :
+        nonce(MakeNonce()),
+        nBytes(_nBytes)
+    {
+        setValid.reset(new map_type());
+        setValid->setup_bytes(nBytes);
+    }
+
+    template<typename... Args>
+    void ComputeEntry(uint256& entry, Domain domain, const Args&... args) const
+    {
+        CSHA256 hasher;
+        hasher.Write(nonce.begin(), 32);
+        uint8_t d = domain;
+        hasher.Write(&d, 1);
+        WriteEntryData(hasher, args...);
+        hasher.Finalize(entry.begin());
+    }
+
+    bool Get(const uint256& entry, const bool erase)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        return setValid->contains(entry, erase);
+    }
+
+    void Set(uint256& entry)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        setValid->insert(entry);
+    }
+
+    // Drops all entries. Only meant for benchmarks and tests which measure uncached verification
+    void Clear()
+    {
+        std::unique_ptr<map_type> newSet(new map_type());
+        newSet->setup_bytes(nBytes);
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        setValid = std::move(newSet);
+    }
+};
+
+// Limit the shared signature cache to 5MB (over 160000 entries). Recovered sigs, ISLOCKs, CLSIGs, final commitments and
+// provider txs are rare compared to normal transaction signatures
+static const size_t SHARED_SIG_CACHE_SIZE = 5 << 20;
+
+extern CCuckooSigCache sharedSigCache;
+
+#endif // EPMCOIN_CUCKOOSIGCACHE_H
@@ -6,6 +6,7 @@
 #define BITCOIN_DBWRAPPER_H
 
 #include "clientversion.h"
+#include "memusage.h"
 #include "serialize.h"
 #include "streams.h"
 #include "util.h"
@@ -602,6 +603,14 @@ protected:
     WritesMap writes;
     DeletesSet deletes;
 
+    // Memory usage of the map/set nodes plus the allocated key itself
+    static size_t WriteKeyMemoryUsage(const CDataStream& ssKey) {
+        return memusage::MallocUsage(sizeof(memusage::stl_tree_node<std::pair<const CDataStream, ValueHolderPtr>>)) + memusage::MallocUsage(ssKey.size());
+    }
+    static size_t DeleteKeyMemoryUsage(const CDataStream& ssKey) {
+        return memusage::MallocUsage(sizeof(memusage::stl_tree_node<CDataStream>)) + memusage::MallocUsage(ssKey.size());
+    }
+
 public:
     CDBTransaction(Parent &_parent, CommitTarget &_commitTarget) : parent(_parent), commitTarget(_commitTarget) {}
 
@@ -612,18 +621,19 @@ public:
 
     template <typename V>
     void Write(const CDataStream& ssKey, const V& v) {
-        auto valueMemoryUsage = ::GetSerializeSize(v, SER_DISK, CLIENT_VERSION);
+        // the serialized size is used as an approximation of the dynamic memory used by the value
+        auto valueMemoryUsage = memusage::MallocUsage(sizeof(ValueHolderImpl<V>)) + ::GetSerializeSize(v, SER_DISK, CLIENT_VERSION);
 
         if (deletes.erase(ssKey)) {
-            memoryUsage -= ssKey.size();
+            memoryUsage -= DeleteKeyMemoryUsage(ssKey);
         }
         auto it = writes.emplace(ssKey, nullptr).first;
         if (it->second) {
-            memoryUsage -= ssKey.size() + it->second->memoryUsage;
+            memoryUsage -= WriteKeyMemoryUsage(ssKey) + it->second->memoryUsage;
         }
         it->second = std::make_unique<ValueHolderImpl<V>>(v, valueMemoryUsage);
 
-        memoryUsage += ssKey.size() + valueMemoryUsage;
+        memoryUsage += WriteKeyMemoryUsage(ssKey) + valueMemoryUsage;
     }
 
     template <typename K, typename V>
@@ -675,11 +685,11 @@ public:
     void Erase(const CDataStream& ssKey) {
         auto it = writes.find(ssKey);
         if (it != writes.end()) {
-            memoryUsage -= ssKey.size() + it->second->memoryUsage;
+            memoryUsage -= WriteKeyMemoryUsage(ssKey) + it->second->memoryUsage;
             writes.erase(it);
         }
         if (deletes.emplace(ssKey).second) {
-            memoryUsage += ssKey.size();
+            memoryUsage += DeleteKeyMemoryUsage(ssKey);
         }
     }
 
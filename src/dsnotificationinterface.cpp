@@ -20,11 +20,13 @@
 
 #include "evo/deterministicmns.h"
 #include "evo/mnauth.h"
+#include "evo/simplifiedmns.h"
 
 #include "llmq/quorums.h"
 #include "llmq/quorums_chainlocks.h"
 #include "llmq/quorums_instantsend.h"
 #include "llmq/quorums_dkgsessionmgr.h"
+#include "llmq/quorums_signing.h"
 
 void CDSNotificationInterface::InitializeCurrentBlockTip()
 {
@@ -62,9 +64,16 @@ void CDSNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, con
 	fPoSTrigger = true;
     }
 
+    // the active quorum tables are needed to verify signatures while still in initial block download
+    if (!fLiteMode) {
+        llmq::quorumSigningManager->UpdatedBlockTip(pindexNew);
+    }
+
     if (fInitialDownload)
         return;
 
+    mnListDiffCache->UpdatedBlockTip(pindexNew);
+
     if (fLiteMode)
         return;
 
@@ -100,4 +109,5 @@ void CDSNotificationInterface::NotifyMasternodeListChanged(bool undo, const CDet
 void CDSNotificationInterface::NotifyChainLock(const CBlockIndex* pindex)
 {
     llmq::quorumInstantSendManager->NotifyChainLock(pindex);
+    mnListDiffCache->NotifyChainLock(pindex);
 }
@@ -5,11 +5,13 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "deterministicmns.h"
+#include "evocache.h"
 #include "specialtx.h"
 
 #include "base58.h"
 #include "chainparams.h"
 #include "core_io.h"
+#include "memusage.h"
 #include "script/standard.h"
 #include "ui_interface.h"
 #include "validation.h"
@@ -22,6 +24,9 @@
 
 static const std::string DB_LIST_SNAPSHOT = "dmn_S";
 static const std::string DB_LIST_DIFF = "dmn_D";
+static const std::string DB_LIST_SNAPSHOT_COMPACT = "dmn_S2";
+static const std::string DB_LIST_DIFF_COMPACT = "dmn_D2";
+static const std::string DB_LIST_FORMAT_VERSION = "dmn_V";
 
 CDeterministicMNManager* deterministicMNManager;
 
@@ -146,14 +151,12 @@ CDeterministicMNCPtr CDeterministicMNList::GetValidMN(const uint256& proTxHash)
     return dmn;
 }
 
-CDeterministicMNCPtr CDeterministicMNList::GetMNByOperatorKey(const CBLSPublicKey& pubKey)
+CDeterministicMNCPtr CDeterministicMNList::GetMNByOperatorKey(const CBLSPublicKey& pubKey) const
 {
-    for (const auto& p : mnMap) {
-        if (p.second->pdmnState->pubKeyOperator.Get() == pubKey) {
-            return p.second;
-        }
+    if (!pubKey.IsValid()) {
+        return nullptr;
     }
-    return nullptr;
+    return GetUniquePropertyMN(pubKey);
 }
 
 CDeterministicMNCPtr CDeterministicMNList::GetMNByCollateral(const COutPoint& collateralOutpoint) const
@@ -193,6 +196,20 @@ CDeterministicMNCPtr CDeterministicMNList::GetMNByInternalId(uint64_t internalId
 	return GetMN(*proTxHash);
 }
 
+std::vector<CDeterministicMNCPtr> CDeterministicMNList::GetMNsByPayoutScript(const CScript& scriptPayout) const
+{
+    std::vector<CDeterministicMNCPtr> result;
+    auto proTxHashes = mnPayoutScriptMap.find(::SerializeHash(scriptPayout));
+    if (!proTxHashes) {
+        return result;
+    }
+    result.reserve(proTxHashes->size());
+    for (const auto& proTxHash : *proTxHashes) {
+        result.emplace_back(GetMN(proTxHash));
+    }
+    return result;
+}
+
 
 static int CompareByLastPaid_GetHeight(const CDeterministicMN& dmn)
 {
@@ -458,6 +475,7 @@ void CDeterministicMNList::AddMN(const CDeterministicMNCPtr& dmn)
     if (dmn->pdmnState->pubKeyOperator.Get().IsValid()) {
         AddUniqueProperty(dmn, dmn->pdmnState->pubKeyOperator);
     }
+    AddPayoutScript(dmn->proTxHash, dmn->pdmnState->scriptPayout);
 }
 
 void CDeterministicMNList::UpdateMN(const CDeterministicMNCPtr& oldDmn, const CDeterministicMNStateCPtr& pdmnState)
@@ -471,6 +489,10 @@ void CDeterministicMNList::UpdateMN(const CDeterministicMNCPtr& oldDmn, const CD
     UpdateUniqueProperty(dmn, oldState->addr, pdmnState->addr);
     UpdateUniqueProperty(dmn, oldState->keyIDOwner, pdmnState->keyIDOwner);
     UpdateUniqueProperty(dmn, oldState->pubKeyOperator, pdmnState->pubKeyOperator);
+    if (oldState->scriptPayout != pdmnState->scriptPayout) {
+        DeletePayoutScript(dmn->proTxHash, oldState->scriptPayout);
+        AddPayoutScript(dmn->proTxHash, pdmnState->scriptPayout);
+    }
 }
 
 void CDeterministicMNList::UpdateMN(const uint256& proTxHash, const CDeterministicMNStateCPtr& pdmnState)
@@ -486,6 +508,11 @@ void CDeterministicMNList::UpdateMN(const CDeterministicMNCPtr& oldDmn, const CD
 	auto oldState = oldDmn->pdmnState;
 	auto newState = std::make_shared<CDeterministicMNState>(*oldState);
 	stateDiff.ApplyToState(*newState);
+    if ((stateDiff.fields & CDeterministicMNStateDiff::Field_confirmedHash) &&
+        !(stateDiff.fields & CDeterministicMNStateDiff::Field_confirmedHashWithProRegTxHash)) {
+        // compact diffs don't store confirmedHashWithProRegTxHash, so we have to recalculate it
+        newState->UpdateConfirmedHash(oldDmn->proTxHash, newState->confirmedHash);
+    }
 	UpdateMN(oldDmn, newState);
 }
 
@@ -501,10 +528,32 @@ void CDeterministicMNList::RemoveMN(const uint256& proTxHash)
     if (dmn->pdmnState->pubKeyOperator.Get().IsValid()) {
         DeleteUniqueProperty(dmn, dmn->pdmnState->pubKeyOperator);
     }
+    DeletePayoutScript(proTxHash, dmn->pdmnState->scriptPayout);
     mnMap = mnMap.erase(proTxHash);
 	mnInternalIdMap = mnInternalIdMap.erase(dmn->internalId);
 }
 
+void CDeterministicMNList::AddPayoutScript(const uint256& proTxHash, const CScript& scriptPayout)
+{
+    auto hash = ::SerializeHash(scriptPayout);
+    auto oldEntry = mnPayoutScriptMap.find(hash);
+    auto newEntry = oldEntry ? oldEntry->insert(proTxHash) : immer::set<uint256>().insert(proTxHash);
+    mnPayoutScriptMap = mnPayoutScriptMap.set(hash, newEntry);
+}
+
+void CDeterministicMNList::DeletePayoutScript(const uint256& proTxHash, const CScript& scriptPayout)
+{
+    auto hash = ::SerializeHash(scriptPayout);
+    auto oldEntry = mnPayoutScriptMap.find(hash);
+    assert(oldEntry && oldEntry->count(proTxHash));
+    auto newEntry = oldEntry->erase(proTxHash);
+    if (newEntry.size() == 0) {
+        mnPayoutScriptMap = mnPayoutScriptMap.erase(hash);
+    } else {
+        mnPayoutScriptMap = mnPayoutScriptMap.set(hash, newEntry);
+    }
+}
+
 CDeterministicMNManager::CDeterministicMNManager(CEvoDB& _evoDb) :
     evoDb(_evoDb)
 {
@@ -545,9 +594,9 @@ bool CDeterministicMNManager::ProcessBlock(const CBlock& block, const CBlockInde
 		oldList = GetListForBlock(pindex->pprev);
         diff = oldList.BuildDiff(newList);
 
-		evoDb.Write(std::make_pair(DB_LIST_DIFF, newList.GetBlockHash()), diff);
+        evoDb.Write(std::make_pair(DB_LIST_DIFF_COMPACT, newList.GetBlockHash()), CDeterministicMNListDiffCompact(diff));
         if ((nHeight % SNAPSHOT_LIST_PERIOD) == 0 || oldList.GetHeight() == -1) {
-			evoDb.Write(std::make_pair(DB_LIST_SNAPSHOT, newList.GetBlockHash()), newList);
+            evoDb.Write(std::make_pair(DB_LIST_SNAPSHOT_COMPACT, newList.GetBlockHash()), CDeterministicMNListCompact(newList));
             LogPrintf("CDeterministicMNManager::%s -- Wrote snapshot. nHeight=%d, mapCurMNs.allMNsCount=%d\n",
                 __func__, nHeight, newList.GetAllMNsCount());
         }
@@ -584,7 +633,7 @@ bool CDeterministicMNManager::UndoBlock(const CBlock& block, const CBlockIndex*
     CDeterministicMNListDiff diff;
     {
         LOCK(cs);
-        evoDb.Read(std::make_pair(DB_LIST_DIFF, blockHash), diff);
+        ReadListDiff(blockHash, diff);
 
         if (diff.HasChanges()) {
             // need to call this before erasing
@@ -594,8 +643,10 @@ bool CDeterministicMNManager::UndoBlock(const CBlock& block, const CBlockIndex*
 
         evoDb.Erase(std::make_pair(DB_LIST_DIFF, blockHash));
         evoDb.Erase(std::make_pair(DB_LIST_SNAPSHOT, blockHash));
+        evoDb.Erase(std::make_pair(DB_LIST_DIFF_COMPACT, blockHash));
+        evoDb.Erase(std::make_pair(DB_LIST_SNAPSHOT_COMPACT, blockHash));
 
-        mnListsCache.erase(blockHash);
+        UncacheList(blockHash);
     }
 
     if (diff.HasChanges()) {
@@ -895,31 +946,89 @@ void CDeterministicMNManager::DecreasePoSePenalties(CDeterministicMNList& mnList
     }
 }
 
+// Memory used by a MN and its state. Both are shared by all lists until the MN is updated
+static size_t MNDynamicUsage(const CDeterministicMNCPtr& dmn)
+{
+    return memusage::DynamicUsage(dmn) + memusage::DynamicUsage(dmn->pdmnState) +
+           memusage::DynamicUsage(dmn->pdmnState->scriptPayout) + memusage::DynamicUsage(dmn->pdmnState->scriptOperatorPayout);
+}
+
+// immer maps store their entries in arrays inside the tree nodes, with about one child pointer per entry in the inner
+// nodes
+template<typename Map>
+static size_t ImmerMapEntryUsage(const Map& m)
+{
+    return sizeof(typename Map::value_type) + sizeof(void*);
+}
+
+size_t CDeterministicMNList::DynamicMemoryUsage() const
+{
+    size_t nUsage = mnMap.size() * ImmerMapEntryUsage(mnMap);
+    nUsage += mnInternalIdMap.size() * ImmerMapEntryUsage(mnInternalIdMap);
+    nUsage += mnUniquePropertyMap.size() * ImmerMapEntryUsage(mnUniquePropertyMap);
+    for (const auto& p : mnPayoutScriptMap) {
+        nUsage += ImmerMapEntryUsage(mnPayoutScriptMap) + p.second.size() * (sizeof(uint256) + sizeof(void*));
+    }
+    for (const auto& p : mnMap) {
+        nUsage += MNDynamicUsage(p.second);
+    }
+    return nUsage;
+}
+
+// Lists built by applying a diff share most of their internal nodes with the base list, so they are only charged for
+// the path copies of the changed entries and for the MNs created by the diff
+static const size_t MN_LIST_CHANGE_MEMORY_USAGE = 3 * 32 * sizeof(void*);
+
+static size_t EstimateListMemoryUsage(const CDeterministicMNList& list)
+{
+    return sizeof(CDeterministicMNList) + list.DynamicMemoryUsage();
+}
+
+static size_t EstimateListMemoryUsage(const CDeterministicMNList& list, const CDeterministicMNListDiff& diff)
+{
+    size_t nChanges = diff.addedMNs.size() + diff.updatedMNs.size() + diff.removedMns.size();
+    size_t nUsage = sizeof(CDeterministicMNList) + nChanges * MN_LIST_CHANGE_MEMORY_USAGE;
+    for (const auto& dmn : diff.addedMNs) {
+        nUsage += MNDynamicUsage(dmn);
+    }
+    // updated MNs are copied together with their new state
+    for (const auto& p : diff.updatedMNs) {
+        auto dmn = list.GetMNByInternalId(p.first);
+        if (dmn) {
+            nUsage += MNDynamicUsage(dmn);
+        }
+    }
+    return nUsage;
+}
+
 CDeterministicMNList CDeterministicMNManager::GetListForBlock(const CBlockIndex* pindex)
 {
     LOCK(cs);
 
+    auto& cacheStats = evoCacheBudget.GetStats(EVO_CACHE_MN_LISTS);
 
     CDeterministicMNList snapshot;
     std::list<std::pair<const CBlockIndex*, CDeterministicMNListDiff>> listDiff;
+    bool fFoundInCache = false;
 
     while (true) {
         // try using cache before reading from disk
 		auto it = mnListsCache.find(pindex->GetBlockHash());
         if (it != mnListsCache.end()) {
-            snapshot = it->second;
+            snapshot = it->second.list;
+            fFoundInCache = true;
             break;
         }
 
-		if (evoDb.Read(std::make_pair(DB_LIST_SNAPSHOT, pindex->GetBlockHash()), snapshot)) {
-			mnListsCache.emplace(pindex->GetBlockHash(), snapshot);
+        if (ReadListSnapshot(pindex->GetBlockHash(), snapshot)) {
+            CacheList(pindex->GetBlockHash(), snapshot);
             break;
         }
 
         CDeterministicMNListDiff diff;
-		if (!evoDb.Read(std::make_pair(DB_LIST_DIFF, pindex->GetBlockHash()), diff)) {
+        if (!ReadListDiff(pindex->GetBlockHash(), diff)) {
 			snapshot = CDeterministicMNList(pindex->GetBlockHash(), -1, 0);
-			mnListsCache.emplace(pindex->GetBlockHash(), snapshot);
+            CacheList(pindex->GetBlockHash(), snapshot);
             break;
         }
 
@@ -927,6 +1036,15 @@ CDeterministicMNList CDeterministicMNManager::GetListForBlock(const CBlockIndex*
 		pindex = pindex->pprev;
     }
 
+    // the list the first diff is applied to
+    uint256 baseBlockHash = pindex->GetBlockHash();
+
+    if (fFoundInCache && listDiff.empty()) {
+        cacheStats.Hit();
+        return snapshot;
+    }
+    cacheStats.Miss();
+
 	for (const auto& p : listDiff) {
 		auto diffIndex = p.first;
 		auto& diff = p.second;
@@ -937,9 +1055,12 @@ CDeterministicMNList CDeterministicMNManager::GetListForBlock(const CBlockIndex*
 			snapshot.SetHeight(diffIndex->nHeight);
 		}
 
-		mnListsCache.emplace(diffIndex->GetBlockHash(), snapshot);
+        CacheList(diffIndex->GetBlockHash(), snapshot, baseBlockHash, EstimateListMemoryUsage(snapshot, diff));
+        baseBlockHash = diffIndex->GetBlockHash();
     }
 
+    EvictListsIfNeeded();
+
     return snapshot;
 }
 
@@ -952,6 +1073,26 @@ CDeterministicMNList CDeterministicMNManager::GetListAtChainTip()
 	return GetListForBlock(tipIndex);
 }
 
+bool CDeterministicMNManager::ReadListSnapshot(const uint256& blockHash, CDeterministicMNList& snapshotRet)
+{
+    CDeterministicMNListCompact compactSnapshot;
+    if (evoDb.Read(std::make_pair(DB_LIST_SNAPSHOT_COMPACT, blockHash), compactSnapshot)) {
+        snapshotRet = std::move(compactSnapshot.list);
+        return true;
+    }
+    return evoDb.Read(std::make_pair(DB_LIST_SNAPSHOT, blockHash), snapshotRet);
+}
+
+bool CDeterministicMNManager::ReadListDiff(const uint256& blockHash, CDeterministicMNListDiff& diffRet)
+{
+    CDeterministicMNListDiffCompact compactDiff;
+    if (evoDb.Read(std::make_pair(DB_LIST_DIFF_COMPACT, blockHash), compactDiff)) {
+        diffRet = std::move(compactDiff.diff);
+        return true;
+    }
+    return evoDb.Read(std::make_pair(DB_LIST_DIFF, blockHash), diffRet);
+}
+
 bool CDeterministicMNManager::IsProTxWithCollateral(const CTransactionRef& tx, uint32_t n)
 {
     if (tx->nVersion != 3 || tx->nType != TRANSACTION_PROVIDER_REGISTER) {
@@ -985,19 +1126,83 @@ bool CDeterministicMNManager::IsDIP3Enforced(int nHeight)
     return nHeight >= Params().GetConsensus().DIP0003EnforcementHeight;
 }
 
+void CDeterministicMNManager::CacheList(const uint256& blockHash, const CDeterministicMNList& list, const uint256& baseBlockHash, size_t nDiffUsage)
+{
+    AssertLockHeld(cs);
+
+    if (mnListsCache.count(blockHash)) {
+        return;
+    }
+
+    CachedList& entry = mnListsCache[blockHash];
+    entry.list = list;
+    entry.nFullUsage = EstimateListMemoryUsage(list);
+    entry.nUsage = entry.nFullUsage;
+
+    auto baseIt = baseBlockHash.IsNull() ? mnListsCache.end() : mnListsCache.find(baseBlockHash);
+    if (baseIt != mnListsCache.end()) {
+        entry.baseBlockHash = baseBlockHash;
+        entry.nUsage = std::min(nDiffUsage, entry.nFullUsage);
+        baseIt->second.derivedBlockHashes.emplace(blockHash);
+    }
+
+    mnListsCacheByHeight.emplace(list.GetHeight(), blockHash);
+    mnListsCacheBytes += entry.nUsage;
+    evoCacheBudget.GetStats(EVO_CACHE_MN_LISTS).SetUsage(mnListsCache.size(), mnListsCacheBytes);
+}
+
+void CDeterministicMNManager::UncacheList(const uint256& blockHash)
+{
+    AssertLockHeld(cs);
+
+    auto it = mnListsCache.find(blockHash);
+    if (it == mnListsCache.end()) {
+        return;
+    }
+    auto& entry = it->second;
+
+    // lists built from this one keep its nodes alive, so they are charged in full from now on
+    for (const auto& derivedBlockHash : entry.derivedBlockHashes) {
+        auto& derived = mnListsCache.at(derivedBlockHash);
+        mnListsCacheBytes += derived.nFullUsage - derived.nUsage;
+        derived.nUsage = derived.nFullUsage;
+        derived.baseBlockHash.SetNull();
+    }
+    if (!entry.baseBlockHash.IsNull()) {
+        mnListsCache.at(entry.baseBlockHash).derivedBlockHashes.erase(blockHash);
+    }
+
+    mnListsCacheBytes -= entry.nUsage;
+    mnListsCacheByHeight.erase(std::make_pair(entry.list.GetHeight(), blockHash));
+    mnListsCache.erase(it);
+    evoCacheBudget.GetStats(EVO_CACHE_MN_LISTS).SetUsage(mnListsCache.size(), mnListsCacheBytes);
+}
+
 void CDeterministicMNManager::CleanupCache(int nHeight)
 {
     AssertLockHeld(cs);
 
-    std::vector<uint256> toDelete;
-    for (const auto& p : mnListsCache) {
-        if (p.second.GetHeight() + LISTS_CACHE_SIZE < nHeight) {
-            toDelete.emplace_back(p.first);
-        }
+    while (!mnListsCacheByHeight.empty() && mnListsCacheByHeight.begin()->first + LISTS_CACHE_SIZE < nHeight) {
+        UncacheList(mnListsCacheByHeight.begin()->second);
     }
-    for (const auto& h : toDelete) {
-        mnListsCache.erase(h);
+
+    EvictListsIfNeeded();
+}
+
+void CDeterministicMNManager::EvictListsIfNeeded()
+{
+    AssertLockHeld(cs);
+
+    size_t nLimit = evoCacheBudget.GetLimit(EVO_CACHE_MN_LISTS);
+
+    // evict the oldest lists first, but always keep the most recent one. Evicting a base list might increase the
+    // charge of the lists built from it, so the usage is re-checked after each eviction
+    size_t nEvicted = 0;
+    while (mnListsCacheBytes > nLimit && mnListsCache.size() > 1) {
+        UncacheList(mnListsCacheByHeight.begin()->second);
+        nEvicted++;
     }
+    evoCacheBudget.GetStats(EVO_CACHE_MN_LISTS).Evicted(nEvicted);
 }
 
 bool CDeterministicMNManager::UpgradeDiff(CDBBatch& batch, const CBlockIndex* pindexNext, const CDeterministicMNList& curMNList, CDeterministicMNList& newMNList)
@@ -1110,4 +1315,54 @@ void CDeterministicMNManager::UpgradeDBIfNeeded()
 	dbTx->Commit();
 
 	evoDb.GetRawDB().CompactFull();
-}
\ No newline at end of file
+}
+
+void CDeterministicMNManager::MigrateDBToCompactFormatIfNeeded()
+{
+    LOCK(cs_main);
+
+    if (chainActive.Tip() == nullptr) {
+        return;
+    }
+
+    uint8_t nFormatVersion = 0;
+    if (evoDb.GetRawDB().Read(DB_LIST_FORMAT_VERSION, nFormatVersion) && nFormatVersion >= DMN_COMPACT_FORMAT_VERSION) {
+        return;
+    }
+
+    // Readers fall back to the legacy format for entries which are not converted yet, so it's safe to interrupt this.
+    // Entries of blocks which are not part of the active chain are not converted and stay readable the same way.
+    LogPrintf("CDeterministicMNManager::%s -- converting MN list snapshots and diffs to compact format\n", __func__);
+
+    CDBBatch batch(evoDb.GetRawDB());
+    size_t nConverted = 0;
+
+    for (int nHeight = Params().GetConsensus().DIP0003Height; nHeight <= chainActive.Height(); nHeight++) {
+        uint256 blockHash = chainActive[nHeight]->GetBlockHash();
+
+        CDeterministicMNListDiff diff;
+        if (evoDb.GetRawDB().Read(std::make_pair(DB_LIST_DIFF, blockHash), diff)) {
+            batch.Write(std::make_pair(DB_LIST_DIFF_COMPACT, blockHash), CDeterministicMNListDiffCompact(diff));
+            batch.Erase(std::make_pair(DB_LIST_DIFF, blockHash));
+            nConverted++;
+        }
+        CDeterministicMNList snapshot;
+        if (evoDb.GetRawDB().Read(std::make_pair(DB_LIST_SNAPSHOT, blockHash), snapshot)) {
+            batch.Write(std::make_pair(DB_LIST_SNAPSHOT_COMPACT, blockHash), CDeterministicMNListCompact(snapshot));
+            batch.Erase(std::make_pair(DB_LIST_SNAPSHOT, blockHash));
+            nConverted++;
+        }
+
+        if (batch.SizeEstimate() >= (1 << 24)) {
+            evoDb.GetRawDB().WriteBatch(batch);
+            batch.Clear();
+        }
+    }
+
+    batch.Write(DB_LIST_FORMAT_VERSION, DMN_COMPACT_FORMAT_VERSION);
+    evoDb.GetRawDB().WriteBatch(batch);
+
+    LogPrintf("CDeterministicMNManager::%s -- done converting %d entries\n", __func__, nConverted);
+
+    evoDb.GetRawDB().CompactFull();
+}
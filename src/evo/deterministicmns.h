@@ -9,6 +9,7 @@
 
 #include "arith_uint256.h"
 #include "bls/bls.h"
+#include "compressor.h"
 #include "dbwrapper.h"
 #include "evodb.h"
 #include "providertx.h"
@@ -17,6 +18,7 @@
 
 #include "immer/map.hpp"
 #include "immer/map_transient.hpp"
+#include "immer/set.hpp"
 
 #include <map>
 
@@ -239,6 +241,205 @@ public:
 typedef std::shared_ptr<CDeterministicMN> CDeterministicMNPtr;
 typedef std::shared_ptr<const CDeterministicMN> CDeterministicMNCPtr;
 
+// Version of the compact on-disk encoding of MN list snapshots and diffs. Bump it when CDMNCompactCoder changes
+static const uint8_t DMN_COMPACT_FORMAT_VERSION = 1;
+
+/**
+ * Table of distinct scripts used by compact snapshots. Many MNs share the same payout script (e.g. when hosted by the
+ * same service), so snapshots store every script only once and let MNs refer to it by index.
+ */
+class CDMNCompactScriptTable
+{
+public:
+    std::vector<CScript> scripts;
+    // only used while writing
+    std::map<CScript, uint32_t> scriptIndexes;
+
+public:
+    void Add(const CScript& script)
+    {
+        if (script.empty() || scriptIndexes.count(script)) {
+            return;
+        }
+        scriptIndexes.emplace(script, (uint32_t)scripts.size());
+        scripts.emplace_back(script);
+    }
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        WriteCompactSize(s, scripts.size());
+        for (const auto& script : scripts) {
+            s << CScriptCompressor(REF(script));
+        }
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        scripts.clear();
+        scriptIndexes.clear();
+        size_t cnt = ReadCompactSize(s);
+        scripts.resize(cnt);
+        for (size_t i = 0; i < cnt; i++) {
+            s >> REF(CScriptCompressor(scripts[i]));
+        }
+    }
+};
+
+/**
+ * Implements the compact on-disk encoding (DMN_COMPACT_FORMAT_VERSION) of MN states, state diffs and MNs.
+ * Compared to the plain serialization, it only writes fields which differ from the default (or previous) state,
+ * uses varints for heights and counters, compresses scripts and omits keyIDVoting when it equals keyIDOwner.
+ * confirmedHashWithProRegTxHash is never written, as it is always recalculated from proTxHash and confirmedHash.
+ * When a script table is given (snapshots), scripts are written as indexes into the table instead of inline.
+ */
+class CDMNCompactCoder
+{
+public:
+    // not a state field, signals that keyIDVoting was omitted because it equals keyIDOwner
+    static const uint32_t Flag_keyIDVotingIsOwner = 0x10000;
+
+private:
+    CDMNCompactScriptTable* scriptTable;
+
+public:
+    explicit CDMNCompactCoder(CDMNCompactScriptTable* _scriptTable = nullptr) : scriptTable(_scriptTable) {}
+
+    template<typename Stream>
+    void WriteStateDiff(Stream& s, const CDeterministicMNStateDiff& diff) const
+    {
+        uint32_t fields = diff.fields & ~CDeterministicMNStateDiff::Field_confirmedHashWithProRegTxHash;
+        if ((fields & CDeterministicMNStateDiff::Field_keyIDOwner) && (fields & CDeterministicMNStateDiff::Field_keyIDVoting) &&
+            diff.state.keyIDOwner == diff.state.keyIDVoting) {
+            fields = (fields & ~CDeterministicMNStateDiff::Field_keyIDVoting) | Flag_keyIDVotingIsOwner;
+        }
+        WriteVarInt(s, fields);
+#define DMN_STATE_DIFF_LINE(f) if (fields & CDeterministicMNStateDiff::Field_##f) WriteField(s, diff.state.f);
+        DMN_STATE_DIFF_ALL_FIELDS
+#undef DMN_STATE_DIFF_LINE
+    }
+
+    // The resulting diff never contains confirmedHashWithProRegTxHash, see CDeterministicMNList::UpdateMN
+    template<typename Stream>
+    void ReadStateDiff(Stream& s, CDeterministicMNStateDiff& diff) const
+    {
+        uint32_t fields = ReadVarInt<Stream, uint32_t>(s);
+        fields &= ~CDeterministicMNStateDiff::Field_confirmedHashWithProRegTxHash;
+        diff.state = CDeterministicMNState();
+#define DMN_STATE_DIFF_LINE(f) if (fields & CDeterministicMNStateDiff::Field_##f) ReadField(s, diff.state.f);
+        DMN_STATE_DIFF_ALL_FIELDS
+#undef DMN_STATE_DIFF_LINE
+        if (fields & Flag_keyIDVotingIsOwner) {
+            diff.state.keyIDVoting = diff.state.keyIDOwner;
+            fields = (fields & ~Flag_keyIDVotingIsOwner) | CDeterministicMNStateDiff::Field_keyIDVoting;
+        }
+        diff.fields = fields;
+    }
+
+    template<typename Stream>
+    void WriteMN(Stream& s, const CDeterministicMN& dmn) const
+    {
+        s << dmn.proTxHash;
+        WriteVarInt(s, dmn.internalId);
+        // most MNs use an output of the ProRegTx itself as collateral, in which case only the index is written
+        bool fInternalCollateral = dmn.collateralOutpoint.hash == dmn.proTxHash;
+        s << fInternalCollateral;
+        if (fInternalCollateral) {
+            WriteVarInt(s, dmn.collateralOutpoint.n);
+        } else {
+            s << dmn.collateralOutpoint;
+        }
+        WriteVarInt(s, dmn.nOperatorReward);
+        // a full state is written as a diff against the default state
+        WriteStateDiff(s, CDeterministicMNStateDiff(CDeterministicMNState(), *dmn.pdmnState));
+    }
+
+    template<typename Stream>
+    void ReadMN(Stream& s, CDeterministicMN& dmn) const
+    {
+        s >> dmn.proTxHash;
+        dmn.internalId = ReadVarInt<Stream, uint64_t>(s);
+        bool fInternalCollateral;
+        s >> fInternalCollateral;
+        if (fInternalCollateral) {
+            dmn.collateralOutpoint = COutPoint(dmn.proTxHash, ReadVarInt<Stream, uint32_t>(s));
+        } else {
+            s >> dmn.collateralOutpoint;
+        }
+        dmn.nOperatorReward = ReadVarInt<Stream, uint16_t>(s);
+
+        CDeterministicMNStateDiff stateDiff;
+        ReadStateDiff(s, stateDiff);
+        auto state = std::make_shared<CDeterministicMNState>();
+        stateDiff.ApplyToState(*state);
+        if (!state->confirmedHash.IsNull()) {
+            state->UpdateConfirmedHash(dmn.proTxHash, state->confirmedHash);
+        }
+        dmn.pdmnState = state;
+    }
+
+private:
+    // heights are -1 when unset, so these are shifted by one to keep them in the 1 byte range of varints
+    template<typename Stream>
+    void WriteField(Stream& s, int v) const
+    {
+        WriteVarInt(s, (uint32_t)v + 1);
+    }
+    template<typename Stream>
+    void ReadField(Stream& s, int& v) const
+    {
+        v = (int)(ReadVarInt<Stream, uint32_t>(s) - 1);
+    }
+
+    template<typename Stream>
+    void WriteField(Stream& s, uint16_t v) const
+    {
+        WriteVarInt(s, v);
+    }
+    template<typename Stream>
+    void ReadField(Stream& s, uint16_t& v) const
+    {
+        v = ReadVarInt<Stream, uint16_t>(s);
+    }
+
+    template<typename Stream>
+    void WriteField(Stream& s, const CScript& script) const
+    {
+        if (scriptTable) {
+            auto it = scriptTable->scriptIndexes.find(script);
+            assert(it != scriptTable->scriptIndexes.end());
+            WriteVarInt(s, it->second);
+        } else {
+            s << CScriptCompressor(REF(script));
+        }
+    }
+    template<typename Stream>
+    void ReadField(Stream& s, CScript& script) const
+    {
+        if (scriptTable) {
+            uint32_t idx = ReadVarInt<Stream, uint32_t>(s);
+            if (idx >= scriptTable->scripts.size()) {
+                throw std::ios_base::failure("invalid script index in compact DMN state");
+            }
+            script = scriptTable->scripts[idx];
+        } else {
+            s >> REF(CScriptCompressor(script));
+        }
+    }
+
+    template<typename Stream, typename T>
+    void WriteField(Stream& s, const T& v) const
+    {
+        s << v;
+    }
+    template<typename Stream, typename T>
+    void ReadField(Stream& s, T& v) const
+    {
+        s >> v;
+    }
+};
+
 class CDeterministicMNListDiff;
 
 template <typename Stream, typename K, typename T, typename Hash, typename Equal>
@@ -282,6 +483,7 @@ public:
     typedef immer::map<uint256, CDeterministicMNCPtr> MnMap;
 	typedef immer::map<uint64_t, uint256> MnInternalIdMap;
     typedef immer::map<uint256, std::pair<uint256, uint32_t> > MnUniquePropertyMap;
+    typedef immer::map<uint256, immer::set<uint256> > MnPayoutScriptMap;
 
 private:
     uint256 blockHash;
@@ -294,6 +496,10 @@ private:
     // we keep track of this as checking for duplicates would otherwise be painfully slow
     MnUniquePropertyMap mnUniquePropertyMap;
 
+    // map of payout script hashes to the proTxHashes of all MNs paying to it. Unlike the unique properties, multiple
+    // MNs may share the same payout script
+    MnPayoutScriptMap mnPayoutScriptMap;
+
 public:
     CDeterministicMNList() {}
 	explicit CDeterministicMNList(const uint256& _blockHash, int _height, uint32_t _totalRegisteredCount) :
@@ -330,6 +536,7 @@ public:
 		mnMap = MnMap();
 		mnUniquePropertyMap = MnUniquePropertyMap();
 		mnInternalIdMap = MnInternalIdMap();
+        mnPayoutScriptMap = MnPayoutScriptMap();
 
 		SerializationOpBase(s, CSerActionUnserialize());
 
@@ -392,6 +599,9 @@ public:
 		nTotalRegisteredCount = _count;
 	}
 
+    // Memory used by the maps of this list and by the MNs in it, including the parts shared with other lists
+    size_t DynamicMemoryUsage() const;
+
     bool IsMNValid(const uint256& proTxHash) const;
     bool IsMNPoSeBanned(const uint256& proTxHash) const;
     bool IsMNValid(const CDeterministicMNCPtr& dmn) const;
@@ -415,12 +625,13 @@ public:
     }
     CDeterministicMNCPtr GetMN(const uint256& proTxHash) const;
     CDeterministicMNCPtr GetValidMN(const uint256& proTxHash) const;
-    CDeterministicMNCPtr GetMNByOperatorKey(const CBLSPublicKey& pubKey);
+    CDeterministicMNCPtr GetMNByOperatorKey(const CBLSPublicKey& pubKey) const;
     CDeterministicMNCPtr GetMNByCollateral(const COutPoint& collateralOutpoint) const;
     CDeterministicMNCPtr GetValidMNByCollateral(const COutPoint& collateralOutpoint) const;
     CDeterministicMNCPtr GetMNByService(const CService& service) const;
     CDeterministicMNCPtr GetValidMNByService(const CService& service) const;
 	CDeterministicMNCPtr GetMNByInternalId(uint64_t internalId) const;
+    std::vector<CDeterministicMNCPtr> GetMNsByPayoutScript(const CScript& scriptPayout) const;
     CDeterministicMNCPtr GetMNPayee() const;
 
     /**
@@ -499,6 +710,9 @@ public:
     }
 
 private:
+    void AddPayoutScript(const uint256& proTxHash, const CScript& scriptPayout);
+    void DeletePayoutScript(const uint256& proTxHash, const CScript& scriptPayout);
+
     template <typename T>
     void AddUniqueProperty(const CDeterministicMNCPtr& dmn, const T& v)
     {
@@ -602,6 +816,132 @@ public:
     }
 };
 
+/**
+ * Owning wrappers which select the compact encoding (see CDMNCompactCoder) for list snapshots and diffs stored in
+ * EvoDB. These must own the wrapped object as CDBTransaction keeps written values around until it is committed.
+ */
+class CDeterministicMNListCompact
+{
+public:
+    CDeterministicMNList list;
+
+public:
+    CDeterministicMNListCompact() {}
+    explicit CDeterministicMNListCompact(const CDeterministicMNList& _list) : list(_list) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        CDMNCompactScriptTable scriptTable;
+        list.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) {
+            scriptTable.Add(dmn->pdmnState->scriptPayout);
+            scriptTable.Add(dmn->pdmnState->scriptOperatorPayout);
+        });
+        CDMNCompactCoder coder(&scriptTable);
+
+        s << DMN_COMPACT_FORMAT_VERSION;
+        s << list.GetBlockHash();
+        s << list.GetHeight();
+        WriteVarInt(s, list.GetTotalRegisteredCount());
+        s << scriptTable;
+        WriteCompactSize(s, list.GetAllMNsCount());
+        list.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) {
+            coder.WriteMN(s, *dmn);
+        });
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        uint8_t nVersion;
+        s >> nVersion;
+        if (nVersion != DMN_COMPACT_FORMAT_VERSION) {
+            throw std::ios_base::failure("unsupported compact MN list version");
+        }
+
+        uint256 blockHash;
+        int nHeight;
+        s >> blockHash;
+        s >> nHeight;
+        uint32_t nTotalRegisteredCount = ReadVarInt<Stream, uint32_t>(s);
+        list = CDeterministicMNList(blockHash, nHeight, nTotalRegisteredCount);
+
+        CDMNCompactScriptTable scriptTable;
+        s >> scriptTable;
+        CDMNCompactCoder coder(&scriptTable);
+
+        size_t cnt = ReadCompactSize(s);
+        for (size_t i = 0; i < cnt; i++) {
+            auto dmn = std::make_shared<CDeterministicMN>();
+            coder.ReadMN(s, *dmn);
+            list.AddMN(dmn);
+        }
+    }
+};
+
+class CDeterministicMNListDiffCompact
+{
+public:
+    CDeterministicMNListDiff diff;
+
+public:
+    CDeterministicMNListDiffCompact() {}
+    explicit CDeterministicMNListDiffCompact(const CDeterministicMNListDiff& _diff) : diff(_diff) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        CDMNCompactCoder coder;
+
+        s << DMN_COMPACT_FORMAT_VERSION;
+        WriteCompactSize(s, diff.addedMNs.size());
+        for (const auto& dmn : diff.addedMNs) {
+            coder.WriteMN(s, *dmn);
+        }
+        WriteCompactSize(s, diff.updatedMNs.size());
+        for (const auto& p : diff.updatedMNs) {
+            WriteVarInt(s, p.first);
+            coder.WriteStateDiff(s, p.second);
+        }
+        WriteCompactSize(s, diff.removedMns.size());
+        for (const auto& id : diff.removedMns) {
+            WriteVarInt(s, id);
+        }
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        uint8_t nVersion;
+        s >> nVersion;
+        if (nVersion != DMN_COMPACT_FORMAT_VERSION) {
+            throw std::ios_base::failure("unsupported compact MN list diff version");
+        }
+
+        CDMNCompactCoder coder;
+        diff = CDeterministicMNListDiff();
+
+        size_t cnt = ReadCompactSize(s);
+        diff.addedMNs.reserve(cnt);
+        for (size_t i = 0; i < cnt; i++) {
+            auto dmn = std::make_shared<CDeterministicMN>();
+            coder.ReadMN(s, *dmn);
+            diff.addedMNs.emplace_back(dmn);
+        }
+        cnt = ReadCompactSize(s);
+        for (size_t i = 0; i < cnt; i++) {
+            uint64_t id = ReadVarInt<Stream, uint64_t>(s);
+            CDeterministicMNStateDiff stateDiff;
+            coder.ReadStateDiff(s, stateDiff);
+            diff.updatedMNs.emplace(id, std::move(stateDiff));
+        }
+        cnt = ReadCompactSize(s);
+        for (size_t i = 0; i < cnt; i++) {
+            diff.removedMns.emplace(ReadVarInt<Stream, uint64_t>(s));
+        }
+    }
+};
+
 // TODO can be removed in a future version
 class CDeterministicMNListDiff_OldFormat
 {
@@ -644,7 +984,22 @@ public:
 private:
     CEvoDB& evoDb;
 
-    std::map<uint256, CDeterministicMNList> mnListsCache;
+    struct CachedList
+    {
+        CDeterministicMNList list;
+        // cached list this one was built from by applying a diff and shares most of its nodes with. Null if the list
+        // is charged in full, either because it was loaded from a snapshot or because its base got evicted
+        uint256 baseBlockHash;
+        // cached lists which were built from this one
+        std::set<uint256> derivedBlockHashes;
+        // estimated memory usage currently charged for this list and the one charged once it doesn't share any nodes
+        size_t nUsage;
+        size_t nFullUsage;
+    };
+    std::map<uint256, CachedList> mnListsCache;
+    // cached lists ordered by height, oldest first
+    std::set<std::pair<int, uint256>> mnListsCacheByHeight;
+    size_t mnListsCacheBytes{0};
 	const CBlockIndex* tipIndex{ nullptr };
 
 public:
@@ -674,8 +1029,20 @@ public:
 	bool UpgradeDiff(CDBBatch& batch, const CBlockIndex* pindexNext, const CDeterministicMNList& curMNList, CDeterministicMNList& newMNList);
 	void UpgradeDBIfNeeded();
 
+    // Converts snapshots and diffs of the active chain into the compact format (see CDMNCompactCoder)
+    void MigrateDBToCompactFormatIfNeeded();
+
 private:
+    // These read the compact format first and fall back to the legacy format for entries not migrated yet
+    bool ReadListSnapshot(const uint256& blockHash, CDeterministicMNList& snapshotRet);
+    bool ReadListDiff(const uint256& blockHash, CDeterministicMNListDiff& diffRet);
+
+    // baseBlockHash is the list the new one was built from by applying a diff with an estimated memory usage of
+    // nDiffUsage. The list is charged in full if there is no such base or the base isn't cached anymore
+    void CacheList(const uint256& blockHash, const CDeterministicMNList& list, const uint256& baseBlockHash = uint256(), size_t nDiffUsage = 0);
+    void UncacheList(const uint256& blockHash);
     void CleanupCache(int nHeight);
+    void EvictListsIfNeeded();
 };
 
 extern CDeterministicMNManager* deterministicMNManager;
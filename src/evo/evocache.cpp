@@ -0,0 +1,74 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "evocache.h"
+#include "evodb.h"
+
+#include "univalue.h"
+
+CEvoCacheBudget evoCacheBudget;
+
+// Share of the budget per component, in percent. The remaining 25% are used for the LevelDB cache of EvoDB
+static const size_t componentShares[EVO_CACHE_COMPONENT_COUNT] = {
+    45, // EVO_CACHE_MN_LISTS
+    20, // EVO_CACHE_QUORUMS
+    5,  // EVO_CACHE_SCAN_QUORUMS
+    5,  // EVO_CACHE_MINED_COMMITMENTS
+};
+static const size_t DB_CACHE_SHARE = 25;
+
+CEvoCacheBudget::CEvoCacheBudget() :
+    nTotalBytes(DEFAULT_EVO_CACHE_SIZE << 20)
+{
+}
+
+size_t CEvoCacheBudget::GetDBCacheBytes() const
+{
+    return nTotalBytes / 100 * DB_CACHE_SHARE;
+}
+
+size_t CEvoCacheBudget::GetLimit(EvoCacheComponent component) const
+{
+    return nTotalBytes / 100 * componentShares[component];
+}
+
+std::string CEvoCacheBudget::GetComponentName(EvoCacheComponent component)
+{
+    switch (component) {
+    case EVO_CACHE_MN_LISTS: return "mnlists";
+    case EVO_CACHE_QUORUMS: return "quorums";
+    case EVO_CACHE_SCAN_QUORUMS: return "scanquorums";
+    case EVO_CACHE_MINED_COMMITMENTS: return "minedcommitments";
+    default: return "unknown";
+    }
+}
+
+void CEvoCacheBudget::ToJson(UniValue& obj) const
+{
+    obj.setObject();
+    obj.push_back(Pair("totalBytes", (uint64_t)nTotalBytes));
+    obj.push_back(Pair("dbCacheBytes", (uint64_t)GetDBCacheBytes()));
+    if (evoDb) {
+        obj.push_back(Pair("dbTransactionBytes", (uint64_t)evoDb->GetMemoryUsage()));
+    }
+
+    UniValue cachesObj(UniValue::VOBJ);
+    for (int i = 0; i < EVO_CACHE_COMPONENT_COUNT; i++) {
+        auto component = (EvoCacheComponent)i;
+        const auto& s = stats[i];
+        uint64_t nHits = s.nHits;
+        uint64_t nMisses = s.nMisses;
+
+        UniValue cacheObj(UniValue::VOBJ);
+        cacheObj.push_back(Pair("limitBytes", (uint64_t)GetLimit(component)));
+        cacheObj.push_back(Pair("bytes", (uint64_t)s.nBytes));
+        cacheObj.push_back(Pair("entries", (uint64_t)s.nEntries));
+        cacheObj.push_back(Pair("hits", nHits));
+        cacheObj.push_back(Pair("misses", nMisses));
+        cacheObj.push_back(Pair("hitRate", nHits + nMisses != 0 ? (double)nHits / (nHits + nMisses) : 0.0));
+        cacheObj.push_back(Pair("evictions", (uint64_t)s.nEvictions));
+        cachesObj.push_back(Pair(GetComponentName(component), cacheObj));
+    }
+    obj.push_back(Pair("caches", cachesObj));
+}
@@ -0,0 +1,77 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef EPMCOIN_EVOCACHE_H
+#define EPMCOIN_EVOCACHE_H
+
+#include <atomic>
+#include <string>
+
+class UniValue;
+
+//! -evocache default (MiB)
+static const int64_t DEFAULT_EVO_CACHE_SIZE = 64;
+//! min. -evocache (MiB)
+static const int64_t MIN_EVO_CACHE_SIZE = 8;
+//! max. -evocache (MiB)
+static const int64_t MAX_EVO_CACHE_SIZE = 16384;
+
+enum EvoCacheComponent {
+    EVO_CACHE_MN_LISTS = 0,
+    EVO_CACHE_QUORUMS,
+    EVO_CACHE_SCAN_QUORUMS,
+    EVO_CACHE_MINED_COMMITMENTS,
+    EVO_CACHE_COMPONENT_COUNT,
+};
+
+class CEvoCacheStats
+{
+public:
+    std::atomic<uint64_t> nHits{0};
+    std::atomic<uint64_t> nMisses{0};
+    std::atomic<uint64_t> nEvictions{0};
+    std::atomic<size_t> nEntries{0};
+    std::atomic<size_t> nBytes{0};
+
+public:
+    void Hit() { nHits++; }
+    void Miss() { nMisses++; }
+    void Evicted(size_t nCount = 1) { nEvictions += nCount; }
+    void SetUsage(size_t _nEntries, size_t _nBytes)
+    {
+        nEntries = _nEntries;
+        nBytes = _nBytes;
+    }
+};
+
+/**
+ * A single memory budget (-evocache) shared by the in-memory caches of the deterministic MN list manager, the quorum
+ * manager and the quorum block processor. Each cache gets a fixed share of the budget, reports its memory usage and
+ * hit/miss counters here, and evicts entries on its own when it exceeds its share.
+ * A quarter of the budget is used as the LevelDB cache of EvoDB itself.
+ */
+class CEvoCacheBudget
+{
+private:
+    std::atomic<size_t> nTotalBytes;
+    CEvoCacheStats stats[EVO_CACHE_COMPONENT_COUNT];
+
+public:
+    CEvoCacheBudget();
+
+    void SetTotalBytes(size_t _nTotalBytes) { nTotalBytes = _nTotalBytes; }
+    size_t GetTotalBytes() const { return nTotalBytes; }
+
+    size_t GetDBCacheBytes() const;
+    size_t GetLimit(EvoCacheComponent component) const;
+    CEvoCacheStats& GetStats(EvoCacheComponent component) { return stats[component]; }
+
+    static std::string GetComponentName(EvoCacheComponent component);
+
+    void ToJson(UniValue& obj) const;
+};
+
+extern CEvoCacheBudget evoCacheBudget;
+
+#endif //EPMCOIN_EVOCACHE_H
@@ -77,6 +77,7 @@ public:
 
     size_t GetMemoryUsage()
     {
+        LOCK(cs);
         return rootDBTransaction.GetMemoryUsage();
     }
 
@@ -9,9 +9,11 @@
 #include "specialtx.h"
 
 #include "base58.h"
+#include "bls/bls_sigcache.h"
 #include "chainparams.h"
 #include "clientversion.h"
 #include "core_io.h"
+#include "cuckoosigcache.h"
 #include "hash.h"
 #include "messagesigner.h"
 #include "script/standard.h"
@@ -46,31 +48,79 @@ static bool CheckService(const uint256& proTxHash, const ProTx& proTx, CValidati
 }
 
 template <typename ProTx>
-static bool CheckHashSig(const ProTx& proTx, const CKeyID& keyID, CValidationState& state)
+static bool CheckStringSig(const ProTx& proTx, const CKeyID& keyID, CValidationState& state, std::vector<CScriptCheck>* pvChecks)
 {
+    std::string strMessage = proTx.MakeSignString();
+    if (pvChecks) {
+        // verified on the script check queue, a failure rejects the block
+        pvChecks->emplace_back([keyID, vchSig = proTx.vchSig, strMessage]() {
+            std::string strError;
+            return CMessageSigner::VerifyMessage(keyID, vchSig, strMessage, strError);
+        });
+        return true;
+    }
+
     std::string strError;
-    if (!CHashSigner::VerifyHash(::SerializeHash(proTx), keyID, proTx.vchSig, strError)) {
+    if (!CMessageSigner::VerifyMessage(keyID, proTx.vchSig, strMessage, strError)) {
         return state.DoS(100, false, REJECT_INVALID, "bad-protx-sig", false, strError);
     }
     return true;
 }
 
 template <typename ProTx>
-static bool CheckStringSig(const ProTx& proTx, const CKeyID& keyID, CValidationState& state)
+static bool CheckHashSig(const ProTx& proTx, const CKeyID& keyID, CValidationState& state, std::vector<CScriptCheck>* pvChecks)
 {
+    // valid payload signatures are cached, so that the signature of a provider tx which was accepted into the mempool
+    // is not verified again when the block is connected
+    uint256 msgHash = ::SerializeHash(proTx);
+    uint256 entry;
+    sharedSigCache.ComputeEntry(entry, CCuckooSigCache::PROTX_ECDSA, msgHash, keyID, proTx.vchSig);
+    if (sharedSigCache.Get(entry, false)) {
+        return true;
+    }
+
+    if (pvChecks) {
+        // verified on the script check queue, a failure rejects the block
+        pvChecks->emplace_back([msgHash, keyID, vchSig = proTx.vchSig, entry]() mutable {
+            std::string strError;
+            if (!CHashSigner::VerifyHash(msgHash, keyID, vchSig, strError)) {
+                return false;
+            }
+            sharedSigCache.Set(entry);
+            return true;
+        });
+        return true;
+    }
+
     std::string strError;
-    if (!CMessageSigner::VerifyMessage(keyID, proTx.vchSig, proTx.MakeSignString(), strError)) {
+    if (!CHashSigner::VerifyHash(msgHash, keyID, proTx.vchSig, strError)) {
         return state.DoS(100, false, REJECT_INVALID, "bad-protx-sig", false, strError);
     }
+    sharedSigCache.Set(entry);
     return true;
 }
 
 template <typename ProTx>
-static bool CheckHashSig(const ProTx& proTx, const CBLSPublicKey& pubKey, CValidationState& state)
+static bool CheckHashSig(const CTransaction& tx, const ProTx& proTx, const CBLSPublicKey& pubKey, CValidationState& state, CProTxSigBatchVerifier* sigBatchVerifier)
 {
-    if (!proTx.sig.VerifyInsecure(pubKey, ::SerializeHash(proTx))) {
+    if (!proTx.sig.IsValid() || !pubKey.IsValid()) {
+        return state.DoS(100, false, REJECT_INVALID, "bad-protx-sig", false);
+    }
+
+    uint256 msgHash = ::SerializeHash(proTx);
+    if (IsBLSSigCached(proTx.sig, pubKey, msgHash)) {
+        return true;
+    }
+
+    if (sigBatchVerifier) {
+        sigBatchVerifier->PushMessage(tx.GetHash(), tx.GetHash(), msgHash, proTx.sig, pubKey);
+        return true;
+    }
+
+    if (!proTx.sig.VerifyInsecure(pubKey, msgHash)) {
         return state.DoS(100, false, REJECT_INVALID, "bad-protx-sig", false);
     }
+    AddBLSSigToCache(proTx.sig, pubKey, msgHash);
     return true;
 }
 
@@ -85,7 +135,7 @@ static bool CheckInputsHash(const CTransaction& tx, const ProTx& proTx, CValidat
     return true;
 }
 
-bool CheckProRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state)
+bool CheckProRegTx(const CTransaction& tx, const CDeterministicMNList* pmnListPrev, CValidationState& state, std::vector<CScriptCheck>* pvChecks)
 {
     if (tx.nType != TRANSACTION_PROVIDER_REGISTER) {
         return state.DoS(100, false, REJECT_INVALID, "bad-protx-type");
@@ -175,8 +225,8 @@ bool CheckProRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValid
         return state.DoS(10, false, REJECT_INVALID, "bad-protx-collateral-reuse");
     }
 
-    if (pindexPrev) {
-		auto mnList = deterministicMNManager->GetListForBlock(pindexPrev);
+    if (pmnListPrev) {
+        const auto& mnList = *pmnListPrev;
 
         // only allow reusing of addresses when it's for the same collateral (which replaces the old MN)
         if (mnList.HasUniqueProperty(ptx.addr) && mnList.GetUniquePropertyMN(ptx.addr)->collateralOutpoint != collateralOutpoint) {
@@ -195,7 +245,7 @@ bool CheckProRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValid
 
     if (!keyForPayloadSig.IsNull()) {
         // collateral is not part of this ProRegTx, so we must verify ownership of the collateral
-        if (!CheckStringSig(ptx, keyForPayloadSig, state)) {
+        if (!CheckStringSig(ptx, keyForPayloadSig, state, pvChecks)) {
             return false;
         }
     } else {
@@ -208,7 +258,7 @@ bool CheckProRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValid
     return true;
 }
 
-bool CheckProUpServTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state)
+bool CheckProUpServTx(const CTransaction& tx, const CDeterministicMNList* pmnListPrev, CValidationState& state, CProTxSigBatchVerifier* sigBatchVerifier)
 {
     if (tx.nType != TRANSACTION_PROVIDER_UPDATE_SERVICE) {
         return state.DoS(100, false, REJECT_INVALID, "bad-protx-type");
@@ -227,8 +277,8 @@ bool CheckProUpServTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CVa
         return false;
     }
 
-    if (pindexPrev) {
-		auto mnList = deterministicMNManager->GetListForBlock(pindexPrev);
+    if (pmnListPrev) {
+        const auto& mnList = *pmnListPrev;
         auto mn = mnList.GetMN(ptx.proTxHash);
         if (!mn) {
             return state.DoS(100, false, REJECT_INVALID, "bad-protx-hash");
@@ -249,11 +299,11 @@ bool CheckProUpServTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CVa
             }
         }
 
-        // we can only check the signature if pindexPrev != NULL and the MN is known
+        // we can only check the signature if pmnListPrev != NULL and the MN is known
         if (!CheckInputsHash(tx, ptx, state)) {
             return false;
         }
-        if (!CheckHashSig(ptx, mn->pdmnState->pubKeyOperator.Get(), state)) {
+        if (!CheckHashSig(tx, ptx, mn->pdmnState->pubKeyOperator.Get(), state, sigBatchVerifier)) {
             return false;
         }
     }
@@ -261,7 +311,7 @@ bool CheckProUpServTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CVa
     return true;
 }
 
-bool CheckProUpRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state)
+bool CheckProUpRegTx(const CTransaction& tx, const CDeterministicMNList* pmnListPrev, CValidationState& state, std::vector<CScriptCheck>* pvChecks)
 {
     if (tx.nType != TRANSACTION_PROVIDER_UPDATE_REGISTRAR) {
         return state.DoS(100, false, REJECT_INVALID, "bad-protx-type");
@@ -292,8 +342,8 @@ bool CheckProUpRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CVal
         return state.DoS(10, false, REJECT_INVALID, "bad-protx-payee-dest");
     }
 
-    if (pindexPrev) {
-		auto mnList = deterministicMNManager->GetListForBlock(pindexPrev);
+    if (pmnListPrev) {
+        const auto& mnList = *pmnListPrev;
         auto dmn = mnList.GetMN(ptx.proTxHash);
         if (!dmn) {
             return state.DoS(100, false, REJECT_INVALID, "bad-protx-hash");
@@ -330,7 +380,7 @@ bool CheckProUpRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CVal
             return false;
         }
 
-        if (!CheckHashSig(ptx, dmn->pdmnState->keyIDOwner, state)) {
+        if (!CheckHashSig(ptx, dmn->pdmnState->keyIDOwner, state, pvChecks)) {
             return false;
         }
     }
@@ -338,7 +388,7 @@ bool CheckProUpRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CVal
     return true;
 }
 
-bool CheckProUpRevTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state)
+bool CheckProUpRevTx(const CTransaction& tx, const CDeterministicMNList* pmnListPrev, CValidationState& state, CProTxSigBatchVerifier* sigBatchVerifier)
 {
     if (tx.nType != TRANSACTION_PROVIDER_UPDATE_REVOKE) {
         return state.DoS(100, false, REJECT_INVALID, "bad-protx-type");
@@ -359,21 +409,25 @@ bool CheckProUpRevTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CVal
         return state.DoS(100, false, REJECT_INVALID, "bad-protx-reason");
     }
 
-    if (pindexPrev) {
-		auto mnList = deterministicMNManager->GetListForBlock(pindexPrev);
-        auto dmn = mnList.GetMN(ptx.proTxHash);
+    if (pmnListPrev) {
+        auto dmn = pmnListPrev->GetMN(ptx.proTxHash);
         if (!dmn)
             return state.DoS(100, false, REJECT_INVALID, "bad-protx-hash");
 
         if (!CheckInputsHash(tx, ptx, state))
             return false;
-        if (!CheckHashSig(ptx, dmn->pdmnState->pubKeyOperator.Get(), state))
+        if (!CheckHashSig(tx, ptx, dmn->pdmnState->pubKeyOperator.Get(), state, sigBatchVerifier))
             return false;
     }
 
     return true;
 }
 
+void ClearProTxSigCache()
+{
+    sharedSigCache.Clear();
+}
+
 std::string CProRegTx::MakeSignString() const
 {
     std::string s;
@@ -8,6 +8,7 @@
 #define EPMCOIN_PROVIDERTX_H
 
 #include "bls/bls.h"
+#include "bls/bls_batchverifier.h"
 #include "consensus/validation.h"
 #include "primitives/transaction.h"
 
@@ -180,9 +181,24 @@ public:
 };
 
 
-bool CheckProRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state);
-bool CheckProUpServTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state);
-bool CheckProUpRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state);
-bool CheckProUpRevTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state);
+// Collects the BLS payload signatures of all provider txs in a block, keyed by txid, so that they can be verified
+// in a single batch instead of one pairing per tx
+typedef CBLSBatchVerifier<uint256, uint256> CProTxSigBatchVerifier;
+
+class CDeterministicMNList;
+class CScriptCheck;
+
+// pmnListPrev is the MN list of the previous block, the contextual checks are skipped without it.
+// If sigBatchVerifier is passed, BLS signatures which are not found in the signature cache are only pushed to the
+// batch verifier and the caller is responsible for calling Verify() on it. If pvChecks is passed, ECDSA signatures are
+// not verified right away, but appended as checks for the script check queue
+bool CheckProRegTx(const CTransaction& tx, const CDeterministicMNList* pmnListPrev, CValidationState& state, std::vector<CScriptCheck>* pvChecks = nullptr);
+bool CheckProUpServTx(const CTransaction& tx, const CDeterministicMNList* pmnListPrev, CValidationState& state, CProTxSigBatchVerifier* sigBatchVerifier = nullptr);
+bool CheckProUpRegTx(const CTransaction& tx, const CDeterministicMNList* pmnListPrev, CValidationState& state, std::vector<CScriptCheck>* pvChecks = nullptr);
+bool CheckProUpRevTx(const CTransaction& tx, const CDeterministicMNList* pmnListPrev, CValidationState& state, CProTxSigBatchVerifier* sigBatchVerifier = nullptr);
+
+// Clears the signature cache, which is shared with BLS signatures. Only meant for benchmarks which measure uncached
+// verification
+void ClearProTxSigCache();
 
 #endif //EPM_PROVIDERTX_H
@@ -14,6 +14,8 @@
 #include "base58.h"
 #include "chainparams.h"
 #include "consensus/merkle.h"
+#include "scheduler.h"
+#include "streams.h"
 #include "univalue.h"
 #include "validation.h"
 
@@ -185,10 +187,9 @@ void CSimplifiedMNListDiff::ToJson(UniValue& obj) const
     }
 }
 
-bool BuildSimplifiedMNListDiff(const uint256& baseBlockHash, const uint256& blockHash, CSimplifiedMNListDiff& mnListDiffRet, std::string& errorRet)
+static bool GetDiffBlockIndexes(const uint256& baseBlockHash, const uint256& blockHash, const CBlockIndex*& baseBlockIndexRet, const CBlockIndex*& blockIndexRet, std::string& errorRet)
 {
     AssertLockHeld(cs_main);
-    mnListDiffRet = CSimplifiedMNListDiff();
 
     const CBlockIndex* baseBlockIndex = chainActive.Genesis();
     if (!baseBlockHash.IsNull()) {
@@ -215,6 +216,47 @@ bool BuildSimplifiedMNListDiff(const uint256& baseBlockHash, const uint256& bloc
         return false;
     }
 
+    baseBlockIndexRet = baseBlockIndex;
+    blockIndexRet = blockIndex;
+    return true;
+}
+
+// Fills in the coinbase TX of the given block and its merkle proof
+static bool BuildCbTxProof(const CBlockIndex* blockIndex, CSimplifiedMNListDiff& mnListDiffRet, std::string& errorRet)
+{
+    AssertLockHeld(cs_main);
+
+    // TODO store coinbase TX in CBlockIndex
+    CBlock block;
+    if (!ReadBlockFromDisk(block, blockIndex, Params().GetConsensus())) {
+        errorRet = strprintf("failed to read block %s from disk", blockIndex->GetBlockHash().ToString());
+        return false;
+    }
+
+    mnListDiffRet.cbTx = block.vtx[0];
+
+    std::vector<uint256> vHashes;
+    std::vector<bool> vMatch(block.vtx.size(), false);
+    for (const auto& tx : block.vtx) {
+        vHashes.emplace_back(tx->GetHash());
+    }
+    vMatch[0] = true; // only coinbase matches
+    mnListDiffRet.cbTxMerkleTree = CPartialMerkleTree(vHashes, vMatch);
+
+    return true;
+}
+
+bool BuildSimplifiedMNListDiff(const uint256& baseBlockHash, const uint256& blockHash, CSimplifiedMNListDiff& mnListDiffRet, std::string& errorRet)
+{
+    AssertLockHeld(cs_main);
+    mnListDiffRet = CSimplifiedMNListDiff();
+
+    const CBlockIndex* baseBlockIndex;
+    const CBlockIndex* blockIndex;
+    if (!GetDiffBlockIndexes(baseBlockHash, blockHash, baseBlockIndex, blockIndex, errorRet)) {
+        return false;
+    }
+
     LOCK(deterministicMNManager->cs);
 
 	auto baseDmnList = deterministicMNManager->GetListForBlock(baseBlockIndex);
@@ -231,22 +273,264 @@ bool BuildSimplifiedMNListDiff(const uint256& baseBlockHash, const uint256& bloc
         return false;
     }
 
-    // TODO store coinbase TX in CBlockIndex
-    CBlock block;
-    if (!ReadBlockFromDisk(block, blockIndex, Params().GetConsensus())) {
-        errorRet = strprintf("failed to read block %s from disk", blockHash.ToString());
+    return BuildCbTxProof(blockIndex, mnListDiffRet, errorRet);
+}
+
+CSimplifiedMNListDiffCache* mnListDiffCache;
+
+CSimplifiedMNListDiffCache::CSimplifiedMNListDiffCache(CScheduler* _scheduler) :
+    scheduler(_scheduler)
+{
+}
+
+void CSimplifiedMNListDiffCache::UpdatedBlockTip(const CBlockIndex* pindexNew)
+{
+    if (!scheduler || pindexNew->nHeight < Params().GetConsensus().DIP0003Height) {
+        return;
+    }
+
+    {
+        LOCK(cs);
+        if (fPrepareScheduled) {
+            // the pending job will pick up the new tip
+            return;
+        }
+        fPrepareScheduled = true;
+    }
+
+    // don't prepare the diffs directly as we're called while cs_main is held by the block connecting thread
+    scheduler->scheduleFromNow([this]() {
+        PrepareDiffs();
+    }, 0);
+}
+
+void CSimplifiedMNListDiffCache::NotifyChainLock(const CBlockIndex* pindex)
+{
+    LOCK(cs);
+    lastChainLockedBlockIndex = pindex;
+}
+
+bool CSimplifiedMNListDiffCache::GetDiff(const uint256& baseBlockHash, const uint256& blockHash, CSimplifiedMNListDiff& mnListDiffRet, std::string& errorRet)
+{
+    auto entry = GetOrBuildEntry(baseBlockHash, blockHash, errorRet);
+    if (!entry) {
         return false;
     }
+    mnListDiffRet = entry->diff;
+    return true;
+}
 
-    mnListDiffRet.cbTx = block.vtx[0];
+bool CSimplifiedMNListDiffCache::GetSerializedDiff(const uint256& baseBlockHash, const uint256& blockHash, int nVersion, std::shared_ptr<const std::vector<unsigned char>>& dataRet, std::string& errorRet)
+{
+    auto entry = GetOrBuildEntry(baseBlockHash, blockHash, errorRet);
+    if (!entry) {
+        return false;
+    }
+    dataRet = GetSerialized(entry, nVersion);
+    return true;
+}
 
-    std::vector<uint256> vHashes;
-    std::vector<bool> vMatch(block.vtx.size(), false);
-    for (const auto& tx : block.vtx) {
-        vHashes.emplace_back(tx->GetHash());
+size_t CSimplifiedMNListDiffCache::GetMemoryUsage()
+{
+    LOCK(cs);
+    return cacheBytes;
+}
+
+uint256 CSimplifiedMNListDiffCache::MakeCacheKey(const uint256& baseBlockHash, const uint256& blockHash)
+{
+    // the requested base hash is part of the key as a null base hash results in a different diff.baseBlockHash
+    CHashWriter hw(SER_GETHASH, 0);
+    hw << baseBlockHash << blockHash;
+    return hw.GetHash();
+}
+
+CSimplifiedMNListDiffCache::CacheEntryPtr CSimplifiedMNListDiffCache::GetOrBuildEntry(const uint256& baseBlockHash, const uint256& blockHash, std::string& errorRet)
+{
+    AssertLockHeld(cs_main);
+
+    // always re-check the block indexes, as a cached diff might have become invalid due to a reorg
+    const CBlockIndex* baseBlockIndex;
+    const CBlockIndex* blockIndex;
+    if (!GetDiffBlockIndexes(baseBlockHash, blockHash, baseBlockIndex, blockIndex, errorRet)) {
+        return nullptr;
     }
-    vMatch[0] = true; // only coinbase matches
-    mnListDiffRet.cbTxMerkleTree = CPartialMerkleTree(vHashes, vMatch);
 
+    uint256 cacheKey = MakeCacheKey(baseBlockHash, blockHash);
+
+    CacheEntryPtr entry;
+    if (GetCachedEntry(cacheKey, entry)) {
+        return entry;
+    }
+
+    entry = std::make_shared<CacheEntry>();
+    entry->cacheKey = cacheKey;
+    if (!BuildSimplifiedMNListDiff(baseBlockHash, blockHash, entry->diff, errorRet)) {
+        return nullptr;
+    }
+
+    AddEntry(entry);
+    return entry;
+}
+
+std::shared_ptr<const std::vector<unsigned char>> CSimplifiedMNListDiffCache::GetSerialized(const CacheEntryPtr& entry, int nVersion)
+{
+    size_t idx = nVersion >= LLMQS_PROTO_VERSION ? 1 : 0;
+
+    {
+        LOCK(cs);
+        if (entry->serialized[idx]) {
+            return entry->serialized[idx];
+        }
+    }
+
+    auto data = std::make_shared<std::vector<unsigned char>>();
+    CVectorWriter{SER_NETWORK, nVersion, *data, 0, entry->diff};
+
+    LOCK(cs);
+    if (!entry->serialized[idx]) {
+        entry->serialized[idx] = data;
+        entry->nBytes += data->capacity();
+        auto it = cacheMap.find(entry->cacheKey);
+        if (it != cacheMap.end() && *it->second == entry) {
+            cacheBytes += data->capacity();
+            TruncateIfNeeded();
+        }
+    }
+    return entry->serialized[idx];
+}
+
+void CSimplifiedMNListDiffCache::PrepareDiffs()
+{
+    struct PendingDiff
+    {
+        uint256 baseBlockHash;
+        CacheEntryPtr entry;
+        CDeterministicMNList baseList;
+    };
+
+    int64_t nTimeStart = GetTimeMicros();
+
+    std::vector<PendingDiff> pendingDiffs;
+    CDeterministicMNList tipList;
+    uint256 tipBlockHash;
+    {
+        LOCK(cs_main);
+
+        const CBlockIndex* pindexTip = chainActive.Tip();
+        const CBlockIndex* pindexChainLock;
+        {
+            LOCK(cs);
+            fPrepareScheduled = false;
+            pindexChainLock = lastChainLockedBlockIndex;
+        }
+        if (!pindexTip) {
+            return;
+        }
+        tipBlockHash = pindexTip->GetBlockHash();
+
+        // null hash, used by SPV clients which have no list yet
+        std::vector<std::pair<uint256, const CBlockIndex*>> bases;
+        bases.emplace_back(uint256(), chainActive.Genesis());
+        if (pindexTip->pprev) {
+            bases.emplace_back(pindexTip->pprev->GetBlockHash(), pindexTip->pprev);
+        }
+        int nCheckpointHeight = (pindexTip->nHeight / MNLISTDIFF_CACHE_CHECKPOINT_INTERVAL) * MNLISTDIFF_CACHE_CHECKPOINT_INTERVAL;
+        for (int i = 0; i < MNLISTDIFF_CACHE_CHECKPOINTS && nCheckpointHeight > 0; i++) {
+            bases.emplace_back(chainActive[nCheckpointHeight]->GetBlockHash(), chainActive[nCheckpointHeight]);
+            nCheckpointHeight -= MNLISTDIFF_CACHE_CHECKPOINT_INTERVAL;
+        }
+        if (pindexChainLock && pindexChainLock->nHeight < pindexTip->nHeight && chainActive.Contains(pindexChainLock)) {
+            bases.emplace_back(pindexChainLock->GetBlockHash(), pindexChainLock);
+        }
+
+        // the coinbase proof is the same for all bases
+        CSimplifiedMNListDiff tipDiff;
+        std::string strError;
+        if (!BuildCbTxProof(pindexTip, tipDiff, strError)) {
+            LogPrintf("CSimplifiedMNListDiffCache::%s -- failed to prepare diffs for block %s: %s\n", __func__, tipBlockHash.ToString(), strError);
+            return;
+        }
+
+        // MN lists are immutable snapshots which can safely be diffed after cs_main is released
+        tipList = deterministicMNManager->GetListForBlock(pindexTip);
+        for (const auto& p : bases) {
+            CacheEntryPtr entry;
+            if (GetCachedEntry(MakeCacheKey(p.first, tipBlockHash), entry)) {
+                continue;
+            }
+
+            entry = std::make_shared<CacheEntry>();
+            entry->cacheKey = MakeCacheKey(p.first, tipBlockHash);
+            entry->diff.cbTx = tipDiff.cbTx;
+            entry->diff.cbTxMerkleTree = tipDiff.cbTxMerkleTree;
+            if (!entry->diff.BuildQuorumsDiff(p.second, pindexTip)) {
+                LogPrintf("CSimplifiedMNListDiffCache::%s -- failed to prepare quorums diff for base %s\n", __func__, p.first.ToString());
+                continue;
+            }
+            pendingDiffs.emplace_back(PendingDiff{p.first, entry, deterministicMNManager->GetListForBlock(p.second)});
+        }
+    }
+
+    for (auto& pendingDiff : pendingDiffs) {
+        auto& diff = pendingDiff.entry->diff;
+        auto mnListDiff = pendingDiff.baseList.BuildSimplifiedDiff(tipList);
+        diff.mnList = std::move(mnListDiff.mnList);
+        diff.deletedMNs = std::move(mnListDiff.deletedMNs);
+        // see BuildSimplifiedMNListDiff, the base hash is the one requested by peers
+        diff.baseBlockHash = pendingDiff.baseBlockHash;
+        diff.blockHash = tipBlockHash;
+
+        AddEntry(pendingDiff.entry);
+        GetSerialized(pendingDiff.entry, PROTOCOL_VERSION);
+    }
+
+    LogPrint("bench", "CSimplifiedMNListDiffCache::%s -- prepared %d diffs for block %s in %.2fms\n", __func__,
+             pendingDiffs.size(), tipBlockHash.ToString(), 0.001 * (GetTimeMicros() - nTimeStart));
+}
+
+bool CSimplifiedMNListDiffCache::GetCachedEntry(const uint256& cacheKey, CacheEntryPtr& entryRet)
+{
+    LOCK(cs);
+    auto it = cacheMap.find(cacheKey);
+    if (it == cacheMap.end()) {
+        return false;
+    }
+    cacheList.splice(cacheList.begin(), cacheList, it->second);
+    entryRet = *it->second;
     return true;
 }
+
+void CSimplifiedMNListDiffCache::AddEntry(const CacheEntryPtr& entry)
+{
+    LOCK(cs);
+
+    if (cacheMap.count(entry->cacheKey)) {
+        // built concurrently by another thread
+        return;
+    }
+
+    const auto& diff = entry->diff;
+    entry->nBytes += ::GetSerializeSize(diff, SER_NETWORK, PROTOCOL_VERSION) +
+                     diff.mnList.capacity() * sizeof(CSimplifiedMNListEntry) +
+                     diff.deletedMNs.capacity() * sizeof(uint256) +
+                     diff.newQuorums.capacity() * sizeof(llmq::CFinalCommitment) +
+                     sizeof(CacheEntry);
+
+    cacheList.emplace_front(entry);
+    cacheMap.emplace(entry->cacheKey, cacheList.begin());
+    cacheBytes += entry->nBytes;
+    TruncateIfNeeded();
+}
+
+void CSimplifiedMNListDiffCache::TruncateIfNeeded()
+{
+    AssertLockHeld(cs);
+
+    // evict the least recently used entries, but always keep the newest one
+    while (cacheBytes > MNLISTDIFF_CACHE_MAX_BYTES && cacheList.size() > 1) {
+        const auto& entry = cacheList.back();
+        cacheBytes -= entry->nBytes;
+        cacheMap.erase(entry->cacheKey);
+        cacheList.pop_back();
+    }
+}
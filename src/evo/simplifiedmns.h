@@ -9,10 +9,18 @@
 #include "merkleblock.h"
 #include "netaddress.h"
 #include "pubkey.h"
+#include "saltedhasher.h"
 #include "serialize.h"
+#include "sync.h"
 #include "version.h"
 
+#include <list>
+#include <memory>
+#include <unordered_map>
+
 class UniValue;
+class CBlockIndex;
+class CScheduler;
 class CDeterministicMNList;
 class CDeterministicMN;
 
@@ -147,4 +155,72 @@ public:
 
 bool BuildSimplifiedMNListDiff(const uint256& baseBlockHash, const uint256& blockHash, CSimplifiedMNListDiff& mnListDiffRet, std::string& errorRet);
 
+// Number of checkpoint bases for which diffs against a new tip are prepared in the background
+static const int MNLISTDIFF_CACHE_CHECKPOINTS = 4;
+// Distance in blocks between two checkpoint bases
+static const int MNLISTDIFF_CACHE_CHECKPOINT_INTERVAL = 576;
+// Maximum estimated memory usage of all cached diffs, including their serialized forms
+static const size_t MNLISTDIFF_CACHE_MAX_BYTES = 32 * 1024 * 1024;
+
+/**
+ * Caches simplified MN list diffs together with their serialized form, so that bursts of GETMNLISTDIFF requests
+ * and "protx diff" calls don't rebuild two full MN lists per request.
+ * Diffs from the usual bases (genesis, previous tip, the last few checkpoints and the last chainlocked block) to a
+ * new tip are prepared on the scheduler thread after each block is connected. Only the MN lists are snapshotted
+ * while cs_main is held, the diffs themselves are built after releasing it.
+ * The cache is bounded by the estimated memory usage of the entries and evicts the least recently used ones first.
+ */
+class CSimplifiedMNListDiffCache
+{
+private:
+    struct CacheEntry
+    {
+        uint256 cacheKey;
+        CSimplifiedMNListDiff diff;
+        // serialized diff for peers below and at/above LLMQS_PROTO_VERSION
+        std::shared_ptr<const std::vector<unsigned char>> serialized[2];
+        // estimated memory usage of the diff and its serialized forms
+        size_t nBytes{0};
+    };
+    typedef std::shared_ptr<CacheEntry> CacheEntryPtr;
+    typedef std::list<CacheEntryPtr> CacheList;
+
+    CCriticalSection cs;
+    CScheduler* scheduler;
+
+    // most recently used entries first
+    CacheList cacheList;
+    std::unordered_map<uint256, CacheList::iterator, StaticSaltedHasher> cacheMap;
+    size_t cacheBytes{0};
+
+    const CBlockIndex* lastChainLockedBlockIndex{nullptr};
+    bool fPrepareScheduled{false};
+
+public:
+    explicit CSimplifiedMNListDiffCache(CScheduler* _scheduler);
+
+    void UpdatedBlockTip(const CBlockIndex* pindexNew);
+    void NotifyChainLock(const CBlockIndex* pindex);
+
+    // Same semantics as BuildSimplifiedMNListDiff, but served from the cache when possible
+    bool GetDiff(const uint256& baseBlockHash, const uint256& blockHash, CSimplifiedMNListDiff& mnListDiffRet, std::string& errorRet);
+    // Returns the MNLISTDIFF message payload as serialized for the given protocol version
+    bool GetSerializedDiff(const uint256& baseBlockHash, const uint256& blockHash, int nVersion, std::shared_ptr<const std::vector<unsigned char>>& dataRet, std::string& errorRet);
+
+    size_t GetMemoryUsage();
+
+private:
+    static uint256 MakeCacheKey(const uint256& baseBlockHash, const uint256& blockHash);
+
+    CacheEntryPtr GetOrBuildEntry(const uint256& baseBlockHash, const uint256& blockHash, std::string& errorRet);
+    std::shared_ptr<const std::vector<unsigned char>> GetSerialized(const CacheEntryPtr& entry, int nVersion);
+    void PrepareDiffs();
+
+    bool GetCachedEntry(const uint256& cacheKey, CacheEntryPtr& entryRet);
+    void AddEntry(const CacheEntryPtr& entry);
+    void TruncateIfNeeded();
+};
+
+extern CSimplifiedMNListDiffCache* mnListDiffCache;
+
 #endif //EPM_SIMPLIFIEDMNS_H
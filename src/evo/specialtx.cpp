@@ -14,12 +14,23 @@
 
 #include "cbtx.h"
 #include "deterministicmns.h"
+#include "providertx.h"
 #include "specialtx.h"
 
 #include "llmq/quorums_commitment.h"
 #include "llmq/quorums_blockprocessor.h"
 
-bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state)
+// Number of operator signed provider txs of a block whose BLS signatures are batch verified in one script check
+static const size_t PROTX_SIG_BATCH_CHECK_SIZE = 32;
+
+static bool IsProTx(const CTransaction& tx)
+{
+    return tx.nVersion == 3 && (tx.nType == TRANSACTION_PROVIDER_REGISTER || tx.nType == TRANSACTION_PROVIDER_UPDATE_SERVICE ||
+                                tx.nType == TRANSACTION_PROVIDER_UPDATE_REGISTRAR || tx.nType == TRANSACTION_PROVIDER_UPDATE_REVOKE);
+}
+
+static bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, const CDeterministicMNList* pmnListPrev, CValidationState& state,
+                           CProTxSigBatchVerifier* sigBatchVerifier, std::vector<CScriptCheck>* pvChecks)
 {
     if (tx.nVersion != 3 || tx.nType == TRANSACTION_NORMAL)
         return true;
@@ -30,13 +41,13 @@ bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CVali
 
     switch (tx.nType) {
     case TRANSACTION_PROVIDER_REGISTER:
-        return CheckProRegTx(tx, pindexPrev, state);
+        return CheckProRegTx(tx, pmnListPrev, state, pvChecks);
     case TRANSACTION_PROVIDER_UPDATE_SERVICE:
-        return CheckProUpServTx(tx, pindexPrev, state);
+        return CheckProUpServTx(tx, pmnListPrev, state, sigBatchVerifier);
     case TRANSACTION_PROVIDER_UPDATE_REGISTRAR:
-        return CheckProUpRegTx(tx, pindexPrev, state);
+        return CheckProUpRegTx(tx, pmnListPrev, state, pvChecks);
     case TRANSACTION_PROVIDER_UPDATE_REVOKE:
-        return CheckProUpRevTx(tx, pindexPrev, state);
+        return CheckProUpRevTx(tx, pmnListPrev, state, sigBatchVerifier);
     case TRANSACTION_COINBASE:
         return CheckCbTx(tx, pindexPrev, state);
     case TRANSACTION_QUORUM_COMMITMENT:
@@ -46,6 +57,68 @@ bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CVali
     return state.DoS(10, false, REJECT_INVALID, "bad-tx-type-check");
 }
 
+bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state)
+{
+    if (pindexPrev && IsProTx(tx)) {
+        auto mnList = deterministicMNManager->GetListForBlock(pindexPrev);
+        return CheckSpecialTx(tx, pindexPrev, &mnList, state, nullptr, nullptr);
+    }
+    return CheckSpecialTx(tx, pindexPrev, nullptr, state, nullptr, nullptr);
+}
+
+static bool VerifyProTxSigBatch(CProTxSigBatchVerifier& sigBatchVerifier, const uint256& blockHash)
+{
+    sigBatchVerifier.Verify();
+    if (!sigBatchVerifier.badMessages.empty()) {
+        LogPrintf("%s -- invalid provider tx signature in block %s, txid=%s\n", __func__,
+                  blockHash.ToString(), sigBatchVerifier.badMessages.begin()->ToString());
+        return false;
+    }
+    return true;
+}
+
+bool CheckSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindexPrev, const CDeterministicMNList& mnListPrev, CValidationState& state, std::vector<CScriptCheck>* pvChecks)
+{
+    // BLS payload signatures of provider txs are batch verified. Per-tx fallback happens inside the batch verifier when
+    // the aggregated verification fails. With pvChecks, every PROTX_SIG_BATCH_CHECK_SIZE operator signed provider txs
+    // make up one check, so that the batches are verified in parallel with the scripts
+    auto sigBatchVerifier = std::make_shared<CProTxSigBatchVerifier>(true, true);
+    size_t nBatchedTxs = 0;
+    uint256 blockHash = block.GetHash();
+
+    auto addBatchCheck = [&]() {
+        pvChecks->emplace_back([sigBatchVerifier, blockHash]() {
+            return VerifyProTxSigBatch(*sigBatchVerifier, blockHash);
+        });
+        sigBatchVerifier = std::make_shared<CProTxSigBatchVerifier>(true, true);
+        nBatchedTxs = 0;
+    };
+
+    for (const auto& tx : block.vtx) {
+        if (!CheckSpecialTx(*tx, pindexPrev, &mnListPrev, state, sigBatchVerifier.get(), pvChecks)) {
+            return false;
+        }
+        if (tx->nVersion == 3 && (tx->nType == TRANSACTION_PROVIDER_UPDATE_SERVICE || tx->nType == TRANSACTION_PROVIDER_UPDATE_REVOKE)) {
+            nBatchedTxs++;
+            if (pvChecks && nBatchedTxs == PROTX_SIG_BATCH_CHECK_SIZE) {
+                addBatchCheck();
+            }
+        }
+    }
+
+    if (nBatchedTxs == 0) {
+        return true;
+    }
+    if (pvChecks) {
+        addBatchCheck();
+        return true;
+    }
+    if (!VerifyProTxSigBatch(*sigBatchVerifier, blockHash)) {
+        return state.DoS(100, false, REJECT_INVALID, "bad-protx-sig");
+    }
+    return true;
+}
+
 bool ProcessSpecialTx(const CTransaction& tx, const CBlockIndex* pindex, CValidationState& state)
 {
     if (tx.nVersion != 3 || tx.nType == TRANSACTION_NORMAL) {
@@ -97,11 +170,9 @@ bool ProcessSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex, CV
 
     int64_t nTime1 = GetTimeMicros();
 
+    // the special txs were checked by CheckSpecialTxsInBlock already
     for (int i = 0; i < (int)block.vtx.size(); i++) {
         const CTransaction& tx = *block.vtx[i];
-        if (!CheckSpecialTx(tx, pindex->pprev, state)) {
-            return false;
-        }
         if (!ProcessSpecialTx(tx, pindex, state)) {
             return false;
         }
@@ -13,9 +13,14 @@
 
 class CBlock;
 class CBlockIndex;
+class CDeterministicMNList;
+class CScriptCheck;
 class CValidationState;
 
 bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state);
+// Checks all special txs of a block against the MN list of the previous block. If pvChecks is passed, the payload
+// signatures are not verified right away, but appended as checks for the script check queue
+bool CheckSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindexPrev, const CDeterministicMNList& mnListPrev, CValidationState& state, std::vector<CScriptCheck>* pvChecks);
 bool ProcessSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex, CValidationState& state, bool fJustCheck, bool fCheckCbTxMerleRoots);
 bool UndoSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex);
 
@@ -41,6 +41,7 @@ CGovernanceObject::CGovernanceObject() :
     fExpired(false),
     fUnparsable(false),
     mapCurrentMNVotes(),
+    voteTally(),
     cmmapOrphanVotes(),
     fileVotes()
 {
@@ -69,6 +70,7 @@ CGovernanceObject::CGovernanceObject(const uint256& nHashParentIn, int nRevision
     fExpired(false),
     fUnparsable(false),
     mapCurrentMNVotes(),
+    voteTally(),
     cmmapOrphanVotes(),
     fileVotes()
 {
@@ -97,6 +99,7 @@ CGovernanceObject::CGovernanceObject(const CGovernanceObject& other) :
     fExpired(other.fExpired),
     fUnparsable(other.fUnparsable),
     mapCurrentMNVotes(other.mapCurrentMNVotes),
+    voteTally(other.voteTally),
     cmmapOrphanVotes(other.cmmapOrphanVotes),
     fileVotes(other.fileVotes)
 {
@@ -106,6 +109,16 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
     const CGovernanceVote& vote,
     CGovernanceException& exception,
     CConnman& connman)
+{
+    return ProcessVote(pfrom, vote, exception, connman, deterministicMNManager->GetListAtChainTip(), VOTE_CHECK_NONE);
+}
+
+bool CGovernanceObject::ProcessVote(CNode* pfrom,
+    const CGovernanceVote& vote,
+    CGovernanceException& exception,
+    CConnman& connman,
+    const CDeterministicMNList& mnList,
+    vote_check_enum_t eCheck)
 {
     LOCK(cs);
 
@@ -119,7 +132,6 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
         return false;
     }
 
-    auto mnList = deterministicMNManager->GetListAtChainTip();
     auto dmn = mnList.GetMNByCollateral(vote.GetMasternodeOutpoint());
 
     if (!dmn) {
@@ -198,7 +210,13 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
     bool onlyVotingKeyAllowed = nObjectType == GOVERNANCE_OBJECT_PROPOSAL && vote.GetSignal() == VOTE_SIGNAL_FUNDING;
 
     // Finally check that the vote is actually valid (done last because of cost of signature verification)
-    if (!vote.IsValid(onlyVotingKeyAllowed)) {
+    bool fValid;
+    if (eCheck == VOTE_CHECK_NONE) {
+        fValid = vote.IsValid(dmn, onlyVotingKeyAllowed);
+    } else {
+        fValid = eCheck == (onlyVotingKeyAllowed ? VOTE_CHECK_VOTING_KEY : VOTE_CHECK_OPERATOR_KEY);
+    }
+    if (!fValid) {
         std::ostringstream ostr;
         ostr << "CGovernanceObject::ProcessVote -- Invalid vote"
              << ", MN outpoint = " << vote.GetMasternodeOutpoint().ToStringShort()
@@ -220,6 +238,8 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
         return false;
     }
 
+    UpdateVoteTally(eSignal, voteInstanceRef.eOutcome, -1);
+    UpdateVoteTally(eSignal, vote.GetOutcome(), 1);
     voteInstanceRef = vote_instance_t(vote.GetOutcome(), nVoteTimeUpdate, vote.GetTimestamp());
     fileVotes.AddVote(vote);
     fDirtyCache = true;
@@ -236,6 +256,9 @@ void CGovernanceObject::ClearMasternodeVotes()
     while (it != mapCurrentMNVotes.end()) {
         if (!mnList.HasMNByCollateral(it->first)) {
             fileVotes.RemoveVotesFromMasternode(it->first);
+            for (const auto& instancePair : it->second.mapInstances) {
+                UpdateVoteTally(instancePair.first, instancePair.second.eOutcome, -1);
+            }
             mapCurrentMNVotes.erase(it++);
         } else {
             ++it;
@@ -263,6 +286,7 @@ std::set<uint256> CGovernanceObject::RemoveInvalidVotes(const COutPoint& mnOutpo
         CGovernanceVote tmpVote(mnOutpoint, nParentHash, (vote_signal_enum_t)jt->first, jt->second.eOutcome);
         tmpVote.SetTime(jt->second.nCreationTime);
         if (removedVotes.count(tmpVote.GetHash())) {
+            UpdateVoteTally(jt->first, jt->second.eOutcome, -1);
             jt = it->second.mapInstances.erase(jt);
         } else {
             ++jt;
@@ -619,15 +643,53 @@ int CGovernanceObject::CountMatchingVotes(vote_signal_enum_t eVoteSignalIn, vote
 {
     LOCK(cs);
 
-    int nCount = 0;
+    if (eVoteSignalIn < 0 || eVoteSignalIn > MAX_SUPPORTED_VOTE_SIGNAL ||
+        eVoteOutcomeIn < 0 || eVoteOutcomeIn > VOTE_OUTCOME_ABSTAIN) {
+        return 0;
+    }
+    return voteTally[eVoteSignalIn][eVoteOutcomeIn];
+}
+
+void CGovernanceObject::UpdateVoteTally(int nSignal, vote_outcome_enum_t eOutcome, int nDelta)
+{
+    AssertLockHeld(cs);
+
+    // VOTE_OUTCOME_NONE is the placeholder of instances which never got a valid vote, it's never counted
+    if (nSignal <= VOTE_SIGNAL_NONE || nSignal > MAX_SUPPORTED_VOTE_SIGNAL ||
+        eOutcome <= VOTE_OUTCOME_NONE || eOutcome > VOTE_OUTCOME_ABSTAIN) {
+        return;
+    }
+    voteTally[nSignal][eOutcome] += nDelta;
+}
+
+void CGovernanceObject::RebuildVoteTally()
+{
+    LOCK(cs);
+
+    voteTally = vote_tally_t();
     for (const auto& votepair : mapCurrentMNVotes) {
-        const vote_rec_t& recVote = votepair.second;
-        vote_instance_m_cit it2 = recVote.mapInstances.find(eVoteSignalIn);
-        if (it2 != recVote.mapInstances.end() && it2->second.eOutcome == eVoteOutcomeIn) {
-            ++nCount;
+        for (const auto& instancePair : votepair.second.mapInstances) {
+            UpdateVoteTally(instancePair.first, instancePair.second.eOutcome, 1);
         }
     }
-    return nCount;
+}
+
+void CGovernanceObject::RebuildCurrentMNVotes(const std::vector<CGovernanceVote>& vecVotes)
+{
+    LOCK(cs);
+
+    mapCurrentMNVotes.clear();
+    for (const auto& vote : vecVotes) {
+        vote_instance_t& voteInstanceRef = mapCurrentMNVotes[vote.GetMasternodeOutpoint()].mapInstances[int(vote.GetSignal())];
+        // same precedence as in ProcessVote. The time a vote was processed at is not stored, the time it was created
+        // at is close enough for the rate checks
+        if (vote.GetTimestamp() > voteInstanceRef.nCreationTime ||
+            (vote.GetTimestamp() == voteInstanceRef.nCreationTime && vote.GetOutcome() >= voteInstanceRef.eOutcome)) {
+            voteInstanceRef = vote_instance_t(vote.GetOutcome(), vote.GetTimestamp(), vote.GetTimestamp());
+        }
+    }
+    RebuildVoteTally();
+    fDirtyCache = true;
 }
 
 /**
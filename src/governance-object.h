@@ -20,10 +20,13 @@
 
 #include <univalue.h>
 
+#include <array>
+
 class CGovernanceManager;
 class CGovernanceTriggerManager;
 class CGovernanceObject;
 class CGovernanceVote;
+class CDeterministicMNList;
 
 static const int MIN_GOVERNANCE_PEER_PROTO_VERSION = 70216;
 static const int GOVERNANCE_FILTER_PROTO_VERSION = 70206;
@@ -91,6 +94,9 @@ typedef vote_instance_m_t::iterator vote_instance_m_it;
 
 typedef vote_instance_m_t::const_iterator vote_instance_m_cit;
 
+/// Number of current votes per signal and outcome
+typedef std::array<std::array<int, VOTE_OUTCOME_ABSTAIN + 1>, MAX_SUPPORTED_VOTE_SIGNAL + 1> vote_tally_t;
+
 struct vote_rec_t {
     vote_instance_m_t mapInstances;
 
@@ -103,6 +109,9 @@ struct vote_rec_t {
     }
 };
 
+// test-only access to the vote processing, defined in test/test_epmcoin.h
+struct GovernanceTestAccess;
+
 /**
 * Governance Object
 *
@@ -113,6 +122,8 @@ class CGovernanceObject
     friend class CGovernanceManager;
     friend class CGovernanceTriggerManager;
     friend class CSuperblock;
+    friend class CGovernanceDB;
+    friend struct GovernanceTestAccess;
 
 public: // Types
     typedef std::map<COutPoint, vote_rec_t> vote_m_t;
@@ -183,6 +194,9 @@ private:
 
     vote_m_t mapCurrentMNVotes;
 
+    /// Tallies of mapCurrentMNVotes, updated whenever a vote instance is added, replaced or removed
+    vote_tally_t voteTally;
+
     /// Limited map of votes orphaned by MN
     vote_cmm_t cmmapOrphanVotes;
 
@@ -323,13 +337,13 @@ public:
             READWRITE(vchSig);
         }
         if (s.GetType() & SER_DISK) {
-            // Only include these for the disk file format
-            LogPrint("gobject", "CGovernanceObject::SerializationOp Reading/writing votes from/to disk\n");
+            // Only include these for the disk file format. The votes themselves are stored in governanceDb
             READWRITE(nDeletionTime);
             READWRITE(fExpired);
             READWRITE(mapCurrentMNVotes);
-            READWRITE(fileVotes);
-            LogPrint("gobject", "CGovernanceObject::SerializationOp hash = %s, vote count = %d\n", GetHash().ToString(), fileVotes.GetVoteCount());
+        }
+        if (ser_action.ForRead()) {
+            RebuildVoteTally();
         }
 
         // AFTER DESERIALIZATION OCCURS, CACHED VARIABLES MUST BE CALCULATED MANUALLY
@@ -340,10 +354,24 @@ private:
     void LoadData();
     void GetData(UniValue& objResult);
 
+    void UpdateVoteTally(int nSignal, vote_outcome_enum_t eOutcome, int nDelta);
+    void RebuildVoteTally();
+    // Replaces the current votes of all masternodes with the latest ones in vecVotes, used when the stored votes are
+    // newer than the stored object
+    void RebuildCurrentMNVotes(const std::vector<CGovernanceVote>& vecVotes);
+
     bool ProcessVote(CNode* pfrom,
         const CGovernanceVote& vote,
         CGovernanceException& exception,
         CConnman& connman);
+    // Same as above, but resolves the masternode from mnList and uses the result of an earlier signature check unless
+    // eCheck is VOTE_CHECK_NONE
+    bool ProcessVote(CNode* pfrom,
+        const CGovernanceVote& vote,
+        CGovernanceException& exception,
+        CConnman& connman,
+        const CDeterministicMNList& mnList,
+        vote_check_enum_t eCheck);
 
     /// Called when MN's which have voted on this object have been removed
     void ClearMasternodeVotes();
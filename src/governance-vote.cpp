@@ -255,6 +255,11 @@ bool CGovernanceVote::CheckSignature(const CBLSPublicKey& pubKey) const
 }
 
 bool CGovernanceVote::IsValid(bool useVotingKey) const
+{
+    return IsValid(deterministicMNManager->GetListAtChainTip().GetMNByCollateral(masternodeOutpoint), useVotingKey);
+}
+
+bool CGovernanceVote::IsValid(const CDeterministicMNCPtr& dmn, bool useVotingKey) const
 {
     if (nTime > GetAdjustedTime() + (60 * 60)) {
         LogPrint("gobject", "CGovernanceVote::IsValid -- vote is too far ahead of current time - %s - nTime %lli - Max Time %lli\n", GetHash().ToString(), nTime, GetAdjustedTime() + (60 * 60));
@@ -273,7 +278,6 @@ bool CGovernanceVote::IsValid(bool useVotingKey) const
         return false;
     }
 
-    auto dmn = deterministicMNManager->GetListAtChainTip().GetMNByCollateral(masternodeOutpoint);
     if (!dmn) {
         LogPrint("gobject", "CGovernanceVote::IsValid -- Unknown Masternode - %s\n", masternodeOutpoint.ToStringShort());
         return false;
@@ -286,6 +290,15 @@ bool CGovernanceVote::IsValid(bool useVotingKey) const
     }
 }
 
+vote_check_enum_t CGovernanceVote::Check(const CDeterministicMNCPtr& dmn) const
+{
+    bool useVotingKey = vchSig.size() != CBLSSignature::SerSize;
+    if (!IsValid(dmn, useVotingKey)) {
+        return VOTE_CHECK_INVALID;
+    }
+    return useVotingKey ? VOTE_CHECK_VOTING_KEY : VOTE_CHECK_OPERATOR_KEY;
+}
+
 bool operator==(const CGovernanceVote& vote1, const CGovernanceVote& vote2)
 {
     bool fResult = ((vote1.masternodeOutpoint == vote2.masternodeOutpoint) &&
@@ -13,6 +13,7 @@
 
 class CGovernanceVote;
 class CConnman;
+class CDeterministicMN;
 
 // INTENTION OF MASTERNODES REGARDING ITEM
 enum vote_outcome_enum_t {
@@ -34,6 +35,14 @@ enum vote_signal_enum_t {
 
 static const int MAX_SUPPORTED_VOTE_SIGNAL = VOTE_SIGNAL_ENDORSED;
 
+// RESULT OF VERIFYING A VOTE AHEAD OF PROCESSING IT (see CGovernanceManager::ProcessPendingVotes)
+enum vote_check_enum_t {
+    VOTE_CHECK_NONE         = 0, //   -- not verified yet, ProcessVote has to do it
+    VOTE_CHECK_INVALID      = 1,
+    VOTE_CHECK_VOTING_KEY   = 2, //   -- valid and signed with the voting key
+    VOTE_CHECK_OPERATOR_KEY = 3, //   -- valid and signed with the operator key
+};
+
 /**
 * Governance Voting
 *
@@ -102,6 +111,11 @@ public:
     bool Sign(const CBLSSecretKey& key);
     bool CheckSignature(const CBLSPublicKey& pubKey) const;
     bool IsValid(bool useVotingKey) const;
+    bool IsValid(const std::shared_ptr<const CDeterministicMN>& dmn, bool useVotingKey) const;
+    // Verifies the vote with the key it was signed with. Only the operator key produces BLS signatures. Reads only the
+    // adjusted time and, for ECDSA votes, SPORK_6_NEW_SIGS through sporkManager, which are both locked internally, so
+    // it can run on worker threads
+    vote_check_enum_t Check(const std::shared_ptr<const CDeterministicMN>& dmn) const;
     void Relay(CConnman& connman) const;
 
     const COutPoint& GetMasternodeOutpoint() const { return masternodeOutpoint; }
@@ -5,24 +5,277 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "governance-votedb.h"
+#include "governance-object.h"
+#include "util.h"
+
+static const std::string DB_OBJECT = "gov_o";
+static const std::string DB_OBJECT_OUTDATED = "gov_oo";
+static const std::string DB_VOTE = "gov_v";
+static const std::string DB_VOTE_PARENT = "gov_vp";
+static const std::string DB_MN_VOTE = "gov_mv";
+static const std::string DB_VOTE_COUNT = "gov_vc";
+
+CGovernanceDB* governanceDb;
+
+CGovernanceDB::CGovernanceDB(size_t nCacheSize, bool fMemory, bool fWipe) :
+    db(fMemory ? "" : (GetDataDir() / "governance"), nCacheSize, fMemory, fWipe),
+    nVoteCount(0)
+{
+    if (!db.Read(DB_VOTE_COUNT, nVoteCount)) {
+        // only happens once for DBs written before the count was stored
+        nVoteCount = CountVotes();
+        db.Write(DB_VOTE_COUNT, nVoteCount);
+    }
+}
+
+int CGovernanceDB::CountVotes()
+{
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+
+    int nCount = 0;
+    auto start = std::make_pair(DB_VOTE_PARENT, uint256());
+    pcursor->Seek(start);
+    while (pcursor->Valid()) {
+        decltype(start) k;
+        if (!pcursor->GetKey(k) || k.first != DB_VOTE_PARENT) {
+            break;
+        }
+        nCount++;
+        pcursor->Next();
+    }
+    return nCount;
+}
+
+void CGovernanceDB::WriteObject(const CGovernanceObject& govobj)
+{
+    CDBBatch batch(db);
+    batch.Write(std::make_pair(DB_OBJECT, govobj.GetHash()), govobj);
+    batch.Erase(std::make_pair(DB_OBJECT_OUTDATED, govobj.GetHash()));
+    db.WriteBatch(batch);
+}
+
+void CGovernanceDB::WriteObjects(const std::map<uint256, CGovernanceObject>& mapObjects)
+{
+    CDBBatch batch(db);
+    for (const auto& p : mapObjects) {
+        batch.Write(std::make_pair(DB_OBJECT, p.first), p.second);
+        batch.Erase(std::make_pair(DB_OBJECT_OUTDATED, p.first));
+    }
+    db.WriteBatch(batch);
+}
+
+void CGovernanceDB::LoadObjects(std::map<uint256, CGovernanceObject>& mapObjectsRet)
+{
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+
+    auto start = std::make_pair(DB_OBJECT, uint256());
+    pcursor->Seek(start);
+    while (pcursor->Valid()) {
+        decltype(start) k;
+        if (!pcursor->GetKey(k) || k.first != DB_OBJECT) {
+            break;
+        }
+
+        CGovernanceObject govobj;
+        if (pcursor->GetValue(govobj)) {
+            auto it = mapObjectsRet.emplace(k.second, govobj).first;
+            it->second.fileVotes.SetLazyLoad(k.second);
+        }
+
+        pcursor->Next();
+    }
+
+    // votes which arrived after the last flush are stored, but not the current votes of their objects
+    int nOutdated = 0;
+    start = std::make_pair(DB_OBJECT_OUTDATED, uint256());
+    pcursor->Seek(start);
+    while (pcursor->Valid()) {
+        decltype(start) k;
+        if (!pcursor->GetKey(k) || k.first != DB_OBJECT_OUTDATED) {
+            break;
+        }
+
+        auto it = mapObjectsRet.find(k.second);
+        if (it != mapObjectsRet.end()) {
+            it->second.RebuildCurrentMNVotes(ReadVotes(k.second));
+            nOutdated++;
+        }
+
+        pcursor->Next();
+    }
+    if (nOutdated != 0) {
+        LogPrintf("CGovernanceDB::%s -- rebuilt the current votes of %d objects\n", __func__, nOutdated);
+    }
+}
+
+void CGovernanceDB::EraseObject(const uint256& nHash)
+{
+    LOCK(cs);
+
+    CDBBatch batch(db);
+    int nErased = 0;
+    for (const auto& vote : ReadVotes(nHash)) {
+        batch.Erase(std::make_tuple(DB_VOTE, nHash, vote.GetHash()));
+        batch.Erase(std::make_pair(DB_VOTE_PARENT, vote.GetHash()));
+        batch.Erase(std::make_tuple(DB_MN_VOTE, vote.GetMasternodeOutpoint(), nHash, vote.GetHash()));
+        nErased++;
+    }
+    batch.Erase(std::make_pair(DB_OBJECT, nHash));
+    batch.Erase(std::make_pair(DB_OBJECT_OUTDATED, nHash));
+    batch.Write(DB_VOTE_COUNT, nVoteCount - nErased);
+    db.WriteBatch(batch);
+    nVoteCount -= nErased;
+}
+
+void CGovernanceDB::WriteVote(const CGovernanceVote& vote)
+{
+    LOCK(cs);
+
+    bool fNew = !db.Exists(std::make_pair(DB_VOTE_PARENT, vote.GetHash()));
+
+    CDBBatch batch(db);
+    batch.Write(std::make_tuple(DB_VOTE, vote.GetParentHash(), vote.GetHash()), vote);
+    batch.Write(std::make_pair(DB_VOTE_PARENT, vote.GetHash()), vote.GetParentHash());
+    batch.Write(std::make_tuple(DB_MN_VOTE, vote.GetMasternodeOutpoint(), vote.GetParentHash(), vote.GetHash()), (uint8_t)1);
+    batch.Write(std::make_pair(DB_OBJECT_OUTDATED, vote.GetParentHash()), (uint8_t)1);
+    if (fNew) {
+        batch.Write(DB_VOTE_COUNT, nVoteCount + 1);
+    }
+    db.WriteBatch(batch);
+
+    if (fNew) {
+        nVoteCount++;
+    }
+}
+
+void CGovernanceDB::EraseVote(const CGovernanceVote& vote)
+{
+    LOCK(cs);
+
+    if (!db.Exists(std::make_pair(DB_VOTE_PARENT, vote.GetHash()))) {
+        return;
+    }
+
+    CDBBatch batch(db);
+    batch.Erase(std::make_tuple(DB_VOTE, vote.GetParentHash(), vote.GetHash()));
+    batch.Erase(std::make_pair(DB_VOTE_PARENT, vote.GetHash()));
+    batch.Erase(std::make_tuple(DB_MN_VOTE, vote.GetMasternodeOutpoint(), vote.GetParentHash(), vote.GetHash()));
+    batch.Write(std::make_pair(DB_OBJECT_OUTDATED, vote.GetParentHash()), (uint8_t)1);
+    batch.Write(DB_VOTE_COUNT, nVoteCount - 1);
+    db.WriteBatch(batch);
+
+    nVoteCount--;
+}
+
+bool CGovernanceDB::ReadVote(const uint256& nVoteHash, CGovernanceVote& voteRet)
+{
+    uint256 nParentHash;
+    if (!db.Read(std::make_pair(DB_VOTE_PARENT, nVoteHash), nParentHash)) {
+        return false;
+    }
+    return db.Read(std::make_tuple(DB_VOTE, nParentHash, nVoteHash), voteRet);
+}
+
+std::vector<CGovernanceVote> CGovernanceDB::ReadVotes(const uint256& nParentHash)
+{
+    std::vector<CGovernanceVote> vecVotes;
+
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+
+    auto start = std::make_tuple(DB_VOTE, nParentHash, uint256());
+    pcursor->Seek(start);
+    while (pcursor->Valid()) {
+        decltype(start) k;
+        if (!pcursor->GetKey(k) || std::get<0>(k) != DB_VOTE || std::get<1>(k) != nParentHash) {
+            break;
+        }
+
+        CGovernanceVote vote;
+        if (pcursor->GetValue(vote)) {
+            vecVotes.emplace_back(vote);
+        }
+
+        pcursor->Next();
+    }
+
+    return vecVotes;
+}
+
+std::vector<CGovernanceVote> CGovernanceDB::ReadVotesFromMasternode(const uint256& nParentHash, const COutPoint& outpointMasternode)
+{
+    std::vector<uint256> vecVoteHashes;
+    {
+        std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+
+        auto start = std::make_tuple(DB_MN_VOTE, outpointMasternode, nParentHash, uint256());
+        pcursor->Seek(start);
+        while (pcursor->Valid()) {
+            decltype(start) k;
+            if (!pcursor->GetKey(k) || std::get<0>(k) != DB_MN_VOTE || std::get<1>(k) != outpointMasternode || std::get<2>(k) != nParentHash) {
+                break;
+            }
+            vecVoteHashes.emplace_back(std::get<3>(k));
+            pcursor->Next();
+        }
+    }
+
+    std::vector<CGovernanceVote> vecVotes;
+    for (const auto& nVoteHash : vecVoteHashes) {
+        CGovernanceVote vote;
+        if (db.Read(std::make_tuple(DB_VOTE, nParentHash, nVoteHash), vote)) {
+            vecVotes.emplace_back(vote);
+        }
+    }
+    return vecVotes;
+}
 
 CGovernanceObjectVoteFile::CGovernanceObjectVoteFile() :
     nMemoryVotes(0),
     listVotes(),
-    mapVoteIndex()
+    mapVoteIndex(),
+    fLoaded(true),
+    nParentHash()
 {
 }
 
 CGovernanceObjectVoteFile::CGovernanceObjectVoteFile(const CGovernanceObjectVoteFile& other) :
     nMemoryVotes(other.nMemoryVotes),
     listVotes(other.listVotes),
-    mapVoteIndex()
+    mapVoteIndex(),
+    fLoaded(other.fLoaded),
+    nParentHash(other.nParentHash)
 {
     RebuildIndex();
 }
 
+void CGovernanceObjectVoteFile::SetLazyLoad(const uint256& nParentHashIn)
+{
+    listVotes.clear();
+    mapVoteIndex.clear();
+    nMemoryVotes = 0;
+    nParentHash = nParentHashIn;
+    fLoaded = false;
+}
+
+void CGovernanceObjectVoteFile::Load() const
+{
+    if (fLoaded) {
+        return;
+    }
+    fLoaded = true;
+    if (!governanceDb) {
+        return;
+    }
+    for (const auto& vote : governanceDb->ReadVotes(nParentHash)) {
+        listVotes.push_back(vote);
+    }
+    RebuildIndex();
+    LogPrint("gobject", "CGovernanceObjectVoteFile::%s -- loaded %d votes for %s\n", __func__, nMemoryVotes, nParentHash.ToString());
+}
+
 void CGovernanceObjectVoteFile::AddVote(const CGovernanceVote& vote)
 {
+    Load();
     uint256 nHash = vote.GetHash();
     // make sure to never add/update already known votes
     if (HasVote(nHash))
@@ -30,16 +283,21 @@ void CGovernanceObjectVoteFile::AddVote(const CGovernanceVote& vote)
     listVotes.push_front(vote);
     mapVoteIndex.emplace(nHash, listVotes.begin());
     ++nMemoryVotes;
+    if (governanceDb) {
+        governanceDb->WriteVote(vote);
+    }
     RemoveOldVotes(vote);
 }
 
 bool CGovernanceObjectVoteFile::HasVote(const uint256& nHash) const
 {
+    Load();
     return mapVoteIndex.find(nHash) != mapVoteIndex.end();
 }
 
 bool CGovernanceObjectVoteFile::SerializeVoteToStream(const uint256& nHash, CDataStream& ss) const
 {
+    Load();
     vote_m_cit it = mapVoteIndex.find(nHash);
     if (it == mapVoteIndex.end()) {
         return false;
@@ -50,6 +308,7 @@ bool CGovernanceObjectVoteFile::SerializeVoteToStream(const uint256& nHash, CDat
 
 std::vector<CGovernanceVote> CGovernanceObjectVoteFile::GetVotes() const
 {
+    Load();
     std::vector<CGovernanceVote> vecResult;
     for (vote_l_cit it = listVotes.begin(); it != listVotes.end(); ++it) {
         vecResult.push_back(*it);
@@ -59,11 +318,24 @@ std::vector<CGovernanceVote> CGovernanceObjectVoteFile::GetVotes() const
 
 void CGovernanceObjectVoteFile::RemoveVotesFromMasternode(const COutPoint& outpointMasternode)
 {
+    if (!fLoaded) {
+        // nothing in memory, so the DB is the only place to clean up
+        if (governanceDb) {
+            for (const auto& vote : governanceDb->ReadVotesFromMasternode(nParentHash, outpointMasternode)) {
+                governanceDb->EraseVote(vote);
+            }
+        }
+        return;
+    }
+
     vote_l_it it = listVotes.begin();
     while (it != listVotes.end()) {
         if (it->GetMasternodeOutpoint() == outpointMasternode) {
             --nMemoryVotes;
             mapVoteIndex.erase(it->GetHash());
+            if (governanceDb) {
+                governanceDb->EraseVote(*it);
+            }
             listVotes.erase(it++);
         } else {
             ++it;
@@ -75,6 +347,19 @@ std::set<uint256> CGovernanceObjectVoteFile::RemoveInvalidVotes(const COutPoint&
 {
     std::set<uint256> removedVotes;
 
+    if (!fLoaded) {
+        if (governanceDb) {
+            for (const auto& vote : governanceDb->ReadVotesFromMasternode(nParentHash, outpointMasternode)) {
+                bool useVotingKey = fProposal && (vote.GetSignal() == VOTE_SIGNAL_FUNDING);
+                if (!vote.IsValid(useVotingKey)) {
+                    removedVotes.emplace(vote.GetHash());
+                    governanceDb->EraseVote(vote);
+                }
+            }
+        }
+        return removedVotes;
+    }
+
     vote_l_it it = listVotes.begin();
     while (it != listVotes.end()) {
         if (it->GetMasternodeOutpoint() == outpointMasternode) {
@@ -83,6 +368,9 @@ std::set<uint256> CGovernanceObjectVoteFile::RemoveInvalidVotes(const COutPoint&
                 removedVotes.emplace(it->GetHash());
                 --nMemoryVotes;
                 mapVoteIndex.erase(it->GetHash());
+                if (governanceDb) {
+                    governanceDb->EraseVote(*it);
+                }
                 listVotes.erase(it++);
                 continue;
             }
@@ -104,6 +392,9 @@ void CGovernanceObjectVoteFile::RemoveOldVotes(const CGovernanceVote& vote)
         {
             --nMemoryVotes;
             mapVoteIndex.erase(it->GetHash());
+            if (governanceDb) {
+                governanceDb->EraseVote(*it);
+            }
             listVotes.erase(it++);
         } else {
             ++it;
@@ -111,7 +402,7 @@ void CGovernanceObjectVoteFile::RemoveOldVotes(const CGovernanceVote& vote)
     }
 }
 
-void CGovernanceObjectVoteFile::RebuildIndex()
+void CGovernanceObjectVoteFile::RebuildIndex() const
 {
     mapVoteIndex.clear();
     nMemoryVotes = 0;
@@ -10,18 +10,74 @@
 #include <list>
 #include <map>
 
+#include "dbwrapper.h"
 #include "governance-vote.h"
 #include "serialize.h"
 #include "streams.h"
+#include "sync.h"
 #include "uint256.h"
 
+class CGovernanceObject;
+
+//! Max memory allocated to the governance DB cache (MiB)
+static const int64_t nMaxGovernanceDBCache = 16;
+
+/**
+ * LevelDB backed storage of governance objects and their votes, which are written incrementally as they change
+ * instead of being part of governance.dat. Votes are stored per object, so that the vote list of an object can be
+ * loaded when it's needed for the first time. Additional indexes allow to find votes by hash and by masternode
+ * without loading any vote lists
+ */
+class CGovernanceDB
+{
+private:
+    CDBWrapper db;
+
+    // serializes vote writes and erases, so that the stored vote count matches the stored votes
+    mutable CCriticalSection cs;
+    // number of stored votes. It's stored as well and updated in the same batch as the votes
+    int nVoteCount;
+
+public:
+    CGovernanceDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    /**
+     * Objects are stored without their votes. Votes are written right away while objects are only written on flush,
+     * so every vote write marks its object as outdated until the object is written again. Outdated objects get their
+     * current votes rebuilt from the stored votes when they're loaded
+     */
+    void WriteObject(const CGovernanceObject& govobj);
+    void WriteObjects(const std::map<uint256, CGovernanceObject>& mapObjects);
+    void LoadObjects(std::map<uint256, CGovernanceObject>& mapObjectsRet);
+
+    /**
+     * Erase an object together with all of its votes
+     */
+    void EraseObject(const uint256& nHash);
+
+    void WriteVote(const CGovernanceVote& vote);
+    void EraseVote(const CGovernanceVote& vote);
+    bool ReadVote(const uint256& nVoteHash, CGovernanceVote& voteRet);
+    std::vector<CGovernanceVote> ReadVotes(const uint256& nParentHash);
+    std::vector<CGovernanceVote> ReadVotesFromMasternode(const uint256& nParentHash, const COutPoint& outpointMasternode);
+
+    int GetVoteCount() const
+    {
+        LOCK(cs);
+        return nVoteCount;
+    }
+
+private:
+    int CountVotes();
+};
+
+extern CGovernanceDB* governanceDb;
+
 /**
  * Represents the collection of votes associated with a given CGovernanceObject
- * Recently received votes are held in memory until a maximum size is reached after
- * which older votes a flushed to a disk file.
  *
- * Note: This is a stub implementation that doesn't limit the number of votes held
- * in memory and doesn't flush to disk.
+ * Votes are written through to governanceDb if it exists. The votes of objects which were loaded from
+ * governanceDb are only read from it on first access
  */
 class CGovernanceObjectVoteFile
 {
@@ -39,61 +95,69 @@ public: // Types
     typedef vote_m_t::const_iterator vote_m_cit;
 
 private:
-    static const int MAX_MEMORY_VOTES = -1;
+    // the vote list is loaded lazily, even by const accessors
+    mutable int nMemoryVotes;
 
-    int nMemoryVotes;
+    mutable vote_l_t listVotes;
 
-    vote_l_t listVotes;
+    mutable vote_m_t mapVoteIndex;
 
-    vote_m_t mapVoteIndex;
+    mutable bool fLoaded;
+
+    // hash of the object the votes belong to, only needed while the votes are not loaded
+    uint256 nParentHash;
 
 public:
     CGovernanceObjectVoteFile();
 
     CGovernanceObjectVoteFile(const CGovernanceObjectVoteFile& other);
 
+    /**
+     * Forget all votes in memory and load them from governanceDb on next access
+     */
+    void SetLazyLoad(const uint256& nParentHashIn);
+
+    bool IsLoaded() const
+    {
+        return fLoaded;
+    }
+
     /**
      * Add a vote to the file
      */
     void AddVote(const CGovernanceVote& vote);
 
     /**
-     * Return true if the vote with this hash is currently cached in memory
+     * Return true if the vote with this hash is known
      */
     bool HasVote(const uint256& nHash) const;
 
     /**
-     * Retrieve a vote cached in memory
+     * Retrieve a known vote
      */
     bool SerializeVoteToStream(const uint256& nHash, CDataStream& ss) const;
 
-    int GetVoteCount()
+    int GetVoteCount() const
     {
+        Load();
         return nMemoryVotes;
     }
 
     std::vector<CGovernanceVote> GetVotes() const;
 
+    /**
+     * These only use the per masternode index of governanceDb if the votes are not loaded yet
+     */
     void RemoveVotesFromMasternode(const COutPoint& outpointMasternode);
     std::set<uint256> RemoveInvalidVotes(const COutPoint& outpointMasternode, bool fProposal);
 
-    ADD_SERIALIZE_METHODS;
-
-    template <typename Stream, typename Operation>
-    inline void SerializationOp(Stream& s, Operation ser_action)
-    {
-        READWRITE(nMemoryVotes);
-        READWRITE(listVotes);
-        if (ser_action.ForRead()) {
-            RebuildIndex();
-        }
-    }
-
 private:
+    void Load() const;
+
     // Drop older votes for the same gobject from the same masternode
     void RemoveOldVotes(const CGovernanceVote& vote);
 
-    void RebuildIndex();
+    void RebuildIndex() const;
 };
 
 #endif
@@ -26,7 +26,7 @@ CGovernanceManager governance;
 
 int nSubmittedFinalBudget;
 
-const std::string CGovernanceManager::SERIALIZATION_VERSION_STRING = "CGovernanceManager-Version-15";
+const std::string CGovernanceManager::SERIALIZATION_VERSION_STRING = "CGovernanceManager-Version-16";
 const int CGovernanceManager::MAX_TIME_FUTURE_DEVIATION = 60 * 60;
 const int CGovernanceManager::RELIABLE_PROPAGATION_TIME = 60;
 
@@ -71,11 +71,22 @@ bool CGovernanceManager::HaveVoteForHash(const uint256& nHash) const
     LOCK(cs);
 
     CGovernanceObject* pGovobj = nullptr;
-    return cmapVoteToObject.Get(nHash, pGovobj) && pGovobj->GetVoteFile().HasVote(nHash);
+    if (cmapVoteToObject.Get(nHash, pGovobj)) {
+        return pGovobj->GetVoteFile().HasVote(nHash);
+    }
+
+    // the vote might belong to an object whose votes were not loaded yet
+    CGovernanceVote vote;
+    return governanceDb && governanceDb->ReadVote(nHash, vote) && mapObjects.count(vote.GetParentHash());
 }
 
 int CGovernanceManager::GetVoteCount() const
 {
+    // the votes of objects loaded from governanceDb are only indexed once they're needed, so only governanceDb knows
+    // their number. Without it, all votes are in memory
+    if (governanceDb) {
+        return governanceDb->GetVoteCount();
+    }
     LOCK(cs);
     return (int)cmapVoteToObject.GetSize();
 }
@@ -85,7 +96,16 @@ bool CGovernanceManager::SerializeVoteForHash(const uint256& nHash, CDataStream&
     LOCK(cs);
 
     CGovernanceObject* pGovobj = nullptr;
-    return cmapVoteToObject.Get(nHash, pGovobj) && pGovobj->GetVoteFile().SerializeVoteToStream(nHash, ss);
+    if (cmapVoteToObject.Get(nHash, pGovobj)) {
+        return pGovobj->GetVoteFile().SerializeVoteToStream(nHash, ss);
+    }
+
+    CGovernanceVote vote;
+    if (!governanceDb || !governanceDb->ReadVote(nHash, vote) || !mapObjects.count(vote.GetParentHash())) {
+        return false;
+    }
+    ss << vote;
+    return true;
 }
 
 void CGovernanceManager::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman)
@@ -245,30 +265,49 @@ void CGovernanceManager::ProcessMessage(CNode* pfrom, const std::string& strComm
 
         LogPrint("gobject", "MNGOVERNANCEOBJECTVOTE -- Received vote: %s\n", vote.ToString());
 
-        std::string strHash = nHash.ToString();
-
         if (!AcceptVoteMessage(nHash)) {
             LogPrint("gobject", "MNGOVERNANCEOBJECTVOTE -- Received unrequested vote object: %s, hash: %s, peer = %d\n",
-                vote.ToString(), strHash, pfrom->GetId());
+                vote.ToString(), nHash.ToString(), pfrom->GetId());
             return;
         }
 
-        CGovernanceException exception;
-        if (ProcessVote(pfrom, vote, exception, connman)) {
-            LogPrint("gobject", "MNGOVERNANCEOBJECTVOTE -- %s new\n", strHash);
-            masternodeSync.BumpAssetLastTime("MNGOVERNANCEOBJECTVOTE");
-            vote.Relay(connman);
-        } else {
-            LogPrint("gobject", "MNGOVERNANCEOBJECTVOTE -- Rejected vote, error = %s\n", exception.what());
-            if ((exception.GetNodePenalty() != 0) && masternodeSync.IsSynced()) {
-                LOCK(cs_main);
-                Misbehaving(pfrom->GetId(), exception.GetNodePenalty());
-            }
+        QueueVote(pfrom->GetId(), vote, connman);
+    }
+}
+
+void CGovernanceManager::QueueVote(NodeId nodeFrom, const CGovernanceVote& vote, CConnman& connman)
+{
+    uint256 nHash = vote.GetHash();
+
+    bool fKnownInvalid;
+    {
+        LOCK(cs);
+        if (cmapVoteToObject.HasKey(nHash)) {
+            LogPrint("gobject", "CGovernanceManager::%s -- skipping known valid vote %s\n", __func__, nHash.ToString());
+            return;
+        }
+        fKnownInvalid = cmapInvalidVotes.HasKey(nHash);
+    }
+    if (fKnownInvalid) {
+        LogPrint("gobject", "CGovernanceManager::%s -- skipping old invalid vote %s, peer=%d\n", __func__, nHash.ToString(), nodeFrom);
+        // same penalty as in ProcessVote
+        if (masternodeSync.IsSynced()) {
+            LOCK(cs_main);
+            Misbehaving(nodeFrom, 20);
+        }
+        return;
+    }
+
+    {
+        LOCK(cs_pendingVotes);
+        pendingVotes.emplace_back(nodeFrom, vote);
+        // during sync votes arrive by the ten thousands, so they are verified in batches. The scheduler picks up
+        // incomplete batches. Once synced, votes are processed right away
+        if (!masternodeSync.IsSynced() && pendingVotes.size() < VOTE_BATCH_SIZE) {
             return;
         }
-        // SEND NOTIFICATION TO SCRIPT/ZMQ
-        GetMainSignals().NotifyGovernanceVote(vote);
     }
+    ProcessPendingVotes(connman);
 }
 
 void CGovernanceManager::CheckOrphanVotes(CGovernanceObject& govobj, CGovernanceException& exception, CConnman& connman)
@@ -323,6 +362,10 @@ void CGovernanceManager::AddGovernanceObject(CGovernanceObject& govobj, CConnman
         return;
     }
 
+    if (governanceDb) {
+        governanceDb->WriteObject(objpair.first->second);
+    }
+
     // SHOULD WE ADD THIS OBJECT TO ANY OTHER MANANGERS?
 
     if (govobj.nObjectType == GOVERNANCE_OBJECT_TRIGGER) {
@@ -345,8 +388,9 @@ void CGovernanceManager::AddGovernanceObject(CGovernanceObject& govobj, CConnman
 
     // WE MIGHT HAVE PENDING/ORPHAN VOTES FOR THIS OBJECT
 
+    // the votes must go into the instance in mapObjects, govobj is just a copy
     CGovernanceException exception;
-    CheckOrphanVotes(govobj, exception, connman);
+    CheckOrphanVotes(objpair.first->second, exception, connman);
 
     // SEND NOTIFICATION TO SCRIPT/ZMQ
     GetMainSignals().NotifyGovernanceObject(govobj);
@@ -429,6 +473,9 @@ void CGovernanceManager::UpdateCachesAndClean()
             }
 
             mapErasedGovernanceObjects.insert(std::make_pair(nHash, nTimeExpired));
+            if (governanceDb) {
+                governanceDb->EraseObject(nHash);
+            }
             mapObjects.erase(it++);
         } else {
             // NOTE: triggers are handled via triggerman
@@ -553,6 +600,21 @@ void CGovernanceManager::DoMaintenance(CConnman& connman)
     // CHECK AND REMOVE - REPROCESS GOVERNANCE OBJECTS
 
     UpdateCachesAndClean();
+
+    FlushObjects();
+}
+
+void CGovernanceManager::FlushObjects()
+{
+    if (!governanceDb) {
+        return;
+    }
+
+    // votes are written as they come in, so this only needs to write the objects themselves
+    LOCK(cs);
+    int64_t nStart = GetTimeMillis();
+    governanceDb->WriteObjects(mapObjects);
+    LogPrint("gobject", "CGovernanceManager::%s -- wrote %d objects in %dms\n", __func__, mapObjects.size(), GetTimeMillis() - nStart);
 }
 
 bool CGovernanceManager::ConfirmInventoryRequest(const CInv& inv)
@@ -638,7 +700,7 @@ void CGovernanceManager::SyncSingleObjVotes(CNode* pnode, const uint256& nProp,
         return;
     }
 
-    auto fileVotes = govobj.GetVoteFile();
+    const auto& fileVotes = govobj.GetVoteFile();
 
     for (const auto& vote : fileVotes.GetVotes()) {
         uint256 nVoteHash = vote.GetHash();
@@ -796,7 +858,109 @@ bool CGovernanceManager::MasternodeRateCheck(const CGovernanceObject& govobj, bo
     return false;
 }
 
+void CGovernanceManager::StartVoteWorker()
+{
+    int workerCount = std::max(1, std::min(4, (int)std::thread::hardware_concurrency() / 2));
+    voteWorkerPool.resize(workerCount);
+    RenameThreadPool(voteWorkerPool, "epmcoin-gov-vote");
+}
+
+void CGovernanceManager::StopVoteWorker()
+{
+    voteWorkerPool.clear_queue();
+    voteWorkerPool.stop(true);
+}
+
+void CGovernanceManager::ProcessPendingVotes(CConnman& connman)
+{
+    std::vector<std::pair<NodeId, CGovernanceVote>> votes;
+    {
+        LOCK(cs_pendingVotes);
+        votes.swap(pendingVotes);
+    }
+    if (votes.empty()) {
+        return;
+    }
+
+    // a single list for the whole batch, instead of a copy for every vote
+    ProcessVotes(votes, connman, deterministicMNManager->GetListAtChainTip());
+}
+
+void CGovernanceManager::ProcessVotes(const std::vector<std::pair<NodeId, CGovernanceVote>>& votes, CConnman& connman, const CDeterministicMNList& mnList)
+{
+    // Only verify the signatures of votes which ProcessVote would verify as well. Votes which were processed since they
+    // were queued, duplicates within the batch and orphans are left at VOTE_CHECK_NONE. ProcessVote rejects the first
+    // two without a signature check and verifies orphans once their parent arrives
+    std::vector<size_t> toCheck;
+    {
+        LOCK(cs);
+        std::set<uint256> setBatchHashes;
+        for (size_t i = 0; i < votes.size(); i++) {
+            const CGovernanceVote& vote = votes[i].second;
+            uint256 nHash = vote.GetHash();
+            if (!setBatchHashes.emplace(nHash).second || cmapVoteToObject.HasKey(nHash) || cmapInvalidVotes.HasKey(nHash) ||
+                    !mapObjects.count(vote.GetParentHash())) {
+                continue;
+            }
+            toCheck.emplace_back(i);
+        }
+    }
+
+    std::vector<vote_check_enum_t> checks(votes.size(), VOTE_CHECK_NONE);
+    auto checkRange = [&votes, &checks, &toCheck, &mnList](size_t start, size_t end) {
+        for (size_t j = start; j < end; j++) {
+            size_t i = toCheck[j];
+            const CGovernanceVote& vote = votes[i].second;
+            checks[i] = vote.Check(mnList.GetMNByCollateral(vote.GetMasternodeOutpoint()));
+        }
+    };
+
+    size_t workerCount = (size_t)voteWorkerPool.size();
+    if (workerCount == 0 || toCheck.size() <= 1) {
+        checkRange(0, toCheck.size());
+    } else {
+        size_t chunkSize = (toCheck.size() + workerCount - 1) / workerCount;
+        std::vector<std::future<void>> futures;
+        for (size_t start = 0; start < toCheck.size(); start += chunkSize) {
+            size_t end = std::min(start + chunkSize, toCheck.size());
+            futures.emplace_back(voteWorkerPool.push([&checkRange, start, end](int threadId) {
+                checkRange(start, end);
+            }));
+        }
+        for (auto& f : futures) {
+            f.get();
+        }
+    }
+
+    for (size_t i = 0; i < votes.size(); i++) {
+        NodeId nodeFrom = votes[i].first;
+        const CGovernanceVote& vote = votes[i].second;
+        std::string strHash = vote.GetHash().ToString();
+
+        CGovernanceException exception;
+        if (ProcessVote(nodeFrom, vote, exception, connman, mnList, checks[i])) {
+            LogPrint("gobject", "MNGOVERNANCEOBJECTVOTE -- %s new\n", strHash);
+            masternodeSync.BumpAssetLastTime("MNGOVERNANCEOBJECTVOTE");
+            vote.Relay(connman);
+            // SEND NOTIFICATION TO SCRIPT/ZMQ
+            GetMainSignals().NotifyGovernanceVote(vote);
+        } else {
+            LogPrint("gobject", "MNGOVERNANCEOBJECTVOTE -- Rejected vote, error = %s\n", exception.what());
+            if ((exception.GetNodePenalty() != 0) && masternodeSync.IsSynced()) {
+                LOCK(cs_main);
+                Misbehaving(nodeFrom, exception.GetNodePenalty());
+            }
+        }
+    }
+}
+
 bool CGovernanceManager::ProcessVote(CNode* pfrom, const CGovernanceVote& vote, CGovernanceException& exception, CConnman& connman)
+{
+    return ProcessVote(pfrom ? pfrom->GetId() : -1, vote, exception, connman, deterministicMNManager->GetListAtChainTip(), VOTE_CHECK_NONE);
+}
+
+bool CGovernanceManager::ProcessVote(NodeId nodeFrom, const CGovernanceVote& vote, CGovernanceException& exception, CConnman& connman,
+                                     const CDeterministicMNList& mnList, vote_check_enum_t eCheck)
 {
     ENTER_CRITICAL_SECTION(cs);
     uint256 nHashVote = vote.GetHash();
@@ -827,7 +991,10 @@ bool CGovernanceManager::ProcessVote(CNode* pfrom, const CGovernanceVote& vote,
         exception = CGovernanceException(ostr.str(), GOVERNANCE_EXCEPTION_WARNING);
         if (cmmapOrphanVotes.Insert(nHashGovobj, vote_time_pair_t(vote, GetAdjustedTime() + GOVERNANCE_ORPHAN_EXPIRATION_TIME))) {
             LEAVE_CRITICAL_SECTION(cs);
-            RequestGovernanceObject(pfrom, nHashGovobj, connman);
+            connman.ForNode(nodeFrom, [&](CNode* pnode) {
+                RequestGovernanceObject(pnode, nHashGovobj, connman);
+                return true;
+            });
             LogPrintf("%s\n", ostr.str());
             return false;
         }
@@ -845,7 +1012,7 @@ bool CGovernanceManager::ProcessVote(CNode* pfrom, const CGovernanceVote& vote,
         return false;
     }
 
-    bool fOk = govobj.ProcessVote(pfrom, vote, exception, connman) && cmapVoteToObject.Insert(nHashVote, &govobj);
+    bool fOk = govobj.ProcessVote(nullptr, vote, exception, connman, mnList, eCheck) && cmapVoteToObject.Insert(nHashVote, &govobj);
     LEAVE_CRITICAL_SECTION(cs);
     return fOk;
 }
@@ -1143,6 +1310,10 @@ void CGovernanceManager::RebuildIndexes()
     cmapVoteToObject.Clear();
     for (auto& objPair : mapObjects) {
         CGovernanceObject& govobj = objPair.second;
+        // votes of objects loaded from governanceDb are only indexed once they're needed
+        if (!govobj.GetVoteFile().IsLoaded()) {
+            continue;
+        }
         std::vector<CGovernanceVote> vecVotes = govobj.GetVoteFile().GetVotes();
         for (size_t i = 0; i < vecVotes.size(); ++i) {
             cmapVoteToObject.Insert(vecVotes[i].GetHash(), &govobj);
@@ -1174,6 +1345,10 @@ void CGovernanceManager::InitOnLoad()
 {
     LOCK(cs);
     int64_t nStart = GetTimeMillis();
+    if (governanceDb) {
+        governanceDb->LoadObjects(mapObjects);
+        LogPrintf("Loaded %d governance objects  %dms\n", mapObjects.size(), GetTimeMillis() - nStart);
+    }
     LogPrintf("Preparing masternode indexes and governance triggers...\n");
     RebuildIndexes();
     AddCachedTriggers();
@@ -1206,7 +1381,7 @@ std::string CGovernanceManager::ToString() const
     return strprintf("Governance Objects: %d (Proposals: %d, Triggers: %d, Other: %d; Erased: %d), Votes: %d",
         (int)mapObjects.size(),
         nProposalCount, nTriggerCount, nOtherCount, (int)mapErasedGovernanceObjects.size(),
-        (int)cmapVoteToObject.GetSize());
+        GetVoteCount());
 }
 
 UniValue CGovernanceManager::ToJson() const
@@ -1237,7 +1412,7 @@ UniValue CGovernanceManager::ToJson() const
     jsonObj.push_back(Pair("triggers", nTriggerCount));
     jsonObj.push_back(Pair("other", nOtherCount));
     jsonObj.push_back(Pair("erased", (int)mapErasedGovernanceObjects.size()));
-    jsonObj.push_back(Pair("votes", (int)cmapVoteToObject.GetSize()));
+    jsonObj.push_back(Pair("votes", GetVoteCount()));
     return jsonObj;
 }
 
@@ -11,6 +11,7 @@
 #include "cachemap.h"
 #include "cachemultimap.h"
 #include "chain.h"
+#include "ctpl.h"
 #include "governance-exceptions.h"
 #include "governance-object.h"
 #include "governance-vote.h"
@@ -153,6 +154,7 @@ public:
 class CGovernanceManager
 {
     friend class CGovernanceObject;
+    friend struct GovernanceTestAccess;
 
 public: // Types
     struct last_object_rec {
@@ -225,6 +227,9 @@ public: // Types
 private:
     static const int MAX_CACHE_SIZE = 1000000;
 
+    // votes received while syncing are verified in batches of this size, see ProcessPendingVotes
+    static const size_t VOTE_BATCH_SIZE = 1000;
+
     static const std::string SERIALIZATION_VERSION_STRING;
 
     static const int MAX_TIME_FUTURE_DEVIATION;
@@ -266,6 +271,14 @@ private:
     // used to check for changed voting keys
     CDeterministicMNList lastMNListForVotingKeys;
 
+    // votes waiting for batched verification, together with the peer they came from
+    CCriticalSection cs_pendingVotes;
+    std::vector<std::pair<NodeId, CGovernanceVote>> pendingVotes;
+
+    // verifies the signatures of pending votes in parallel. Not started in unit tests and lite mode, in which case
+    // verification happens on the calling thread
+    ctpl::thread_pool voteWorkerPool;
+
     class ScopedLockBool
     {
         bool& ref;
@@ -308,6 +321,17 @@ public:
 
     void DoMaintenance(CConnman& connman);
 
+    // Writes all objects to governanceDb. Votes are written as they arrive, so this is independent of their number
+    void FlushObjects();
+
+    void StartVoteWorker();
+    void StopVoteWorker();
+
+    // Verifies all pending votes and applies them afterwards. The masternodes of all votes are resolved from the same
+    // list and the signatures are verified on the vote workers without holding cs. Only the final processing of each
+    // vote takes cs
+    void ProcessPendingVotes(CConnman& connman);
+
     CGovernanceObject* FindGovernanceObject(const uint256& nHash);
 
     // These commands are only used in RPC
@@ -357,7 +381,6 @@ public:
         READWRITE(mapErasedGovernanceObjects);
         READWRITE(cmapInvalidVotes);
         READWRITE(cmmapOrphanVotes);
-        READWRITE(mapObjects);
         READWRITE(mapLastMasternodeObject);
         READWRITE(lastMNListForVotingKeys);
     }
@@ -434,7 +457,17 @@ private:
         cmmapOrphanVotes.Insert(vote.GetHash(), vote_time_pair_t(vote, GetAdjustedTime() + GOVERNANCE_ORPHAN_EXPIRATION_TIME));
     }
 
+    // Drops votes which were processed already and queues the others. The queue is processed right away once synced,
+    // otherwise when it's full or by the scheduler
+    void QueueVote(NodeId nodeFrom, const CGovernanceVote& vote, CConnman& connman);
+    // Verifies and applies a batch of votes, see ProcessPendingVotes
+    void ProcessVotes(const std::vector<std::pair<NodeId, CGovernanceVote>>& votes, CConnman& connman, const CDeterministicMNList& mnList);
+
     bool ProcessVote(CNode* pfrom, const CGovernanceVote& vote, CGovernanceException& exception, CConnman& connman);
+    // Same as above, but with the sending peer given by id and the masternode resolved from mnList. eCheck is the result
+    // of an earlier signature check, or VOTE_CHECK_NONE to verify the vote here
+    bool ProcessVote(NodeId nodeFrom, const CGovernanceVote& vote, CGovernanceException& exception, CConnman& connman,
+                     const CDeterministicMNList& mnList, vote_check_enum_t eCheck);
 
     /// Called to indicate a requested object has been received
     bool AcceptObjectMessage(const uint256& nHash);
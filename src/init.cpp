@@ -68,6 +68,8 @@
 #include "warnings.h"
 
 #include "evo/deterministicmns.h"
+#include "evo/evocache.h"
+#include "evo/simplifiedmns.h"
 #include "llmq/quorums_init.h"
 
 #include "llmq/quorums_init.h"
@@ -261,11 +263,14 @@ void PrepareShutdown()
         g_connman->Stop();
     }
     g_connman.reset();
+    // no more votes can arrive, so the vote workers are not needed anymore
+    governance.StopVoteWorker();
 
     if (!fLiteMode && !fRPCInWarmup) {
         // STORE DATA CACHES INTO SERIALIZED DAT FILES
         CFlatDB<CMasternodeMetaMan> flatdb1("mncache.dat", "magicMasternodeCache");
         flatdb1.Dump(mmetaman);
+        governance.FlushObjects();
         CFlatDB<CGovernanceManager> flatdb3("governance.dat", "magicGovernanceCache");
         flatdb3.Dump(governance);
         CFlatDB<CNetFulfilledRequestManager> flatdb4("netfulfilled.dat", "magicFulfilledCache");
@@ -308,10 +313,14 @@ void PrepareShutdown()
         delete pblocktree;
         pblocktree = NULL;
         llmq::DestroyLLMQSystem();
+        delete mnListDiffCache;
+        mnListDiffCache = nullptr;
         delete deterministicMNManager;
         deterministicMNManager = NULL;
         delete evoDb;
         evoDb = NULL;
+        delete governanceDb;
+        governanceDb = nullptr;
     }
 #ifdef ENABLE_WALLET
     if (pwalletMain)
@@ -445,6 +454,7 @@ std::string HelpMessage(HelpMessageMode mode)
     }
     strUsage += HelpMessageOpt("-datadir=<dir>", _("Specify data directory"));
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
+    strUsage += HelpMessageOpt("-evocache=<n>", strprintf(_("Set the memory budget in megabytes for the masternode list, quorum and EvoDB caches (%d to %d, default: %d)"), MIN_EVO_CACHE_SIZE, MAX_EVO_CACHE_SIZE, DEFAULT_EVO_CACHE_SIZE));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file on startup"));
     strUsage += HelpMessageOpt("-maxorphantxsize=<n>", strprintf(_("Maximum total size of all orphan transactions in megabytes (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE));
     strUsage += HelpMessageOpt("-maxmempool=<n>", strprintf(_("Keep the transaction memory pool below <n> megabytes (default: %u)"), DEFAULT_MAX_MEMPOOL_SIZE));
@@ -1735,13 +1745,21 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
     nCoinDBCache = std::min(nCoinDBCache, nMaxCoinsDBCache << 20); // cap total coins db cache
     nTotalCache -= nCoinDBCache;
+    int64_t nGovernanceDBCache = std::min(nTotalCache / 16, nMaxGovernanceDBCache << 20);
+    nTotalCache -= nGovernanceDBCache;
     nCoinCacheUsage = nTotalCache; // the rest goes to in-memory cache
     int64_t nMempoolSizeMax = GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
-    int64_t nEvoDbCache = 1024 * 1024 * 16; // TODO
+    int64_t nEvoCache = GetArg("-evocache", DEFAULT_EVO_CACHE_SIZE) << 20;
+    nEvoCache = std::max(nEvoCache, MIN_EVO_CACHE_SIZE << 20);
+    nEvoCache = std::min(nEvoCache, MAX_EVO_CACHE_SIZE << 20);
+    evoCacheBudget.SetTotalBytes(nEvoCache);
+    int64_t nEvoDbCache = evoCacheBudget.GetDBCacheBytes();
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
+    LogPrintf("* Using %.1fMiB for governance database\n", nGovernanceDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set (plus up to %.1fMiB of unused mempool space)\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024));
+    LogPrintf("* Using %.1fMiB for evo caches (%.1fMiB of it for the EvoDB database)\n", nEvoCache * (1.0 / 1024 / 1024), nEvoDbCache * (1.0 / 1024 / 1024));
 
     bool fLoaded = false;
     int64_t nStart = GetTimeMillis();
@@ -1761,11 +1779,13 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
                 delete pcoinscatcher;
                 delete pblocktree;
                 llmq::DestroyLLMQSystem();
+                delete mnListDiffCache;
                 delete deterministicMNManager;
                 delete evoDb;
 
                 evoDb = new CEvoDB(nEvoDbCache, false, fReindex || fReindexChainState);
                 deterministicMNManager = new CDeterministicMNManager(*evoDb);
+                mnListDiffCache = new CSimplifiedMNListDiffCache(&scheduler);
                 pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex);
                 pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fReindex || fReindexChainState);
                 pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
@@ -1819,6 +1839,7 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
                 }
 
 				deterministicMNManager->UpgradeDBIfNeeded();
+                deterministicMNManager->MigrateDBToCompactFormatIfNeeded();
 
                 uiInterface.InitMessage(_("Verifying blocks..."));
                 if (fHavePruned && GetArg("-checkblocks", DEFAULT_CHECKBLOCKS) > MIN_BLOCKS_TO_KEEP) {
@@ -1995,6 +2016,9 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
             return InitError(_("Failed to load masternode cache from") + "\n" + (pathDB / strDBName).string());
         }
 
+        // objects and votes live in their own LevelDB, governance.dat only holds the remaining manager state
+        governanceDb = new CGovernanceDB(nGovernanceDBCache);
+
         strDBName = "governance.dat";
         CFlatDB<CGovernanceManager> flatdb3(strDBName, "magicGovernanceCache");
         if(!flatdb3.Load(governance)) {
@@ -2028,6 +2052,8 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
         scheduler.scheduleEvery(boost::bind(&CMasternodeUtils::DoMaintenance, boost::ref(*g_connman)), 1 * 1000);
 
         scheduler.scheduleEvery(boost::bind(&CGovernanceManager::DoMaintenance, boost::ref(governance), boost::ref(*g_connman)), 60 * 5 * 1000);
+        governance.StartVoteWorker();
+        scheduler.scheduleEvery(boost::bind(&CGovernanceManager::ProcessPendingVotes, boost::ref(governance), boost::ref(*g_connman)), 1 * 1000);
 
         scheduler.scheduleEvery(boost::bind(&CInstantSend::DoMaintenance, boost::ref(instantsend)), 60 * 1000);
 
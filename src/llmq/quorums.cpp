@@ -12,12 +12,14 @@
 #include "quorums_init.h"
 #include "quorums_utils.h"
 
+#include "evo/evocache.h"
 #include "evo/specialtx.h"
 
 #include "activemasternode.h"
 #include "chainparams.h"
 #include "init.h"
 #include "masternode-sync.h"
+#include "memusage.h"
 #include "univalue.h"
 #include "validation.h"
 
@@ -28,6 +30,11 @@ namespace llmq
 
 static const std::string DB_QUORUM_SK_SHARE = "q_Qsk";
 static const std::string DB_QUORUM_QUORUM_VVEC = "q_Qqvvec";
+static const std::string DB_QUORUM_PUBKEY_SHARES = "q_Qpkshares";
+
+// Number of members per cache populator job. Each chunk is pushed to the BLS worker pool only after the previous one
+// finished, so populating a large quorum never occupies more than one worker and never starves other queued BLS work
+static const size_t CACHE_POPULATOR_CHUNK_SIZE = 8;
 
 CQuorumManager* quorumManager;
 
@@ -42,14 +49,47 @@ static uint256 MakeQuorumKey(const CQuorum& q)
     return hw.GetHash();
 }
 
-CQuorum::~CQuorum()
+bool CQuorumPubKeySharesStore::Read(const CQuorum& quorum, BLSPublicKeyVector& pkSharesRet)
 {
-    // most likely the thread is already done
-    stopCachePopulatorThread = true;
-	// watch out to not join the thread when we're called from inside the thread, which might happen on shutdown. This
-	// is because on shutdown the thread is the last owner of the shared CQuorum instance and thus the destroyer of it.
-	if (cachePopulatorThread.joinable() && cachePopulatorThread.get_id() != std::this_thread::get_id()) {
-        cachePopulatorThread.join();
+    // the quorum key covers the members, so shares of a quorum with a different member set are never used
+    std::pair<uint256, BLSPublicKeyVector> v;
+    if (!evoDb.Read(std::make_tuple(DB_QUORUM_PUBKEY_SHARES, (uint8_t)quorum.params.type, quorum.qc.quorumHash), v)) {
+        return false;
+    }
+    if (v.first != MakeQuorumKey(quorum) || v.second.size() != quorum.members.size()) {
+        return false;
+    }
+    pkSharesRet = std::move(v.second);
+    return true;
+}
+
+void CQuorumPubKeySharesStore::Write(const CQuorum& quorum, const BLSPublicKeyVector& pkShares)
+{
+    evoDb.GetRawDB().Write(std::make_tuple(DB_QUORUM_PUBKEY_SHARES, (uint8_t)quorum.params.type, quorum.qc.quorumHash), std::make_pair(MakeQuorumKey(quorum), pkShares));
+}
+
+void CQuorumPubKeySharesStore::EraseInactive(Consensus::LLMQType llmqType, const std::set<uint256>& activeQuorumHashes)
+{
+    auto& db = evoDb.GetRawDB();
+    std::unique_ptr<CDBIterator> dbIt(db.NewIterator());
+
+    auto firstKey = std::make_tuple(DB_QUORUM_PUBKEY_SHARES, (uint8_t)llmqType, uint256());
+    dbIt->Seek(firstKey);
+
+    CDBBatch batch(db);
+    while (dbIt->Valid()) {
+        decltype(firstKey) curKey;
+        if (!dbIt->GetKey(curKey) || std::get<0>(curKey) != DB_QUORUM_PUBKEY_SHARES || std::get<1>(curKey) != (uint8_t)llmqType) {
+            break;
+        }
+        if (!activeQuorumHashes.count(std::get<2>(curKey))) {
+            batch.Erase(curKey);
+        }
+        dbIt->Next();
+    }
+
+    if (batch.SizeEstimate() != 0) {
+        db.WriteBatch(batch);
     }
 }
 
@@ -87,7 +127,7 @@ CBLSPublicKey CQuorum::GetPubKeyShare(size_t memberIdx) const
         return CBLSPublicKey();
     }
     auto& m = members[memberIdx];
-    return blsCache.BuildPubKeyShare(m->proTxHash, quorumVvec, CBLSId::FromHash(m->proTxHash));
+    return blsCache.BuildPubKeyShare(m->proTxHash, qc.quorumHash, quorumVvec, CBLSId::FromHash(m->proTxHash));
 }
 
 CBLSSecretKey CQuorum::GetSkShare() const
@@ -117,7 +157,7 @@ void CQuorum::WriteContributions(CEvoDB& evoDb)
     }
 }
 
-bool CQuorum::ReadContributions(CEvoDB& evoDb)
+bool CQuorum::ReadContributions(CEvoDB& evoDb, CQuorumPubKeySharesStore& pkSharesStore)
 {
     uint256 dbKey = MakeQuorumKey(*this);
 
@@ -132,38 +172,131 @@ bool CQuorum::ReadContributions(CEvoDB& evoDb)
     // member of the quorum but observed the whole DKG process to have the quorum verification vector.
     evoDb.Read(std::make_pair(DB_QUORUM_SK_SHARE, dbKey), skShare);
 
+    // Same for the public key shares. If they are missing, the cache populator will recalculate and persist them
+    BLSPublicKeyVector pkShares;
+    if (pkSharesStore.Read(*this, pkShares)) {
+        bool complete = true;
+        for (size_t i = 0; i < members.size(); i++) {
+            if (qc.validMembers[i] && !pkShares[i].IsValid()) {
+                complete = false;
+                break;
+            }
+        }
+        if (complete) {
+            for (size_t i = 0; i < members.size(); i++) {
+                if (qc.validMembers[i]) {
+                    blsCache.SetPubKeyShare(members[i]->proTxHash, pkShares[i]);
+                }
+            }
+            hasPersistedPubKeyShares = true;
+        }
+    }
+
     return true;
 }
 
-void CQuorum::StartCachePopulatorThread(std::shared_ptr<CQuorum> _this)
+void CQuorum::StartCachePopulator(const std::shared_ptr<CQuorum>& _this, const std::shared_ptr<CQuorumPubKeySharesStore>& pkSharesStore)
 {
-    if (_this->quorumVvec == nullptr) {
+    if (_this->quorumVvec == nullptr || _this->hasPersistedPubKeyShares) {
         return;
     }
 
+    LogPrint("llmq", "CQuorum::%s -- start\n", __func__);
+
+    auto pkShares = std::make_shared<BLSPublicKeyVector>(_this->members.size());
+    std::weak_ptr<CQuorum> weakThis = _this;
+    std::weak_ptr<CQuorumPubKeySharesStore> weakStore = pkSharesStore;
     cxxtimer::Timer t(true);
-    LogPrint("llmq", "CQuorum::StartCachePopulatorThread -- start\n");
-
-    // this thread will exit after some time
-    // when then later some other thread tries to get keys, it will be much faster
-    _this->cachePopulatorThread = std::thread([_this, t]() {
-        RenameThread("epmcoin-q-cachepop");
-        for (size_t i = 0; i < _this->members.size() && !_this->stopCachePopulatorThread && !ShutdownRequested(); i++) {
-            if (_this->qc.validMembers[i]) {
-                _this->GetPubKeyShare(i);
+    // the first chunk builds the vvec tables, which should not happen on the calling thread
+    _this->blsWorker.AsyncRun([weakThis, weakStore, pkShares, t]() {
+        PopulateCacheChunk(weakThis, weakStore, 0, pkShares, t);
+    });
+}
+
+void CQuorum::PopulateCacheChunk(std::weak_ptr<CQuorum> weakThis, std::weak_ptr<CQuorumPubKeySharesStore> weakStore, size_t start, std::shared_ptr<BLSPublicKeyVector> pkShares, cxxtimer::Timer t)
+{
+    // only keep the quorum alive while a chunk is being prepared or finished. If it got dropped from all caches in the
+    // meantime, nobody is interested in its public key shares anymore
+    auto _this = weakThis.lock();
+    if (!_this || ShutdownRequested()) {
+        return;
+    }
+
+    if (start >= _this->members.size()) {
+        if (auto pkSharesStore = weakStore.lock()) {
+            pkSharesStore->Write(*_this, *pkShares);
+        }
+        // all shares are cached now, so the tables are not needed anymore
+        _this->blsCache.EraseVerificationVectorTable(_this->qc.quorumHash);
+        LogPrint("llmq", "CQuorum::%s -- done. time=%d\n", __func__, t.count());
+        return;
+    }
+
+    size_t end = std::min(start + CACHE_POPULATOR_CHUNK_SIZE, _this->members.size());
+    std::vector<size_t> idxs;
+    BLSIdVector ids;
+    for (size_t i = start; i < end; i++) {
+        if (_this->qc.validMembers[i]) {
+            idxs.emplace_back(i);
+            ids.emplace_back(CBLSId::FromHash(_this->members[i]->proTxHash));
+        }
+    }
+
+    auto doneCallback = [weakThis, weakStore, end, idxs, pkShares, t](const BLSPublicKeyVector& chunk) {
+        if (auto _this = weakThis.lock()) {
+            for (size_t i = 0; i < idxs.size(); i++) {
+                (*pkShares)[idxs[i]] = chunk[i];
+                _this->blsCache.SetPubKeyShare(_this->members[idxs[i]]->proTxHash, chunk[i]);
             }
         }
-        LogPrint("llmq", "CQuorum::StartCachePopulatorThread -- done. time=%d\n", t.count());
-    });
+        PopulateCacheChunk(weakThis, weakStore, end, pkShares, t);
+    };
+
+    // the tables are shared with GetPubKeyShare, so whoever needs them first builds them
+    auto table = _this->blsCache.BuildVerificationVectorTable(_this->qc.quorumHash, _this->quorumVvec);
+    if (table) {
+        _this->blsWorker.AsyncBuildPubKeyShares(table, ids, false, doneCallback);
+    } else {
+        _this->blsWorker.AsyncBuildPubKeyShares(_this->quorumVvec, ids, doneCallback);
+    }
+}
+
+static size_t EstimateQuorumMemoryUsage(const CQuorum& quorum)
+{
+    size_t nUsage = sizeof(CQuorum);
+    nUsage += memusage::DynamicUsage(quorum.members);
+    nUsage += memusage::DynamicUsage(quorum.qc.signers) + memusage::DynamicUsage(quorum.qc.validMembers);
+    if (quorum.quorumVvec) {
+        nUsage += memusage::MallocUsage(sizeof(BLSVerificationVector)) + memusage::DynamicUsage(*quorum.quorumVvec);
+        // the cache populator recovers the public key shares of all members
+        nUsage += quorum.members.size() * sizeof(CBLSPublicKey);
+    }
+    return nUsage;
 }
 
 CQuorumManager::CQuorumManager(CEvoDB& _evoDb, CBLSWorker& _blsWorker, CDKGSessionManager& _dkgManager) :
     evoDb(_evoDb),
     blsWorker(_blsWorker),
-    dkgManager(_dkgManager)
+    dkgManager(_dkgManager),
+    pkSharesStore(std::make_shared<CQuorumPubKeySharesStore>(_evoDb)),
+    scanQuorumsCache(GetScanQuorumsCacheMaxSize())
 {
 }
 
+size_t CQuorumManager::GetScanQuorumsCacheMaxSize()
+{
+    // ScanQuorums caches at most signingActiveQuorumCount + 1 quorums per entry
+    size_t nMaxQuorums = 0;
+    for (const auto& p : Params().GetConsensus().llmqs) {
+        nMaxQuorums = std::max(nMaxQuorums, (size_t)p.second.signingActiveQuorumCount + 1);
+    }
+    std::vector<CQuorumCPtr> largestEntry;
+    largestEntry.reserve(nMaxQuorums);
+    size_t nEntryUsage = decltype(scanQuorumsCache)::EntryMemoryUsage(largestEntry);
+    // the LRU cache grows up to twice its size before it truncates
+    return std::max((size_t)32, evoCacheBudget.GetLimit(EVO_CACHE_SCAN_QUORUMS) / (2 * nEntryUsage));
+}
+
 void CQuorumManager::UpdatedBlockTip(const CBlockIndex* pindexNew, bool fInitialDownload)
 {
     if (!masternodeSync.IsBlockchainSynced()) {
@@ -172,6 +305,7 @@ void CQuorumManager::UpdatedBlockTip(const CBlockIndex* pindexNew, bool fInitial
 
     for (auto& p : Params().GetConsensus().llmqs) {
         EnsureQuorumConnections(p.first, pindexNew);
+        CleanupPubKeyShares(p.first, pindexNew);
     }
 }
 
@@ -230,6 +364,18 @@ void CQuorumManager::EnsureQuorumConnections(Consensus::LLMQType llmqType, const
     }
 }
 
+void CQuorumManager::CleanupPubKeyShares(Consensus::LLMQType llmqType, const CBlockIndex* pindexNew)
+{
+    const auto& params = Params().GetConsensus().llmqs.at(llmqType);
+
+    // only the active quorums sign, the shares of older ones are recovered again if they are ever needed
+    std::set<uint256> activeQuorumHashes;
+    for (auto& quorum : ScanQuorums(llmqType, pindexNew, (size_t)params.signingActiveQuorumCount)) {
+        activeQuorumHashes.emplace(quorum->qc.quorumHash);
+    }
+    pkSharesStore->EraseInactive(llmqType, activeQuorumHashes);
+}
+
 bool CQuorumManager::BuildQuorumFromCommitment(const CFinalCommitment& qc, const CBlockIndex* pindexQuorum, const uint256& minedBlockHash, std::shared_ptr<CQuorum>& quorum) const
 {
     assert(pindexQuorum);
@@ -240,7 +386,7 @@ bool CQuorumManager::BuildQuorumFromCommitment(const CFinalCommitment& qc, const
 	quorum->Init(qc, pindexQuorum, minedBlockHash, members);
 
     bool hasValidVvec = false;
-    if (quorum->ReadContributions(evoDb)) {
+    if (quorum->ReadContributions(evoDb, *pkSharesStore)) {
         hasValidVvec = true;
     } else {
         if (BuildQuorumContributions(qc, quorum)) {
@@ -255,7 +401,7 @@ bool CQuorumManager::BuildQuorumFromCommitment(const CFinalCommitment& qc, const
         // pre-populate caches in the background
         // recovering public key shares is quite expensive and would result in serious lags for the first few signing
         // sessions if the shares would be calculated on-demand
-        CQuorum::StartCachePopulatorThread(quorum);
+        CQuorum::StartCachePopulator(quorum, pkSharesStore);
     }
 
     return true;
@@ -321,14 +467,18 @@ std::vector<CQuorumCPtr> CQuorumManager::ScanQuorums(Consensus::LLMQType llmqTyp
 
     std::vector<CQuorumCPtr> result;
 
+    auto& cacheStats = evoCacheBudget.GetStats(EVO_CACHE_SCAN_QUORUMS);
+
     if (maxCount <= cacheMaxSize) {
         LOCK(quorumsCacheCs);
         if (scanQuorumsCache.get(cacheKey, result)) {
+            cacheStats.Hit();
             if (result.size() > maxCount) {
                 result.resize(maxCount);
             }
             return result;
         }
+        cacheStats.Miss();
     }
 
     bool storeCache = false;
@@ -350,7 +500,12 @@ std::vector<CQuorumCPtr> CQuorumManager::ScanQuorums(Consensus::LLMQType llmqTyp
 
     if (storeCache) {
         LOCK(quorumsCacheCs);
+        size_t nOldSize = scanQuorumsCache.size();
         scanQuorumsCache.insert(cacheKey, result);
+        if (scanQuorumsCache.size() < nOldSize) {
+            cacheStats.Evicted(nOldSize + 1 - scanQuorumsCache.size());
+        }
+        cacheStats.SetUsage(scanQuorumsCache.size(), scanQuorumsCache.DynamicMemoryUsage());
     }
 
     if (result.size() > maxCount) {
@@ -390,10 +545,14 @@ CQuorumCPtr CQuorumManager::GetQuorum(Consensus::LLMQType llmqType, const CBlock
 
     LOCK(quorumsCacheCs);
 
+    auto& cacheStats = evoCacheBudget.GetStats(EVO_CACHE_QUORUMS);
+
     auto it = quorumsCache.find(std::make_pair(llmqType, quorumHash));
     if (it != quorumsCache.end()) {
-        return it->second;
+        cacheStats.Hit();
+        return it->second.first;
     }
+    cacheStats.Miss();
 
     CFinalCommitment qc;
     uint256 minedBlockHash;
@@ -409,11 +568,35 @@ CQuorumCPtr CQuorumManager::GetQuorum(Consensus::LLMQType llmqType, const CBlock
         return nullptr;
     }
 
-    quorumsCache.emplace(std::make_pair(llmqType, quorumHash), quorum);
+    size_t nUsage = EstimateQuorumMemoryUsage(*quorum);
+    quorumsCache.emplace(std::make_pair(llmqType, quorumHash), std::make_pair(quorum, nUsage));
+    quorumsCacheByHeight.emplace(pindexQuorum->nHeight, std::make_pair(llmqType, quorumHash));
+    quorumsCacheBytes += nUsage;
+    EvictQuorumsIfNeeded();
 
     return quorum;
 }
 
+void CQuorumManager::EvictQuorumsIfNeeded()
+{
+    AssertLockHeld(quorumsCacheCs);
+
+    auto& cacheStats = evoCacheBudget.GetStats(EVO_CACHE_QUORUMS);
+    size_t nLimit = evoCacheBudget.GetLimit(EVO_CACHE_QUORUMS);
+
+    // evict the oldest quorums first, they are the least likely to be needed again. Quorums which are still in use
+    // stay alive through their shared pointers and are simply rebuilt when requested again
+    while (quorumsCacheBytes > nLimit && quorumsCache.size() > 1) {
+        auto oldestIt = quorumsCache.find(quorumsCacheByHeight.begin()->second);
+        quorumsCacheBytes -= oldestIt->second.second;
+        quorumsCache.erase(oldestIt);
+        quorumsCacheByHeight.erase(quorumsCacheByHeight.begin());
+        cacheStats.Evicted();
+    }
+
+    cacheStats.SetUsage(quorumsCache.size(), quorumsCacheBytes);
+}
+
 CQuorumCPtr CQuorumManager::GetNewestQuorum(Consensus::LLMQType llmqType)
 {
     auto quorums = ScanQuorums(llmqType, 1);
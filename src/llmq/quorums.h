@@ -19,10 +19,32 @@
 #include "bls/bls.h"
 #include "bls/bls_worker.h"
 
+#include "cxxtimer.hpp"
+
 namespace llmq
 {
 
 class CDKGSessionManager;
+class CQuorum;
+
+/**
+ * Persists the recovered public key shares of quorums in the evo DB. Only the shares of the currently active quorums
+ * are kept, the quorum manager erases the ones of older quorums on every new block.
+ * The quorum manager owns the store and the cache populator jobs only hold weak references to it, so jobs still queued
+ * in the BLS worker pool can't write to the DB anymore once the quorum system is destroyed.
+ */
+class CQuorumPubKeySharesStore
+{
+private:
+    CEvoDB& evoDb;
+
+public:
+    explicit CQuorumPubKeySharesStore(CEvoDB& _evoDb) : evoDb(_evoDb) {}
+
+    bool Read(const CQuorum& quorum, BLSPublicKeyVector& pkSharesRet);
+    void Write(const CQuorum& quorum, const BLSPublicKeyVector& pkShares);
+    void EraseInactive(Consensus::LLMQType llmqType, const std::set<uint256>& activeQuorumHashes);
+};
 
 /**
  * An object of this class represents a quorum which was mined on-chain (through a quorum commitment)
@@ -48,15 +70,14 @@ public:
     CBLSSecretKey skShare;
 
 private:
-    // Recovery of public key shares is very slow, so we start a background thread that pre-populates a cache so that
-    // the public key shares are ready when needed later
+    CBLSWorker& blsWorker;
+    // Recovery of public key shares is very slow, so we push background jobs to the BLS worker pool that pre-populate
+    // a cache so that the public key shares are ready when needed later. The shares are also persisted in the evo DB
     mutable CBLSWorkerCache blsCache;
-    std::atomic<bool> stopCachePopulatorThread;
-    std::thread cachePopulatorThread;
+    bool hasPersistedPubKeyShares{false};
 
 public:
-    CQuorum(const Consensus::LLMQParams& _params, CBLSWorker& _blsWorker) : params(_params), blsCache(_blsWorker), stopCachePopulatorThread(false) {}
-    ~CQuorum();
+    CQuorum(const Consensus::LLMQParams& _params, CBLSWorker& _blsWorker) : params(_params), blsWorker(_blsWorker), blsCache(_blsWorker) {}
 	void Init(const CFinalCommitment& _qc, const CBlockIndex* _pindexQuorum, const uint256& _minedBlockHash, const std::vector<CDeterministicMNCPtr>& _members);
 
     bool IsMember(const uint256& proTxHash) const;
@@ -68,8 +89,9 @@ public:
 
 private:
     void WriteContributions(CEvoDB& evoDb);
-    bool ReadContributions(CEvoDB& evoDb);
-    static void StartCachePopulatorThread(std::shared_ptr<CQuorum> _this);
+    bool ReadContributions(CEvoDB& evoDb, CQuorumPubKeySharesStore& pkSharesStore);
+    static void StartCachePopulator(const std::shared_ptr<CQuorum>& _this, const std::shared_ptr<CQuorumPubKeySharesStore>& pkSharesStore);
+    static void PopulateCacheChunk(std::weak_ptr<CQuorum> weakThis, std::weak_ptr<CQuorumPubKeySharesStore> weakStore, size_t start, std::shared_ptr<BLSPublicKeyVector> pkShares, cxxtimer::Timer t);
 };
 typedef std::shared_ptr<CQuorum> CQuorumPtr;
 typedef std::shared_ptr<const CQuorum> CQuorumCPtr;
@@ -86,10 +108,15 @@ private:
     CEvoDB& evoDb;
     CBLSWorker& blsWorker;
     CDKGSessionManager& dkgManager;
+    std::shared_ptr<CQuorumPubKeySharesStore> pkSharesStore;
 
     CCriticalSection quorumsCacheCs;
-    std::map<std::pair<Consensus::LLMQType, uint256>, CQuorumPtr> quorumsCache;
-    unordered_lru_cache<std::pair<Consensus::LLMQType, uint256>, std::vector<CQuorumCPtr>, StaticSaltedHasher, 32> scanQuorumsCache;
+    // cached quorums together with their estimated memory usage
+    std::map<std::pair<Consensus::LLMQType, uint256>, std::pair<CQuorumPtr, size_t>> quorumsCache;
+    // keys of quorumsCache ordered by quorum height, oldest first
+    std::set<std::pair<int, std::pair<Consensus::LLMQType, uint256>>> quorumsCacheByHeight;
+    size_t quorumsCacheBytes{0};
+    unordered_lru_cache<std::pair<Consensus::LLMQType, uint256>, std::vector<CQuorumCPtr>, StaticSaltedHasher> scanQuorumsCache;
 
 public:
     CQuorumManager(CEvoDB& _evoDb, CBLSWorker& _blsWorker, CDKGSessionManager& _dkgManager);
@@ -109,11 +136,15 @@ public:
 private:
     // all private methods here are cs_main-free
     void EnsureQuorumConnections(Consensus::LLMQType llmqType, const CBlockIndex *pindexNew);
+    void CleanupPubKeyShares(Consensus::LLMQType llmqType, const CBlockIndex *pindexNew);
 
     bool BuildQuorumFromCommitment(const CFinalCommitment& qc, const CBlockIndex* pindexQuorum, const uint256& minedBlockHash, std::shared_ptr<CQuorum>& quorum) const;
     bool BuildQuorumContributions(const CFinalCommitment& fqc, std::shared_ptr<CQuorum>& quorum) const;
 
     CQuorumCPtr GetQuorum(Consensus::LLMQType llmqType, const CBlockIndex* pindex);
+    void EvictQuorumsIfNeeded();
+
+    static size_t GetScanQuorumsCacheMaxSize();
 };
 
 extern CQuorumManager* quorumManager;
@@ -9,6 +9,7 @@
 #include "quorums_debug.h"
 #include "quorums_utils.h"
 
+#include "evo/evocache.h"
 #include "evo/specialtx.h"
 
 #include "chain.h"
@@ -29,6 +30,19 @@ static const std::string DB_MINED_COMMITMENT_BY_INVERSED_HEIGHT = "q_mcih";
 
 static const std::string DB_BEST_BLOCK_UPGRADE = "q_bbu2";
 
+static size_t GetMinedCommitmentCacheMaxSize()
+{
+    size_t nEntryUsage = unordered_lru_cache<std::pair<Consensus::LLMQType, uint256>, bool, StaticSaltedHasher>::EntryMemoryUsage(false);
+    // the LRU cache grows up to twice its size before it truncates
+    return std::max((size_t)32, evoCacheBudget.GetLimit(EVO_CACHE_MINED_COMMITMENTS) / (2 * nEntryUsage));
+}
+
+CQuorumBlockProcessor::CQuorumBlockProcessor(CEvoDB& _evoDb) :
+    evoDb(_evoDb),
+    hasMinedCommitmentCache(GetMinedCommitmentCacheMaxSize())
+{
+}
+
 void CQuorumBlockProcessor::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman)
 {
     if (strCommand == NetMsgType::QFCOMMITMENT) {
@@ -376,20 +390,29 @@ uint256 CQuorumBlockProcessor::GetQuorumBlockHash(Consensus::LLMQType llmqType,
 
 bool CQuorumBlockProcessor::HasMinedCommitment(Consensus::LLMQType llmqType, const uint256& quorumHash)
 {
+    auto& cacheStats = evoCacheBudget.GetStats(EVO_CACHE_MINED_COMMITMENTS);
+
     auto cacheKey = std::make_pair(llmqType, quorumHash);
     {
         LOCK(minableCommitmentsCs);
-        auto cacheIt = hasMinedCommitmentCache.find(cacheKey);
-        if (cacheIt != hasMinedCommitmentCache.end()) {
-            return cacheIt->second;
+        bool ret;
+        if (hasMinedCommitmentCache.get(cacheKey, ret)) {
+            cacheStats.Hit();
+            return ret;
         }
     }
+    cacheStats.Miss();
 
     auto key = std::make_pair(DB_MINED_COMMITMENT, std::make_pair((uint8_t)llmqType, quorumHash));
     bool ret = evoDb.Exists(key);
 
     LOCK(minableCommitmentsCs);
-    hasMinedCommitmentCache.emplace(cacheKey, ret);
+    size_t nOldSize = hasMinedCommitmentCache.size();
+    hasMinedCommitmentCache.insert(cacheKey, ret);
+    if (hasMinedCommitmentCache.size() < nOldSize) {
+        cacheStats.Evicted(nOldSize + 1 - hasMinedCommitmentCache.size());
+    }
+    cacheStats.SetUsage(hasMinedCommitmentCache.size(), hasMinedCommitmentCache.DynamicMemoryUsage());
     return ret;
 }
 
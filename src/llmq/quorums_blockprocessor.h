@@ -14,9 +14,9 @@
 #include "primitives/transaction.h"
 #include "saltedhasher.h"
 #include "sync.h"
+#include "unordered_lru_cache.h"
 
 #include <map>
-#include <unordered_map>
 
 class CNode;
 class CConnman;
@@ -34,10 +34,10 @@ private:
     std::map<std::pair<Consensus::LLMQType, uint256>, uint256> minableCommitmentsByQuorum;
     std::map<uint256, CFinalCommitment> minableCommitments;
 
-    std::unordered_map<std::pair<Consensus::LLMQType, uint256>, bool, StaticSaltedHasher> hasMinedCommitmentCache;
+    unordered_lru_cache<std::pair<Consensus::LLMQType, uint256>, bool, StaticSaltedHasher> hasMinedCommitmentCache;
 
 public:
-    CQuorumBlockProcessor(CEvoDB& _evoDb) : evoDb(_evoDb) {}
+    CQuorumBlockProcessor(CEvoDB& _evoDb);
 
     void UpgradeDB();
 
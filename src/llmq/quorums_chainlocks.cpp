@@ -7,10 +7,12 @@
 #include "quorums.h"
 #include "quorums_chainlocks.h"
 #include "quorums_instantsend.h"
+#include "quorums_latency.h"
 #include "quorums_signing.h"
 #include "quorums_utils.h"
 
 #include "chain.h"
+#include "dbwrapper.h"
 #include "masternode-sync.h"
 #include "net_processing.h"
 #include "scheduler.h"
@@ -18,10 +20,13 @@
 #include "txmempool.h"
 #include "validation.h"
 
+#include <boost/bind.hpp>
+
 namespace llmq
 {
 
 static const std::string CLSIG_REQUESTID_PREFIX = "clsig";
+static const std::string DB_BLOCK_TXS = "cl_btx";
 
 CChainLocksHandler* chainLocksHandler;
 
@@ -30,8 +35,110 @@ std::string CChainLockSig::ToString() const
     return strprintf("CChainLockSig(nHeight=%d, blockHash=%s)", nHeight, blockHash.ToString());
 }
 
-CChainLocksHandler::CChainLocksHandler(CScheduler* _scheduler) :
-    scheduler(_scheduler)
+CTxFirstSeenTimes::CTxFirstSeenTimes(int64_t _maxAge, unsigned int nExpectedExpired) :
+    maxAge(_maxAge),
+    expired(nExpectedExpired, 0.000001)
+{
+    // entries are only expired after they are at least maxAge old
+    buckets.resize(maxAge / BUCKET_SECONDS + 2);
+}
+
+void CTxFirstSeenTimes::Expire(int64_t nNow)
+{
+    int64_t curBucket = nNow / BUCKET_SECONDS;
+    if (lastBucket == -1) {
+        lastBucket = curBucket;
+        return;
+    }
+
+    // each new bucket reuses the slot of the oldest bucket
+    int64_t bucketCount = (int64_t)buckets.size();
+    for (int64_t b = std::max(lastBucket + 1, curBucket - bucketCount + 1); b <= curBucket; b++) {
+        auto& bucket = buckets[b % bucketCount];
+        for (const auto& txid : bucket) {
+            auto it = times.find(txid);
+            if (it == times.end() || it->second.fInMempool) {
+                // RemovedFromMempool will forget about it
+                continue;
+            }
+            times.erase(it);
+            expired.insert(txid);
+        }
+        bucket.clear();
+    }
+    lastBucket = std::max(lastBucket, curBucket);
+}
+
+bool CTxFirstSeenTimes::IsBucketExpired(int64_t nBucket) const
+{
+    return nBucket <= lastBucket - (int64_t)buckets.size();
+}
+
+void CTxFirstSeenTimes::Add(const uint256& txid, int64_t nTime, int64_t nNow, bool fInMempool)
+{
+    Expire(nNow);
+
+    auto it = times.find(txid);
+    if (it != times.end()) {
+        if (fInMempool) {
+            it->second.fInMempool = true;
+        }
+        return;
+    }
+
+    int64_t bucketCount = (int64_t)buckets.size();
+    int64_t b = std::min(nTime / BUCKET_SECONDS, lastBucket);
+    bool fExpired = expired.contains(txid);
+    if (fExpired || nNow - nTime >= maxAge || b <= lastBucket - bucketCount + 1) {
+        // old enough already
+        if (fInMempool) {
+            // we don't know the time of TXs which only the bloom filter remembers, but we know that they are old
+            times.emplace(txid, Entry{fExpired ? std::min(nTime, nNow - maxAge) : nTime, lastBucket - bucketCount, true});
+        } else if (!fExpired) {
+            expired.insert(txid);
+        }
+        return;
+    }
+
+    times.emplace(txid, Entry{nTime, b, fInMempool});
+    buckets[b % bucketCount].emplace_back(txid);
+}
+
+void CTxFirstSeenTimes::RemovedFromMempool(const uint256& txid)
+{
+    auto it = times.find(txid);
+    if (it == times.end()) {
+        return;
+    }
+    it->second.fInMempool = false;
+    if (IsBucketExpired(it->second.nBucket)) {
+        // Expire skipped it while it was in the mempool
+        times.erase(it);
+        expired.insert(txid);
+    }
+}
+
+int64_t CTxFirstSeenTimes::GetAge(const uint256& txid, int64_t nNow) const
+{
+    auto it = times.find(txid);
+    if (it != times.end()) {
+        return nNow - it->second.nTime;
+    }
+    if (expired.contains(txid)) {
+        return maxAge;
+    }
+    return 0;
+}
+
+bool CTxFirstSeenTimes::IsKnown(const uint256& txid) const
+{
+    return times.count(txid) != 0 || expired.contains(txid);
+}
+
+CChainLocksHandler::CChainLocksHandler(CDBWrapper& _llmqDb, CScheduler* _scheduler) :
+    llmqDb(_llmqDb),
+    scheduler(_scheduler),
+    txFirstSeenTimes(WAIT_FOR_ISLOCK_TIMEOUT, 100000)
 {
 }
 
@@ -42,6 +149,7 @@ CChainLocksHandler::~CChainLocksHandler()
 void CChainLocksHandler::Start()
 {
     quorumSigningManager->RegisterRecoveredSigsListener(this);
+    mempool.NotifyEntryRemoved.connect(boost::bind(&CChainLocksHandler::TransactionRemovedFromMempool, this, _1, _2));
     scheduler->scheduleEvery([&]() {
         CheckActiveState();
         EnforceBestChainLock();
@@ -52,6 +160,7 @@ void CChainLocksHandler::Start()
 
 void CChainLocksHandler::Stop()
 {
+    mempool.NotifyEntryRemoved.disconnect(boost::bind(&CChainLocksHandler::TransactionRemovedFromMempool, this, _1, _2));
     quorumSigningManager->UnregisterRecoveredSigsListener(this);
 }
 
@@ -134,6 +243,10 @@ void CChainLocksHandler::ProcessNewChainLock(NodeId from, const llmq::CChainLock
         bestChainLockHash = hash;
         bestChainLock = clsig;
 
+        if (clsig.blockHash == lastTipBlockHash) {
+            latencyStats.Add(LATENCY_CHAINLOCK, GetTimeMillis() - lastTipTime);
+        }
+
         CInv inv(MSG_CLSIG, hash);
         g_connman->RelayInv(inv, LLMQS_PROTO_VERSION);
 
@@ -192,18 +305,27 @@ void CChainLocksHandler::UpdatedBlockTip(const CBlockIndex* pindexNew)
     // don't call TrySignChainTip directly but instead let the scheduler call it. This way we ensure that cs_main is
     // never locked and TrySignChainTip is not called twice in parallel. Also avoids recursive calls due to
     // EnforceBestChainLock switching chains.
-    LOCK(cs);
-    if (tryLockChainTipScheduled) {
-        return;
-    }
-    tryLockChainTipScheduled = true;
-    scheduler->scheduleFromNow([&]() {
-        CheckActiveState();
-        EnforceBestChainLock();
-        TrySignChainTip();
+    BlockTxsWrite blockTxsWrite;
+    {
         LOCK(cs);
-        tryLockChainTipScheduled = false;
-    }, 0);
+        // all TXs of the new tip were handled by SyncTransaction already
+        blockTxsWrite = FinishBlockTxs();
+        if (pindexNew->GetBlockHash() != lastTipBlockHash) {
+            lastTipBlockHash = pindexNew->GetBlockHash();
+            lastTipTime = GetTimeMillis();
+        }
+        if (!tryLockChainTipScheduled) {
+            tryLockChainTipScheduled = true;
+            scheduler->scheduleFromNow([&]() {
+                CheckActiveState();
+                EnforceBestChainLock();
+                TrySignChainTip();
+                LOCK(cs);
+                tryLockChainTipScheduled = false;
+            }, 0);
+        }
+    }
+    WriteBlockTxs(blockTxsWrite);
 }
 
 void CChainLocksHandler::CheckActiveState()
@@ -303,20 +425,19 @@ void CChainLocksHandler::TrySignChainTip()
                 break;
             }
 
-            auto txids = GetBlockTxs(pindexWalk->GetBlockHash());
+            auto txids = GetBlockTxs(pindexWalk);
             if (!txids) {
-                pindexWalk = pindexWalk->pprev;
-                continue;
+                // can only happen for blocks which are still being connected or which are not available on disk
+                LogPrint("chainlocks", "CChainLocksHandler::%s -- not signing block %s due to unknown TXs in block %s\n", __func__,
+                          pindex->GetBlockHash().ToString(), pindexWalk->GetBlockHash().ToString());
+                return;
             }
 
             for (auto& txid : *txids) {
-                int64_t txAge = 0;
+                int64_t txAge;
                 {
                     LOCK(cs);
-                    auto it = txFirstSeenTime.find(txid);
-                    if (it != txFirstSeenTime.end()) {
-                        txAge = GetAdjustedTime() - it->second;
-                    }
+                    txAge = txFirstSeenTimes.GetAge(txid, GetAdjustedTime());
                 }
 
                 if (txAge < WAIT_FOR_ISLOCK_TIMEOUT && !quorumInstantSendManager->IsLocked(txid)) {
@@ -353,91 +474,191 @@ void CChainLocksHandler::SyncTransaction(const CTransaction& tx, const CBlockInd
     if (tx.IsCoinBase() || tx.vin.empty()) {
         handleTx = false;
     }
+    bool isBlockTx = pindex && posInBlock != CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK;
+    uint256 txid = tx.GetHash();
 
 	if (!masternodeSync.IsBlockchainSynced()) {
-		if (handleTx && posInBlock == CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK) {
-			auto info = mempool.info(tx.GetHash());
+		if (handleTx && !isBlockTx) {
+			auto info = mempool.info(txid);
 			if (!info.tx) {
 				return;
 			}
 			LOCK(cs);
-			txFirstSeenTime.emplace(tx.GetHash(), info.nTime);
+			txFirstSeenTimes.Add(txid, info.nTime, GetAdjustedTime(), true);
+		} else if (isBlockTx) {
+			// only persist the txids, we don't keep anything in memory until we're synced
+			BlockTxsWrite blockTxsWrite;
+			{
+				LOCK(cs);
+				blockTxsWrite = AddBlockTx(pindex, handleTx ? &txid : nullptr, false);
+			}
+			WriteBlockTxs(blockTxsWrite);
 		}
 		return;
 	}
 
-    LOCK(cs);
+    // TXs which conflicted with a block are passed in here as well, after they were removed from the mempool
+    bool fInMempool = handleTx && !isBlockTx && mempool.exists(txid);
 
-    if (handleTx) {
-        int64_t curTime = GetAdjustedTime();
-        txFirstSeenTime.emplace(tx.GetHash(), curTime);
-    }
+    BlockTxsWrite blockTxsWrite;
+    {
+        LOCK(cs);
 
-    // We listen for SyncTransaction so that we can collect all TX ids of all included TXs of newly received blocks
-    // We need this information later when we try to sign a new tip, so that we can determine if all included TXs are
-    // safe.
-    if (pindex && posInBlock != CMainSignals::SYNC_TRANSACTION_NOT_IN_BLOCK) {
-        auto it = blockTxs.find(pindex->GetBlockHash());
-        if (it == blockTxs.end()) {
-            // we want this to be run even if handleTx == false, so that the coinbase TX triggers creation of an empty entry
-            it = blockTxs.emplace(pindex->GetBlockHash(), std::make_shared<std::unordered_set<uint256, StaticSaltedHasher>>()).first;
-        }
         if (handleTx) {
-            auto& txs = *it->second;
-            txs.emplace(tx.GetHash());
+            txFirstSeenTimes.Add(txid, GetAdjustedTime(), GetAdjustedTime(), fInMempool);
+        }
+
+        // We listen for SyncTransaction so that we can collect all TX ids of all included TXs of newly received blocks
+        // We need this information later when we try to sign a new tip, so that we can determine if all included TXs are
+        // safe.
+        if (isBlockTx) {
+            // we want this to be run even if handleTx == false, so that the coinbase TX triggers creation of an empty entry
+            blockTxsWrite = AddBlockTx(pindex, handleTx ? &txid : nullptr, true);
         }
     }
+    WriteBlockTxs(blockTxsWrite);
 }
 
-CChainLocksHandler::BlockTxs::mapped_type CChainLocksHandler::GetBlockTxs(const uint256& blockHash)
+void CChainLocksHandler::TransactionRemovedFromMempool(CTransactionRef tx, MemPoolRemovalReason reason)
+{
+    LOCK(cs);
+    txFirstSeenTimes.RemovedFromMempool(tx->GetHash());
+}
+
+CChainLocksHandler::BlockTxsWrite CChainLocksHandler::AddBlockTx(const CBlockIndex* pindex, const uint256* txid, bool keepInMemory)
+{
+    AssertLockHeld(cs);
+
+    BlockTxsWrite blockTxsWrite;
+    if (pindex != curBlockTxsIndex) {
+        blockTxsWrite = FinishBlockTxs();
+        curBlockTxsIndex = pindex;
+        curBlockTxsKeepInMemory = keepInMemory;
+    }
+    if (txid) {
+        curBlockTxs.emplace_back(*txid);
+    }
+    return blockTxsWrite;
+}
+
+CChainLocksHandler::BlockTxsWrite CChainLocksHandler::FinishBlockTxs()
+{
+    AssertLockHeld(cs);
+
+    if (!curBlockTxsIndex) {
+        return BlockTxsWrite();
+    }
+
+    auto txids = std::make_shared<const std::vector<uint256>>(std::move(curBlockTxs));
+    BlockTxsWrite blockTxsWrite;
+    if (curBlockTxsKeepInMemory || curBlockTxsIndex->GetBlockTime() >= GetAdjustedTime() - BLOCK_TXS_MAX_PERSIST_AGE) {
+        blockTxsWrite = std::make_pair(curBlockTxsIndex, txids);
+    }
+    if (curBlockTxsKeepInMemory) {
+        blockTxs[curBlockTxsIndex->GetBlockHash()] = txids;
+    }
+
+    curBlockTxsIndex = nullptr;
+    curBlockTxs.clear();
+    return blockTxsWrite;
+}
+
+void CChainLocksHandler::WriteBlockTxs(const BlockTxsWrite& blockTxsWrite)
 {
     AssertLockNotHeld(cs);
-    AssertLockNotHeld(cs_main);
 
-    CChainLocksHandler::BlockTxs::mapped_type ret;
+    if (!blockTxsWrite.first) {
+        return;
+    }
+    auto pindex = blockTxsWrite.first;
+    llmqDb.Write(std::make_tuple(DB_BLOCK_TXS, (uint32_t)htobe32(pindex->nHeight), pindex->GetBlockHash()), *blockTxsWrite.second);
+}
+
+CChainLocksHandler::BlockTxsPtr CChainLocksHandler::GetBlockTxs(const CBlockIndex* pindex)
+{
+    AssertLockNotHeld(cs);
+    AssertLockNotHeld(cs_main);
 
     {
         LOCK(cs);
-        auto it = blockTxs.find(blockHash);
+        if (pindex == curBlockTxsIndex) {
+            // block is still being connected, we'll retry when the tip gets updated
+            return nullptr;
+        }
+        auto it = blockTxs.find(pindex->GetBlockHash());
         if (it != blockTxs.end()) {
-            ret = it->second;
+            return it->second;
         }
     }
-    if (!ret) {
-        // This should only happen when freshly started.
-        // If running for some time, SyncTransaction should have been called before which fills blockTxs.
-        LogPrint("chainlocks", "CChainLocksHandler::%s -- blockTxs for %s not found. Trying ReadBlockFromDisk\n", __func__,
-                 blockHash.ToString());
 
-        uint32_t blockTime;
+    // This should only happen when freshly started or when the block was connected while we were not synced
+    auto dbKey = std::make_tuple(DB_BLOCK_TXS, (uint32_t)htobe32(pindex->nHeight), pindex->GetBlockHash());
+    std::vector<uint256> txids;
+    if (!llmqDb.Read(dbKey, txids)) {
+        // The block was connected while running an older version (or the txid list got lost), so the list is rebuilt
+        // from disk once and persisted again
+        LogPrint("chainlocks", "CChainLocksHandler::%s -- txids of block %s not found. Trying ReadBlockFromDisk\n", __func__,
+                 pindex->GetBlockHash().ToString());
+
+        CBlock block;
         {
             LOCK(cs_main);
-            auto pindex = mapBlockIndex.at(blockHash);
-            CBlock block;
             if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
                 return nullptr;
             }
-
-            ret = std::make_shared<std::unordered_set<uint256, StaticSaltedHasher>>();
-            for (auto& tx : block.vtx) {
-                if (tx->IsCoinBase() || tx->vin.empty()) {
-                    continue;
-                }
-                ret->emplace(tx->GetHash());
+        }
+        for (auto& tx : block.vtx) {
+            if (tx->IsCoinBase() || tx->vin.empty()) {
+                continue;
             }
-
-            blockTime = block.nTime;
+            txids.emplace_back(tx->GetHash());
         }
+        llmqDb.Write(dbKey, txids);
+    }
 
-        LOCK(cs);
-        blockTxs.emplace(blockHash, ret);
-        for (auto& txid : *ret) {
-            txFirstSeenTime.emplace(txid, blockTime);
-        }
+    LOCK(cs);
+    auto ret = std::make_shared<const std::vector<uint256>>(std::move(txids));
+    blockTxs.emplace(pindex->GetBlockHash(), ret);
+    for (auto& txid : *ret) {
+        txFirstSeenTimes.Add(txid, pindex->GetBlockTime(), GetAdjustedTime(), false);
     }
     return ret;
 }
 
+void CChainLocksHandler::CleanupBlockTxsDb(int tipHeight)
+{
+    int maxHeight = tipHeight - BLOCK_TXS_KEEP_DEPTH;
+    if (maxHeight <= 0) {
+        return;
+    }
+
+    std::unique_ptr<CDBIterator> pcursor(llmqDb.NewIterator());
+
+    auto start = std::make_tuple(DB_BLOCK_TXS, (uint32_t)0, uint256());
+    pcursor->Seek(start);
+
+    CDBBatch batch(llmqDb);
+    while (pcursor->Valid()) {
+        decltype(start) k;
+
+        if (!pcursor->GetKey(k) || std::get<0>(k) != DB_BLOCK_TXS) {
+            break;
+        }
+        if ((int)be32toh(std::get<1>(k)) >= maxHeight) {
+            break;
+        }
+
+        batch.Erase(k);
+
+        pcursor->Next();
+    }
+    pcursor.reset();
+
+    if (batch.SizeEstimate() != 0) {
+        llmqDb.WriteBatch(batch);
+    }
+}
+
 bool CChainLocksHandler::IsTxSafeForMining(const uint256& txid)
 {
     if (!sporkManager.IsSporkActive(SPORK_3_INSTANTSEND_BLOCK_FILTERING)) {
@@ -447,16 +668,13 @@ bool CChainLocksHandler::IsTxSafeForMining(const uint256& txid)
         return true;
     }
 
-    int64_t txAge = 0;
+    int64_t txAge;
     {
         LOCK(cs);
         if (!isSporkActive) {
             return true;
         }
-        auto it = txFirstSeenTime.find(txid);
-        if (it != txFirstSeenTime.end()) {
-            txAge = GetAdjustedTime() - it->second;
-        }
+        txAge = txFirstSeenTimes.GetAge(txid, GetAdjustedTime());
     }
 
     if (txAge < WAIT_FOR_ISLOCK_TIMEOUT && !quorumInstantSendManager->IsLocked(txid)) {
@@ -667,50 +885,37 @@ void CChainLocksHandler::Cleanup()
         }
     }
 
-    // need mempool.cs due to GetTransaction calls
-    LOCK2(cs_main, mempool.cs);
-    LOCK(cs);
+    int tipHeight;
+    {
+        LOCK2(cs_main, cs);
 
-    for (auto it = seenChainLocks.begin(); it != seenChainLocks.end(); ) {
-        if (GetTimeMillis() - it->second >= CLEANUP_SEEN_TIMEOUT) {
-            it = seenChainLocks.erase(it);
-        } else {
-            ++it;
+        for (auto it = seenChainLocks.begin(); it != seenChainLocks.end(); ) {
+            if (GetTimeMillis() - it->second >= CLEANUP_SEEN_TIMEOUT) {
+                it = seenChainLocks.erase(it);
+            } else {
+                ++it;
+            }
         }
-    }
 
-    for (auto it = blockTxs.begin(); it != blockTxs.end(); ) {
-        auto pindex = mapBlockIndex.at(it->first);
-        if (InternalHasChainLock(pindex->nHeight, pindex->GetBlockHash())) {
-            for (auto& txid : *it->second) {
-                txFirstSeenTime.erase(txid);
-            }
-            it = blockTxs.erase(it);
-        } else if (InternalHasConflictingChainLock(pindex->nHeight, pindex->GetBlockHash())) {
-            it = blockTxs.erase(it);
-        } else {
-            ++it;
-        }
-    }
-    for (auto it = txFirstSeenTime.begin(); it != txFirstSeenTime.end(); ) {
-        CTransactionRef tx;
-        uint256 hashBlock;
-        if (!GetTransaction(it->first, tx, Params().GetConsensus(), hashBlock)) {
-            // tx has vanished, probably due to conflicts
-            it = txFirstSeenTime.erase(it);
-        } else if (!hashBlock.IsNull()) {
-            auto pindex = mapBlockIndex.at(hashBlock);
-            if (chainActive.Tip()->GetAncestor(pindex->nHeight) == pindex && chainActive.Height() - pindex->nHeight >= 6) {
-                // tx got confirmed >= 6 times, so we can stop keeping track of it
-                it = txFirstSeenTime.erase(it);
+        for (auto it = blockTxs.begin(); it != blockTxs.end(); ) {
+            auto pindex = mapBlockIndex.at(it->first);
+            if (InternalHasChainLock(pindex->nHeight, pindex->GetBlockHash())) {
+                it = blockTxs.erase(it);
+            } else if (InternalHasConflictingChainLock(pindex->nHeight, pindex->GetBlockHash())) {
+                it = blockTxs.erase(it);
             } else {
                 ++it;
             }
-        } else {
-            ++it;
         }
+
+        txFirstSeenTimes.Expire(GetAdjustedTime());
+
+        tipHeight = chainActive.Height();
     }
 
+    CleanupBlockTxsDb(tipHeight);
+
+    LOCK(cs);
     lastCleanupTime = GetTimeMillis();
 }
 
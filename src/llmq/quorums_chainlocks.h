@@ -10,14 +10,18 @@
 #include "llmq/quorums.h"
 #include "llmq/quorums_signing.h"
 
+#include "bloom.h"
 #include "net.h"
 #include "chainparams.h"
+#include "saltedhasher.h"
 
 #include <atomic>
-#include <unordered_set>
+#include <unordered_map>
 
 class CBlockIndex;
+class CDBWrapper;
 class CScheduler;
+enum class MemPoolRemovalReason;
 
 namespace llmq
 {
@@ -43,6 +47,50 @@ public:
     std::string ToString() const;
 };
 
+/**
+ * Keeps track of the times when TXs were first seen, for as long as the TXs are young enough to matter. The TXs are
+ * kept in a ring of time buckets, so expiring old entries only touches the expired buckets instead of scanning all TXs.
+ * TXs which are still in the mempool keep their exact time when their bucket expires, until they leave the mempool.
+ * All other TXs from expired buckets are only remembered in a rolling bloom filter, so that they are not mistaken for
+ * unseen TXs.
+ */
+class CTxFirstSeenTimes
+{
+public:
+    static const int64_t BUCKET_SECONDS = 60;
+
+private:
+    struct Entry {
+        int64_t nTime;
+        // absolute number of the bucket which holds the TX, or an expired one for old TXs in the mempool
+        int64_t nBucket;
+        bool fInMempool;
+    };
+
+    int64_t maxAge;
+    std::vector<std::vector<uint256>> buckets;
+    // absolute number (time / BUCKET_SECONDS) of the newest bucket
+    int64_t lastBucket{-1};
+    std::unordered_map<uint256, Entry, StaticSaltedHasher> times;
+    CRollingBloomFilter expired;
+
+public:
+    CTxFirstSeenTimes(int64_t _maxAge, unsigned int nExpectedExpired);
+
+    // Does nothing if the TX was seen before, except for remembering that it is in the mempool now
+    void Add(const uint256& txid, int64_t nTime, int64_t nNow, bool fInMempool);
+    void RemovedFromMempool(const uint256& txid);
+    // Returns 0 for unseen TXs and at least maxAge for TXs that expired already
+    int64_t GetAge(const uint256& txid, int64_t nNow) const;
+    bool IsKnown(const uint256& txid) const;
+    void Expire(int64_t nNow);
+
+    size_t size() const { return times.size(); }
+
+private:
+    bool IsBucketExpired(int64_t nBucket) const;
+};
+
 class CChainLocksHandler : public CRecoveredSigsListener
 {
     static const int64_t CLEANUP_INTERVAL = 1000 * 30;
@@ -51,7 +99,13 @@ class CChainLocksHandler : public CRecoveredSigsListener
     // how long to wait for ixlocks until we consider a block with non-ixlocked TXs to be safe to sign
     static const int64_t WAIT_FOR_ISLOCK_TIMEOUT = 10 * 60;
 
+    // how many blocks below the tip the persisted block txid lists are kept
+    static const int BLOCK_TXS_KEEP_DEPTH = 100;
+    // txid lists of blocks older than this are not persisted while syncing, as we won't try to sign on top of them
+    static const int64_t BLOCK_TXS_MAX_PERSIST_AGE = 24 * 60 * 60;
+
 private:
+    CDBWrapper& llmqDb;
     CScheduler* scheduler;
     CCriticalSection cs;
     bool tryLockChainTipScheduled{false};
@@ -65,21 +119,33 @@ private:
     const CBlockIndex* bestChainLockBlockIndex{nullptr};
     const CBlockIndex* lastNotifyChainLockBlockIndex{nullptr};
 
+    // used to measure the latency from a new tip until it gets ChainLocked
+    uint256 lastTipBlockHash;
+    int64_t lastTipTime{0};
+
     int32_t lastSignedHeight{-1};
     uint256 lastSignedRequestId;
     uint256 lastSignedMsgHash;
 
     // We keep track of txids from recently received blocks so that we can check if all TXs got ixlocked
-    typedef std::unordered_map<uint256, std::shared_ptr<std::unordered_set<uint256, StaticSaltedHasher>>> BlockTxs;
-    BlockTxs blockTxs;
-    std::unordered_map<uint256, int64_t> txFirstSeenTime;
+    // The txid lists are also written to the DB, so that they are still known after a restart
+    typedef std::shared_ptr<const std::vector<uint256>> BlockTxsPtr;
+    // a txid list which still needs to be written to the DB. The write happens after cs got released
+    typedef std::pair<const CBlockIndex*, BlockTxsPtr> BlockTxsWrite;
+    std::unordered_map<uint256, BlockTxsPtr, StaticSaltedHasher> blockTxs;
+    // txids of the block which is currently connected. Finished when the next block starts or when the tip is updated
+    const CBlockIndex* curBlockTxsIndex{nullptr};
+    std::vector<uint256> curBlockTxs;
+    bool curBlockTxsKeepInMemory{false};
+
+    CTxFirstSeenTimes txFirstSeenTimes;
 
     std::map<uint256, int64_t> seenChainLocks;
 
     int64_t lastCleanupTime{0};
 
 public:
-    CChainLocksHandler(CScheduler* _scheduler);
+    CChainLocksHandler(CDBWrapper& _llmqDb, CScheduler* _scheduler);
     ~CChainLocksHandler();
 
     void Start();
@@ -93,6 +159,7 @@ public:
     void AcceptedBlockHeader(const CBlockIndex* pindexNew);
     void UpdatedBlockTip(const CBlockIndex* pindexNew);
     void SyncTransaction(const CTransaction &tx, const CBlockIndex *pindex, int posInBlock);
+    void TransactionRemovedFromMempool(CTransactionRef tx, MemPoolRemovalReason reason);
     void CheckActiveState();
     void TrySignChainTip();
     void EnforceBestChainLock();
@@ -110,7 +177,11 @@ private:
 
     void DoInvalidateBlock(const CBlockIndex* pindex, bool activateBestChain);
 
-    BlockTxs::mapped_type GetBlockTxs(const uint256& blockHash);
+    BlockTxsWrite AddBlockTx(const CBlockIndex* pindex, const uint256* txid, bool keepInMemory);
+    BlockTxsWrite FinishBlockTxs();
+    void WriteBlockTxs(const BlockTxsWrite& blockTxsWrite);
+    BlockTxsPtr GetBlockTxs(const CBlockIndex* pindex);
+    void CleanupBlockTxsDb(int tipHeight);
 
     void Cleanup();
 };
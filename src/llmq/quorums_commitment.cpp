@@ -7,6 +7,7 @@
 #include "quorums_commitment.h"
 #include "quorums_utils.h"
 
+#include "bls/bls_sigcache.h"
 #include "chainparams.h"
 #include "validation.h"
 
@@ -81,7 +82,8 @@ bool CFinalCommitment::Verify(const std::vector<CDeterministicMNCPtr>& members,
         }
     }
 
-    // sigs are only checked when the block is processed
+    // sigs are only checked when the block is processed. The signature cache makes sure that a commitment which was
+    // already verified when it was relayed doesn't need the pairings again at block connect
     if (checkSigs) {
         uint256 commitmentHash = CLLMQUtils::BuildCommitmentHash((uint8_t)params.type, quorumHash, validMembers, quorumPublicKey, quorumVvecHash);
 
@@ -93,12 +95,12 @@ bool CFinalCommitment::Verify(const std::vector<CDeterministicMNCPtr>& members,
             memberPubKeys.emplace_back(members[i]->pdmnState->pubKeyOperator.Get());
         }
 
-        if (!membersSig.VerifySecureAggregated(memberPubKeys, commitmentHash)) {
+        if (!VerifySecureAggregatedBLSSigCached(membersSig, memberPubKeys, commitmentHash)) {
             LogPrintfFinalCommitment("invalid aggregated members signature\n");
             return false;
         }
 
-        if (!quorumSig.VerifyInsecure(quorumPublicKey, commitmentHash)) {
+        if (!VerifyBLSSigCached(quorumSig, quorumPublicKey, commitmentHash)) {
             LogPrintfFinalCommitment("invalid quorum signature\n");
             return false;
         }
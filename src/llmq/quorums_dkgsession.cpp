@@ -310,8 +310,6 @@ void CDKGSession::ReceiveMessage(const uint256& hash, const CDKGContribution& qc
 
     logger.Batch("received and relayed contribution. received=%d/%d, time=%d", receivedCount, members.size(), t1.count());
 
-    cxxtimer::Timer t2(true);
-
     if (!AreWeMember()) {
         // can't further validate
         return;
@@ -319,41 +317,16 @@ void CDKGSession::ReceiveMessage(const uint256& hash, const CDKGContribution& qc
 
 	dkgManager.WriteVerifiedVvecContribution(params.type, pindexQuorum, qc.proTxHash, qc.vvec);
 
-    bool complain = false;
-    CBLSSecretKey skContribution;
-    if (!qc.contributions->Decrypt(myIdx, *activeMasternodeInfo.blsKeyOperator, skContribution, PROTOCOL_VERSION)) {
-        logger.Batch("contribution from %s could not be decrypted", member->dmn->proTxHash.ToString());
-        complain = true;
-    } else if (member->idx != myIdx && ShouldSimulateError("complain-lie")) {
-        logger.Batch("lying/complaining for %s", member->dmn->proTxHash.ToString());
-        complain = true;
-    }
-
-    if (complain) {
-        member->weComplain = true;
-        quorumDKGDebugManager->UpdateLocalMemberStatus(params.type, member->idx, [&](CDKGDebugMemberStatus& status) {
-            status.weComplain = true;
-            return true;
-        });
-        return;
-    }
-
-    logger.Batch("decrypted our contribution share. time=%d", t2.count());
-
-    bool verifyPending = false;
-    receivedSkContributions[member->idx] = skContribution;
-    pendingContributionVerifications.emplace_back(member->idx);
+    // decryption is deferred to VerifyPendingContributions, so that it can be done in parallel for multiple members
+    pendingContributionVerifications.emplace_back(member->idx, qc.contributions);
     if (pendingContributionVerifications.size() >= 32) {
-        verifyPending = true;
-    }
-
-    if (verifyPending) {
         VerifyPendingContributions();
     }
 }
 
-// Verifies all pending secret key contributions in one batch
-// This is done by aggregating the verification vectors belonging to the secret key contributions
+// Decrypts and verifies all pending secret key contributions in one batch
+// Decryption is performed in parallel on the BLS worker
+// Verification is done by aggregating the verification vectors belonging to the secret key contributions
 // The resulting aggregated vvec is then used to recover a public key share
 // The public key share must match the public key belonging to the aggregated secret key contributions
 // See CBLSWorker::VerifyContributionShares for more details.
@@ -363,23 +336,59 @@ void CDKGSession::VerifyPendingContributions()
 
     cxxtimer::Timer t1(true);
 
-    std::vector<size_t> pend = std::move(pendingContributionVerifications);
+    auto pend = std::move(pendingContributionVerifications);
     if (pend.empty()) {
         return;
     }
 
+    std::vector<size_t> decryptIndexes;
+    std::vector<std::shared_ptr<CBLSIESMultiRecipientObjects<CBLSSecretKey>>> encryptedContributions;
+    for (const auto& p : pend) {
+        auto& m = members[p.first];
+        if (m->bad || m->weComplain) {
+            continue;
+        }
+        decryptIndexes.emplace_back(p.first);
+        encryptedContributions.emplace_back(p.second);
+    }
+
+    auto decrypted = blsWorker.DecryptContributions(encryptedContributions, myIdx, *activeMasternodeInfo.blsKeyOperator, PROTOCOL_VERSION);
+
+    logger.Batch("decrypted %d pending contributions. time=%d", decryptIndexes.size(), t1.count());
+
     std::vector<size_t> memberIndexes;
     std::vector<BLSVerificationVectorPtr> vvecs;
     BLSSecretKeyVector skContributions;
 
-    for (const auto& idx : pend) {
-        auto& m = members[idx];
-        if (m->bad || m->weComplain) {
+    for (size_t i = 0; i < decryptIndexes.size(); i++) {
+        auto& m = members[decryptIndexes[i]];
+
+        bool complain = false;
+        if (!decrypted[i].IsValid()) {
+            logger.Batch("contribution from %s could not be decrypted", m->dmn->proTxHash.ToString());
+            complain = true;
+        } else if (m->idx != myIdx && ShouldSimulateError("complain-lie")) {
+            logger.Batch("lying/complaining for %s", m->dmn->proTxHash.ToString());
+            complain = true;
+        }
+
+        if (complain) {
+            m->weComplain = true;
+            quorumDKGDebugManager->UpdateLocalMemberStatus(params.type, m->idx, [&](CDKGDebugMemberStatus& status) {
+                status.weComplain = true;
+                return true;
+            });
             continue;
         }
-        memberIndexes.emplace_back(idx);
-        vvecs.emplace_back(receivedVvecs[idx]);
-        skContributions.emplace_back(receivedSkContributions[idx]);
+
+        receivedSkContributions[m->idx] = decrypted[i];
+        memberIndexes.emplace_back(m->idx);
+        vvecs.emplace_back(receivedVvecs[m->idx]);
+        skContributions.emplace_back(decrypted[i]);
+    }
+
+    if (memberIndexes.empty()) {
+        return;
     }
 
     auto result = blsWorker.VerifyContributionShares(myId, vvecs, skContributions);
@@ -279,7 +279,8 @@ private:
     std::map<uint256, CDKGPrematureCommitment> prematureCommitments;
     std::set<CInv> invSet;
 
-    std::vector<size_t> pendingContributionVerifications;
+    // member index and encrypted contributions of all received contributions which were not decrypted/verified yet
+    std::vector<std::pair<size_t, std::shared_ptr<CBLSIESMultiRecipientObjects<CBLSSecretKey>>>> pendingContributionVerifications;
 
     // filled by ReceivePrematureCommitment and used by FinalizeCommitments
     std::set<uint256> validCommitments;
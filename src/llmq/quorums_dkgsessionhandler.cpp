@@ -14,6 +14,7 @@
 #include "chainparams.h"
 #include "init.h"
 #include "net_processing.h"
+#include "scheduler.h"
 #include "validation.h"
 
 namespace llmq
@@ -85,9 +86,10 @@ void CDKGPendingMessages::Clear()
 
 //////
 
-CDKGSessionHandler::CDKGSessionHandler(const Consensus::LLMQParams& _params, ctpl::thread_pool& _messageHandlerPool, CBLSWorker& _blsWorker, CDKGSessionManager& _dkgManager) :
+CDKGSessionHandler::CDKGSessionHandler(const Consensus::LLMQParams& _params, ctpl::thread_pool& _messageHandlerPool, CScheduler* _scheduler, CBLSWorker& _blsWorker, CDKGSessionManager& _dkgManager) :
     params(_params),
     messageHandlerPool(_messageHandlerPool),
+    scheduler(_scheduler),
     blsWorker(_blsWorker),
     dkgManager(_dkgManager),
     curSession(std::make_shared<CDKGSession>(_params, _blsWorker, _dkgManager)),
@@ -96,35 +98,36 @@ CDKGSessionHandler::CDKGSessionHandler(const Consensus::LLMQParams& _params, ctp
     pendingJustifications((size_t)_params.size * 2),
     pendingPrematureCommitments((size_t)_params.size * 2)
 {
-    phaseHandlerThread = std::thread([this] {
-        RenameThread(strprintf("epmcoin-q-phase-%d", (uint8_t)params.type).c_str());
-        PhaseHandlerThread();
-    });
 }
 
 CDKGSessionHandler::~CDKGSessionHandler()
+{
+}
+
+void CDKGSessionHandler::Stop()
 {
     stopRequested = true;
-    if (phaseHandlerThread.joinable()) {
-        phaseHandlerThread.join();
-    }
 }
 
 void CDKGSessionHandler::UpdatedBlockTip(const CBlockIndex* pindexNew)
 {
-    LOCK(cs);
+    {
+        LOCK(cs);
 
-    int quorumStageInt = pindexNew->nHeight % params.dkgInterval;
-    const CBlockIndex* pindexQuorum = pindexNew->GetAncestor(pindexNew->nHeight - quorumStageInt);
+        int quorumStageInt = pindexNew->nHeight % params.dkgInterval;
+        const CBlockIndex* pindexQuorum = pindexNew->GetAncestor(pindexNew->nHeight - quorumStageInt);
 
-    quorumHeight = pindexQuorum->nHeight;
-    quorumHash = pindexQuorum->GetBlockHash();
+        quorumHeight = pindexQuorum->nHeight;
+        quorumHash = pindexQuorum->GetBlockHash();
 
-    bool fNewPhase = (quorumStageInt % params.dkgPhaseBlocks) == 0;
-    int phaseInt = quorumStageInt / params.dkgPhaseBlocks + 1;
-    if (fNewPhase && phaseInt >= QuorumPhase_Initialized && phaseInt <= QuorumPhase_Idle) {
-        phase = static_cast<QuorumPhase>(phaseInt);
+        bool fNewPhase = (quorumStageInt % params.dkgPhaseBlocks) == 0;
+        int phaseInt = quorumStageInt / params.dkgPhaseBlocks + 1;
+        if (fNewPhase && phaseInt >= QuorumPhase_Initialized && phaseInt <= QuorumPhase_Idle) {
+            phase = static_cast<QuorumPhase>(phaseInt);
+        }
     }
+
+    ScheduleStep();
 }
 
 void CDKGSessionHandler::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman)
@@ -138,7 +141,11 @@ void CDKGSessionHandler::ProcessMessage(CNode* pfrom, const std::string& strComm
         pendingJustifications.PushPendingMessage(pfrom->id, vRecv);
     } else if (strCommand == NetMsgType::QPCOMMITMENT) {
         pendingPrematureCommitments.PushPendingMessage(pfrom->id, vRecv);
+    } else {
+        return;
     }
+
+    ScheduleStep();
 }
 
 bool CDKGSessionHandler::InitNewQuorum(const CBlockIndex* pindexQuorum)
@@ -147,7 +154,10 @@ bool CDKGSessionHandler::InitNewQuorum(const CBlockIndex* pindexQuorum)
 
     const auto& consensus = Params().GetConsensus();
 
-    curSession = std::make_shared<CDKGSession>(params, blsWorker, dkgManager);
+    {
+        LOCK(cs);
+        curSession = std::make_shared<CDKGSession>(params, blsWorker, dkgManager);
+    }
 
     if (!FullDIP0003Mode()) return false;
 
@@ -167,105 +177,6 @@ std::pair<QuorumPhase, uint256> CDKGSessionHandler::GetPhaseAndQuorumHash() cons
     return std::make_pair(phase, quorumHash);
 }
 
-class AbortPhaseException : public std::exception {
-};
-
-void CDKGSessionHandler::WaitForNextPhase(QuorumPhase curPhase,
-                                          QuorumPhase nextPhase,
-                                          const uint256& expectedQuorumHash,
-                                          const WhileWaitFunc& runWhileWaiting)
-{
-    while (true) {
-        if (stopRequested || ShutdownRequested()) {
-            throw AbortPhaseException();
-        }
-        auto p = GetPhaseAndQuorumHash();
-        if (!expectedQuorumHash.IsNull() && p.second != expectedQuorumHash) {
-            throw AbortPhaseException();
-        }
-        if (p.first == nextPhase) {
-            break;
-        }
-        if (curPhase != QuorumPhase_None && p.first != curPhase) {
-            throw AbortPhaseException();
-        }
-        if (!runWhileWaiting()) {
-            MilliSleep(100);
-        }
-    }
-
-    if (nextPhase == QuorumPhase_Initialized) {
-        quorumDKGDebugManager->ResetLocalSessionStatus(params.type);
-    } else {
-        quorumDKGDebugManager->UpdateLocalSessionStatus(params.type, [&](CDKGDebugSessionStatus& status) {
-            bool changed = status.phase != (uint8_t) nextPhase;
-            status.phase = (uint8_t) nextPhase;
-            return changed;
-        });
-    }
-}
-
-void CDKGSessionHandler::WaitForNewQuorum(const uint256& oldQuorumHash)
-{
-    while (true) {
-        if (stopRequested || ShutdownRequested()) {
-            throw AbortPhaseException();
-        }
-        auto p = GetPhaseAndQuorumHash();
-        if (p.second != oldQuorumHash) {
-            return;
-        }
-        MilliSleep(100);
-    }
-}
-
-// Sleep some time to not fully overload the whole network
-void CDKGSessionHandler::SleepBeforePhase(QuorumPhase curPhase,
-                                          const uint256& expectedQuorumHash,
-                                          double randomSleepFactor,
-                                          const WhileWaitFunc& runWhileWaiting)
-{
-    // expected time for a full phase
-    double phaseTime = params.dkgPhaseBlocks * Params().GetConsensus().nPowTargetSpacing * 1000;
-    // expected time per member
-    phaseTime = phaseTime / params.size;
-    // Don't expect perfect block times and thus reduce the phase time to be on the secure side (caller chooses factor)
-    phaseTime *= randomSleepFactor;
-
-    if (Params().MineBlocksOnDemand()) {
-        // on regtest, blocks can be mined on demand without any significant time passing between these. We shouldn't
-        // wait before phases in this case
-        phaseTime = 0;
-    }
-
-    int64_t sleepTime = (int64_t)(phaseTime * curSession->GetMyMemberIndex());
-    int64_t endTime = GetTimeMillis() + sleepTime;
-    while (GetTimeMillis() < endTime) {
-        if (stopRequested || ShutdownRequested()) {
-            throw AbortPhaseException();
-        }
-        auto p = GetPhaseAndQuorumHash();
-        if (p.first != curPhase || p.second != expectedQuorumHash) {
-            throw AbortPhaseException();
-        }
-        if (!runWhileWaiting()) {
-            MilliSleep(100);
-        }
-    }
-}
-
-void CDKGSessionHandler::HandlePhase(QuorumPhase curPhase,
-                                     QuorumPhase nextPhase,
-                                     const uint256& expectedQuorumHash,
-                                     double randomSleepFactor,
-                                     const StartPhaseFunc& startPhaseFunc,
-                                     const WhileWaitFunc& runWhileWaiting)
-{
-    SleepBeforePhase(curPhase, expectedQuorumHash, randomSleepFactor, runWhileWaiting);
-    startPhaseFunc();
-    WaitForNextPhase(curPhase, nextPhase, expectedQuorumHash, runWhileWaiting);
-}
-
 // returns a set of NodeIds which sent invalid messages
 template<typename Message>
 std::set<NodeId> BatchVerifyMessageSigs(CDKGSession& session, const std::vector<std::pair<NodeId, std::shared_ptr<Message>>>& messages)
@@ -438,33 +349,155 @@ bool ProcessPendingMessageBatch(CDKGSession& session, CDKGPendingMessages& pendi
     return true;
 }
 
-void CDKGSessionHandler::HandleDKGRound()
+template bool ProcessPendingMessageBatch<CDKGContribution>(CDKGSession& session, CDKGPendingMessages& pendingMessages, size_t maxCount);
+template bool ProcessPendingMessageBatch<CDKGComplaint>(CDKGSession& session, CDKGPendingMessages& pendingMessages, size_t maxCount);
+template bool ProcessPendingMessageBatch<CDKGJustification>(CDKGSession& session, CDKGPendingMessages& pendingMessages, size_t maxCount);
+template bool ProcessPendingMessageBatch<CDKGPrematureCommitment>(CDKGSession& session, CDKGPendingMessages& pendingMessages, size_t maxCount);
+
+void CDKGSessionHandler::ScheduleStep()
+{
+    LOCK(cs);
+    if (stopRequested) {
+        return;
+    }
+    if (stepRunning) {
+        // let the running step do another iteration
+        stepRequested = true;
+        return;
+    }
+    if (stepQueued) {
+        return;
+    }
+    stepQueued = true;
+    messageHandlerPool.push([this](int threadId) {
+        RunSteps();
+    });
+}
+
+void CDKGSessionHandler::ScheduleStepAt(int64_t nTime)
 {
-    uint256 curQuorumHash;
-    int curQuorumHeight;
+    {
+        LOCK(cs);
+        if (scheduledStepTime == nTime) {
+            return;
+        }
+        scheduledStepTime = nTime;
+    }
 
-    WaitForNextPhase(QuorumPhase_None, QuorumPhase_Initialized, uint256(), []{return false;});
+    // there is no way to unschedule, so the step will simply find nothing to do if the session moved on in the meantime
+    scheduler->scheduleFromNow([this]() {
+        ScheduleStep();
+    }, std::max(nTime - GetTimeMillis(), (int64_t)0));
+}
 
+void CDKGSessionHandler::RunSteps()
+{
+    {
+        LOCK(cs);
+        stepQueued = false;
+        stepRunning = true;
+        stepRequested = false;
+    }
+
+    while (true) {
+        Step();
+
+        LOCK(cs);
+        if (!stepRequested || stopRequested) {
+            stepRunning = false;
+            return;
+        }
+        stepRequested = false;
+    }
+}
+
+void CDKGSessionHandler::Step()
+{
+    if (stopRequested || ShutdownRequested()) {
+        return;
+    }
+
+    auto p = GetPhaseAndQuorumHash();
+    QuorumPhase curPhase = p.first;
+    const uint256& curQuorumHash = p.second;
+
+    if (sessionPhase != QuorumPhase_Idle && curQuorumHash != sessionQuorumHash) {
+        AbortSession();
+    }
+
+    if (sessionPhase == QuorumPhase_Idle) {
+        // wait for the next DKG round to start
+        if (curPhase != QuorumPhase_Initialized || curQuorumHash == sessionQuorumHash) {
+            return;
+        }
+        if (!StartNewSession(curQuorumHash)) {
+            return;
+        }
+    }
+
+    if (ProcessPendingMessages(sessionPhase)) {
+        // there might be more messages. Handle them in the next step so that other LLMQ types are not blocked
+        ScheduleStep();
+    }
+
+    while (true) {
+        if (curPhase == sessionPhase) {
+            if (!phaseActionDone) {
+                if (GetTimeMillis() < phaseActionTime) {
+                    ScheduleStepAt(phaseActionTime);
+                    return;
+                }
+                RunPhaseAction(sessionPhase);
+                phaseActionDone = true;
+                // the phase action might have queued our own messages
+                ScheduleStep();
+            }
+            return;
+        }
+
+        if (phaseActionDone && curPhase == sessionPhase + 1) {
+            EnterPhase(curPhase);
+            if (sessionPhase == QuorumPhase_Finalize) {
+                auto finalCommitments = curSession->FinalizeCommitments();
+                for (const auto& fqc : finalCommitments) {
+                    quorumBlockProcessor->AddMinableCommitment(fqc);
+                }
+                sessionPhase = QuorumPhase_Idle;
+                return;
+            }
+            continue;
+        }
+
+        // we either missed a phase, the chain went backwards or we did not manage to execute the phase action in time
+        AbortSession();
+        return;
+    }
+}
+
+bool CDKGSessionHandler::StartNewSession(const uint256& newQuorumHash)
+{
     {
         LOCK(cs);
         pendingContributions.Clear();
         pendingComplaints.Clear();
         pendingJustifications.Clear();
         pendingPrematureCommitments.Clear();
-        curQuorumHash = quorumHash;
-        curQuorumHeight = quorumHeight;
     }
 
+    quorumDKGDebugManager->ResetLocalSessionStatus(params.type);
+
+    sessionQuorumHash = newQuorumHash;
+
 	const CBlockIndex* pindexQuorum;
 	{
 		LOCK(cs_main);
-		pindexQuorum = mapBlockIndex.at(curQuorumHash);
+		pindexQuorum = mapBlockIndex.at(newQuorumHash);
 	}
 
 	if (!InitNewQuorum(pindexQuorum)) {
-        // should actually never happen
-        WaitForNewQuorum(curQuorumHash);
-        throw AbortPhaseException();
+        // should actually never happen. Wait for the next quorum
+        sessionPhase = QuorumPhase_Idle;
+        return false;
     }
 
     quorumDKGDebugManager->UpdateLocalSessionStatus(params.type, [&](CDKGDebugSessionStatus& status) {
@@ -497,66 +530,109 @@ void CDKGSessionHandler::HandleDKGRound()
                 }
                 LogPrint("llmq-dkg", debugMsg);
             }
-            g_connman->AddMasternodeQuorumNodes(params.type, curQuorumHash, connections);
+            g_connman->AddMasternodeQuorumNodes(params.type, newQuorumHash, connections);
         }
     }
 
-    WaitForNextPhase(QuorumPhase_Initialized, QuorumPhase_Contribute, curQuorumHash, []{return false;});
-
-    // Contribute
-    auto fContributeStart = [this]() {
-        curSession->Contribute(pendingContributions);
-    };
-    auto fContributeWait = [this] {
-        return ProcessPendingMessageBatch<CDKGContribution>(*curSession, pendingContributions, 8);
-    };
-    HandlePhase(QuorumPhase_Contribute, QuorumPhase_Complain, curQuorumHash, 0.05, fContributeStart, fContributeWait);
-
-    // Complain
-    auto fComplainStart = [this]() {
-        curSession->VerifyAndComplain(pendingComplaints);
-    };
-    auto fComplainWait = [this] {
-        return ProcessPendingMessageBatch<CDKGComplaint>(*curSession, pendingComplaints, 8);
-    };
-    HandlePhase(QuorumPhase_Complain, QuorumPhase_Justify, curQuorumHash, 0.05, fComplainStart, fComplainWait);
-
-    // Justify
-    auto fJustifyStart = [this]() {
-        curSession->VerifyAndJustify(pendingJustifications);
-    };
-    auto fJustifyWait = [this] {
-        return ProcessPendingMessageBatch<CDKGJustification>(*curSession, pendingJustifications, 8);
-    };
-    HandlePhase(QuorumPhase_Justify, QuorumPhase_Commit, curQuorumHash, 0.05, fJustifyStart, fJustifyWait);
-
-    // Commit
-    auto fCommitStart = [this]() {
-        curSession->VerifyAndCommit(pendingPrematureCommitments);
-    };
-    auto fCommitWait = [this] {
-        return ProcessPendingMessageBatch<CDKGPrematureCommitment>(*curSession, pendingPrematureCommitments, 8);
-    };
-    HandlePhase(QuorumPhase_Commit, QuorumPhase_Finalize, curQuorumHash, 0.1, fCommitStart, fCommitWait);
-
-    auto finalCommitments = curSession->FinalizeCommitments();
-    for (const auto& fqc : finalCommitments) {
-        quorumBlockProcessor->AddMinableCommitment(fqc);
+    sessionPhase = QuorumPhase_Initialized;
+    // nothing to do in the initialization phase
+    phaseActionDone = true;
+    return true;
+}
+
+void CDKGSessionHandler::AbortSession()
+{
+    quorumDKGDebugManager->UpdateLocalSessionStatus(params.type, [&](CDKGDebugSessionStatus& status) {
+        status.aborted = true;
+        return true;
+    });
+    LogPrint("llmq-dkg", "CDKGSessionHandler::%s -- aborted current DKG session for llmq=%s\n", __func__, params.name);
+
+    // keep sessionQuorumHash, so that we wait for the next quorum
+    sessionPhase = QuorumPhase_Idle;
+}
+
+void CDKGSessionHandler::EnterPhase(QuorumPhase nextPhase)
+{
+    sessionPhase = nextPhase;
+    phaseActionDone = nextPhase == QuorumPhase_Finalize;
+    phaseActionTime = GetTimeMillis() + GetPhaseActionDelay(nextPhase);
+    // messages for the new phase might already be pending
+    ScheduleStep();
+
+    quorumDKGDebugManager->UpdateLocalSessionStatus(params.type, [&](CDKGDebugSessionStatus& status) {
+        bool changed = status.phase != (uint8_t) nextPhase;
+        status.phase = (uint8_t) nextPhase;
+        return changed;
+    });
+}
+
+// Delay the phase action to not fully overload the whole network
+// Members act in the order of their member index, each in its own slot of a small part of the expected phase time.
+// The offset inside the slot is derived from the quorum hash and the member, so that the schedule is deterministic but
+// does not put the start of all slots at the same fixed distance
+int64_t CDKGSessionHandler::GetPhaseActionDelay(QuorumPhase curPhase) const
+{
+    if (!curSession->AreWeMember() || scheduler == nullptr) {
+        return 0;
+    }
+    if (Params().MineBlocksOnDemand()) {
+        // on regtest, blocks can be mined on demand without any significant time passing between these. We shouldn't
+        // wait before phases in this case
+        return 0;
+    }
+
+    // Don't expect perfect block times and thus reduce the phase time to be on the secure side
+    double phaseFactor = curPhase == QuorumPhase_Commit ? 0.1 : 0.05;
+
+    // expected time for a full phase
+    double slotTime = params.dkgPhaseBlocks * Params().GetConsensus().nPowTargetSpacing * 1000 * phaseFactor;
+    // expected time per member
+    slotTime = slotTime / params.size;
+
+    CHashWriter hw(SER_GETHASH, 0);
+    hw << sessionQuorumHash;
+    hw << curSession->myProTxHash;
+    hw << (uint8_t)curPhase;
+    double slotOffset = (hw.GetHash().GetCheapHash() % 1000) / 1000.0;
+
+    return (int64_t)(slotTime * (curSession->GetMyMemberIndex() + slotOffset));
+}
+
+void CDKGSessionHandler::RunPhaseAction(QuorumPhase curPhase)
+{
+    switch (curPhase) {
+        case QuorumPhase_Contribute:
+            curSession->Contribute(pendingContributions);
+            break;
+        case QuorumPhase_Complain:
+            curSession->VerifyAndComplain(pendingComplaints);
+            break;
+        case QuorumPhase_Justify:
+            curSession->VerifyAndJustify(pendingJustifications);
+            break;
+        case QuorumPhase_Commit:
+            curSession->VerifyAndCommit(pendingPrematureCommitments);
+            break;
+        default:
+            break;
     }
 }
 
-void CDKGSessionHandler::PhaseHandlerThread()
+// Processes a single batch of pending messages for the given phase. Returns true if there might be more messages
+bool CDKGSessionHandler::ProcessPendingMessages(QuorumPhase curPhase)
 {
-    while (!stopRequested && !ShutdownRequested()) {
-        try {
-            HandleDKGRound();
-        } catch (AbortPhaseException& e) {
-            quorumDKGDebugManager->UpdateLocalSessionStatus(params.type, [&](CDKGDebugSessionStatus& status) {
-                status.aborted = true;
-                return true;
-            });
-            LogPrint("llmq-dkg", "CDKGSessionHandler::%s -- aborted current DKG session for llmq=%s\n", __func__, params.name);
-        }
+    switch (curPhase) {
+        case QuorumPhase_Contribute:
+            return ProcessPendingMessageBatch<CDKGContribution>(*curSession, pendingContributions, 8);
+        case QuorumPhase_Complain:
+            return ProcessPendingMessageBatch<CDKGComplaint>(*curSession, pendingComplaints, 8);
+        case QuorumPhase_Justify:
+            return ProcessPendingMessageBatch<CDKGJustification>(*curSession, pendingJustifications, 8);
+        case QuorumPhase_Commit:
+            return ProcessPendingMessageBatch<CDKGPrematureCommitment>(*curSession, pendingPrematureCommitments, 8);
+        default:
+            return false;
     }
 }
 
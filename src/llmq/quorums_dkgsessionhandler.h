@@ -13,6 +13,8 @@
 
 #include "ctpl.h"
 
+class CScheduler;
+
 namespace llmq
 {
 
@@ -30,8 +32,8 @@ enum QuorumPhase {
 /**
  * Acts as a FIFO queue for incoming DKG messages. The reason we need this is that deserialization of these messages
  * is too slow to be processed in the main message handler thread. So, instead of processing them directly from the
- * main handler thread, we push them into a CDKGPendingMessages object and later pop+deserialize them in the DKG phase
- * handler thread.
+ * main handler thread, we push them into a CDKGPendingMessages object and later pop+deserialize them in the steps of
+ * the DKG session handler.
  *
  * Each message type has it's own instance of this class.
  */
@@ -91,8 +93,10 @@ public:
 /**
  * Handles multiple sequential sessions of one specific LLMQ type. There is one instance of this class per LLMQ type.
  *
- * It internally starts the phase handler thread, which constantly loops and sequentially processes one session at a
- * time and waiting for the next phase if necessary.
+ * The handler has no thread of its own. It is driven by events (new chain tips, incoming messages and timers for the
+ * send schedule), which all result in a call to ScheduleStep. Steps are executed on the message handler pool that is
+ * shared by all LLMQ types, while the steps of a single handler are never executed concurrently. Each step advances
+ * the local session as far as the current chain phase allows.
  */
 class CDKGSessionHandler
 {
@@ -105,6 +109,7 @@ private:
 
     const Consensus::LLMQParams& params;
     ctpl::thread_pool& messageHandlerPool;
+    CScheduler* scheduler;
     CBLSWorker& blsWorker;
     CDKGSessionManager& dkgManager;
 
@@ -112,7 +117,18 @@ private:
     int quorumHeight{-1};
     uint256 quorumHash;
     std::shared_ptr<CDKGSession> curSession;
-    std::thread phaseHandlerThread;
+
+    // protected by cs. Ensure that at most one step is queued or running at any time
+    bool stepQueued{false};
+    bool stepRunning{false};
+    bool stepRequested{false};
+    int64_t scheduledStepTime{0};
+
+    // state of the local session. Only accessed while executing a step
+    QuorumPhase sessionPhase{QuorumPhase_Idle};
+    uint256 sessionQuorumHash;
+    bool phaseActionDone{false};
+    int64_t phaseActionTime{0};
 
     CDKGPendingMessages pendingContributions;
     CDKGPendingMessages pendingComplaints;
@@ -120,27 +136,37 @@ private:
     CDKGPendingMessages pendingPrematureCommitments;
 
 public:
-    CDKGSessionHandler(const Consensus::LLMQParams& _params, ctpl::thread_pool& _messageHandlerPool, CBLSWorker& blsWorker, CDKGSessionManager& _dkgManager);
+    CDKGSessionHandler(const Consensus::LLMQParams& _params, ctpl::thread_pool& _messageHandlerPool, CScheduler* _scheduler, CBLSWorker& blsWorker, CDKGSessionManager& _dkgManager);
     ~CDKGSessionHandler();
 
     void UpdatedBlockTip(const CBlockIndex *pindexNew);
     void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman);
 
+    void Stop();
+
 private:
 	bool InitNewQuorum(const CBlockIndex* pindexQuorum);
 
     std::pair<QuorumPhase, uint256> GetPhaseAndQuorumHash() const;
 
-    typedef std::function<void()> StartPhaseFunc;
-    typedef std::function<bool()> WhileWaitFunc;
-    void WaitForNextPhase(QuorumPhase curPhase, QuorumPhase nextPhase, const uint256& expectedQuorumHash, const WhileWaitFunc& runWhileWaiting);
-    void WaitForNewQuorum(const uint256& oldQuorumHash);
-    void SleepBeforePhase(QuorumPhase curPhase, const uint256& expectedQuorumHash, double randomSleepFactor, const WhileWaitFunc& runWhileWaiting);
-    void HandlePhase(QuorumPhase curPhase, QuorumPhase nextPhase, const uint256& expectedQuorumHash, double randomSleepFactor, const StartPhaseFunc& startPhaseFunc, const WhileWaitFunc& runWhileWaiting);
-    void HandleDKGRound();
-    void PhaseHandlerThread();
+    void ScheduleStep();
+    void ScheduleStepAt(int64_t nTime);
+    void RunSteps();
+    void Step();
+
+    bool StartNewSession(const uint256& newQuorumHash);
+    void AbortSession();
+    void EnterPhase(QuorumPhase nextPhase);
+    int64_t GetPhaseActionDelay(QuorumPhase curPhase) const;
+    void RunPhaseAction(QuorumPhase curPhase);
+    bool ProcessPendingMessages(QuorumPhase curPhase);
 };
 
+// Pops up to maxCount pending messages, verifies their signatures in one batch and passes the valid ones to the session.
+// Returns true if there might be more messages. Instantiated for all DKG message types
+template<typename Message>
+bool ProcessPendingMessageBatch(CDKGSession& session, CDKGPendingMessages& pendingMessages, size_t maxCount);
+
 }
 
 #endif //EPM_QUORUMS_DKGSESSIONHANDLER_H
@@ -23,9 +23,10 @@ CDKGSessionManager* quorumDKGSessionManager;
 static const std::string DB_VVEC = "qdkg_V";
 static const std::string DB_SKCONTRIB = "qdkg_S";
 
-CDKGSessionManager::CDKGSessionManager(CDBWrapper& _llmqDb, CBLSWorker& _blsWorker) :
+CDKGSessionManager::CDKGSessionManager(CDBWrapper& _llmqDb, CBLSWorker& _blsWorker, CScheduler* _scheduler) :
     llmqDb(_llmqDb),
-    blsWorker(_blsWorker)
+    blsWorker(_blsWorker),
+    scheduler(_scheduler)
 {
 }
 
@@ -38,7 +39,7 @@ void CDKGSessionManager::StartMessageHandlerPool()
     for (const auto& qt : Params().GetConsensus().llmqs) {
         dkgSessionHandlers.emplace(std::piecewise_construct,
                 std::forward_as_tuple(qt.first),
-                std::forward_as_tuple(qt.second, messageHandlerPool, blsWorker, *this));
+                std::forward_as_tuple(qt.second, messageHandlerPool, scheduler, blsWorker, *this));
     }
 
     messageHandlerPool.resize(2);
@@ -47,6 +48,9 @@ void CDKGSessionManager::StartMessageHandlerPool()
 
 void CDKGSessionManager::StopMessageHandlerPool()
 {
+    for (auto& p : dkgSessionHandlers) {
+        p.second.Stop();
+    }
     messageHandlerPool.stop(true);
 }
 
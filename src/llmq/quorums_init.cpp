@@ -33,12 +33,12 @@ void InitLLMQSystem(CEvoDB& evoDb, CScheduler* scheduler, bool unitTests, bool f
 
     quorumDKGDebugManager = new CDKGDebugManager();
     quorumBlockProcessor = new CQuorumBlockProcessor(evoDb);
-    quorumDKGSessionManager = new CDKGSessionManager(*llmqDb, *blsWorker);
+    quorumDKGSessionManager = new CDKGSessionManager(*llmqDb, *blsWorker, scheduler);
     quorumManager = new CQuorumManager(evoDb, *blsWorker, *quorumDKGSessionManager);
-    quorumSigSharesManager = new CSigSharesManager();
+    quorumSigSharesManager = new CSigSharesManager(*blsWorker);
     quorumSigningManager = new CSigningManager(*llmqDb, unitTests);
-    chainLocksHandler = new CChainLocksHandler(scheduler);
-    quorumInstantSendManager = new CInstantSendManager(*llmqDb);
+    chainLocksHandler = new CChainLocksHandler(*llmqDb, scheduler);
+    quorumInstantSendManager = new CInstantSendManager(*llmqDb, *blsWorker);
 }
 
 void DestroyLLMQSystem()
@@ -7,6 +7,7 @@
 #ifndef EPMCOIN_QUORUMS_INIT_H
 #define EPMCOIN_QUORUMS_INIT_H
 
+class CBLSWorker;
 class CDBWrapper;
 class CEvoDB;
 class CScheduler;
@@ -17,6 +18,8 @@ namespace llmq
 // If true, we will connect to all new quorums and watch their communication
 static const bool DEFAULT_WATCH_QUORUMS = false;
 
+extern CBLSWorker* blsWorker;
+
 // Init/destroy LLMQ globals
 void InitLLMQSystem(CEvoDB& evoDb, CScheduler* scheduler, bool unitTests, bool fWipe = false);
 void DestroyLLMQSystem();
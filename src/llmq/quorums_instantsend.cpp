@@ -6,13 +6,16 @@
 
 #include "quorums_chainlocks.h"
 #include "quorums_instantsend.h"
+#include "quorums_latency.h"
 #include "quorums_utils.h"
 
-#include "bls/bls_batchverifier.h"
+#include "bls/bls_sigcache.h"
+#include "bls/bls_worker.h"
 #include "chainparams.h"
 #include "coins.h"
 #include "txmempool.h"
 #include "masternode-sync.h"
+#include "memusage.h"
 #include "net_processing.h"
 #include "spork.h"
 #include "validation.h"
@@ -33,6 +36,12 @@ namespace llmq
 static const std::string INPUTLOCK_REQUESTID_PREFIX = "inlock";
 static const std::string ISLOCK_REQUESTID_PREFIX = "islock";
 
+// Pending ISLOCKs are verified in rounds of at most this many locks, so that a flood of ISLOCKs does not delay other
+// work of the worker thread. Leftovers are handled in the next round right away
+static const size_t MAX_ISLOCKS_PER_ROUND = 1024;
+// Each round is split into batches of this size, which are verified in parallel on the BLS worker pool
+static const size_t ISLOCK_VERIFY_BATCH_SIZE = 32;
+
 CInstantSendManager* quorumInstantSendManager;
 
 uint256 CInstantSendLock::GetRequestId() const
@@ -335,8 +344,167 @@ std::vector<uint256> CInstantSendDb::RemoveChainedInstantSendLocks(const uint256
 
 ////////////////
 
-CInstantSendManager::CInstantSendManager(CDBWrapper& _llmqDb) :
-    db(_llmqDb)
+uint32_t CNonLockedTxsIndex::GetOrAllocSlot(const uint256& txid)
+{
+    auto it = byTxid.find(txid);
+    if (it != byTxid.end()) {
+        return it->second;
+    }
+
+    uint32_t slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        slot = (uint32_t)slots.size();
+        slots.emplace_back();
+    }
+    slots[slot].txid = txid;
+    byTxid.emplace(txid, slot);
+    return slot;
+}
+
+void CNonLockedTxsIndex::FreeSlot(uint32_t slot)
+{
+    auto& e = slots[slot];
+    byTxid.erase(e.txid);
+    e.pindexMined = nullptr;
+    e.tx.reset();
+    e.nTimeFirstSeen = 0;
+    // keep the capacity of the vectors, so that the slot can be reused without new allocations
+    e.children.clear();
+    e.nextSpender.clear();
+    freeSlots.emplace_back(slot);
+}
+
+size_t CNonLockedTxsIndex::GetSpenderInputIndex(uint32_t slot, const COutPoint& outpoint) const
+{
+    const auto& vin = slots[slot].tx->vin;
+    for (size_t i = 0; i < vin.size(); i++) {
+        if (vin[i].prevout == outpoint) {
+            return i;
+        }
+    }
+    assert(false);
+}
+
+void CNonLockedTxsIndex::UnlinkSpender(uint32_t slot, size_t inputIndex)
+{
+    const auto& outpoint = slots[slot].tx->vin[inputIndex].prevout;
+    uint32_t next = slots[slot].nextSpender[inputIndex];
+
+    auto it = bySpentOutpoint.find(outpoint);
+    if (it == bySpentOutpoint.end()) {
+        return;
+    }
+    if (it->second == slot) {
+        if (next == NO_SLOT) {
+            bySpentOutpoint.erase(it);
+        } else {
+            it->second = next;
+        }
+        return;
+    }
+    for (uint32_t cur = it->second; cur != NO_SLOT; ) {
+        auto& curNext = slots[cur].nextSpender[GetSpenderInputIndex(cur, outpoint)];
+        if (curNext == slot) {
+            curNext = next;
+            return;
+        }
+        cur = curNext;
+    }
+}
+
+void CNonLockedTxsIndex::Add(const CTransactionRef& tx, int64_t nTimeFirstSeen)
+{
+    uint32_t slot = GetOrAllocSlot(tx->GetHash());
+    if (slots[slot].tx) {
+        return;
+    }
+    slots[slot].tx = tx;
+    slots[slot].nTimeFirstSeen = nTimeFirstSeen;
+    slots[slot].nextSpender.assign(tx->vin.size(), NO_SLOT);
+
+    for (size_t i = 0; i < tx->vin.size(); i++) {
+        const auto& prevout = tx->vin[i].prevout;
+
+        // this might grow "slots", so don't hold references into it while calling this
+        uint32_t parentSlot = GetOrAllocSlot(prevout.hash);
+        auto& children = slots[parentSlot].children;
+        if (std::find(children.begin(), children.end(), slot) == children.end()) {
+            children.emplace_back(slot);
+        }
+
+        auto it = bySpentOutpoint.emplace(prevout, slot);
+        if (!it.second) {
+            slots[slot].nextSpender[i] = it.first->second;
+            it.first->second = slot;
+        }
+    }
+}
+
+bool CNonLockedTxsIndex::Remove(const uint256& txid, std::vector<uint256>* childrenRet)
+{
+    auto it = byTxid.find(txid);
+    if (it == byTxid.end()) {
+        return false;
+    }
+    uint32_t slot = it->second;
+
+    if (childrenRet) {
+        for (auto childSlot : slots[slot].children) {
+            childrenRet->emplace_back(slots[childSlot].txid);
+        }
+    }
+
+    if (slots[slot].tx) {
+        const auto& vin = slots[slot].tx->vin;
+        for (size_t i = 0; i < vin.size(); i++) {
+            auto jt = byTxid.find(vin[i].prevout.hash);
+            if (jt != byTxid.end()) {
+                auto& parent = slots[jt->second];
+                auto kt = std::find(parent.children.begin(), parent.children.end(), slot);
+                if (kt != parent.children.end()) {
+                    *kt = parent.children.back();
+                    parent.children.pop_back();
+                }
+                if (!parent.tx && parent.children.empty()) {
+                    FreeSlot(jt->second);
+                }
+            }
+
+            UnlinkSpender(slot, i);
+        }
+    }
+
+    FreeSlot(slot);
+    return true;
+}
+
+CNonLockedTxsIndex::Entry* CNonLockedTxsIndex::Get(const uint256& txid)
+{
+    auto it = byTxid.find(txid);
+    if (it == byTxid.end()) {
+        return nullptr;
+    }
+    return &slots[it->second];
+}
+
+size_t CNonLockedTxsIndex::DynamicMemoryUsage() const
+{
+    size_t usage = memusage::DynamicUsage(slots) + memusage::DynamicUsage(freeSlots);
+    usage += memusage::DynamicUsage(byTxid) + memusage::DynamicUsage(bySpentOutpoint);
+    for (const auto& e : slots) {
+        usage += memusage::DynamicUsage(e.children) + memusage::DynamicUsage(e.nextSpender);
+    }
+    return usage;
+}
+
+////////////////
+
+CInstantSendManager::CInstantSendManager(CDBWrapper& _llmqDb, CBLSWorker& _blsWorker) :
+    db(_llmqDb),
+    blsWorker(_blsWorker)
 {
     workInterrupt.reset();
 }
@@ -374,6 +542,7 @@ void CInstantSendManager::Stop()
 void CInstantSendManager::InterruptWorkerThread()
 {
     workInterrupt();
+    workWakeup.Wakeup();
 }
 
 bool CInstantSendManager::ProcessTx(const CTransaction& tx, bool allowReSigning, const Consensus::Params& params)
@@ -716,6 +885,7 @@ void CInstantSendManager::ProcessMessageInstantSendLock(CNode* pfrom, const llmq
             islock.txid.ToString(), hash.ToString(), pfrom->id);
 
     pendingInstantSendLocks.emplace(hash, std::make_pair(pfrom->id, std::move(islock)));
+    workWakeup.Wakeup();
 }
 
 bool CInstantSendManager::PreVerifyInstantSendLock(NodeId nodeId, const llmq::CInstantSendLock& islock, bool& retBan)
@@ -741,10 +911,20 @@ bool CInstantSendManager::PreVerifyInstantSendLock(NodeId nodeId, const llmq::CI
 bool CInstantSendManager::ProcessPendingInstantSendLocks()
 {
     decltype(pendingInstantSendLocks) pend;
+    bool hasMore = false;
 
     {
         LOCK(cs);
-        pend = std::move(pendingInstantSendLocks);
+        if (pendingInstantSendLocks.size() <= MAX_ISLOCKS_PER_ROUND) {
+            pend = std::move(pendingInstantSendLocks);
+        } else {
+            auto it = pendingInstantSendLocks.begin();
+            while (pend.size() < MAX_ISLOCKS_PER_ROUND) {
+                pend.emplace(it->first, std::move(it->second));
+                it = pendingInstantSendLocks.erase(it);
+            }
+            hasMore = true;
+        }
     }
 
     if (pend.empty()) {
@@ -785,13 +965,19 @@ bool CInstantSendManager::ProcessPendingInstantSendLocks()
                     ++it;
                 }
             }
-            // now check against the previous active set and perform banning if this fails
+            // now check against the previous active set and perform banning if this fails. Only the bad ones are
+            // verified again
             ProcessPendingInstantSendLocks(tipHeight - 1, pend, true);
         }
     } else {
         ProcessPendingInstantSendLocks(tipHeight, pend, true);
     }
 
+    if (hasMore) {
+        // make sure the worker thread doesn't wait before handling the rest
+        workWakeup.Wakeup();
+    }
+
     return true;
 }
 
@@ -799,20 +985,32 @@ std::unordered_set<uint256> CInstantSendManager::ProcessPendingInstantSendLocks(
 {
     auto llmqType = Params().GetConsensus().llmqForInstaEPM;
 
-    CBLSBatchVerifier<NodeId, uint256> batchVerifier(false, true, 8);
+    // One entry per ISLOCK that needs verification. Entries are split into fixed size batches which are verified in
+    // parallel on the BLS worker pool. Batches are bisected on failure, so that a single bad ISLOCK doesn't result
+    // in per-sig re-verification of everything else
+    std::vector<uint256> hashes;
+    BLSSignatureVector sigs;
+    BLSPublicKeyVector pubKeys;
+    std::vector<uint256> signHashes;
     std::unordered_map<uint256, std::pair<CQuorumCPtr, CRecoveredSig>> recSigs;
+    // aggregated verification does not support duplicate message hashes, so duplicates are verified separately
+    std::unordered_set<uint256, StaticSaltedHasher> signHashesSeen;
+    std::vector<size_t> batchable;
+    std::vector<size_t> duplicates;
+    // ISLOCKs which were already verified when received from another peer
+    std::vector<size_t> cached;
+
+    std::unordered_set<NodeId> badSources;
+    std::unordered_set<uint256> badISLocks;
 
     for (const auto& p : pend) {
         auto& hash = p.first;
         auto nodeId = p.second.first;
         auto& islock = p.second.second;
 
-        if (batchVerifier.badSources.count(nodeId)) {
-            continue;
-        }
-
         if (!islock.sig.Get().IsValid()) {
-            batchVerifier.badSources.emplace(nodeId);
+            badSources.emplace(nodeId);
+            badISLocks.emplace(hash);
             continue;
         }
 
@@ -823,13 +1021,24 @@ std::unordered_set<uint256> CInstantSendManager::ProcessPendingInstantSendLocks(
             continue;
         }
 
+        // selection results are cached, so this is cheap when we see the same ISLOCK again (e.g. from other peers)
         auto quorum = quorumSigningManager->SelectQuorumForSigning(llmqType, signHeight, id);
         if (!quorum) {
             // should not happen, but if one fails to select, all others will also fail to select
             return {};
         }
         uint256 signHash = CLLMQUtils::BuildSignHash(llmqType, quorum->qc.quorumHash, id, islock.txid);
-        batchVerifier.PushMessage(nodeId, hash, signHash, islock.sig.Get(), quorum->qc.quorumPublicKey);
+        if (IsBLSSigCached(islock.sig.Get(), quorum->qc.quorumPublicKey, signHash)) {
+            cached.emplace_back(hashes.size());
+        } else if (signHashesSeen.emplace(signHash).second) {
+            batchable.emplace_back(hashes.size());
+        } else {
+            duplicates.emplace_back(hashes.size());
+        }
+        hashes.emplace_back(hash);
+        sigs.emplace_back(islock.sig.Get());
+        pubKeys.emplace_back(quorum->qc.quorumPublicKey);
+        signHashes.emplace_back(signHash);
 
         // We can reconstruct the CRecoveredSig objects from the islock and pass it to the signing manager, which
         // avoids unnecessary double-verification of the signature. We however only do this when verification here
@@ -847,13 +1056,49 @@ std::unordered_set<uint256> CInstantSendManager::ProcessPendingInstantSendLocks(
         }
     }
 
-    batchVerifier.Verify();
+    std::vector<bool> valid(hashes.size(), false);
+    std::vector<std::pair<std::vector<size_t>, std::future<std::vector<bool>>>> futures;
+    for (size_t start = 0; start < batchable.size(); start += ISLOCK_VERIFY_BATCH_SIZE) {
+        size_t end = std::min(start + ISLOCK_VERIFY_BATCH_SIZE, batchable.size());
+        std::vector<size_t> idxs(batchable.begin() + start, batchable.begin() + end);
+        BLSSignatureVector batchSigs;
+        BLSPublicKeyVector batchPubKeys;
+        std::vector<uint256> batchSignHashes;
+        for (auto idx : idxs) {
+            batchSigs.emplace_back(sigs[idx]);
+            batchPubKeys.emplace_back(pubKeys[idx]);
+            batchSignHashes.emplace_back(signHashes[idx]);
+        }
+        auto f = blsWorker.AsyncVerifySigsBisect(batchSigs, batchPubKeys, batchSignHashes);
+        futures.emplace_back(std::move(idxs), std::move(f));
+    }
+    for (auto idx : cached) {
+        valid[idx] = true;
+    }
+    for (auto idx : duplicates) {
+        valid[idx] = VerifyBLSSigCached(sigs[idx], pubKeys[idx], signHashes[idx]);
+    }
+    for (auto& f : futures) {
+        auto batchValid = f.second.get();
+        for (size_t i = 0; i < f.first.size(); i++) {
+            auto idx = f.first[i];
+            valid[idx] = batchValid[i];
+            if (valid[idx]) {
+                AddBLSSigToCache(sigs[idx], pubKeys[idx], signHashes[idx]);
+            }
+        }
+    }
 
-    std::unordered_set<uint256> badISLocks;
+    for (size_t i = 0; i < hashes.size(); i++) {
+        if (!valid[i]) {
+            badISLocks.emplace(hashes[i]);
+            badSources.emplace(pend.at(hashes[i]).first);
+        }
+    }
 
-    if (ban && !batchVerifier.badSources.empty()) {
+    if (ban && !badSources.empty()) {
         LOCK(cs_main);
-        for (auto& nodeId : batchVerifier.badSources) {
+        for (auto& nodeId : badSources) {
             // Let's not be too harsh, as the peer might simply be unlucky and might have sent us an old lock which
             // does not validate anymore due to changed quorums
             Misbehaving(nodeId, 20);
@@ -864,10 +1109,9 @@ std::unordered_set<uint256> CInstantSendManager::ProcessPendingInstantSendLocks(
         auto nodeId = p.second.first;
         auto& islock = p.second.second;
 
-        if (batchVerifier.badMessages.count(hash)) {
+        if (badISLocks.count(hash)) {
             LogPrintf("CInstantSendManager::%s -- txid=%s, islock=%s: invalid sig in islock, peer=%d\n", __func__,
                      islock.txid.ToString(), hash.ToString(), nodeId);
-            badISLocks.emplace(hash);
             continue;
         }
 
@@ -950,6 +1194,11 @@ void CInstantSendManager::ProcessInstantSendLock(NodeId from, const uint256& has
             db.WriteInstantSendLockMined(hash, pindexMined->nHeight);
         }
 
+        auto nonLockedInfo = nonLockedTxs.Get(islock.txid);
+        if (nonLockedInfo && nonLockedInfo->tx) {
+            latencyStats.Add(LATENCY_ISLOCK, GetTimeMillis() - nonLockedInfo->nTimeFirstSeen);
+        }
+
         // This will also add children TXs to pendingRetryTxs
         RemoveNonLockedTx(islock.txid, true);
     }
@@ -1050,7 +1299,7 @@ void CInstantSendManager::SyncTransaction(const CTransaction& tx, const CBlockIn
     if (!chainlocked && islockHash.IsNull()) {
         // TX is not locked, so make sure it is tracked
         AddNonLockedTx(MakeTransactionRef(tx));
-        nonLockedTxs.at(tx.GetHash()).pindexMined = !isDisconnect ? pindex : nullptr;
+        nonLockedTxs.Get(tx.GetHash())->pindexMined = !isDisconnect ? pindex : nullptr;
     } else {
         // TX is locked, so make sure we don't track it anymore
         RemoveNonLockedTx(tx.GetHash(), true);
@@ -1060,21 +1309,7 @@ void CInstantSendManager::SyncTransaction(const CTransaction& tx, const CBlockIn
 void CInstantSendManager::AddNonLockedTx(const CTransactionRef& tx)
 {
     AssertLockHeld(cs);
-    auto res = nonLockedTxs.emplace(tx->GetHash(), NonLockedTxInfo());
-    auto& info = res.first->second;
-
-    if (!info.tx) {
-        info.tx = tx;
-        for (const auto& in : tx->vin) {
-            nonLockedTxs[in.prevout.hash].children.emplace(tx->GetHash());
-        }
-    }
-
-    if (res.second) {
-        for (auto& in : tx->vin) {
-            nonLockedTxsByInputs.emplace(in.prevout.hash, std::make_pair(in.prevout.n, tx->GetHash()));
-        }
-    }
+    nonLockedTxs.Add(tx, GetTimeMillis());
 
 	LogPrint("instantsend", "CInstantSendManager::%s -- txid=%s\n", __func__,
 		tx->GetHash().ToString());
@@ -1084,45 +1319,21 @@ void CInstantSendManager::RemoveNonLockedTx(const uint256& txid, bool retryChild
 {
     AssertLockHeld(cs);
 
-    auto it = nonLockedTxs.find(txid);
-    if (it == nonLockedTxs.end()) {
+    std::vector<uint256> children;
+    if (!nonLockedTxs.Remove(txid, retryChildren ? &children : nullptr)) {
         return;
     }
-    auto& info = it->second;
 
 	size_t retryChildrenCount = 0;
-    if (retryChildren) {
-        // TX got locked, so we can retry locking children
-        for (auto& childTxid : info.children) {
-            pendingRetryTxs.emplace(childTxid);
-			retryChildrenCount++;
-        }
+    // TX got locked, so we can retry locking children
+    for (auto& childTxid : children) {
+        pendingRetryTxs.emplace(childTxid);
+        retryChildrenCount++;
     }
-
-    if (info.tx) {
-        for (const auto& in : info.tx->vin) {
-            auto jt = nonLockedTxs.find(in.prevout.hash);
-            if (jt != nonLockedTxs.end()) {
-                jt->second.children.erase(txid);
-                if (!jt->second.tx && jt->second.children.empty()) {
-                    nonLockedTxs.erase(jt);
-                }
-            }
-
-            auto its = nonLockedTxsByInputs.equal_range(in.prevout.hash);
-            for (auto kt = its.first; kt != its.second; ) {
-                if (kt->second.first != in.prevout.n) {
-                    ++kt;
-                    continue;
-                } else {
-                    kt = nonLockedTxsByInputs.erase(kt);
-                }
-            }
-        }
+    if (retryChildrenCount != 0) {
+        workWakeup.Wakeup();
     }
 
-    nonLockedTxs.erase(it);
-
 	LogPrint("instantsend", "CInstantSendManager::%s -- txid=%s, retryChildren=%d, retryChildrenCount=%d\n", __func__,
 		txid.ToString(), retryChildren, retryChildrenCount);
 
@@ -1196,13 +1407,13 @@ void CInstantSendManager::HandleFullyConfirmedBlock(const CBlockIndex* pindex)
         // Find all previously unlocked TXs that got locked by this fully confirmed (ChainLock) block and remove them
         // from the nonLockedTxs map. Also collect all children of these TXs and mark them for retrying of IS locking.
         std::vector<uint256> toRemove;
-        for (auto& p : nonLockedTxs) {
-            auto pindexMined = p.second.pindexMined;
+        nonLockedTxs.ForEach([&](const CNonLockedTxsIndex::Entry& info) {
+            auto pindexMined = info.pindexMined;
 
             if (pindexMined && pindex->GetAncestor(pindexMined->nHeight) == pindexMined) {
-                toRemove.emplace_back(p.first);
+                toRemove.emplace_back(info.txid);
             }
-        }
+        });
         for (auto& txid : toRemove) {
             // This will also add children to pendingRetryTxs
             RemoveNonLockedTx(txid, true);
@@ -1253,27 +1464,18 @@ void CInstantSendManager::ResolveBlockConflicts(const uint256& islockHash, const
     {
         LOCK(cs);
         for (auto& in : islock.inputs) {
-            auto its = nonLockedTxsByInputs.equal_range(in.hash);
-            for (auto it = its.first; it != its.second; ++it) {
-                if (it->second.first != in.n) {
-                    continue;
-                }
-                auto& conflictTxid = it->second.second;
+            nonLockedTxs.ForEachSpender(in, [&](const CNonLockedTxsIndex::Entry& info) {
+                auto& conflictTxid = info.txid;
                 if (conflictTxid == islock.txid) {
-                    continue;
-                }
-                auto jt = nonLockedTxs.find(conflictTxid);
-                if (jt == nonLockedTxs.end()) {
-                    continue;
+                    return;
                 }
-                auto& info = jt->second;
                 if (!info.pindexMined || !info.tx) {
-                    continue;
+                    return;
                 }
                 LogPrintf("CInstantSendManager::%s -- txid=%s, islock=%s: mined TX %s with input %s and mined in block %s conflicts with islock\n", __func__,
                           islock.txid.ToString(), islockHash.ToString(), conflictTxid.ToString(), in.ToStringShort(), info.pindexMined->GetBlockHash().ToString());
                 conflicts[info.pindexMined].emplace(conflictTxid, info.tx);
-            }
+            });
         }
     }
 
@@ -1395,11 +1597,11 @@ bool CInstantSendManager::ProcessPendingRetryLockTxs()
         CTransactionRef tx;
         {
             LOCK(cs);
-            auto it = nonLockedTxs.find(txid);
-            if (it == nonLockedTxs.end()) {
+            auto info = nonLockedTxs.Get(txid);
+            if (!info) {
                 continue;
             }
-            tx = it->second.tx;
+            tx = info->tx;
 
             if (!tx) {
                 continue;
@@ -1506,6 +1708,40 @@ size_t CInstantSendManager::GetInstantSendLockCount()
     return db.GetInstantSendLockCount();
 }
 
+UniValue CInstantSendManager::GetMemoryInfo()
+{
+    LOCK(cs);
+
+    size_t creatingUsage = memusage::DynamicUsage(creatingInstantSendLocks) + memusage::DynamicUsage(txToCreatingInstantSendLocks);
+    for (const auto& p : creatingInstantSendLocks) {
+        creatingUsage += memusage::DynamicUsage(p.second.inputs);
+    }
+    size_t pendingUsage = memusage::DynamicUsage(pendingInstantSendLocks);
+    for (const auto& p : pendingInstantSendLocks) {
+        pendingUsage += memusage::DynamicUsage(p.second.second.inputs);
+    }
+
+    std::vector<std::tuple<std::string, size_t, size_t>> entries = {
+        std::make_tuple("nonLockedTxs", nonLockedTxs.size(), nonLockedTxs.DynamicMemoryUsage()),
+        std::make_tuple("inputRequestIds", inputRequestIds.size(), memusage::DynamicUsage(inputRequestIds)),
+        std::make_tuple("creatingInstantSendLocks", creatingInstantSendLocks.size(), creatingUsage),
+        std::make_tuple("pendingInstantSendLocks", pendingInstantSendLocks.size(), pendingUsage),
+        std::make_tuple("pendingRetryTxs", pendingRetryTxs.size(), memusage::DynamicUsage(pendingRetryTxs)),
+    };
+
+    UniValue ret(UniValue::VOBJ);
+    size_t totalBytes = 0;
+    for (const auto& e : entries) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("entries", (int64_t)std::get<1>(e)));
+        obj.push_back(Pair("bytes", (int64_t)std::get<2>(e)));
+        ret.push_back(Pair(std::get<0>(e), obj));
+        totalBytes += std::get<2>(e);
+    }
+    ret.push_back(Pair("totalBytes", (int64_t)totalBytes));
+    return ret;
+}
+
 void CInstantSendManager::WorkThreadMain()
 {
     while (!workInterrupt) {
@@ -1515,7 +1751,9 @@ void CInstantSendManager::WorkThreadMain()
         didWork |= ProcessPendingRetryLockTxs();
 
         if (!didWork) {
-            if (!workInterrupt.sleep_for(std::chrono::milliseconds(100))) {
+            // new ISLOCKs and TXs to retry wake us up, the timeout is only a fallback
+            workWakeup.WaitFor(workInterrupt, std::chrono::milliseconds(100));
+            if (workInterrupt) {
                 return;
             }
         }
@@ -10,9 +10,11 @@
 #include "quorums_signing.h"
 
 #include "coins.h"
+#include "threadinterrupt.h"
 #include "unordered_lru_cache.h"
 #include "primitives/transaction.h"
 
+#include <limits>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -74,14 +76,83 @@ public:
     std::vector<uint256> RemoveChainedInstantSendLocks(const uint256& islockHash, const uint256& txid, int nHeight);
 };
 
+/**
+ * Tracks TXs which are neither IS locked nor ChainLocked, together with their children and the outpoints they spend.
+ * Entries live in a slot arena (a vector with a free list), which is reused when TXs come and go. Children and all
+ * TXs spending the same outpoint are linked through slot numbers, so the only hash maps are the txid and the outpoint
+ * index, which both only store slot numbers. The TXs themselves are shared with the mempool entries.
+ * Pointers and references to entries are only valid until the next call to Add.
+ */
+class CNonLockedTxsIndex
+{
+public:
+    enum : uint32_t { NO_SLOT = std::numeric_limits<uint32_t>::max() };
+
+    struct Entry {
+        uint256 txid;
+        const CBlockIndex* pindexMined{nullptr};
+        // null if the entry only exists because it has non-locked children
+        CTransactionRef tx;
+        // used to measure the latency until the TX gets locked
+        int64_t nTimeFirstSeen{0};
+        // slots of TXs spending outputs of this TX
+        std::vector<uint32_t> children;
+        // one entry per input of tx, pointing to the next TX which spends the same outpoint
+        std::vector<uint32_t> nextSpender;
+    };
+
+private:
+    std::vector<Entry> slots;
+    std::vector<uint32_t> freeSlots;
+    std::unordered_map<uint256, uint32_t, StaticSaltedHasher> byTxid;
+    // first TX spending an outpoint, the others are linked through Entry::nextSpender
+    std::unordered_map<COutPoint, uint32_t, SaltedOutpointHasher> bySpentOutpoint;
+
+public:
+    void Add(const CTransactionRef& tx, int64_t nTimeFirstSeen);
+    // Returns false if txid is unknown. If childrenRet is not null, the txids of all children are added to it
+    bool Remove(const uint256& txid, std::vector<uint256>* childrenRet);
+
+    Entry* Get(const uint256& txid);
+    size_t size() const { return byTxid.size(); }
+
+    template<typename Callback>
+    void ForEach(Callback&& cb) const
+    {
+        for (const auto& p : byTxid) {
+            cb(slots[p.second]);
+        }
+    }
+    template<typename Callback>
+    void ForEachSpender(const COutPoint& outpoint, Callback&& cb) const
+    {
+        auto it = bySpentOutpoint.find(outpoint);
+        for (uint32_t slot = it != bySpentOutpoint.end() ? it->second : NO_SLOT; slot != NO_SLOT; ) {
+            const auto& e = slots[slot];
+            cb(e);
+            slot = e.nextSpender[GetSpenderInputIndex(slot, outpoint)];
+        }
+    }
+
+    size_t DynamicMemoryUsage() const;
+
+private:
+    uint32_t GetOrAllocSlot(const uint256& txid);
+    void FreeSlot(uint32_t slot);
+    size_t GetSpenderInputIndex(uint32_t slot, const COutPoint& outpoint) const;
+    void UnlinkSpender(uint32_t slot, size_t inputIndex);
+};
+
 class CInstantSendManager : public CRecoveredSigsListener
 {
 private:
     CCriticalSection cs;
     CInstantSendDb db;
+    CBLSWorker& blsWorker;
 
     std::thread workThread;
     CThreadInterrupt workInterrupt;
+    CThreadWakeup workWakeup;
 
     /**
      * Request ids of inputs that we signed. Used to determine if a recovered signature belongs to an
@@ -103,18 +174,12 @@ private:
 
     // TXs which are neither IS locked nor ChainLocked. We use this to determine for which TXs we need to retry IS locking
     // of child TXs
-    struct NonLockedTxInfo {
-        const CBlockIndex* pindexMined{nullptr};
-        CTransactionRef tx;
-        std::unordered_set<uint256, StaticSaltedHasher> children;
-    };
-    std::unordered_map<uint256, NonLockedTxInfo, StaticSaltedHasher> nonLockedTxs;
-    std::unordered_multimap<uint256, std::pair<uint32_t, uint256>> nonLockedTxsByInputs;
+    CNonLockedTxsIndex nonLockedTxs;
 
     std::unordered_set<uint256, StaticSaltedHasher> pendingRetryTxs;
 
 public:
-    CInstantSendManager(CDBWrapper& _llmqDb);
+    CInstantSendManager(CDBWrapper& _llmqDb, CBLSWorker& _blsWorker);
     ~CInstantSendManager();
 
     void Start();
@@ -163,6 +228,8 @@ public:
     bool GetInstantSendLockByHash(const uint256& hash, CInstantSendLock& ret);
 
     size_t GetInstantSendLockCount();
+    // Memory usage of the in-memory state, per structure
+    UniValue GetMemoryInfo();
 
     void WorkThreadMain();
 };
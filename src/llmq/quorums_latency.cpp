@@ -0,0 +1,125 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "quorums_latency.h"
+
+#include "tinyformat.h"
+
+#include <algorithm>
+
+namespace llmq
+{
+
+CLatencyStats latencyStats;
+
+const std::array<int64_t, CLatencyHistogram::BUCKET_COUNT - 1> CLatencyHistogram::BUCKET_BOUNDS = {{
+    1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 30000
+}};
+
+void CLatencyHistogram::Add(int64_t nMillis)
+{
+    nMillis = std::max(nMillis, (int64_t)0);
+
+    size_t idx = std::lower_bound(BUCKET_BOUNDS.begin(), BUCKET_BOUNDS.end(), nMillis) - BUCKET_BOUNDS.begin();
+
+    LOCK(cs);
+    buckets[idx]++;
+    if (count == 0 || nMillis < min) {
+        min = nMillis;
+    }
+    if (count == 0 || nMillis > max) {
+        max = nMillis;
+    }
+    count++;
+    sum += nMillis;
+}
+
+void CLatencyHistogram::Reset()
+{
+    LOCK(cs);
+    buckets.fill(0);
+    count = 0;
+    sum = 0;
+    min = 0;
+    max = 0;
+}
+
+int64_t CLatencyHistogram::GetPercentile(double percentile) const
+{
+    AssertLockHeld(cs);
+
+    // we only know the bucket, so this returns its upper bound (or the maximum for the last bucket)
+    uint64_t target = (uint64_t)(percentile * count);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        seen += buckets[i];
+        if (seen > target) {
+            return i < BUCKET_BOUNDS.size() ? std::min(BUCKET_BOUNDS[i], max) : max;
+        }
+    }
+    return max;
+}
+
+UniValue CLatencyHistogram::ToJson() const
+{
+    LOCK(cs);
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("count", (int64_t)count));
+    if (count == 0) {
+        return ret;
+    }
+
+    ret.push_back(Pair("min", min));
+    ret.push_back(Pair("max", max));
+    ret.push_back(Pair("avg", sum / (int64_t)count));
+    ret.push_back(Pair("p50", GetPercentile(0.5)));
+    ret.push_back(Pair("p90", GetPercentile(0.9)));
+    ret.push_back(Pair("p99", GetPercentile(0.99)));
+
+    UniValue bucketsObj(UniValue::VOBJ);
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        if (buckets[i] == 0) {
+            continue;
+        }
+        std::string name = i < BUCKET_BOUNDS.size() ? strprintf("<=%d", BUCKET_BOUNDS[i]) : strprintf(">%d", BUCKET_BOUNDS.back());
+        bucketsObj.push_back(Pair(name, (int64_t)buckets[i]));
+    }
+    ret.push_back(Pair("buckets", bucketsObj));
+
+    return ret;
+}
+
+void CLatencyStats::Add(LatencyType type, int64_t nMillis)
+{
+    histograms[type].Add(nMillis);
+}
+
+void CLatencyStats::Reset()
+{
+    for (auto& h : histograms) {
+        h.Reset();
+    }
+}
+
+UniValue CLatencyStats::ToJson() const
+{
+    UniValue ret(UniValue::VOBJ);
+    for (size_t i = 0; i < LATENCY_COUNT; i++) {
+        ret.push_back(Pair(GetTypeName((LatencyType)i), histograms[i].ToJson()));
+    }
+    return ret;
+}
+
+const char* CLatencyStats::GetTypeName(LatencyType type)
+{
+    switch (type) {
+        case LATENCY_RECOVERED_SIG: return "recsig";
+        case LATENCY_ISLOCK: return "islock";
+        case LATENCY_CHAINLOCK: return "chainlock";
+        default: return "unknown";
+    }
+}
+
+}
@@ -0,0 +1,74 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef EPMCOIN_QUORUMS_LATENCY_H
+#define EPMCOIN_QUORUMS_LATENCY_H
+
+#include "sync.h"
+#include "univalue.h"
+
+#include <array>
+
+namespace llmq
+{
+
+enum LatencyType {
+    // from AsyncSign until the recovered signature is known
+    LATENCY_RECOVERED_SIG,
+    // from the TX being first seen until its ISLOCK is processed
+    LATENCY_ISLOCK,
+    // from a new chain tip until its CLSIG is processed
+    LATENCY_CHAINLOCK,
+
+    LATENCY_COUNT
+};
+
+/**
+ * Histogram of latencies in milliseconds. The buckets grow roughly exponentially so that both local
+ * processing delays and multi-second network round trips can be told apart.
+ */
+class CLatencyHistogram
+{
+public:
+    static const size_t BUCKET_COUNT = 15;
+    // upper bounds (inclusive) of all buckets except the last one, which collects everything above
+    static const std::array<int64_t, BUCKET_COUNT - 1> BUCKET_BOUNDS;
+
+private:
+    mutable CCriticalSection cs;
+    std::array<uint64_t, BUCKET_COUNT> buckets{};
+    uint64_t count{0};
+    int64_t sum{0};
+    int64_t min{0};
+    int64_t max{0};
+
+public:
+    void Add(int64_t nMillis);
+    void Reset();
+
+    UniValue ToJson() const;
+
+private:
+    int64_t GetPercentile(double percentile) const;
+};
+
+class CLatencyStats
+{
+private:
+    std::array<CLatencyHistogram, LATENCY_COUNT> histograms;
+
+public:
+    void Add(LatencyType type, int64_t nMillis);
+    void Reset();
+
+    UniValue ToJson() const;
+
+    static const char* GetTypeName(LatencyType type);
+};
+
+extern CLatencyStats latencyStats;
+
+}
+
+#endif //EPMCOIN_QUORUMS_LATENCY_H
@@ -10,15 +10,18 @@
 
 #include "activemasternode.h"
 #include "bls/bls_batchverifier.h"
+#include "bls/bls_sigcache.h"
 #include "cxxtimer.hpp"
 #include "init.h"
 #include "net_processing.h"
 #include "netmessagemaker.h"
+#include "random.h"
 #include "scheduler.h"
 #include "validation.h"
 
 #include <algorithm>
 #include <limits>
+#include <map>
 #include <unordered_set>
 
 namespace llmq
@@ -38,20 +41,67 @@ UniValue CRecoveredSig::ToJson() const
     return ret;
 }
 
-CRecoveredSigsDb::CRecoveredSigsDb(CDBWrapper& _db) :
-    db(_db)
+CHashBloomFilter::CHashBloomFilter(size_t nBits) :
+    data((nBits + 63) / 64)
+{
+    salt1 = GetRand(std::numeric_limits<uint64_t>::max());
+    salt2 = GetRand(std::numeric_limits<uint64_t>::max());
+}
+
+void CHashBloomFilter::insert(const uint256& hash, uint8_t tweak)
+{
+    // the inputs are already hashes, so we can use their bits directly (double hashing)
+    uint64_t h1 = hash.GetUint64(0) ^ salt1 ^ ((uint64_t)tweak * 0x9E3779B97F4A7C15ULL);
+    uint64_t h2 = (hash.GetUint64(1) ^ salt2) | 1;
+    uint64_t nBits = data.size() * 64;
+    for (int i = 0; i < HASH_FUNCS; i++) {
+        uint64_t bit = (h1 + i * h2) % nBits;
+        data[bit >> 6] |= (uint64_t)1 << (bit & 63);
+    }
+    insertCount++;
+}
+
+bool CHashBloomFilter::contains(const uint256& hash, uint8_t tweak) const
+{
+    uint64_t h1 = hash.GetUint64(0) ^ salt1 ^ ((uint64_t)tweak * 0x9E3779B97F4A7C15ULL);
+    uint64_t h2 = (hash.GetUint64(1) ^ salt2) | 1;
+    uint64_t nBits = data.size() * 64;
+    for (int i = 0; i < HASH_FUNCS; i++) {
+        uint64_t bit = (h1 + i * h2) % nBits;
+        if (!(data[bit >> 6] & ((uint64_t)1 << (bit & 63)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CHashBloomFilter::clear()
+{
+    std::fill(data.begin(), data.end(), 0);
+    insertCount = 0;
+}
+
+CRecoveredSigsDb::CRecoveredSigsDb(CDBWrapper& _db, size_t _bloomFilterMaxElements) :
+    db(_db),
+    bloomFilterMaxElements(_bloomFilterMaxElements)
 {
     if (Params().NetworkIDString() == CBaseChainParams::TESTNET) {
         // TODO this can be completely removed after some time (when we're pretty sure the conversion has been run on most testnet MNs)
-        if (db.Exists(std::string("rs_upgraded"))) {
-            return;
+        if (!db.Exists(std::string("rs_upgraded"))) {
+            ConvertInvalidTimeKeys();
+            AddVoteTimeKeys();
+
+            db.Write(std::string("rs_upgraded"), (uint8_t)1);
         }
+    }
 
-        ConvertInvalidTimeKeys();
-        AddVoteTimeKeys();
+    LOCK(cs);
+    LoadBloomFilters();
+}
 
-        db.Write(std::string("rs_upgraded"), (uint8_t)1);
-    }
+CRecoveredSigsDb::~CRecoveredSigsDb()
+{
+    FlushPendingWrites();
 }
 
 // This converts time values in "rs_t" from host endiannes to big endiannes, which is required to have proper ordering of the keys
@@ -127,8 +177,76 @@ void CRecoveredSigsDb::AddVoteTimeKeys()
     LogPrintf("CRecoveredSigsDb::%s -- added %d rs_vt entries\n", __func__, cnt);
 }
 
+void CRecoveredSigsDb::LoadBloomFilters()
+{
+    AssertLockHeld(cs);
+
+    cxxtimer::Timer t(true);
+
+    sigForIdFilter.clear();
+    sigForSessionFilter.clear();
+    sigForHashFilter.clear();
+
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+
+    // there are 2 "rs_r" keys per recSig and both start with llmqType and id. They are next to each other, so the
+    // second one is skipped to keep the filter at one element per recSig
+    auto start1 = std::make_tuple(std::string("rs_r"), (uint8_t)0, uint256());
+    pcursor->Seek(start1);
+    decltype(start1) lastKey;
+    while (pcursor->Valid()) {
+        decltype(start1) k;
+        if (!pcursor->GetKey(k) || std::get<0>(k) != "rs_r") {
+            break;
+        }
+        if (k != lastKey) {
+            sigForIdFilter.insert(std::get<2>(k), std::get<1>(k));
+            lastKey = k;
+        }
+        pcursor->Next();
+    }
+
+    auto start2 = std::make_tuple(std::string("rs_h"), uint256());
+    pcursor->Seek(start2);
+    while (pcursor->Valid()) {
+        decltype(start2) k;
+        if (!pcursor->GetKey(k) || std::get<0>(k) != "rs_h") {
+            break;
+        }
+        sigForHashFilter.insert(std::get<1>(k));
+        pcursor->Next();
+    }
+
+    auto start3 = std::make_tuple(std::string("rs_s"), uint256());
+    pcursor->Seek(start3);
+    while (pcursor->Valid()) {
+        decltype(start3) k;
+        if (!pcursor->GetKey(k) || std::get<0>(k) != "rs_s") {
+            break;
+        }
+        sigForSessionFilter.insert(std::get<1>(k));
+        pcursor->Next();
+    }
+    pcursor.reset();
+
+    bloomFiltersLoadedCount = GetBloomFilterElementCount();
+
+    LogPrint("llmq", "CRecoveredSigsDb::%s -- loaded %d recSigs into bloom filters. time=%d\n", __func__, sigForHashFilter.inserted(), t.count());
+}
+
 bool CRecoveredSigsDb::HasRecoveredSig(Consensus::LLMQType llmqType, const uint256& id, const uint256& msgHash)
 {
+    {
+        LOCK(cs);
+        auto it = pendingRecSigs.find(std::make_pair(llmqType, id));
+        if (it != pendingRecSigs.end() && it->second.recSig.msgHash == msgHash) {
+            return true;
+        }
+        if (!sigForIdFilter.contains(id, (uint8_t)llmqType)) {
+            return false;
+        }
+    }
+
     auto k = std::make_tuple(std::string("rs_r"), (uint8_t)llmqType, id, msgHash);
     return db.Exists(k);
 }
@@ -142,6 +260,12 @@ bool CRecoveredSigsDb::HasRecoveredSigForId(Consensus::LLMQType llmqType, const
         if (hasSigForIdCache.get(cacheKey, ret)) {
             return ret;
         }
+        if (pendingRecSigs.count(cacheKey)) {
+            return true;
+        }
+        if (!sigForIdFilter.contains(id, (uint8_t)llmqType)) {
+            return false;
+        }
     }
 
 
@@ -161,6 +285,12 @@ bool CRecoveredSigsDb::HasRecoveredSigForSession(const uint256& signHash)
         if (hasSigForSessionCache.get(signHash, ret)) {
             return ret;
         }
+        if (pendingRecSigsBySignHash.count(signHash)) {
+            return true;
+        }
+        if (!sigForSessionFilter.contains(signHash)) {
+            return false;
+        }
     }
 
     auto k = std::make_tuple(std::string("rs_s"), signHash);
@@ -179,6 +309,12 @@ bool CRecoveredSigsDb::HasRecoveredSigForHash(const uint256& hash)
         if (hasSigForHashCache.get(hash, ret)) {
             return ret;
         }
+        if (pendingRecSigsByHash.count(hash)) {
+            return true;
+        }
+        if (!sigForHashFilter.contains(hash)) {
+            return false;
+        }
     }
 
     auto k = std::make_tuple(std::string("rs_h"), hash);
@@ -191,6 +327,15 @@ bool CRecoveredSigsDb::HasRecoveredSigForHash(const uint256& hash)
 
 bool CRecoveredSigsDb::ReadRecoveredSig(Consensus::LLMQType llmqType, const uint256& id, CRecoveredSig& ret)
 {
+    {
+        LOCK(cs);
+        auto it = pendingRecSigs.find(std::make_pair(llmqType, id));
+        if (it != pendingRecSigs.end()) {
+            ret = it->second.recSig;
+            return true;
+        }
+    }
+
     auto k = std::make_tuple(std::string("rs_r"), (uint8_t)llmqType, id);
 
     CDataStream ds(SER_DISK, CLIENT_VERSION);
@@ -208,8 +353,17 @@ bool CRecoveredSigsDb::ReadRecoveredSig(Consensus::LLMQType llmqType, const uint
 
 bool CRecoveredSigsDb::GetRecoveredSigByHash(const uint256& hash, CRecoveredSig& ret)
 {
-    auto k1 = std::make_tuple(std::string("rs_h"), hash);
     std::pair<uint8_t, uint256> k2;
+    {
+        LOCK(cs);
+        auto it = pendingRecSigsByHash.find(hash);
+        if (it != pendingRecSigsByHash.end()) {
+            ret = pendingRecSigs.at(it->second).recSig;
+            return true;
+        }
+    }
+
+    auto k1 = std::make_tuple(std::string("rs_h"), hash);
     if (!db.Read(k1, k2)) {
         return false;
     }
@@ -224,47 +378,122 @@ bool CRecoveredSigsDb::GetRecoveredSigById(Consensus::LLMQType llmqType, const u
 
 void CRecoveredSigsDb::WriteRecoveredSig(const llmq::CRecoveredSig& recSig)
 {
+    auto key = std::make_pair((Consensus::LLMQType)recSig.llmqType, recSig.id);
+    auto signHash = CLLMQUtils::BuildSignHash(recSig);
+
+    LOCK(cs);
+
+    auto it = pendingRecSigs.find(key);
+    if (it != pendingRecSigs.end()) {
+        pendingRecSigsByHash.erase(it->second.recSig.GetHash());
+        pendingRecSigsBySignHash.erase(it->second.signHash);
+    }
+    pendingRecSigs[key] = {recSig, signHash, (uint32_t)GetAdjustedTime()};
+    pendingRecSigsByHash[recSig.GetHash()] = key;
+    pendingRecSigsBySignHash[signHash] = key;
+
+    sigForIdFilter.insert(recSig.id, recSig.llmqType);
+    sigForSessionFilter.insert(signHash);
+    sigForHashFilter.insert(recSig.GetHash());
+
+    hasSigForIdCache.insert(key, true);
+    hasSigForSessionCache.insert(signHash, true);
+    hasSigForHashCache.insert(recSig.GetHash(), true);
+}
+
+void CRecoveredSigsDb::FlushPendingWrites()
+{
+    LOCK(cs);
+    FlushPendingWritesInternal();
+}
+
+size_t CRecoveredSigsDb::GetBloomFilterElementCount()
+{
+    LOCK(cs);
+    return std::max(sigForIdFilter.inserted(), std::max(sigForSessionFilter.inserted(), sigForHashFilter.inserted()));
+}
+
+void CRecoveredSigsDb::FlushPendingWritesInternal()
+{
+    AssertLockHeld(cs);
+
+    if (pendingRecSigs.empty() && pendingVotes.empty()) {
+        return;
+    }
+
     CDBBatch batch(db);
 
-    uint32_t curTime = GetAdjustedTime();
+    // bucket keys must be unique, otherwise we'd overwrite the entries of a previous flush into the same bucket
+    int64_t flushTime = std::max(GetTimeMicros(), lastFlushTime + 1);
+    lastFlushTime = flushTime;
 
-    // we put these close to each other to leverage leveldb's key compaction
-    // this way, the second key can be used for fast HasRecoveredSig checks while the first key stores the recSig
-    auto k1 = std::make_tuple(std::string("rs_r"), recSig.llmqType, recSig.id);
-    auto k2 = std::make_tuple(std::string("rs_r"), recSig.llmqType, recSig.id, recSig.msgHash);
-    batch.Write(k1, recSig);
-    // this key is also used to store the current time, so that we can easily get to the "rs_t" key when we have the id
-    batch.Write(k2, curTime);
+    std::map<uint32_t, std::vector<std::pair<uint8_t, uint256>>> buckets;
+    for (auto& p : pendingRecSigs) {
+        auto& recSig = p.second.recSig;
 
-    // store by object hash
-    auto k3 = std::make_tuple(std::string("rs_h"), recSig.GetHash());
-    batch.Write(k3, std::make_pair(recSig.llmqType, recSig.id));
+        // we put these close to each other to leverage leveldb's key compaction
+        // this way, the second key can be used for fast HasRecoveredSig checks while the first key stores the recSig
+        auto k1 = std::make_tuple(std::string("rs_r"), recSig.llmqType, recSig.id);
+        auto k2 = std::make_tuple(std::string("rs_r"), recSig.llmqType, recSig.id, recSig.msgHash);
+        batch.Write(k1, recSig);
+        // this key is also used to store the write time, so that we can easily check the time bucket when we have the id
+        batch.Write(k2, p.second.writeTime);
 
-    // store by signHash
-    auto signHash = CLLMQUtils::BuildSignHash(recSig);
-    auto k4 = std::make_tuple(std::string("rs_s"), signHash);
-    batch.Write(k4, (uint8_t)1);
+        // store by object hash
+        auto k3 = std::make_tuple(std::string("rs_h"), recSig.GetHash());
+        batch.Write(k3, std::make_pair(recSig.llmqType, recSig.id));
 
-    // store by current time. Allows fast cleanup of old recSigs
-    auto k5 = std::make_tuple(std::string("rs_t"), (uint32_t)htobe32(curTime), recSig.llmqType, recSig.id);
-    batch.Write(k5, (uint8_t)1);
+        // store by signHash
+        auto k4 = std::make_tuple(std::string("rs_s"), p.second.signHash);
+        batch.Write(k4, (uint8_t)1);
 
-    db.WriteBatch(batch);
+        buckets[p.second.writeTime / TIME_BUCKET_SECONDS].emplace_back(recSig.llmqType, recSig.id);
+    }
+    for (auto& b : buckets) {
+        auto k = std::make_tuple(std::string("rs_tb"), (uint32_t)htobe32(b.first), (uint64_t)htobe64(flushTime));
+        batch.Write(k, b.second);
+    }
 
-    {
-        int64_t t = GetTimeMillis();
+    buckets.clear();
+    for (auto& p : pendingVotes) {
+        auto k = std::make_tuple(std::string("rs_v"), (uint8_t)p.first.first, p.first.second);
+        batch.Write(k, p.second.first);
 
-        LOCK(cs);
-        hasSigForIdCache.insert(std::make_pair((Consensus::LLMQType)recSig.llmqType, recSig.id), true);
-        hasSigForSessionCache.insert(signHash, true);
-        hasSigForHashCache.insert(recSig.GetHash(), true);
+        buckets[p.second.second / TIME_BUCKET_SECONDS].emplace_back((uint8_t)p.first.first, p.first.second);
     }
+    for (auto& b : buckets) {
+        auto k = std::make_tuple(std::string("rs_vb"), (uint32_t)htobe32(b.first), (uint64_t)htobe64(flushTime));
+        batch.Write(k, b.second);
+    }
+
+    db.WriteBatch(batch);
+
+    pendingRecSigs.clear();
+    pendingRecSigsByHash.clear();
+    pendingRecSigsBySignHash.clear();
+    pendingVotes.clear();
 }
 
-void CRecoveredSigsDb::RemoveRecoveredSig(CDBBatch& batch, Consensus::LLMQType llmqType, const uint256& id, bool deleteTimeKey)
+void CRecoveredSigsDb::RemoveRecoveredSig(CDBBatch& batch, Consensus::LLMQType llmqType, const uint256& id, bool deleteTimeKey, int64_t onlyInTimeBucket)
 {
     AssertLockHeld(cs);
 
+    auto pendingIt = pendingRecSigs.find(std::make_pair(llmqType, id));
+    if (pendingIt != pendingRecSigs.end()) {
+        if (onlyInTimeBucket != -1) {
+            // it was written again after it got into the bucket that is currently cleaned up
+            return;
+        }
+        auto& recSig = pendingIt->second.recSig;
+        hasSigForIdCache.erase(std::make_pair(llmqType, id));
+        hasSigForSessionCache.erase(pendingIt->second.signHash);
+        hasSigForHashCache.erase(recSig.GetHash());
+        pendingRecSigsByHash.erase(recSig.GetHash());
+        pendingRecSigsBySignHash.erase(pendingIt->second.signHash);
+        pendingRecSigs.erase(pendingIt);
+        return;
+    }
+
     CRecoveredSig recSig;
     if (!ReadRecoveredSig(llmqType, id, recSig)) {
         return;
@@ -276,22 +505,32 @@ void CRecoveredSigsDb::RemoveRecoveredSig(CDBBatch& batch, Consensus::LLMQType l
     auto k2 = std::make_tuple(std::string("rs_r"), recSig.llmqType, recSig.id, recSig.msgHash);
     auto k3 = std::make_tuple(std::string("rs_h"), recSig.GetHash());
     auto k4 = std::make_tuple(std::string("rs_s"), signHash);
-    batch.Erase(k1);
-    batch.Erase(k2);
-    batch.Erase(k3);
-    batch.Erase(k4);
 
-    if (deleteTimeKey) {
+    if (deleteTimeKey || onlyInTimeBucket != -1) {
         CDataStream writeTimeDs(SER_DISK, CLIENT_VERSION);
+        uint32_t writeTime = 0;
         // TODO remove the size() == sizeof(uint32_t) in a future version (when we stop supporting upgrades from < 0.14.1)
-        if (db.ReadDataStream(k2, writeTimeDs) && writeTimeDs.size() == sizeof(uint32_t)) {
-            uint32_t writeTime;
+        bool hasWriteTime = db.ReadDataStream(k2, writeTimeDs) && writeTimeDs.size() == sizeof(uint32_t);
+        if (hasWriteTime) {
             writeTimeDs >> writeTime;
+        }
+        if (onlyInTimeBucket != -1 && (!hasWriteTime || writeTime / TIME_BUCKET_SECONDS != onlyInTimeBucket)) {
+            // the recSig was removed and written again later, so it belongs to another bucket
+            return;
+        }
+        if (deleteTimeKey && hasWriteTime) {
+            // only recSigs written by older versions have these keys. Newer ones are in time buckets, which are
+            // skipped in cleanup when the recSig is gone
             auto k5 = std::make_tuple(std::string("rs_t"), (uint32_t) htobe32(writeTime), recSig.llmqType, recSig.id);
             batch.Erase(k5);
         }
     }
 
+    batch.Erase(k1);
+    batch.Erase(k2);
+    batch.Erase(k3);
+    batch.Erase(k4);
+
     hasSigForIdCache.erase(std::make_pair((Consensus::LLMQType)recSig.llmqType, recSig.id));
     hasSigForSessionCache.erase(signHash);
     hasSigForHashCache.erase(recSig.GetHash());
@@ -305,7 +544,8 @@ void CRecoveredSigsDb::RemoveRecoveredSig(Consensus::LLMQType llmqType, const ui
     db.WriteBatch(batch);
 }
 
-void CRecoveredSigsDb::CleanupOldRecoveredSigs(int64_t maxAge)
+// Cleans up "rs_t" keys, which were written per recSig by older versions
+void CRecoveredSigsDb::CleanupLegacyTimeKeys(int64_t maxAge)
 {
     std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
 
@@ -356,34 +596,113 @@ void CRecoveredSigsDb::CleanupOldRecoveredSigs(int64_t maxAge)
 
     db.WriteBatch(batch);
 
-    LogPrint("llmq", "CRecoveredSigsDb::%d -- deleted %d entries\n", __func__, toDelete.size());
+    LogPrint("llmq", "CRecoveredSigsDb::%s -- deleted %d legacy entries\n", __func__, toDelete.size());
+}
+
+void CRecoveredSigsDb::CleanupOldRecoveredSigs(int64_t maxAge)
+{
+    CleanupLegacyTimeKeys(maxAge);
+
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+
+    auto start = std::make_tuple(std::string("rs_tb"), (uint32_t)0, (uint64_t)0);
+    uint32_t endBucket = (uint32_t)(GetAdjustedTime() - maxAge) / TIME_BUCKET_SECONDS;
+    pcursor->Seek(start);
+
+    // only whole buckets are deleted, so we only need to visit the bucket keys here and not every single recSig
+    std::vector<std::pair<decltype(start), std::vector<std::pair<uint8_t, uint256>>>> toDelete;
+    size_t cnt = 0;
+    while (pcursor->Valid()) {
+        decltype(start) k;
+
+        if (!pcursor->GetKey(k) || std::get<0>(k) != "rs_tb") {
+            break;
+        }
+        if (be32toh(std::get<1>(k)) >= endBucket) {
+            break;
+        }
+
+        std::vector<std::pair<uint8_t, uint256>> entries;
+        if (pcursor->GetValue(entries)) {
+            cnt += entries.size();
+        }
+        toDelete.emplace_back(k, std::move(entries));
+
+        pcursor->Next();
+    }
+    pcursor.reset();
+
+    if (toDelete.empty()) {
+        return;
+    }
+
+    CDBBatch batch(db);
+    {
+        LOCK(cs);
+        for (auto& p : toDelete) {
+            uint32_t bucket = be32toh(std::get<1>(p.first));
+            for (auto& e : p.second) {
+                RemoveRecoveredSig(batch, (Consensus::LLMQType)e.first, e.second, false, bucket);
+            }
+            batch.Erase(p.first);
+
+            if (batch.SizeEstimate() >= (1 << 24)) {
+                db.WriteBatch(batch);
+                batch.Clear();
+            }
+        }
+        db.WriteBatch(batch);
+
+        // the bloom filters can't forget removed recSigs, so rebuild them when they hold more elements than they were
+        // sized for. If the DB itself holds that many recSigs, only rebuild again after a quarter of that was added.
+        // Pending writes are flushed first, as the filters are rebuilt from the DB
+        size_t bloomFilterElementCount = GetBloomFilterElementCount();
+        if (bloomFilterElementCount > bloomFilterMaxElements &&
+            bloomFilterElementCount - bloomFiltersLoadedCount >= bloomFilterMaxElements / 4) {
+            FlushPendingWritesInternal();
+            LoadBloomFilters();
+        }
+    }
+
+    LogPrint("llmq", "CRecoveredSigsDb::%s -- deleted %d entries in %d buckets\n", __func__, cnt, toDelete.size());
 }
 
 bool CRecoveredSigsDb::HasVotedOnId(Consensus::LLMQType llmqType, const uint256& id)
 {
+    {
+        LOCK(cs);
+        if (pendingVotes.count(std::make_pair(llmqType, id))) {
+            return true;
+        }
+    }
+
     auto k = std::make_tuple(std::string("rs_v"), (uint8_t)llmqType, id);
     return db.Exists(k);
 }
 
 bool CRecoveredSigsDb::GetVoteForId(Consensus::LLMQType llmqType, const uint256& id, uint256& msgHashRet)
 {
+    {
+        LOCK(cs);
+        auto it = pendingVotes.find(std::make_pair(llmqType, id));
+        if (it != pendingVotes.end()) {
+            msgHashRet = it->second.first;
+            return true;
+        }
+    }
+
     auto k = std::make_tuple(std::string("rs_v"), (uint8_t)llmqType, id);
     return db.Read(k, msgHashRet);
 }
 
 void CRecoveredSigsDb::WriteVoteForId(Consensus::LLMQType llmqType, const uint256& id, const uint256& msgHash)
 {
-    auto k1 = std::make_tuple(std::string("rs_v"), (uint8_t)llmqType, id);
-    auto k2 = std::make_tuple(std::string("rs_vt"), (uint32_t)htobe32(GetAdjustedTime()), (uint8_t)llmqType, id);
-
-    CDBBatch batch(db);
-    batch.Write(k1, msgHash);
-    batch.Write(k2, (uint8_t)1);
-
-    db.WriteBatch(batch);
+    LOCK(cs);
+    pendingVotes[std::make_pair(llmqType, id)] = std::make_pair(msgHash, (uint32_t)GetAdjustedTime());
 }
 
-void CRecoveredSigsDb::CleanupOldVotes(int64_t maxAge)
+// Cleans up "rs_vt" keys, which were written per vote by older versions
+void CRecoveredSigsDb::CleanupLegacyVoteTimeKeys(int64_t maxAge)
 {
     std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
 
@@ -421,7 +740,53 @@ void CRecoveredSigsDb::CleanupOldVotes(int64_t maxAge)
 
     db.WriteBatch(batch);
 
-    LogPrint("llmq", "CRecoveredSigsDb::%d -- deleted %d entries\n", __func__, cnt);
+    LogPrint("llmq", "CRecoveredSigsDb::%s -- deleted %d legacy entries\n", __func__, cnt);
+}
+
+void CRecoveredSigsDb::CleanupOldVotes(int64_t maxAge)
+{
+    CleanupLegacyVoteTimeKeys(maxAge);
+
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+
+    auto start = std::make_tuple(std::string("rs_vb"), (uint32_t)0, (uint64_t)0);
+    uint32_t endBucket = (uint32_t)(GetAdjustedTime() - maxAge) / TIME_BUCKET_SECONDS;
+    pcursor->Seek(start);
+
+    CDBBatch batch(db);
+    size_t cnt = 0;
+    size_t bucketCnt = 0;
+    while (pcursor->Valid()) {
+        decltype(start) k;
+
+        if (!pcursor->GetKey(k) || std::get<0>(k) != "rs_vb") {
+            break;
+        }
+        if (be32toh(std::get<1>(k)) >= endBucket) {
+            break;
+        }
+
+        std::vector<std::pair<uint8_t, uint256>> entries;
+        if (pcursor->GetValue(entries)) {
+            for (auto& e : entries) {
+                batch.Erase(std::make_tuple(std::string("rs_v"), e.first, e.second));
+            }
+            cnt += entries.size();
+        }
+        batch.Erase(k);
+        bucketCnt++;
+
+        pcursor->Next();
+    }
+    pcursor.reset();
+
+    if (bucketCnt == 0) {
+        return;
+    }
+
+    db.WriteBatch(batch);
+
+    LogPrint("llmq", "CRecoveredSigsDb::%s -- deleted %d entries in %d buckets\n", __func__, cnt, bucketCnt);
 }
 
 //////////////////
@@ -429,6 +794,9 @@ void CRecoveredSigsDb::CleanupOldVotes(int64_t maxAge)
 CSigningManager::CSigningManager(CDBWrapper& llmqDb, bool fMemory) :
     db(llmqDb)
 {
+    for (const auto& p : Params().GetConsensus().llmqs) {
+        activeQuorumTables.emplace(p.first, nullptr);
+    }
 }
 
 bool CSigningManager::AlreadyHave(const CInv& inv)
@@ -478,8 +846,12 @@ void CSigningManager::ProcessMessageRecoveredSig(CNode* pfrom, const CRecoveredS
 	LogPrint("llmq", "CSigningManager::%s -- signHash=%s, id=%s, msgHash=%s, node=%d\n", __func__,
 		CLLMQUtils::BuildSignHash(recoveredSig).ToString(), recoveredSig.id.ToString(), recoveredSig.msgHash.ToString(), pfrom->GetId());
 
-    LOCK(cs);
-    pendingRecoveredSigs[pfrom->id].emplace_back(recoveredSig);
+    {
+        LOCK(cs);
+        pendingRecoveredSigs[pfrom->id].emplace_back(recoveredSig);
+    }
+    // pending recovered sigs are verified and processed by the sig shares worker thread
+    quorumSigSharesManager->WakeupWorkerThread();
 }
 
 bool CSigningManager::PreVerifyRecoveredSig(NodeId nodeId, const CRecoveredSig& recoveredSig, bool& retBan)
@@ -613,7 +985,12 @@ bool CSigningManager::ProcessPendingRecoveredSigs(CConnman& connman)
             }
 
             const auto& quorum = quorums.at(std::make_pair((Consensus::LLMQType)recSig.llmqType, recSig.quorumHash));
-            batchVerifier.PushMessage(nodeId, recSig.GetHash(), CLLMQUtils::BuildSignHash(recSig), recSig.sig.Get(), quorum->qc.quorumPublicKey);
+            auto signHash = CLLMQUtils::BuildSignHash(recSig);
+            // the same recovered sig usually arrives from multiple peers
+            if (IsBLSSigCached(recSig.sig.Get(), quorum->qc.quorumPublicKey, signHash)) {
+                continue;
+            }
+            batchVerifier.PushMessage(nodeId, recSig.GetHash(), signHash, recSig.sig.Get(), quorum->qc.quorumPublicKey);
             verifyCount++;
         }
     }
@@ -642,6 +1019,7 @@ bool CSigningManager::ProcessPendingRecoveredSigs(CConnman& connman)
             }
 
             const auto& quorum = quorums.at(std::make_pair((Consensus::LLMQType)recSig.llmqType, recSig.quorumHash));
+            AddBLSSigToCache(recSig.sig.Get(), quorum->qc.quorumPublicKey, CLLMQUtils::BuildSignHash(recSig));
             ProcessRecoveredSig(nodeId, recSig, quorum, connman);
         }
     }
@@ -708,8 +1086,11 @@ void CSigningManager::ProcessRecoveredSig(NodeId nodeId, const CRecoveredSig& re
 
 void CSigningManager::PushReconstructedRecoveredSig(const llmq::CRecoveredSig& recoveredSig, const llmq::CQuorumCPtr& quorum)
 {
-    LOCK(cs);
-    pendingReconstructedRecoveredSigs.emplace_back(recoveredSig, quorum);
+    {
+        LOCK(cs);
+        pendingReconstructedRecoveredSigs.emplace_back(recoveredSig, quorum);
+    }
+    quorumSigSharesManager->WakeupWorkerThread();
 }
 
 void CSigningManager::RemoveRecoveredSig(Consensus::LLMQType llmqType, const uint256& id)
@@ -717,6 +1098,11 @@ void CSigningManager::RemoveRecoveredSig(Consensus::LLMQType llmqType, const uin
     db.RemoveRecoveredSig(llmqType, id);
 }
 
+void CSigningManager::FlushPendingWrites()
+{
+    db.FlushPendingWrites();
+}
+
 void CSigningManager::Cleanup()
 {
     int64_t now = GetTimeMillis();
@@ -864,19 +1250,108 @@ bool CSigningManager::GetVoteForId(Consensus::LLMQType llmqType, const uint256&
     return db.GetVoteForId(llmqType, id, msgHashRet);
 }
 
+const CBlockIndex* CSigningManager::GetActiveQuorumSetStartBlock(int signHeight)
+{
+    LOCK(cs_main);
+    int startBlockHeight = signHeight - SIGN_HEIGHT_OFFSET;
+    if (startBlockHeight > chainActive.Height()) {
+        return nullptr;
+    }
+    return chainActive[startBlockHeight];
+}
+
+CSigningManager::ActiveQuorumSetCPtr CSigningManager::BuildActiveQuorumSet(Consensus::LLMQType llmqType, std::vector<CQuorumCPtr>&& quorums)
+{
+    auto set = std::make_shared<ActiveQuorumSet>();
+    set->quorums = std::move(quorums);
+    set->scoreHashers.reserve(set->quorums.size());
+    for (const auto& quorum : set->quorums) {
+        CHashWriter h(SER_NETWORK, 0);
+        h << (uint8_t)llmqType;
+        h << quorum->qc.quorumHash;
+        set->scoreHashers.emplace_back(h);
+    }
+    return set;
+}
+
+void CSigningManager::UpdatedBlockTip(const CBlockIndex* pindexNew)
+{
+    for (const auto& p : Params().GetConsensus().llmqs) {
+        auto llmqType = p.first;
+        size_t poolSize = (size_t)p.second.signingActiveQuorumCount;
+
+        auto& tableRef = activeQuorumTables.at(llmqType);
+        auto oldTable = std::atomic_load(&tableRef);
+
+        auto newTable = std::make_shared<ActiveQuorumTable>();
+        newTable->tipHeight = pindexNew->nHeight;
+        newTable->sets.reserve(ACTIVE_QUORUM_TABLE_DEPTH);
+
+        for (int i = 0; i < ACTIVE_QUORUM_TABLE_DEPTH; i++) {
+            int startHeight = pindexNew->nHeight - i - SIGN_HEIGHT_OFFSET;
+            if (startHeight < 0) {
+                break;
+            }
+            const CBlockIndex* pindexStart = pindexNew->GetAncestor(startHeight);
+
+            ActiveQuorumSetCPtr set;
+            if (oldTable) {
+                for (const auto& e : oldTable->sets) {
+                    if (e.first == pindexStart) {
+                        set = e.second;
+                        break;
+                    }
+                }
+            }
+            if (!set) {
+                auto quorums = quorumManager->ScanQuorums(llmqType, pindexStart, poolSize);
+                if (!newTable->sets.empty() && newTable->sets.back().second->quorums == quorums) {
+                    set = newTable->sets.back().second;
+                } else {
+                    set = BuildActiveQuorumSet(llmqType, std::move(quorums));
+                }
+            }
+            newTable->sets.emplace_back(pindexStart, set);
+        }
+
+        std::atomic_store(&tableRef, std::shared_ptr<const ActiveQuorumTable>(std::move(newTable)));
+    }
+}
+
+CSigningManager::ActiveQuorumSetCPtr CSigningManager::GetCachedActiveQuorumSet(Consensus::LLMQType llmqType, int signHeight)
+{
+    auto it = activeQuorumTables.find(llmqType);
+    if (it == activeQuorumTables.end()) {
+        return nullptr;
+    }
+    auto table = std::atomic_load(&it->second);
+    if (!table) {
+        return nullptr;
+    }
+    int i = table->tipHeight - signHeight;
+    if (i < 0 || i >= (int)table->sets.size()) {
+        return nullptr;
+    }
+    // the table might still belong to a chain which was reorganized away
+    if (table->sets[i].first != GetActiveQuorumSetStartBlock(signHeight)) {
+        return nullptr;
+    }
+    return table->sets[i].second;
+}
+
 std::vector<CQuorumCPtr> CSigningManager::GetActiveQuorumSet(Consensus::LLMQType llmqType, int signHeight)
 {
+    auto set = GetCachedActiveQuorumSet(llmqType, signHeight);
+    if (set) {
+        return set->quorums;
+    }
+
     auto& llmqParams = Params().GetConsensus().llmqs.at(llmqType);
     size_t poolSize = (size_t)llmqParams.signingActiveQuorumCount;
 
-    CBlockIndex* pindexStart;
-    {
-        LOCK(cs_main);
-        int startBlockHeight = signHeight - SIGN_HEIGHT_OFFSET;
-        if (startBlockHeight > chainActive.Height()) {
-            return {};
-        }
-        pindexStart = chainActive[startBlockHeight];
+    const CBlockIndex* pindexStart = GetActiveQuorumSetStartBlock(signHeight);
+    if (!pindexStart) {
+        return {};
     }
 
     return quorumManager->ScanQuorums(llmqType, pindexStart, poolSize);
@@ -884,22 +1359,28 @@ std::vector<CQuorumCPtr> CSigningManager::GetActiveQuorumSet(Consensus::LLMQType
 
 CQuorumCPtr CSigningManager::SelectQuorumForSigning(Consensus::LLMQType llmqType, int signHeight, const uint256& selectionHash)
 {
-    auto quorums = GetActiveQuorumSet(llmqType, signHeight);
-    if (quorums.empty()) {
+    auto set = GetCachedActiveQuorumSet(llmqType, signHeight);
+    if (!set) {
+        // sign height is too old or the tables were not built yet (e.g. while in initial block download)
+        set = BuildActiveQuorumSet(llmqType, GetActiveQuorumSet(llmqType, signHeight));
+    }
+    if (set->quorums.empty()) {
         return nullptr;
     }
 
-    std::vector<std::pair<uint256, size_t>> scores;
-    scores.reserve(quorums.size());
-    for (size_t i = 0; i < quorums.size(); i++) {
-        CHashWriter h(SER_NETWORK, 0);
-        h << (uint8_t)llmqType;
-        h << quorums[i]->qc.quorumHash;
+    // the quorum with the lowest score wins
+    size_t bestIdx = 0;
+    uint256 bestScore;
+    for (size_t i = 0; i < set->quorums.size(); i++) {
+        CHashWriter h(set->scoreHashers[i]);
         h << selectionHash;
-        scores.emplace_back(h.GetHash(), i);
+        uint256 score = h.GetHash();
+        if (i == 0 || score < bestScore) {
+            bestScore = score;
+            bestIdx = i;
+        }
     }
-    std::sort(scores.begin(), scores.end());
-    return quorums[scores.front().second];
+    return set->quorums[bestIdx];
 }
 
 bool CSigningManager::VerifyRecoveredSig(Consensus::LLMQType llmqType, int signedAtHeight, const uint256& id, const uint256& msgHash, const CBLSSignature& sig)
@@ -912,7 +1393,7 @@ bool CSigningManager::VerifyRecoveredSig(Consensus::LLMQType llmqType, int signe
     }
 
     uint256 signHash = CLLMQUtils::BuildSignHash(llmqParams.type, quorum->qc.quorumHash, id, msgHash);
-    return sig.VerifyInsecure(quorum->qc.quorumPublicKey, signHash);
+    return VerifyBLSSigCached(sig, quorum->qc.quorumPublicKey, signHash);
 }
 
 }
@@ -15,6 +15,7 @@
 #include "univalue.h"
 #include "unordered_lru_cache.h"
 
+#include <map>
 #include <unordered_map>
 
 namespace llmq
@@ -63,9 +64,45 @@ public:
     UniValue ToJson() const;
 };
 
+/**
+ * Fixed size bloom filter for 256 bit hashes. Unlike CRollingBloomFilter, it never forgets elements, so a negative
+ * answer is always correct. It only becomes less precise when more elements than planned are inserted.
+ */
+class CHashBloomFilter
+{
+private:
+    static const int HASH_FUNCS = 6;
+
+    std::vector<uint64_t> data;
+    uint64_t salt1;
+    uint64_t salt2;
+    size_t insertCount{0};
+
+public:
+    explicit CHashBloomFilter(size_t nBits);
+
+    void insert(const uint256& hash, uint8_t tweak = 0);
+    bool contains(const uint256& hash, uint8_t tweak = 0) const;
+    void clear();
+    size_t inserted() const { return insertCount; }
+};
+
 class CRecoveredSigsDb
 {
 private:
+    // recSigs and votes are put into time buckets of this size. Cleanup then only needs to visit the bucket entries
+    static const uint32_t TIME_BUCKET_SECONDS = 60 * 60;
+    // each of the bloom filters takes 512KB and gives a false positive rate below 0.1% for up to 250k recSigs. Each
+    // filter gets exactly one element per recSig
+    static const size_t BLOOM_FILTER_BITS = 1 << 22;
+    static const size_t BLOOM_FILTER_MAX_ELEMENTS = 250000;
+
+    struct PendingRecSig {
+        CRecoveredSig recSig;
+        uint256 signHash;
+        uint32_t writeTime;
+    };
+
     CDBWrapper& db;
 
     CCriticalSection cs;
@@ -73,8 +110,27 @@ private:
     unordered_lru_cache<uint256, bool, StaticSaltedHasher, 30000> hasSigForSessionCache;
     unordered_lru_cache<uint256, bool, StaticSaltedHasher, 30000> hasSigForHashCache;
 
+    // Front-ends for the negative "has" queries. Elements are never removed, so these might give false positives for
+    // removed recSigs, in which case we fall back to the DB
+    CHashBloomFilter sigForIdFilter{BLOOM_FILTER_BITS};
+    CHashBloomFilter sigForSessionFilter{BLOOM_FILTER_BITS};
+    CHashBloomFilter sigForHashFilter{BLOOM_FILTER_BITS};
+
+    // Write-combining. Written recSigs and votes are kept in memory until FlushPendingWrites is called, which writes
+    // all of them in one batch. All reads check these first
+    std::unordered_map<std::pair<Consensus::LLMQType, uint256>, PendingRecSig, StaticSaltedHasher> pendingRecSigs;
+    std::unordered_map<uint256, std::pair<Consensus::LLMQType, uint256>, StaticSaltedHasher> pendingRecSigsByHash;
+    std::unordered_map<uint256, std::pair<Consensus::LLMQType, uint256>, StaticSaltedHasher> pendingRecSigsBySignHash;
+    std::unordered_map<std::pair<Consensus::LLMQType, uint256>, std::pair<uint256, uint32_t>, StaticSaltedHasher> pendingVotes;
+    // makes bucket keys unique, even when multiple flushes happen in the same time bucket
+    int64_t lastFlushTime{0};
+    // the bloom filters are rebuilt from the DB in cleanup once they hold more than this many elements
+    size_t bloomFilterMaxElements;
+    size_t bloomFiltersLoadedCount{0};
+
 public:
-    CRecoveredSigsDb(CDBWrapper& _db);
+    explicit CRecoveredSigsDb(CDBWrapper& _db, size_t _bloomFilterMaxElements = BLOOM_FILTER_MAX_ELEMENTS);
+    ~CRecoveredSigsDb();
 
     void ConvertInvalidTimeKeys();
     void AddVoteTimeKeys();
@@ -97,9 +153,21 @@ public:
 
     void CleanupOldVotes(int64_t maxAge);
 
+    // Writes all pending recSigs and votes in a single batch
+    void FlushPendingWrites();
+
+    // Number of recSigs in the bloom filters, including removed ones which are still in there until the next rebuild
+    size_t GetBloomFilterElementCount();
+
 private:
+    void FlushPendingWritesInternal();
+    void LoadBloomFilters();
+    void CleanupLegacyTimeKeys(int64_t maxAge);
+    void CleanupLegacyVoteTimeKeys(int64_t maxAge);
+
     bool ReadRecoveredSig(Consensus::LLMQType llmqType, const uint256& id, CRecoveredSig& ret);
-    void RemoveRecoveredSig(CDBBatch& batch, Consensus::LLMQType llmqType, const uint256& id, bool deleteTimeKey);
+    // if onlyInTimeBucket is not -1, the recSig is only removed when it was written inside this time bucket
+    void RemoveRecoveredSig(CDBBatch& batch, Consensus::LLMQType llmqType, const uint256& id, bool deleteTimeKey, int64_t onlyInTimeBucket = -1);
 };
 
 class CRecoveredSigsListener
@@ -136,6 +204,24 @@ private:
 
     std::vector<CRecoveredSigsListener*> recoveredSigsListeners;
 
+    // Active quorum sets of the most recent sign heights, rebuilt for each LLMQ type on every new chain tip. Sets are
+    // shared between sign heights and between consecutive tables as long as no new quorum gets mined. The tables are
+    // replaced atomically, so selecting a quorum for a recent sign height needs neither cs_main nor any other lock
+    static const int ACTIVE_QUORUM_TABLE_DEPTH = 16;
+    struct ActiveQuorumSet {
+        std::vector<CQuorumCPtr> quorums;
+        // selection score hashers per quorum, with the LLMQ type and the quorum hash already written
+        std::vector<CHashWriter> scoreHashers;
+    };
+    typedef std::shared_ptr<const ActiveQuorumSet> ActiveQuorumSetCPtr;
+    struct ActiveQuorumTable {
+        int tipHeight;
+        // entry i belongs to sign height tipHeight - i and contains the start block of the scan and the set
+        std::vector<std::pair<const CBlockIndex*, ActiveQuorumSetCPtr>> sets;
+    };
+    // only the values are modified after construction, through std::atomic_load/std::atomic_store
+    std::map<Consensus::LLMQType, std::shared_ptr<const ActiveQuorumTable>> activeQuorumTables;
+
 public:
     CSigningManager(CDBWrapper& llmqDb, bool fMemory);
 
@@ -152,6 +238,11 @@ public:
     // mechanism prevents possible conflicts. As an example, ChainLocks prevent conflicts in confirmed TXs InstaEPM votes
     void RemoveRecoveredSig(Consensus::LLMQType llmqType, const uint256& id);
 
+    // Writes all recovered sigs and votes which were collected since the last call to the DB
+    void FlushPendingWrites();
+
+    void UpdatedBlockTip(const CBlockIndex* pindexNew);
+
 private:
     void ProcessMessageRecoveredSig(CNode* pfrom, const CRecoveredSig& recoveredSig, CConnman& connman);
     bool PreVerifyRecoveredSig(NodeId nodeId, const CRecoveredSig& recoveredSig, bool& retBan);
@@ -163,6 +254,9 @@ private:
     bool ProcessPendingRecoveredSigs(CConnman& connman); // called from the worker thread of CSigSharesManager
     void ProcessRecoveredSig(NodeId nodeId, const CRecoveredSig& recoveredSig, const CQuorumCPtr& quorum, CConnman& connman);
     void Cleanup(); // called from the worker thread of CSigSharesManager
+    const CBlockIndex* GetActiveQuorumSetStartBlock(int signHeight);
+    ActiveQuorumSetCPtr GetCachedActiveQuorumSet(Consensus::LLMQType llmqType, int signHeight);
+    static ActiveQuorumSetCPtr BuildActiveQuorumSet(Consensus::LLMQType llmqType, std::vector<CQuorumCPtr>&& quorums);
 
 public:
     // public interface
@@ -180,6 +274,7 @@ public:
     bool GetVoteForId(Consensus::LLMQType llmqType, const uint256& id, uint256& msgHashRet);
 
     std::vector<CQuorumCPtr> GetActiveQuorumSet(Consensus::LLMQType llmqType, int signHeight);
+    // cheap for the most recent sign heights, as these are served from the active quorum tables
     CQuorumCPtr SelectQuorumForSigning(Consensus::LLMQType llmqType, int signHeight, const uint256& selectionHash);
 
     // Verifies a recovered sig that was signed while the chain tip was at signedAtTip
@@ -4,12 +4,14 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "quorums_latency.h"
 #include "quorums_signing.h"
 #include "quorums_signing_shares.h"
 #include "quorums_utils.h"
 
 #include "activemasternode.h"
 #include "bls/bls_batchverifier.h"
+#include "bls/bls_sigcache.h"
 #include "init.h"
 #include "net_processing.h"
 #include "netmessagemaker.h"
@@ -182,9 +184,77 @@ void CSigSharesNodeState::RemoveSession(const uint256& signHash)
     pendingIncomingSigShares.EraseAllForSignHash(signHash);
 }
 
+size_t CSigSharesStore::Add(const CSigShare& sigShare, int64_t nTimeSeen)
+{
+    auto& shard = GetShard(sigShare.GetSignHash());
+    LOCK(shard.cs);
+    if (!shard.sigShares.Add(sigShare.GetKey(), sigShare)) {
+        return 0;
+    }
+    shard.timeSeenForSessions[sigShare.GetSignHash()] = nTimeSeen;
+    return shard.sigShares.CountForSignHash(sigShare.GetSignHash());
+}
+
+bool CSigSharesStore::Has(const SigShareKey& k)
+{
+    auto& shard = GetShard(k.first);
+    LOCK(shard.cs);
+    return shard.sigShares.Has(k);
+}
+
+bool CSigSharesStore::Get(const SigShareKey& k, CSigShare& ret)
+{
+    auto& shard = GetShard(k.first);
+    LOCK(shard.cs);
+    auto sigShare = shard.sigShares.Get(k);
+    if (!sigShare) {
+        return false;
+    }
+    ret = *sigShare;
+    return true;
+}
+
+size_t CSigSharesStore::CountForSignHash(const uint256& signHash)
+{
+    auto& shard = GetShard(signHash);
+    LOCK(shard.cs);
+    return shard.sigShares.CountForSignHash(signHash);
+}
+
+size_t CSigSharesStore::Size()
+{
+    size_t ret = 0;
+    for (auto& shard : shards) {
+        LOCK(shard.cs);
+        ret += shard.sigShares.Size();
+    }
+    return ret;
+}
+
+void CSigSharesStore::EraseAllForSignHash(const uint256& signHash)
+{
+    auto& shard = GetShard(signHash);
+    LOCK(shard.cs);
+    shard.sigShares.EraseAllForSignHash(signHash);
+    shard.timeSeenForSessions.erase(signHash);
+}
+
+void CSigSharesStore::GetTimedOutSessions(int64_t nTime, int64_t timeout, std::unordered_set<uint256, StaticSaltedHasher>& ret)
+{
+    for (auto& shard : shards) {
+        LOCK(shard.cs);
+        for (auto& p : shard.timeSeenForSessions) {
+            if (nTime - p.second >= timeout) {
+                ret.emplace(p.first);
+            }
+        }
+    }
+}
+
 //////////////////////
 
-CSigSharesManager::CSigSharesManager()
+CSigSharesManager::CSigSharesManager(CBLSWorker& _blsWorker) :
+    blsWorker(_blsWorker)
 {
     workInterrupt.reset();
 }
@@ -230,6 +300,12 @@ void CSigSharesManager::UnregisterAsRecoveredSigsListener()
 void CSigSharesManager::InterruptWorkerThread()
 {
     workInterrupt();
+    workWakeup.Wakeup();
+}
+
+void CSigSharesManager::WakeupWorkerThread()
+{
+    workWakeup.Wakeup();
 }
 
 void CSigSharesManager::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman)
@@ -299,7 +375,12 @@ void CSigSharesManager::ProcessMessage(CNode* pfrom, const std::string& strComma
                 return;
             }
         }
+    } else {
+        return;
     }
+
+    // new shares need to be verified and announcements/requests need to be answered, so don't wait for the next poll
+    WakeupWorkerThread();
 }
 
 bool CSigSharesManager::ProcessMessageSigSesAnn(CNode* pfrom, const CSigSesAnn& ann, CConnman& connman)
@@ -585,6 +666,8 @@ bool CSigSharesManager::ProcessPendingSigShares(CConnman& connman)
     // It's ok to perform insecure batched verification here as we verify against the quorum public key shares,
     // which are not craftable by individual entities, making the rogue public key attack impossible
     CBLSBatchVerifier<NodeId, SigShareKey> batchVerifier(false, true);
+    // sig shares are collected from up to 32 nodes per round, which is enough to make use of the BLS worker threads
+    batchVerifier.EnableParallelVerification(blsWorker);
 
     size_t verifyCount = 0;
     for (auto& p : sigSharesByNodes) {
@@ -679,17 +762,20 @@ void CSigSharesManager::ProcessSigShare(NodeId nodeId, const CSigShare& sigShare
         return;
     }
 
+    // this also updates the time we've seen the last sigShare
+    size_t sigShareCount = sigShares.Add(sigShare, GetAdjustedTime());
+    if (sigShareCount == 0) {
+        return;
+    }
+    if (sigShareCount >= quorum->params.threshold) {
+        canTryRecovery = true;
+    }
+
     {
         LOCK(cs);
 
-        if (!sigShares.Add(sigShare.GetKey(), sigShare)) {
-            return;
-        }
         sigSharesToAnnounce.Add(sigShare.GetKey(), true);
 
-        // Update the time we've seen the last sigShare
-        timeSeenForSessions[sigShare.GetSignHash()] = GetAdjustedTime();
-
         if (!quorumNodes.empty()) {
             // don't announce and wait for other nodes to request this share and directly send it to them
             // there is no way the other nodes know about this share as this is the one created on this node
@@ -701,86 +787,123 @@ void CSigSharesManager::ProcessSigShare(NodeId nodeId, const CSigShare& sigShare
                 session.knows.Set(sigShare.quorumMember, true);
             }
         }
-
-        size_t sigShareCount = sigShares.CountForSignHash(sigShare.GetSignHash());
-        if (sigShareCount >= quorum->params.threshold) {
-            canTryRecovery = true;
-        }
     }
 
     if (canTryRecovery) {
-        TryRecoverSig(quorum, sigShare.id, sigShare.msgHash, connman);
+        TryRecoverSig(quorum, sigShare.id, sigShare.msgHash);
     }
 }
 
-void CSigSharesManager::TryRecoverSig(const CQuorumCPtr& quorum, const uint256& id, const uint256& msgHash, CConnman& connman)
+void CSigSharesManager::TryRecoverSig(const CQuorumCPtr& quorum, const uint256& id, const uint256& msgHash)
 {
     if (quorumSigningManager->HasRecoveredSigForId(quorum->params.type, id)) {
         return;
     }
 
-    std::vector<CBLSSignature> sigSharesForRecovery;
-    std::vector<CBLSId> idsForRecovery;
+    auto signHash = CLLMQUtils::BuildSignHash(quorum->params.type, quorum->qc.quorumHash, id, msgHash);
     {
         LOCK(cs);
-
-        auto k = std::make_pair(quorum->params.type, id);
-
-        auto signHash = CLLMQUtils::BuildSignHash(quorum->params.type, quorum->qc.quorumHash, id, msgHash);
-        auto sigShares = this->sigShares.GetAllForSignHash(signHash);
-        if (!sigShares) {
+        // shares from multiple nodes might complete the threshold while a recovery is already running
+        if (!recoveriesInProgress.emplace(signHash).second) {
             return;
         }
+    }
 
+    std::vector<CBLSSignature> sigSharesForRecovery;
+    std::vector<CBLSId> idsForRecovery;
+
+    bool found = sigShares.WithSigSharesForSignHash(signHash, [&](const SigShareMemberMap<CSigShare>& m) {
         sigSharesForRecovery.reserve((size_t) quorum->params.threshold);
         idsForRecovery.reserve((size_t) quorum->params.threshold);
-        for (auto it = sigShares->begin(); it != sigShares->end() && sigSharesForRecovery.size() < quorum->params.threshold; ++it) {
+        for (auto it = m.begin(); it != m.end() && sigSharesForRecovery.size() < quorum->params.threshold; ++it) {
             auto& sigShare = it->second;
             sigSharesForRecovery.emplace_back(sigShare.sigShare.Get());
             idsForRecovery.emplace_back(CBLSId::FromHash(quorum->members[sigShare.quorumMember]->proTxHash));
         }
+    });
 
-        // check if we can recover the final signature
-        if (sigSharesForRecovery.size() < quorum->params.threshold) {
+    // check if we can recover the final signature
+    if (!found || sigSharesForRecovery.size() < quorum->params.threshold) {
+        LOCK(cs);
+        recoveriesInProgress.erase(signHash);
+        return;
+    }
+
+    // Recovery is expensive, so let the BLS worker pool do it. This way, many sessions reaching their threshold at the
+    // same time (e.g. on a new block with many TXs to lock) are recovered in parallel
+    int64_t nStartTime = GetTimeMillis();
+    blsWorker.AsyncRecoverSig(sigSharesForRecovery, idsForRecovery, [this, quorum, id, msgHash, signHash, nStartTime](const CBLSSignature& recoveredSig) {
+        LOCK(cs);
+        if (!recoveredSig.IsValid()) {
+            LogPrintf("CSigSharesManager::%s -- failed to recover signature. id=%s, msgHash=%s, time=%d\n", "TryRecoverSig",
+                      id.ToString(), msgHash.ToString(), GetTimeMillis() - nStartTime);
+            recoveriesInProgress.erase(signHash);
             return;
         }
+
+        LogPrint("llmq-sigs", "CSigSharesManager::%s -- recovered signature. id=%s, msgHash=%s, time=%d\n", "TryRecoverSig",
+                  id.ToString(), msgHash.ToString(), GetTimeMillis() - nStartTime);
+
+        CRecoveredSig rs;
+        rs.llmqType = quorum->params.type;
+        rs.quorumHash = quorum->qc.quorumHash;
+        rs.id = id;
+        rs.msgHash = msgHash;
+        rs.sig.Set(recoveredSig);
+        rs.UpdateHash();
+        finishedRecoveries.emplace_back(std::move(rs), quorum);
+
+        WakeupWorkerThread();
+    });
+}
+
+bool CSigSharesManager::ProcessFinishedRecoveries(CConnman& connman)
+{
+    decltype(finishedRecoveries) v;
+    {
+        LOCK(cs);
+        v = std::move(finishedRecoveries);
+    }
+    if (v.empty()) {
+        return false;
     }
 
-    // now recover it
-    cxxtimer::Timer t(true);
-    CBLSSignature recoveredSig;
-    if (!recoveredSig.Recover(sigSharesForRecovery, idsForRecovery)) {
-        LogPrintf("CSigSharesManager::%s -- failed to recover signature. id=%s, msgHash=%s, time=%d\n", __func__,
-                  id.ToString(), msgHash.ToString(), t.count());
-        return;
+    // There should actually be no need to verify the self-recovered signatures as it should always succeed. We still
+    // do it to catch bugs, but in batches so that it's much cheaper than verifying each one on its own.
+    // It's ok to perform insecure batched verification here as we verify against the quorum public keys, which are not
+    // craftable by individual entities, making the rogue public key attack impossible
+    CBLSBatchVerifier<uint256, uint256> batchVerifier(false, true);
+    for (auto& p : v) {
+        auto& rs = p.first;
+        auto signHash = CLLMQUtils::BuildSignHash(rs);
+        batchVerifier.PushMessage(signHash, signHash, signHash, rs.sig.Get(), p.second->qc.quorumPublicKey);
     }
 
-    LogPrint("llmq-sigs", "CSigSharesManager::%s -- recovered signature. id=%s, msgHash=%s, time=%d\n", __func__,
-              id.ToString(), msgHash.ToString(), t.count());
+    cxxtimer::Timer verifyTimer(true);
+    batchVerifier.Verify();
+    verifyTimer.stop();
 
-    CRecoveredSig rs;
-    rs.llmqType = quorum->params.type;
-    rs.quorumHash = quorum->qc.quorumHash;
-    rs.id = id;
-    rs.msgHash = msgHash;
-    rs.sig.Set(recoveredSig);
-    rs.UpdateHash();
+    LogPrint("llmq-sigs", "CSigSharesManager::%s -- verified own recovered sigs. count=%d, vt=%d\n", __func__, v.size(), verifyTimer.count());
 
-    // There should actually be no need to verify the self-recovered signatures as it should always succeed. Let's
-    // however still verify it from time to time, so that we have a chance to catch bugs. We do only this sporadic
-    // verification because this is unbatched and thus slow verification that happens here.
-    if (((recoveredSigsCounter++) % 100) == 0) {
-        auto signHash = CLLMQUtils::BuildSignHash(rs);
-        bool valid = recoveredSig.VerifyInsecure(quorum->qc.quorumPublicKey, signHash);
-        if (!valid) {
+    for (auto& p : v) {
+        auto& rs = p.first;
+        if (batchVerifier.badMessages.count(CLLMQUtils::BuildSignHash(rs))) {
             // this should really not happen as we have verified all signature shares before
             LogPrintf("CSigSharesManager::%s -- own recovered signature is invalid. id=%s, msgHash=%s\n", __func__,
-                      id.ToString(), msgHash.ToString());
-            return;
+                      rs.id.ToString(), rs.msgHash.ToString());
+            continue;
         }
+        // other members will send us the same recovered sig, which then doesn't need to be verified again
+        AddBLSSigToCache(rs.sig.Get(), p.second->qc.quorumPublicKey, CLLMQUtils::BuildSignHash(rs));
+        quorumSigningManager->ProcessRecoveredSig(-1, rs, p.second, connman);
     }
 
-    quorumSigningManager->ProcessRecoveredSig(-1, rs, quorum, connman);
+    LOCK(cs);
+    for (auto& p : v) {
+        recoveriesInProgress.erase(CLLMQUtils::BuildSignHash(p.first));
+    }
+
+    return true;
 }
 
 void CSigSharesManager::CollectSigSharesToRequest(std::unordered_map<NodeId, std::unordered_map<uint256, CSigSharesInv, StaticSaltedHasher>>& sigSharesToRequest)
@@ -903,22 +1026,22 @@ void CSigSharesManager::CollectSigSharesToSend(std::unordered_map<NodeId, std::u
 
             CBatchedSigShares batchedSigShares;
 
-            for (size_t i = 0; i < session.requested.inv.size(); i++) {
-                if (!session.requested.inv[i]) {
-                    continue;
-                }
-                session.requested.inv[i] = false;
+            sigShares.WithSigSharesForSignHash(signHash, [&](const SigShareMemberMap<CSigShare>& m) {
+                for (size_t i = 0; i < session.requested.inv.size(); i++) {
+                    if (!session.requested.inv[i]) {
+                        continue;
+                    }
 
-                auto k = std::make_pair(signHash, (uint16_t)i);
-                const CSigShare* sigShare = sigShares.Get(k);
-                if (!sigShare) {
-                    // he requested something we don'have
-                    session.requested.inv[i] = false;
-                    continue;
-                }
+                    const CSigShare* sigShare = m.get((uint16_t)i);
+                    if (!sigShare) {
+                        // he requested something we don'have
+                        continue;
+                    }
 
-                batchedSigShares.sigShares.emplace_back((uint16_t)i, sigShare->sigShare);
-            }
+                    batchedSigShares.sigShares.emplace_back((uint16_t)i, sigShare->sigShare);
+                }
+            });
+            std::fill(session.requested.inv.begin(), session.requested.inv.end(), false);
 
             if (!batchedSigShares.sigShares.empty()) {
                 if (sigSharesToSend2 == nullptr) {
@@ -940,10 +1063,11 @@ void CSigSharesManager::CollectSigSharesToAnnounce(std::unordered_map<NodeId, st
     this->sigSharesToAnnounce.ForEach([&](const SigShareKey& sigShareKey, bool) {
         auto& signHash = sigShareKey.first;
         auto quorumMember = sigShareKey.second;
-        const CSigShare* sigShare = sigShares.Get(sigShareKey);
-        if (!sigShare) {
+        CSigShare sigShareObj;
+        if (!sigShares.Get(sigShareKey, sigShareObj)) {
             return;
         }
+        const CSigShare* sigShare = &sigShareObj;
 
         // announce to the nodes which we know through the intra-quorum-communication system
         auto quorumKey = std::make_pair((Consensus::LLMQType)sigShare->llmqType, sigShare->quorumHash);
@@ -1164,12 +1288,9 @@ void CSigSharesManager::Cleanup()
     // quorumHash -> quorumPtr (as GetQuorum() requires cs_main, leading to deadlocks with cs held)
     std::unordered_map<std::pair<Consensus::LLMQType, uint256>, CQuorumCPtr, StaticSaltedHasher> quorums;
 
-    {
-        LOCK(cs);
-        sigShares.ForEach([&](const SigShareKey& k, const CSigShare& sigShare) {
-            quorums.emplace(std::make_pair((Consensus::LLMQType) sigShare.llmqType, sigShare.quorumHash), nullptr);
-        });
-    }
+    sigShares.ForEach([&](const SigShareKey& k, const CSigShare& sigShare) {
+        quorums.emplace(std::make_pair((Consensus::LLMQType) sigShare.llmqType, sigShare.quorumHash), nullptr);
+    });
 
     // Find quorums which became inactive
     for (auto it = quorums.begin(); it != quorums.end(); ) {
@@ -1181,55 +1302,47 @@ void CSigSharesManager::Cleanup()
         }
     }
 
-    {
-        // Now delete sessions which are for inactive quorums
-        LOCK(cs);
-        std::unordered_set<uint256, StaticSaltedHasher> inactiveQuorumSessions;
-        sigShares.ForEach([&](const SigShareKey& k, const CSigShare& sigShare) {
-            if (!quorums.count(std::make_pair((Consensus::LLMQType)sigShare.llmqType, sigShare.quorumHash))) {
-                inactiveQuorumSessions.emplace(sigShare.GetSignHash());
-            }
-        });
-        for (auto& signHash : inactiveQuorumSessions) {
-            RemoveSigSharesForSession(signHash);
+    // Find sessions which are for inactive quorums and sessions which were succesfully recovered. The recovered sig
+    // check is done after iterating, so that we don't call into the signing manager while a shard is locked
+    std::unordered_set<uint256, StaticSaltedHasher> inactiveQuorumSessions;
+    std::unordered_set<uint256, StaticSaltedHasher> activeQuorumSessions;
+    sigShares.ForEach([&](const SigShareKey& k, const CSigShare& sigShare) {
+        if (!quorums.count(std::make_pair((Consensus::LLMQType)sigShare.llmqType, sigShare.quorumHash))) {
+            inactiveQuorumSessions.emplace(sigShare.GetSignHash());
+        } else {
+            activeQuorumSessions.emplace(sigShare.GetSignHash());
+        }
+    });
+    std::unordered_set<uint256, StaticSaltedHasher> doneSessions;
+    for (auto& signHash : activeQuorumSessions) {
+        if (quorumSigningManager->HasRecoveredSigForSession(signHash)) {
+            doneSessions.emplace(signHash);
         }
     }
 
+    // Find sessions which timed out
+    std::unordered_set<uint256, StaticSaltedHasher> timeoutSessions;
+    sigShares.GetTimedOutSessions(now, SESSION_NEW_SHARES_TIMEOUT, timeoutSessions);
+
     {
         LOCK(cs);
 
+        // Now delete sessions which are for inactive quorums
+        for (auto& signHash : inactiveQuorumSessions) {
+            RemoveSigSharesForSession(signHash);
+        }
+
         // Remove sessions which were succesfully recovered
-        std::unordered_set<uint256, StaticSaltedHasher> doneSessions;
-        sigShares.ForEach([&](const SigShareKey& k, const CSigShare& sigShare) {
-            if (doneSessions.count(sigShare.GetSignHash())) {
-                return;
-            }
-            if (quorumSigningManager->HasRecoveredSigForSession(sigShare.GetSignHash())) {
-                doneSessions.emplace(sigShare.GetSignHash());
-            }
-        });
         for (auto& signHash : doneSessions) {
             RemoveSigSharesForSession(signHash);
         }
 
         // Remove sessions which timed out
-        std::unordered_set<uint256, StaticSaltedHasher> timeoutSessions;
-        for (auto& p : timeSeenForSessions) {
-            auto& signHash = p.first;
-            int64_t lastSeenTime = p.second;
-
-            if (now - lastSeenTime >= SESSION_NEW_SHARES_TIMEOUT) {
-                timeoutSessions.emplace(signHash);
-            }
-        }
         for (auto& signHash : timeoutSessions) {
-            size_t count = sigShares.CountForSignHash(signHash);
-
-            if (count > 0) {
-                auto m = sigShares.GetAllForSignHash(signHash);
-                assert(m);
-
-                auto& oneSigShare = m->begin()->second;
+            size_t count = 0;
+            bool found = sigShares.WithSigSharesForSignHash(signHash, [&](const SigShareMemberMap<CSigShare>& m) {
+                count = m.size();
+                auto& oneSigShare = m.begin()->second;
 
                 std::string strMissingMembers;
                 if (LogAcceptCategory("llmq")) {
@@ -1237,7 +1350,7 @@ void CSigSharesManager::Cleanup()
                     if (quorumIt != quorums.end()) {
                         auto& quorum = quorumIt->second;
                         for (size_t i = 0; i < quorum->members.size(); i++) {
-                            if (!m->count((uint16_t)i)) {
+                            if (!m.count((uint16_t)i)) {
                                 auto& dmn = quorum->members[i];
                                 strMissingMembers += strprintf("\n  %s", dmn->proTxHash.ToString());
                             }
@@ -1247,12 +1360,23 @@ void CSigSharesManager::Cleanup()
 
                 LogPrint("llmq-sigs", "CSigSharesManager::%s -- signing session timed out. signHash=%s, id=%s, msgHash=%s, sigShareCount=%d, missingMembers=%s\n", __func__,
                           signHash.ToString(), oneSigShare.id.ToString(), oneSigShare.msgHash.ToString(), count, strMissingMembers);
-            } else {
+            });
+            if (!found) {
                 LogPrint("llmq-sigs", "CSigSharesManager::%s -- signing session timed out. signHash=%s, sigShareCount=%d\n", __func__,
                           signHash.ToString(), count);
             }
             RemoveSigSharesForSession(signHash);
         }
+
+        // Forget about own signing attempts which never resulted in a session (e.g. when signing failed)
+        int64_t nowMillis = GetTimeMillis();
+        for (auto it = signStartTimes.begin(); it != signStartTimes.end(); ) {
+            if (nowMillis - it->second >= SESSION_NEW_SHARES_TIMEOUT * 1000) {
+                it = signStartTimes.erase(it);
+            } else {
+                ++it;
+            }
+        }
     }
 
     // Find node states for peers that disappeared from CConnman
@@ -1288,7 +1412,7 @@ void CSigSharesManager::RemoveSigSharesForSession(const uint256& signHash)
     sigSharesRequested.EraseAllForSignHash(signHash);
     sigSharesToAnnounce.EraseAllForSignHash(signHash);
     sigShares.EraseAllForSignHash(signHash);
-    timeSeenForSessions.erase(signHash);
+    signStartTimes.erase(signHash);
 }
 
 void CSigSharesManager::RemoveBannedNodeStates()
@@ -1340,6 +1464,7 @@ void CSigSharesManager::BanNode(NodeId nodeId)
 void CSigSharesManager::WorkThreadMain()
 {
     int64_t lastSendTime = 0;
+    bool wokenUp = false;
 
     while (!workInterrupt) {
         if (!quorumSigningManager || !g_connman) {
@@ -1354,9 +1479,13 @@ void CSigSharesManager::WorkThreadMain()
         RemoveBannedNodeStates();
         didWork |= quorumSigningManager->ProcessPendingRecoveredSigs(*g_connman);
         didWork |= ProcessPendingSigShares(*g_connman);
+        didWork |= ProcessFinishedRecoveries(*g_connman);
         didWork |= SignPendingSigShares();
+        quorumSigningManager->FlushPendingWrites();
 
-        if (GetTimeMillis() - lastSendTime > 100) {
+        // Whatever caused new work (incoming messages, own shares, recovered sigs) most likely also results in new
+        // messages to send, so send them right away. The periodic send is only needed to handle request timeouts.
+        if (didWork || wokenUp || GetTimeMillis() - lastSendTime > 100) {
             SendMessages();
             lastSendTime = GetTimeMillis();
         }
@@ -1364,9 +1493,10 @@ void CSigSharesManager::WorkThreadMain()
         Cleanup();
         quorumSigningManager->Cleanup();
 
-        // TODO Wakeup when pending signing is needed?
+        wokenUp = false;
         if (!didWork) {
-            if (!workInterrupt.sleep_for(std::chrono::milliseconds(100))) {
+            wokenUp = workWakeup.WaitFor(workInterrupt, std::chrono::milliseconds(100));
+            if (workInterrupt) {
                 return;
             }
         }
@@ -1375,8 +1505,12 @@ void CSigSharesManager::WorkThreadMain()
 
 void CSigSharesManager::AsyncSign(const CQuorumCPtr& quorum, const uint256& id, const uint256& msgHash)
 {
-    LOCK(cs);
-    pendingSigns.emplace_back(quorum, id, msgHash);
+    {
+        LOCK(cs);
+        pendingSigns.emplace_back(quorum, id, msgHash);
+        signStartTimes.emplace(CLLMQUtils::BuildSignHash(quorum->params.type, quorum->qc.quorumHash, id, msgHash), GetTimeMillis());
+    }
+    WakeupWorkerThread();
 }
 
 bool CSigSharesManager::SignPendingSigShares()
@@ -1387,6 +1521,12 @@ bool CSigSharesManager::SignPendingSigShares()
         v = std::move(pendingSigns);
     }
 
+    if (!v.empty()) {
+        // votes are written before signing is requested, so this makes sure they are on disk before our sig shares
+        // leave this node
+        quorumSigningManager->FlushPendingWrites();
+    }
+
     for (auto& t : v) {
         Sign(std::get<0>(t), std::get<1>(t), std::get<2>(t));
     }
@@ -1441,13 +1581,12 @@ void CSigSharesManager::ForceReAnnouncement(const CQuorumCPtr& quorum, Consensus
 {
 	LOCK(cs);
 	auto signHash = CLLMQUtils::BuildSignHash(llmqType, quorum->qc.quorumHash, id, msgHash);
-	auto sigs = sigShares.GetAllForSignHash(signHash);
-	if (sigs) {
-		for (auto& p : *sigs) {
+	sigShares.WithSigSharesForSignHash(signHash, [&](const SigShareMemberMap<CSigShare>& sigs) {
+		for (auto& p : sigs) {
 			// re-announce every sigshare to every node
 			sigSharesToAnnounce.Add(std::make_pair(signHash, p.first), true);
 		}
-	}
+	});
 	for (auto& p : nodeStates) {
 		CSigSharesNodeState& nodeState = p.second;
 		auto session = nodeState.GetSessionBySignHash(signHash);
@@ -1464,7 +1603,12 @@ void CSigSharesManager::ForceReAnnouncement(const CQuorumCPtr& quorum, Consensus
 void CSigSharesManager::HandleNewRecoveredSig(const llmq::CRecoveredSig& recoveredSig)
 {
     LOCK(cs);
-    RemoveSigSharesForSession(CLLMQUtils::BuildSignHash(recoveredSig));
+    auto signHash = CLLMQUtils::BuildSignHash(recoveredSig);
+    auto it = signStartTimes.find(signHash);
+    if (it != signStartTimes.end()) {
+        latencyStats.Add(LATENCY_RECOVERED_SIG, GetTimeMillis() - it->second);
+    }
+    RemoveSigSharesForSession(signHash);
 }
 
 }
@@ -8,17 +8,22 @@
 #define EPMCOIN_QUORUMS_SIGNING_SHARES_H
 
 #include "bls/bls.h"
+#include "bls/bls_worker.h"
 #include "chainparams.h"
 #include "net.h"
 #include "random.h"
 #include "saltedhasher.h"
 #include "serialize.h"
 #include "sync.h"
+#include "threadinterrupt.h"
 #include "tinyformat.h"
 #include "uint256.h"
 
 #include "llmq/quorums.h"
+#include "llmq/quorums_signing.h"
 
+#include <array>
+#include <limits>
 #include <thread>
 #include <mutex>
 #include <unordered_map>
@@ -133,17 +138,100 @@ public:
     std::string ToInvString() const;
 };
 
+// Maps quorum member indexes to values of a single signing session. Values are kept densely in a vector and a
+// member-indexed slot array gives O(1) lookups without hashing. With up to 400 members per quorum, this is much more
+// cache friendly than a node based map. Erasing moves the last value into the freed slot, so order is not preserved.
+template<typename T>
+class SigShareMemberMap
+{
+public:
+    typedef std::pair<uint16_t, T> value_type;
+    typedef typename std::vector<value_type>::iterator iterator;
+    typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+private:
+    enum : uint16_t { NO_SLOT = std::numeric_limits<uint16_t>::max() };
+
+    std::vector<uint16_t> slots;
+    std::vector<value_type> values;
+
+public:
+    bool emplace(uint16_t quorumMember, const T& v)
+    {
+        if (quorumMember >= slots.size()) {
+            slots.resize(quorumMember + 1, NO_SLOT);
+        }
+        if (slots[quorumMember] != NO_SLOT) {
+            return false;
+        }
+        slots[quorumMember] = (uint16_t)values.size();
+        values.emplace_back(quorumMember, v);
+        return true;
+    }
+
+    bool erase(uint16_t quorumMember)
+    {
+        if (!count(quorumMember)) {
+            return false;
+        }
+        uint16_t slot = slots[quorumMember];
+        if (slot != values.size() - 1) {
+            values[slot] = std::move(values.back());
+            slots[values[slot].first] = slot;
+        }
+        values.pop_back();
+        slots[quorumMember] = NO_SLOT;
+        return true;
+    }
+
+    template<typename F>
+    void erase_if(F&& f)
+    {
+        for (size_t i = 0; i < values.size(); ) {
+            if (f(values[i])) {
+                // moves the last value into slot i, which must then be checked as well
+                erase(values[i].first);
+            } else {
+                i++;
+            }
+        }
+    }
+
+    T* get(uint16_t quorumMember)
+    {
+        return count(quorumMember) ? &values[slots[quorumMember]].second : nullptr;
+    }
+
+    const T* get(uint16_t quorumMember) const
+    {
+        return count(quorumMember) ? &values[slots[quorumMember]].second : nullptr;
+    }
+
+    size_t count(uint16_t quorumMember) const
+    {
+        return quorumMember < slots.size() && slots[quorumMember] != NO_SLOT ? 1 : 0;
+    }
+
+    size_t size() const { return values.size(); }
+    bool empty() const { return values.empty(); }
+
+    iterator begin() { return values.begin(); }
+    iterator end() { return values.end(); }
+    const_iterator begin() const { return values.begin(); }
+    const_iterator end() const { return values.end(); }
+};
+
 template<typename T>
 class SigShareMap
 {
 private:
-    std::unordered_map<uint256, std::unordered_map<uint16_t, T>, StaticSaltedHasher> internalMap;
+    std::unordered_map<uint256, SigShareMemberMap<T>, StaticSaltedHasher> internalMap;
 
 public:
     bool Add(const SigShareKey& k, const T& v)
     {
         auto& m = internalMap[k.first];
-        return m.emplace(k.second, v).second;
+        return m.emplace(k.second, v);
     }
 
     void Erase(const SigShareKey& k)
@@ -178,13 +266,7 @@ public:
         if (it == internalMap.end()) {
             return nullptr;
         }
-
-        auto jt = it->second.find(k.second);
-        if (jt == it->second.end()) {
-            return nullptr;
-        }
-
-        return &jt->second;
+        return it->second.get(k.second);
     }
 
     T& GetOrAdd(const SigShareKey& k)
@@ -228,7 +310,7 @@ public:
         return internalMap.empty();
     }
 
-    const std::unordered_map<uint16_t, T>* GetAllForSignHash(const uint256& signHash)
+    const SigShareMemberMap<T>* GetAllForSignHash(const uint256& signHash)
     {
         auto it = internalMap.find(signHash);
         if (it == internalMap.end()) {
@@ -248,14 +330,10 @@ public:
         for (auto it = internalMap.begin(); it != internalMap.end(); ) {
             SigShareKey k;
             k.first = it->first;
-            for (auto jt = it->second.begin(); jt != it->second.end(); ) {
-                k.second = jt->first;
-                if (f(k, jt->second)) {
-                    jt = it->second.erase(jt);
-                } else {
-                    ++jt;
-                }
-            }
+            it->second.erase_if([&](typename SigShareMemberMap<T>::value_type& p) {
+                k.second = p.first;
+                return f(k, p.second);
+            });
             if (it->second.empty()) {
                 it = internalMap.erase(it);
             } else {
@@ -278,6 +356,66 @@ public:
     }
 };
 
+/**
+ * Stores all verified sig shares, split into shards by signHash. Each shard has its own lock, so that message
+ * handling, recovery and cleanup of different signing sessions don't contend on CSigSharesManager::cs.
+ * CSigSharesManager::cs may be held when calling into the store, but callbacks must never lock it.
+ */
+class CSigSharesStore
+{
+public:
+    static const size_t SHARD_COUNT = 16;
+
+private:
+    struct Shard
+    {
+        CCriticalSection cs;
+        SigShareMap<CSigShare> sigShares;
+        // stores time of last received sig share. Used to detect timeouts
+        std::unordered_map<uint256, int64_t, StaticSaltedHasher> timeSeenForSessions;
+    };
+    std::array<Shard, SHARD_COUNT> shards;
+
+    Shard& GetShard(const uint256& signHash)
+    {
+        return shards[signHash.GetCheapHash() % SHARD_COUNT];
+    }
+
+public:
+    // returns the number of shares known for the session after adding or 0 if the share was already known
+    size_t Add(const CSigShare& sigShare, int64_t nTimeSeen);
+    bool Has(const SigShareKey& k);
+    bool Get(const SigShareKey& k, CSigShare& ret);
+    size_t CountForSignHash(const uint256& signHash);
+    size_t Size();
+    void EraseAllForSignHash(const uint256& signHash);
+    void GetTimedOutSessions(int64_t nTime, int64_t timeout, std::unordered_set<uint256, StaticSaltedHasher>& ret);
+
+    // calls f with all shares of a session while the shard is locked. Returns false if the session is unknown
+    template<typename F>
+    bool WithSigSharesForSignHash(const uint256& signHash, F&& f)
+    {
+        auto& shard = GetShard(signHash);
+        LOCK(shard.cs);
+        auto m = shard.sigShares.GetAllForSignHash(signHash);
+        if (!m) {
+            return false;
+        }
+        f(*m);
+        return true;
+    }
+
+    // calls f for all shares, locking one shard at a time
+    template<typename F>
+    void ForEach(F&& f)
+    {
+        for (auto& shard : shards) {
+            LOCK(shard.cs);
+            shard.sigShares.ForEach(f);
+        }
+    }
+};
+
 class CSigSharesNodeState
 {
 public:
@@ -347,26 +485,31 @@ private:
 
     std::thread workThread;
     CThreadInterrupt workInterrupt;
+    CThreadWakeup workWakeup;
 
-    SigShareMap<CSigShare> sigShares;
-
-    // stores time of last receivedSigShare. Used to detect timeouts
-    std::unordered_map<uint256, int64_t, StaticSaltedHasher> timeSeenForSessions;
+    CSigSharesStore sigShares;
 
     std::unordered_map<NodeId, CSigSharesNodeState> nodeStates;
     SigShareMap<std::pair<NodeId, int64_t>> sigSharesRequested;
     SigShareMap<bool> sigSharesToAnnounce;
 
     std::vector<std::tuple<const CQuorumCPtr, uint256, uint256>> pendingSigns;
+    // time of AsyncSign per signHash, used to measure the latency until the recovered sig is known
+    std::unordered_map<uint256, int64_t, StaticSaltedHasher> signStartTimes;
 
     // must be protected by cs
     FastRandomContext rnd;
 
+    CBLSWorker& blsWorker;
+    // signHashes for which a recovery is running on the BLS worker pool. Used to coalesce concurrent recoveries
+    std::unordered_set<uint256, StaticSaltedHasher> recoveriesInProgress;
+    // recovered sigs which still need to be verified and processed by the worker thread
+    std::vector<std::pair<CRecoveredSig, CQuorumCPtr>> finishedRecoveries;
+
     int64_t lastCleanupTime{0};
-    std::atomic<uint32_t> recoveredSigsCounter{0};
 
 public:
-    CSigSharesManager();
+    CSigSharesManager(CBLSWorker& _blsWorker);
     ~CSigSharesManager();
 
     void StartWorkerThread();
@@ -374,6 +517,8 @@ public:
     void RegisterAsRecoveredSigsListener();
     void UnregisterAsRecoveredSigsListener();
     void InterruptWorkerThread();
+    // wakes up the worker thread so that new work is handled without waiting for the next poll interval
+    void WakeupWorkerThread();
 
 public:
     void ProcessMessage(CNode* pnode, const std::string& strCommand, CDataStream& vRecv, CConnman& connman);
@@ -405,7 +550,8 @@ private:
             CConnman& connman);
 
     void ProcessSigShare(NodeId nodeId, const CSigShare& sigShare, CConnman& connman, const CQuorumCPtr& quorum);
-    void TryRecoverSig(const CQuorumCPtr& quorum, const uint256& id, const uint256& msgHash, CConnman& connman);
+    void TryRecoverSig(const CQuorumCPtr& quorum, const uint256& id, const uint256& msgHash);
+    bool ProcessFinishedRecoveries(CConnman& connman);
 
 private:
     bool GetSessionInfoByRecvId(NodeId nodeId, uint32_t sessionId, CSigSharesNodeState::SessionInfo& retInfo);
@@ -870,7 +870,7 @@ size_t CConnman::SocketSendData(CNode *pnode) const
     size_t nSentSize = 0;
 
     while (it != pnode->vSendMsg.end()) {
-        const auto &data = *it;
+        const auto &data = it->Get();
         assert(data.size() > pnode->nSendOffset);
         int nBytes = 0;
         {
@@ -3228,13 +3228,14 @@ bool CConnman::NodeFullyConnected(const CNode* pnode)
 
 void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg, bool allowOptimisticSend)
 {
-    size_t nMessageSize = msg.data.size();
+    const auto& payload = msg.sharedData ? *msg.sharedData : msg.data;
+    size_t nMessageSize = payload.size();
     size_t nTotalSize = nMessageSize + CMessageHeader::HEADER_SIZE;
     LogPrint("net", "sending %s (%d bytes) peer=%d\n",  SanitizeString(msg.command.c_str()), nMessageSize, pnode->id);
 
     std::vector<unsigned char> serializedHeader;
     serializedHeader.reserve(CMessageHeader::HEADER_SIZE);
-    uint256 hash = Hash(msg.data.data(), msg.data.data() + nMessageSize);
+    uint256 hash = Hash(payload.data(), payload.data() + nMessageSize);
     CMessageHeader hdr(Params().MessageStart(), msg.command.c_str(), nMessageSize);
     memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
 
@@ -3252,9 +3253,13 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg, bool allowOpti
 
         if (pnode->nSendSize > nSendBufferMaxSize)
             pnode->fPauseSend = true;
-        pnode->vSendMsg.push_back(std::move(serializedHeader));
-        if (nMessageSize)
-            pnode->vSendMsg.push_back(std::move(msg.data));
+        pnode->vSendMsg.emplace_back(std::move(serializedHeader));
+        if (nMessageSize) {
+            if (msg.sharedData)
+                pnode->vSendMsg.emplace_back(std::move(msg.sharedData));
+            else
+                pnode->vSendMsg.emplace_back(std::move(msg.data));
+        }
 
         // If write queue empty, attempt "optimistic write"
         if (optimisticSend == true)
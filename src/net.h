@@ -141,9 +141,25 @@ struct CSerializedNetMsg
     CSerializedNetMsg& operator=(const CSerializedNetMsg&) = delete;
 
     std::vector<unsigned char> data;
+    // If set, this is sent instead of data. Allows sending cached messages to multiple peers without copying them
+    std::shared_ptr<const std::vector<unsigned char>> sharedData;
     std::string command;
 };
 
+/** An entry of the send queue of a node, which either owns its data or shares it with a cache */
+class CSendBuffer
+{
+private:
+    std::vector<unsigned char> data;
+    std::shared_ptr<const std::vector<unsigned char>> sharedData;
+
+public:
+    explicit CSendBuffer(std::vector<unsigned char>&& _data) : data(std::move(_data)) {}
+    explicit CSendBuffer(std::shared_ptr<const std::vector<unsigned char>>&& _sharedData) : sharedData(std::move(_sharedData)) {}
+
+    const std::vector<unsigned char>& Get() const { return sharedData ? *sharedData : data; }
+};
+
 
 class CConnman
 {
@@ -725,7 +741,7 @@ public:
     size_t nSendSize; // total size of all vSendMsg entries
     size_t nSendOffset; // offset inside the first vSendMsg already sent
     uint64_t nSendBytes;
-    std::deque<std::vector<unsigned char>> vSendMsg;
+    std::deque<CSendBuffer> vSendMsg;
     CCriticalSection cs_vSend;
     CCriticalSection cs_hSocket;
     CCriticalSection cs_vRecv;
@@ -3055,10 +3055,13 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
 
         LOCK(cs_main);
 
-        CSimplifiedMNListDiff mnListDiff;
+        std::shared_ptr<const std::vector<unsigned char>> mnListDiffData;
         std::string strError;
-        if (BuildSimplifiedMNListDiff(cmd.baseBlockHash, cmd.blockHash, mnListDiff, strError)) {
-            connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MNLISTDIFF, mnListDiff));
+        if (mnListDiffCache->GetSerializedDiff(cmd.baseBlockHash, cmd.blockHash, pfrom->GetSendVersion(), mnListDiffData, strError)) {
+            CSerializedNetMsg msg;
+            msg.command = NetMsgType::MNLISTDIFF;
+            msg.sharedData = mnListDiffData;
+            connman.PushMessage(pfrom, std::move(msg));
         } else {
             LogPrint("net", "getmnlistdiff failed for baseBlockHash=%s, blockHash=%s. error=%s\n", cmd.baseBlockHash.ToString(), cmd.blockHash.ToString(), strError);
             Misbehaving(pfrom->id, 1);
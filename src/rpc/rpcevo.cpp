@@ -24,6 +24,7 @@
 #include "evo/specialtx.h"
 #include "evo/providertx.h"
 #include "evo/deterministicmns.h"
+#include "evo/evocache.h"
 #include "evo/simplifiedmns.h"
 
 #include "bls/bls.h"
@@ -856,6 +857,9 @@ void protx_list_help()
             "  registered   - List all ProTx which are registered at the given chain height.\n"
             "                 This will also include ProTx which failed PoSe verfication.\n"
             "  valid        - List only ProTx which are active/valid at the given chain height.\n"
+            "  payee        - List only ProTx which pay to the given address at the given chain height.\n"
+            "                 Usage: protx list payee \"address\" (\"detailed\" \"height\")\n"
+            "                 This will also include ProTx which failed PoSe verfication.\n"
 #ifdef ENABLE_WALLET
             "  wallet       - List only ProTx which are found in your wallet at the given chain height.\n"
             "                 This will also include ProTx which failed PoSe verfication.\n"
@@ -1004,6 +1008,29 @@ UniValue protx_list(const JSONRPCRequest& request)
         mnList.ForEachMN(onlyValid, [&](const CDeterministicMNCPtr& dmn) {
             ret.push_back(BuildDMNListEntry(pwallet, dmn, detailed));
         });
+    } else if (type == "payee") {
+        if (request.params.size() < 3 || request.params.size() > 5) {
+            protx_list_help();
+        }
+
+        CBitcoinAddress payeeAddress(request.params[2].get_str());
+        if (!payeeAddress.IsValid()) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, strprintf("invalid payee address: %s", request.params[2].get_str()));
+        }
+
+        LOCK(cs_main);
+
+        bool detailed = request.params.size() > 3 ? ParseBoolV(request.params[3], "detailed") : false;
+
+        int height = request.params.size() > 4 ? ParseInt32V(request.params[4], "height") : chainActive.Height();
+        if (height < 1 || height > chainActive.Height()) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "invalid height specified");
+        }
+
+        CDeterministicMNList mnList = deterministicMNManager->GetListForBlock(chainActive[height]);
+        for (const auto& dmn : mnList.GetMNsByPayoutScript(GetScriptForDestination(payeeAddress.Get()))) {
+            ret.push_back(BuildDMNListEntry(pwallet, dmn, detailed));
+        }
     } else {
         throw JSONRPCError(RPC_INVALID_PARAMETER, "invalid type specified");
     }
@@ -1084,7 +1111,7 @@ UniValue protx_diff(const JSONRPCRequest& request)
 
     CSimplifiedMNListDiff mnListDiff;
     std::string strError;
-    if (!BuildSimplifiedMNListDiff(baseBlockHash, blockHash, mnListDiff, strError)) {
+    if (!mnListDiffCache->GetDiff(baseBlockHash, blockHash, mnListDiff, strError)) {
         throw std::runtime_error(strError);
     }
 
@@ -1218,6 +1245,42 @@ UniValue bls_fromsecret(const JSONRPCRequest& request)
     return ret;
 }
 
+void bls_cacheinfo_help()
+{
+    throw std::runtime_error(
+            "bls cacheinfo\n"
+            "\nReturns statistics of the process-wide cache of decoded BLS public keys.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"entries\": n,            (numeric) The number of cached public keys\n"
+            "  \"maxEntries\": n,         (numeric) The maximum number of cached public keys, 0 if the cache is disabled\n"
+            "  \"hits\": n,               (numeric) The number of public keys which did not need to be decoded\n"
+            "  \"misses\": n,             (numeric) The number of public keys which had to be decoded\n"
+            "  \"hitRate\": x.xxx         (numeric) hits / (hits + misses)\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("bls cacheinfo", "")
+    );
+}
+
+UniValue bls_cacheinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1) {
+        bls_cacheinfo_help();
+    }
+
+    auto stats = CBLSPublicKeyCache::GetStats();
+    uint64_t lookups = stats.hits + stats.misses;
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("entries", (int64_t)stats.entries));
+    ret.push_back(Pair("maxEntries", (int64_t)stats.maxSize));
+    ret.push_back(Pair("hits", (int64_t)stats.hits));
+    ret.push_back(Pair("misses", (int64_t)stats.misses));
+    ret.push_back(Pair("hitRate", lookups != 0 ? (double)stats.hits / lookups : 0.0));
+    return ret;
+}
+
 [[ noreturn ]] void bls_help()
 {
     throw std::runtime_error(
@@ -1229,6 +1292,7 @@ UniValue bls_fromsecret(const JSONRPCRequest& request)
             "\nAvailable commands:\n"
             "  generate          - Create a BLS secret/public key pair\n"
             "  fromsecret        - Parse a BLS secret key and return the secret/public key pair\n"
+            "  cacheinfo         - Return statistics of the decoded BLS public key cache\n"
             );
 }
 
@@ -1247,15 +1311,52 @@ UniValue _bls(const JSONRPCRequest& request)
         return bls_generate(request);
     } else if (command == "fromsecret") {
         return bls_fromsecret(request);
+    } else if (command == "cacheinfo") {
+        return bls_cacheinfo(request);
     } else {
         bls_help();
     }
 }
 
+UniValue getevocacheinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0) {
+        throw std::runtime_error(
+                "getevocacheinfo\n"
+                "\nReturns memory usage and hit/miss statistics of the caches sharing the -evocache budget.\n"
+                "\nResult:\n"
+                "{\n"
+                "  \"totalBytes\": n,           (numeric) The total budget configured with -evocache\n"
+                "  \"dbCacheBytes\": n,         (numeric) The part of the budget used as the EvoDB database cache\n"
+                "  \"dbTransactionBytes\": n,   (numeric) Memory used by uncommitted EvoDB writes\n"
+                "  \"caches\": {                (object) Statistics per cache\n"
+                "    \"name\": {\n"
+                "      \"limitBytes\": n,       (numeric) The share of the budget this cache may use\n"
+                "      \"bytes\": n,            (numeric) The estimated memory currently used by this cache\n"
+                "      \"entries\": n,          (numeric) The number of cached entries\n"
+                "      \"hits\": n,             (numeric) The number of lookups answered from the cache\n"
+                "      \"misses\": n,           (numeric) The number of lookups which had to go to disk\n"
+                "      \"hitRate\": x.xxx,      (numeric) hits / (hits + misses)\n"
+                "      \"evictions\": n         (numeric) The number of entries evicted to stay within limitBytes\n"
+                "    }, ...\n"
+                "  }\n"
+                "}\n"
+                "\nExamples:\n"
+                + HelpExampleCli("getevocacheinfo", "")
+                + HelpExampleRpc("getevocacheinfo", "")
+        );
+    }
+
+    UniValue ret;
+    evoCacheBudget.ToJson(ret);
+    return ret;
+}
+
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         okSafeMode
   //  --------------------- ------------------------  -----------------------  ----------
     { "evo",                "bls",                    &_bls,                   false, {}  },
+    { "evo",                "getevocacheinfo",        &getevocacheinfo,        true,  {}  },
     { "evo",                "protx",                  &protx,                  false, {}  },
 };
 
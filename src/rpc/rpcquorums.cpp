@@ -10,6 +10,8 @@
 #include "llmq/quorums_blockprocessor.h"
 #include "llmq/quorums_debug.h"
 #include "llmq/quorums_dkgsession.h"
+#include "llmq/quorums_instantsend.h"
+#include "llmq/quorums_latency.h"
 #include "llmq/quorums_signing.h"
 
 void quorum_list_help()
@@ -371,6 +373,53 @@ UniValue quorum_dkgsimerror(const JSONRPCRequest& request)
     return UniValue();
 }
 
+void quorum_latency_help()
+{
+    throw std::runtime_error(
+            "quorum latency ( reset )\n"
+            "Return histograms (in milliseconds) of the latencies observed by this node for recovered signatures\n"
+            "(own signing request until recovery), InstantSend locks (TX first seen until ISLOCK) and ChainLocks\n"
+            "(new tip until CLSIG).\n"
+            "\nArguments:\n"
+            "1. reset                 (boolean, optional, default=false) Reset all histograms after returning them.\n"
+    );
+}
+
+UniValue quorum_latency(const JSONRPCRequest& request)
+{
+    if (request.fHelp || (request.params.size() < 1 || request.params.size() > 2)) {
+        quorum_latency_help();
+    }
+
+    bool reset = false;
+    if (request.params.size() > 1) {
+        reset = ParseBoolV(request.params[1], "reset");
+    }
+
+    auto ret = llmq::latencyStats.ToJson();
+    if (reset) {
+        llmq::latencyStats.Reset();
+    }
+    return ret;
+}
+
+void quorum_instantsendinfo_help()
+{
+    throw std::runtime_error(
+            "quorum instantsendinfo\n"
+            "Return the number of entries and the estimated memory usage (in bytes) of the in-memory structures\n"
+            "used by the LLMQ based InstantSend manager.\n"
+    );
+}
+
+UniValue quorum_instantsendinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1) {
+        quorum_instantsendinfo_help();
+    }
+
+    return llmq::quorumInstantSendManager->GetMemoryInfo();
+}
 
 [[ noreturn ]] void quorum_help()
 {
@@ -390,6 +439,8 @@ UniValue quorum_dkgsimerror(const JSONRPCRequest& request)
             "  hasrecsig         - Test if a valid recovered signature is present\n"
             "  getrecsig         - Get a recovered signature\n"
             "  isconflicting     - Test if a conflict exists\n"
+            "  latency           - Return signing and locking latency histograms\n"
+            "  instantsendinfo   - Return memory usage of the InstantSend manager\n"
     );
 }
 
@@ -416,6 +467,10 @@ UniValue quorum(const JSONRPCRequest& request)
         return quorum_sigs_cmd(request);
     } else if (command == "dkgsimerror") {
         return quorum_dkgsimerror(request);
+    } else if (command == "latency") {
+        return quorum_latency(request);
+    } else if (command == "instantsendinfo") {
+        return quorum_instantsendinfo(request);
     } else {
         quorum_help();
     }
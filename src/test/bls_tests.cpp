@@ -6,6 +6,8 @@
 
 #include "bls/bls.h"
 #include "bls/bls_batchverifier.h"
+#include "bls/bls_sigcache.h"
+#include "bls/bls_worker.h"
 #include "test/test_epmcoin.h"
 
 #include <boost/test/unit_test.hpp>
@@ -48,6 +50,77 @@ BOOST_AUTO_TEST_CASE(bls_sig_tests)
     BOOST_CHECK(sig2.VerifyInsecure(sk2.GetPublicKey(), msgHash1));
 }
 
+BOOST_AUTO_TEST_CASE(bls_pubkey_cache_tests)
+{
+    CBLSSecretKey sk;
+    sk.MakeNewKey();
+    auto pk = sk.GetPublicKey();
+    std::vector<unsigned char> buf;
+    pk.GetBuf(buf);
+
+    auto stats1 = CBLSPublicKeyCache::GetStats();
+
+    // the first deserialization decodes the key, the following ones are served from the cache
+    CBLSPublicKey pk1, pk2;
+    pk1.SetBuf(buf);
+    pk2.SetBuf(buf);
+    BOOST_CHECK(pk1 == pk && pk2 == pk);
+
+    auto stats2 = CBLSPublicKeyCache::GetStats();
+    BOOST_CHECK_EQUAL(stats2.misses, stats1.misses + 1);
+    BOOST_CHECK_EQUAL(stats2.hits, stats1.hits + 1);
+
+    // lazy keys go through the same cache
+    CBLSLazyPublicKey lazyPk;
+    CDataStream ds(SER_NETWORK, PROTOCOL_VERSION);
+    ds << pk;
+    ds >> lazyPk;
+    BOOST_CHECK(lazyPk.Get() == pk);
+    BOOST_CHECK_EQUAL(CBLSPublicKeyCache::GetStats().hits, stats2.hits + 1);
+
+    // invalid keys are never cached
+    std::vector<unsigned char> invalidBuf(CBLSPublicKey::SerSize, 0xff);
+    CBLSPublicKey pk3;
+    pk3.SetBuf(invalidBuf);
+    pk3.SetBuf(invalidBuf);
+    BOOST_CHECK(!pk3.IsValid());
+    BOOST_CHECK_EQUAL(CBLSPublicKeyCache::GetStats().hits, stats2.hits + 1);
+
+    // disabling the cache forces decoding
+    CBLSPublicKeyCache::SetMaxSize(0);
+    CBLSPublicKey pk4;
+    pk4.SetBuf(buf);
+    BOOST_CHECK(pk4 == pk);
+    BOOST_CHECK_EQUAL(CBLSPublicKeyCache::GetStats().entries, 0);
+    BOOST_CHECK_EQUAL(CBLSPublicKeyCache::GetStats().hits, stats2.hits + 1);
+    CBLSPublicKeyCache::SetMaxSize(CBLSPublicKeyCache::DEFAULT_MAX_SIZE);
+}
+
+BOOST_AUTO_TEST_CASE(bls_sigcache_tests)
+{
+    CBLSSecretKey sk1, sk2;
+    sk1.MakeNewKey();
+    sk2.MakeNewKey();
+    uint256 msgHash = GetRandHash();
+    auto sig1 = sk1.Sign(msgHash);
+
+    BOOST_CHECK(!IsBLSSigCached(sig1, sk1.GetPublicKey(), msgHash));
+    BOOST_CHECK(VerifyBLSSigCached(sig1, sk1.GetPublicKey(), msgHash));
+    BOOST_CHECK(IsBLSSigCached(sig1, sk1.GetPublicKey(), msgHash));
+
+    // invalid sigs are never cached
+    BOOST_CHECK(!VerifyBLSSigCached(sig1, sk2.GetPublicKey(), msgHash));
+    BOOST_CHECK(!IsBLSSigCached(sig1, sk2.GetPublicKey(), msgHash));
+
+    // secure aggregated entries don't collide with insecure ones
+    auto aggSig = CBLSSignature::AggregateSecure({sig1, sk2.Sign(msgHash)}, {sk1.GetPublicKey(), sk2.GetPublicKey()}, msgHash);
+    BOOST_CHECK(VerifySecureAggregatedBLSSigCached(aggSig, {sk1.GetPublicKey(), sk2.GetPublicKey()}, msgHash));
+    BOOST_CHECK(!IsBLSSigCached(aggSig, sk1.GetPublicKey(), msgHash));
+
+    ClearBLSSigCache();
+    BOOST_CHECK(!IsBLSSigCached(sig1, sk1.GetPublicKey(), msgHash));
+}
+
 struct Message
 {
     uint32_t sourceId;
@@ -79,9 +152,12 @@ static void AddMessage(std::vector<Message>& vec, uint32_t sourceId, uint32_t ms
     vec.emplace_back(m);
 }
 
-static void Verify(std::vector<Message>& vec, bool secureVerification, bool perMessageFallback)
+static void Verify(std::vector<Message>& vec, bool secureVerification, bool perMessageFallback, CBLSWorker* worker = nullptr)
 {
     CBLSBatchVerifier<uint32_t, uint32_t> batchVerifier(secureVerification, perMessageFallback);
+    if (worker) {
+        batchVerifier.EnableParallelVerification(*worker, 1);
+    }
 
     std::set<uint32_t> expectedBadMessages;
     std::set<uint32_t> expectedBadSources;
@@ -111,6 +187,11 @@ static void Verify(std::vector<Message>& vec)
     Verify(vec, true, false);
     Verify(vec, false, true);
     Verify(vec, true, true);
+
+    CBLSWorker worker;
+    worker.Start();
+    Verify(vec, false, true, &worker);
+    Verify(vec, true, true, &worker);
 }
 
 BOOST_AUTO_TEST_CASE(batch_verifier_tests)
@@ -154,6 +235,85 @@ BOOST_AUTO_TEST_CASE(batch_verifier_tests)
     // last message invalid from one source
     AddMessage(msgs, 1, 7, 1, false);
     Verify(msgs);
+
+    msgs.clear();
+    // many sources with a few invalid messages spread over them, which are isolated by bisection
+    for (uint32_t i = 0; i < 40; i++) {
+        AddMessage(msgs, i / 4, i, i + 1, i % 13 != 5);
+    }
+    Verify(msgs);
+}
+
+BOOST_AUTO_TEST_CASE(verify_sigs_bisect_tests)
+{
+    BOOST_CHECK(CBLSWorker::VerifySigsBisect({}, {}, {}).empty());
+
+    // no invalid sigs, a single invalid one, the first one, the last one and several adjacent/spread ones
+    std::vector<std::set<size_t>> invalidSets = {{}, {5}, {0}, {12}, {3, 4, 5}, {1, 6, 7, 11}};
+    for (const auto& invalid : invalidSets) {
+        std::vector<Message> msgs;
+        for (size_t i = 0; i < 13; i++) {
+            AddMessage(msgs, 1, i, i + 1, !invalid.count(i));
+        }
+
+        BLSSignatureVector sigs;
+        BLSPublicKeyVector pubKeys;
+        std::vector<uint256> msgHashes;
+        for (auto& m : msgs) {
+            sigs.emplace_back(m.sig);
+            pubKeys.emplace_back(m.pk);
+            msgHashes.emplace_back(m.msgHash);
+        }
+
+        auto result = CBLSWorker::VerifySigsBisect(sigs, pubKeys, msgHashes);
+        BOOST_REQUIRE(result.size() == msgs.size());
+        for (size_t i = 0; i < msgs.size(); i++) {
+            BOOST_CHECK(result[i] == msgs[i].valid);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(vvec_table_tests)
+{
+    BOOST_CHECK(CBLSVerificationVectorTable::Build({}) == nullptr);
+    BOOST_CHECK(CBLSVerificationVectorTable::Build({CBLSPublicKey()}) == nullptr);
+
+    for (size_t threshold : {1, 2, 30}) {
+        BLSSecretKeyVector msk(threshold);
+        BLSVerificationVector vvec;
+        for (auto& sk : msk) {
+            sk.MakeNewKey();
+            vvec.emplace_back(sk.GetPublicKey());
+        }
+
+        auto table = CBLSVerificationVectorTable::Build(vvec);
+        BOOST_REQUIRE(table != nullptr);
+        BOOST_CHECK_EQUAL(table->GetCoefficientCount(), threshold);
+
+        BLSIdVector ids;
+        for (int i = 0; i < 10; i++) {
+            ids.emplace_back(CBLSId::FromHash(GetRandHash()));
+        }
+        ids.emplace_back();
+
+        // tables, the batched variant and the shares of the secret keys all agree with PublicKeyShare
+        BLSPublicKeyVector pkShares;
+        BOOST_CHECK(CBLSPublicKey::PublicKeyShares(vvec, ids, pkShares));
+        BOOST_REQUIRE(pkShares.size() == ids.size());
+        for (size_t i = 0; i < ids.size(); i++) {
+            CBLSPublicKey pkShare1, pkShare2;
+            bool valid = ids[i].IsValid();
+            BOOST_CHECK(pkShare1.PublicKeyShare(vvec, ids[i]) == valid);
+            BOOST_CHECK(table->Evaluate(ids[i], pkShare2) == valid);
+            BOOST_CHECK(pkShare1 == pkShare2);
+            BOOST_CHECK(pkShares[i] == pkShare1);
+            if (valid) {
+                CBLSSecretKey skShare;
+                BOOST_CHECK(skShare.SecretKeyShare(msk, ids[i]));
+                BOOST_CHECK(skShare.GetPublicKey() == pkShare2);
+            }
+        }
+    }
 }
 
 BOOST_AUTO_TEST_SUITE_END()
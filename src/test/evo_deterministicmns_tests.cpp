@@ -19,6 +19,10 @@
 #include "evo/specialtx.h"
 #include "evo/providertx.h"
 #include "evo/deterministicmns.h"
+#include "evo/evocache.h"
+#include "evo/evodb.h"
+#include "evo/simplifiedmns.h"
+#include "llmq/quorums_commitment.h"
 
 #include <boost/test/unit_test.hpp>
 
@@ -334,6 +338,7 @@ BOOST_FIXTURE_TEST_CASE(dip3_protx, TestChainDIP3Setup)
 
     auto dmn = deterministicMNManager->GetListAtChainTip().GetMN(dmnHashes[0]);
     BOOST_ASSERT(dmn != nullptr && dmn->pdmnState->addr.GetPort() == 1000);
+    BOOST_ASSERT(deterministicMNManager->GetListAtChainTip().GetMNByOperatorKey(operatorKeys[dmnHashes[0]].GetPublicKey()) == dmn);
 
     // test ProUpRevTx
     tx = CreateProUpRevTx(utxos, dmnHashes[0], operatorKeys[dmnHashes[0]], coinbaseKey);
@@ -401,6 +406,230 @@ BOOST_FIXTURE_TEST_CASE(dip3_protx, TestChainDIP3Setup)
     }
     BOOST_ASSERT(foundRevived);
 
+    // test that the compact encodings of lists and diffs roundtrip
+    auto tipList = deterministicMNManager->GetListAtChainTip();
+    auto prevList = deterministicMNManager->GetListForBlock(chainActive.Tip()->pprev->pprev);
+    CDataStream ds(SER_DISK, CLIENT_VERSION);
+    ds << CDeterministicMNListCompact(tipList);
+    CDeterministicMNListCompact compactList;
+    ds >> compactList;
+    BOOST_CHECK_EQUAL(compactList.list.GetBlockHash().ToString(), tipList.GetBlockHash().ToString());
+    BOOST_CHECK_EQUAL(compactList.list.GetTotalRegisteredCount(), tipList.GetTotalRegisteredCount());
+    BOOST_ASSERT(!tipList.BuildDiff(compactList.list).HasChanges());
+    BOOST_ASSERT(::SerializeHash(tipList) == ::SerializeHash(compactList.list));
+
+    auto diff = prevList.BuildDiff(tipList);
+    ds << CDeterministicMNListDiffCompact(diff);
+    CDeterministicMNListDiffCompact compactDiff;
+    ds >> compactDiff;
+    auto appliedList = prevList.ApplyDiff(chainActive.Tip(), compactDiff.diff);
+    BOOST_ASSERT(::SerializeHash(appliedList) == ::SerializeHash(tipList));
+
+    // test that the MN list cache accounts for its entries
+    {
+        const auto& cacheStats = evoCacheBudget.GetStats(EVO_CACHE_MN_LISTS);
+        BOOST_CHECK(cacheStats.nEntries > 0);
+        BOOST_CHECK(cacheStats.nBytes > 0);
+        BOOST_CHECK(cacheStats.nHits + cacheStats.nMisses > 0);
+    }
+
+    // test that cached MN list diffs match freshly built ones and are only serialized once
+    {
+        LOCK(cs_main);
+        CSimplifiedMNListDiff mnListDiff;
+        std::string strError;
+        BOOST_ASSERT(BuildSimplifiedMNListDiff(uint256(), chainActive.Tip()->GetBlockHash(), mnListDiff, strError));
+        std::vector<unsigned char> vExpected;
+        CVectorWriter(SER_NETWORK, PROTOCOL_VERSION, vExpected, 0, mnListDiff);
+
+        std::shared_ptr<const std::vector<unsigned char>> data1, data2;
+        BOOST_ASSERT(mnListDiffCache->GetSerializedDiff(uint256(), chainActive.Tip()->GetBlockHash(), PROTOCOL_VERSION, data1, strError));
+        BOOST_ASSERT(mnListDiffCache->GetSerializedDiff(uint256(), chainActive.Tip()->GetBlockHash(), PROTOCOL_VERSION, data2, strError));
+        BOOST_ASSERT(*data1 == vExpected);
+        BOOST_ASSERT(data1 == data2);
+        BOOST_CHECK(mnListDiffCache->GetMemoryUsage() >= data1->size());
+        BOOST_CHECK(mnListDiffCache->GetMemoryUsage() <= MNLISTDIFF_CACHE_MAX_BYTES);
+    }
+
     const_cast<Consensus::Params&>(Params().GetConsensus()).DIP0003EnforcementHeight = DIP0003EnforcementHeightBackup;
 }
+
+// Writes a snapshot with mnCount MNs for the first block and diffs with updateCount changed MNs for each of the
+// following blocks
+static void BuildMNListChain(CEvoDB& evoDb, size_t mnCount, size_t diffCount, size_t updateCount, std::vector<uint256>& blockHashesRet, std::vector<CBlockIndex>& indexesRet)
+{
+    blockHashesRet.resize(diffCount + 1);
+    indexesRet.resize(diffCount + 1);
+    for (size_t i = 0; i < indexesRet.size(); i++) {
+        blockHashesRet[i] = GetRandHash();
+        indexesRet[i].phashBlock = &blockHashesRet[i];
+        indexesRet[i].nHeight = (int)i;
+        indexesRet[i].pprev = i > 0 ? &indexesRet[i - 1] : nullptr;
+    }
+
+    CDeterministicMNList mnList(blockHashesRet[0], 0, 0);
+    std::vector<uint256> proTxHashes;
+    for (size_t i = 0; i < mnCount; i++) {
+        uint160 ownerKeyHash;
+        GetRandBytes(ownerKeyHash.begin(), ownerKeyHash.size());
+
+        auto dmnState = std::make_shared<CDeterministicMNState>();
+        dmnState->keyIDOwner = CKeyID(ownerKeyHash);
+
+        auto dmn = std::make_shared<CDeterministicMN>();
+        dmn->proTxHash = GetRandHash();
+        dmn->internalId = i;
+        dmn->collateralOutpoint = COutPoint(GetRandHash(), 0);
+        dmn->pdmnState = dmnState;
+        mnList.AddMN(dmn);
+        proTxHashes.emplace_back(dmn->proTxHash);
+    }
+    evoDb.Write(std::make_pair(std::string("dmn_S2"), blockHashesRet[0]), CDeterministicMNListCompact(mnList));
+
+    for (size_t i = 1; i < indexesRet.size(); i++) {
+        CDeterministicMNList newList = mnList;
+        newList.SetBlockHash(blockHashesRet[i]);
+        newList.SetHeight((int)i);
+        for (size_t j = 0; j < updateCount; j++) {
+            auto dmn = newList.GetMN(proTxHashes[(i * updateCount + j) % proTxHashes.size()]);
+            auto newState = std::make_shared<CDeterministicMNState>(*dmn->pdmnState);
+            newState->nPoSePenalty++;
+            newList.UpdateMN(dmn->proTxHash, newState);
+        }
+        evoDb.Write(std::make_pair(std::string("dmn_D2"), blockHashesRet[i]), CDeterministicMNListDiffCompact(mnList.BuildDiff(newList)));
+        mnList = newList;
+    }
+    evoDb.CommitRootTransaction();
+}
+
+BOOST_FIXTURE_TEST_CASE(dip3_mnlist_cache_budget, BasicTestingSetup)
+{
+    static const size_t diffCount = 10;
+
+    size_t nTotalBytesBackup = evoCacheBudget.GetTotalBytes();
+    const auto& cacheStats = evoCacheBudget.GetStats(EVO_CACHE_MN_LISTS);
+    auto setLimit = [](size_t nLimit) {
+        // GetLimit() is 45% of the total, rounded down per percent
+        evoCacheBudget.SetTotalBytes((nLimit / 45 + 1) * 100);
+        BOOST_ASSERT(evoCacheBudget.GetLimit(EVO_CACHE_MN_LISTS) >= nLimit);
+        BOOST_ASSERT(evoCacheBudget.GetLimit(EVO_CACHE_MN_LISTS) <= nLimit + 45);
+    };
+
+    CEvoDB evoDb(1 << 20, true, true);
+    std::vector<uint256> blockHashes;
+    std::vector<CBlockIndex> indexes;
+    BuildMNListChain(evoDb, 100, diffCount, 5, blockHashes, indexes);
+
+    evoCacheBudget.SetTotalBytes(DEFAULT_EVO_CACHE_SIZE << 20);
+
+    // a list loaded from a snapshot is charged in full
+    size_t nFullBytes;
+    {
+        CDeterministicMNManager mnManager(evoDb);
+        mnManager.GetListForBlock(&indexes[0]);
+        BOOST_CHECK_EQUAL((size_t)cacheStats.nEntries, 1U);
+        nFullBytes = cacheStats.nBytes;
+    }
+
+    // lists built from diffs only add the changed entries as long as their base is cached
+    size_t nDiffBytes;
+    {
+        CDeterministicMNManager mnManager(evoDb);
+        mnManager.GetListForBlock(&indexes.back());
+        BOOST_CHECK_EQUAL((size_t)cacheStats.nEntries, diffCount + 1);
+        nDiffBytes = (cacheStats.nBytes - nFullBytes) / diffCount;
+        BOOST_CHECK_EQUAL((size_t)cacheStats.nBytes, nFullBytes + diffCount * nDiffBytes);
+        BOOST_CHECK(nDiffBytes * 4 < nFullBytes);
+    }
+
+    // evicting a base charges the list built from it in full, so the budget is kept by evicting the oldest lists
+    // until only the lists which fit as diffs on top of one full list are left
+    {
+        setLimit(nFullBytes + 5 * nDiffBytes + nDiffBytes / 2);
+        CDeterministicMNManager mnManager(evoDb);
+        uint64_t nEvictionsBefore = cacheStats.nEvictions;
+        mnManager.GetListForBlock(&indexes.back());
+        BOOST_CHECK_EQUAL((size_t)cacheStats.nEntries, 6U);
+        BOOST_CHECK_EQUAL((size_t)cacheStats.nBytes, nFullBytes + 5 * nDiffBytes);
+        BOOST_CHECK(cacheStats.nBytes <= evoCacheBudget.GetLimit(EVO_CACHE_MN_LISTS));
+        BOOST_CHECK_EQUAL(cacheStats.nEvictions - nEvictionsBefore, (uint64_t)(diffCount - 5));
+
+        // the newest lists are kept and served from the cache, the oldest ones were evicted
+        uint64_t nHitsBefore = cacheStats.nHits;
+        uint64_t nMissesBefore = cacheStats.nMisses;
+        for (size_t i = diffCount - 5; i <= diffCount; i++) {
+            mnManager.GetListForBlock(&indexes[i]);
+        }
+        BOOST_CHECK_EQUAL(cacheStats.nHits - nHitsBefore, 6U);
+        BOOST_CHECK_EQUAL((uint64_t)cacheStats.nMisses, nMissesBefore);
+        mnManager.GetListForBlock(&indexes[diffCount - 6]);
+        BOOST_CHECK_EQUAL(cacheStats.nMisses - nMissesBefore, 1U);
+    }
+
+    // the newest list is always kept, but charged in full once nothing else is left
+    {
+        setLimit(nFullBytes / 2);
+        CDeterministicMNManager mnManager(evoDb);
+        mnManager.GetListForBlock(&indexes.back());
+        BOOST_CHECK_EQUAL((size_t)cacheStats.nEntries, 1U);
+        BOOST_CHECK_EQUAL((size_t)cacheStats.nBytes, nFullBytes);
+    }
+
+    evoCacheBudget.SetTotalBytes(nTotalBytesBackup);
+}
+
+BOOST_FIXTURE_TEST_CASE(dip3_payout_script_index, BasicTestingSetup)
+{
+    CScript scriptPayout1 = GenerateRandomAddress();
+    CScript scriptPayout2 = GenerateRandomAddress();
+
+    auto matches = [](const std::vector<CDeterministicMNCPtr>& dmns, std::set<uint256> proTxHashes) {
+        for (const auto& dmn : dmns) {
+            if (!proTxHashes.erase(dmn->proTxHash)) {
+                return false;
+            }
+        }
+        return proTxHashes.empty();
+    };
+
+    CDeterministicMNList mnList(uint256(), 0, 0);
+    std::vector<uint256> proTxHashes;
+    for (size_t i = 0; i < 4; i++) {
+        CKey ownerKey;
+        ownerKey.MakeNewKey(true);
+
+        auto dmnState = std::make_shared<CDeterministicMNState>();
+        dmnState->keyIDOwner = ownerKey.GetPubKey().GetID();
+        dmnState->scriptPayout = i < 3 ? scriptPayout1 : scriptPayout2;
+
+        auto dmn = std::make_shared<CDeterministicMN>();
+        dmn->proTxHash = GetRandHash();
+        dmn->internalId = i;
+        dmn->collateralOutpoint = COutPoint(GetRandHash(), 0);
+        dmn->pdmnState = dmnState;
+        mnList.AddMN(dmn);
+        proTxHashes.emplace_back(dmn->proTxHash);
+    }
+    BOOST_CHECK(matches(mnList.GetMNsByPayoutScript(scriptPayout1), {proTxHashes[0], proTxHashes[1], proTxHashes[2]}));
+    BOOST_CHECK(matches(mnList.GetMNsByPayoutScript(scriptPayout2), {proTxHashes[3]}));
+    BOOST_CHECK(mnList.GetMNsByPayoutScript(GenerateRandomAddress()).empty());
+
+    // changing the payout script moves the MN to the new script
+    auto newState = std::make_shared<CDeterministicMNState>(*mnList.GetMN(proTxHashes[1])->pdmnState);
+    newState->scriptPayout = scriptPayout2;
+    mnList.UpdateMN(proTxHashes[1], newState);
+    BOOST_CHECK(matches(mnList.GetMNsByPayoutScript(scriptPayout1), {proTxHashes[0], proTxHashes[2]}));
+    BOOST_CHECK(matches(mnList.GetMNsByPayoutScript(scriptPayout2), {proTxHashes[1], proTxHashes[3]}));
+
+    // removed MNs are dropped from the index, copies of the list keep their own index
+    CDeterministicMNList oldList = mnList;
+    mnList.RemoveMN(proTxHashes[0]);
+    mnList.RemoveMN(proTxHashes[3]);
+    BOOST_CHECK(matches(mnList.GetMNsByPayoutScript(scriptPayout1), {proTxHashes[2]}));
+    BOOST_CHECK(matches(mnList.GetMNsByPayoutScript(scriptPayout2), {proTxHashes[1]}));
+    BOOST_CHECK(matches(oldList.GetMNsByPayoutScript(scriptPayout1), {proTxHashes[0], proTxHashes[2]}));
+
+    mnList.RemoveMN(proTxHashes[2]);
+    BOOST_CHECK(mnList.GetMNsByPayoutScript(scriptPayout1).empty());
+}
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,123 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "clientversion.h"
+#include "evo/deterministicmns.h"
+#include "governance-object.h"
+#include "governance-vote.h"
+#include "random.h"
+#include "streams.h"
+#include "utiltime.h"
+
+#include "test/test_epmcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(governance_object_tests, TestingSetup)
+
+// counts the current votes one by one, which is what the tally replaces
+static int CountCurrentVotes(const CGovernanceObject& govobj, const std::vector<TestMasternode>& mns, int nSignal, vote_outcome_enum_t eOutcome)
+{
+    int nCount = 0;
+    for (const auto& mn : mns) {
+        vote_rec_t voteRecord;
+        if (!govobj.GetCurrentMNVotes(mn.collateralOutpoint, voteRecord)) {
+            continue;
+        }
+        auto it = voteRecord.mapInstances.find(nSignal);
+        if (it != voteRecord.mapInstances.end() && it->second.eOutcome == eOutcome) {
+            nCount++;
+        }
+    }
+    return nCount;
+}
+
+static void CheckTally(const CGovernanceObject& govobj, const std::vector<TestMasternode>& mns)
+{
+    for (int nSignal = VOTE_SIGNAL_FUNDING; nSignal <= MAX_SUPPORTED_VOTE_SIGNAL; nSignal++) {
+        for (int nOutcome = VOTE_OUTCOME_YES; nOutcome <= VOTE_OUTCOME_ABSTAIN; nOutcome++) {
+            auto eSignal = (vote_signal_enum_t)nSignal;
+            auto eOutcome = (vote_outcome_enum_t)nOutcome;
+            BOOST_CHECK_EQUAL(govobj.CountMatchingVotes(eSignal, eOutcome), CountCurrentVotes(govobj, mns, nSignal, eOutcome));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(vote_tally)
+{
+    int64_t nTime = GetTime();
+    SetMockTime(nTime);
+
+    std::vector<TestMasternode> mns;
+    auto mnList = CreateTestMNList(mns, 4);
+
+    CGovernanceObject govobj = CreateTestProposal(nTime);
+    uint256 nHash = govobj.GetHash();
+
+    auto processVote = [&](size_t nMN, vote_signal_enum_t eSignal, vote_outcome_enum_t eOutcome) {
+        return GovernanceTestAccess::ProcessVote(govobj, CGovernanceVote(mns[nMN].collateralOutpoint, nHash, eSignal, eOutcome), mnList);
+    };
+
+    // new votes
+    BOOST_CHECK(processVote(0, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES));
+    BOOST_CHECK(processVote(1, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES));
+    BOOST_CHECK(processVote(2, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_NO));
+    BOOST_CHECK(processVote(3, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_ABSTAIN));
+    BOOST_CHECK(processVote(0, VOTE_SIGNAL_VALID, VOTE_OUTCOME_YES));
+    BOOST_CHECK(processVote(1, VOTE_SIGNAL_DELETE, VOTE_OUTCOME_NO));
+    // votes of unknown masternodes are not counted
+    BOOST_CHECK(!GovernanceTestAccess::ProcessVote(govobj, CGovernanceVote(COutPoint(GetRandHash(), 0), nHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES), mnList));
+    BOOST_CHECK_EQUAL(govobj.GetYesCount(VOTE_SIGNAL_FUNDING), 2);
+    BOOST_CHECK_EQUAL(govobj.GetNoCount(VOTE_SIGNAL_FUNDING), 1);
+    BOOST_CHECK_EQUAL(govobj.GetAbstainCount(VOTE_SIGNAL_FUNDING), 1);
+    BOOST_CHECK_EQUAL(govobj.GetAbsoluteYesCount(VOTE_SIGNAL_VALID), 1);
+    BOOST_CHECK_EQUAL(govobj.GetAbsoluteNoCount(VOTE_SIGNAL_DELETE), 1);
+    CheckTally(govobj, mns);
+
+    // newer votes replace the older ones of the same masternode and signal
+    SetMockTime(nTime + GOVERNANCE_UPDATE_MIN + 1);
+    BOOST_CHECK(processVote(0, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_NO));
+    BOOST_CHECK(processVote(1, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES));
+    BOOST_CHECK_EQUAL(govobj.GetYesCount(VOTE_SIGNAL_FUNDING), 1);
+    BOOST_CHECK_EQUAL(govobj.GetNoCount(VOTE_SIGNAL_FUNDING), 2);
+    BOOST_CHECK_EQUAL(govobj.GetAbstainCount(VOTE_SIGNAL_FUNDING), 1);
+    BOOST_CHECK_EQUAL(govobj.GetVoteFile().GetVoteCount(), 6);
+    CheckTally(govobj, mns);
+
+    // the tally is not serialized, but rebuilt from the current votes
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << govobj;
+    CGovernanceObject govobj2;
+    ss >> govobj2;
+    for (int nSignal = VOTE_SIGNAL_FUNDING; nSignal <= MAX_SUPPORTED_VOTE_SIGNAL; nSignal++) {
+        for (int nOutcome = VOTE_OUTCOME_YES; nOutcome <= VOTE_OUTCOME_ABSTAIN; nOutcome++) {
+            auto eSignal = (vote_signal_enum_t)nSignal;
+            auto eOutcome = (vote_outcome_enum_t)nOutcome;
+            BOOST_CHECK_EQUAL(govobj2.CountMatchingVotes(eSignal, eOutcome), govobj.CountMatchingVotes(eSignal, eOutcome));
+        }
+    }
+    CheckTally(govobj2, mns);
+
+    // the votes of masternodes which are not in the list at the chain tip are invalid
+    BOOST_CHECK_EQUAL(GovernanceTestAccess::RemoveInvalidVotes(govobj, mns[0].collateralOutpoint).size(), 2);
+    BOOST_CHECK(GovernanceTestAccess::RemoveInvalidVotes(govobj, mns[0].collateralOutpoint).empty());
+    BOOST_CHECK_EQUAL(govobj.GetYesCount(VOTE_SIGNAL_FUNDING), 1);
+    BOOST_CHECK_EQUAL(govobj.GetNoCount(VOTE_SIGNAL_FUNDING), 1);
+    BOOST_CHECK_EQUAL(govobj.GetAbsoluteYesCount(VOTE_SIGNAL_VALID), 0);
+    CheckTally(govobj, mns);
+
+    // the same goes for all of them
+    GovernanceTestAccess::ClearMasternodeVotes(govobj);
+    BOOST_CHECK_EQUAL(govobj.GetVoteFile().GetVoteCount(), 0);
+    for (int nSignal = VOTE_SIGNAL_FUNDING; nSignal <= MAX_SUPPORTED_VOTE_SIGNAL; nSignal++) {
+        for (int nOutcome = VOTE_OUTCOME_YES; nOutcome <= VOTE_OUTCOME_ABSTAIN; nOutcome++) {
+            BOOST_CHECK_EQUAL(govobj.CountMatchingVotes((vote_signal_enum_t)nSignal, (vote_outcome_enum_t)nOutcome), 0);
+        }
+    }
+    CheckTally(govobj, mns);
+
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
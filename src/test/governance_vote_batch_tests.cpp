@@ -0,0 +1,107 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "governance.h"
+#include "governance-object.h"
+#include "governance-vote.h"
+#include "masternode-sync.h"
+#include "random.h"
+
+#include "test/test_epmcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(governance_vote_batch_tests, TestingSetup)
+
+static CGovernanceVote MakeVote(const TestMasternode& mn, const uint256& nParentHash, vote_signal_enum_t eSignal, bool fOperatorKey)
+{
+    CGovernanceVote vote(mn.collateralOutpoint, nParentHash, eSignal, VOTE_OUTCOME_YES);
+    if (fOperatorKey) {
+        BOOST_CHECK(vote.Sign(mn.operatorKey));
+    } else {
+        BOOST_CHECK(vote.Sign(mn.votingKey, mn.votingKey.GetPubKey().GetID()));
+    }
+    return vote;
+}
+
+BOOST_AUTO_TEST_CASE(vote_batch_handoff)
+{
+    BOOST_REQUIRE(!masternodeSync.IsSynced());
+
+    std::vector<TestMasternode> mns;
+    auto mnList = CreateTestMNList(mns, 2);
+
+    CGovernanceObject govobj = CreateTestProposal(GetAdjustedTime());
+    BOOST_REQUIRE(govobj.GetObjectType() == GOVERNANCE_OBJECT_PROPOSAL);
+    GovernanceTestAccess::AddObject(govobj);
+
+    // funding votes on proposals must be signed with the voting key, all other votes with the operator key. The
+    // pre-check only tells which key signed the vote, ProcessVote must reject the wrong one
+    CGovernanceVote validFunding = MakeVote(mns[0], govobj.GetHash(), VOTE_SIGNAL_FUNDING, false);
+    CGovernanceVote invalidFunding = MakeVote(mns[1], govobj.GetHash(), VOTE_SIGNAL_FUNDING, true);
+    CGovernanceVote validDelete = MakeVote(mns[1], govobj.GetHash(), VOTE_SIGNAL_DELETE, true);
+    CGovernanceVote invalidDelete = MakeVote(mns[0], govobj.GetHash(), VOTE_SIGNAL_DELETE, false);
+    BOOST_CHECK(validFunding.Check(mnList.GetMNByCollateral(mns[0].collateralOutpoint)) == VOTE_CHECK_VOTING_KEY);
+    BOOST_CHECK(invalidFunding.Check(mnList.GetMNByCollateral(mns[1].collateralOutpoint)) == VOTE_CHECK_OPERATOR_KEY);
+
+    // votes signed by a different masternode fail the pre-check
+    CGovernanceVote forged = MakeVote(mns[0], govobj.GetHash(), VOTE_SIGNAL_VALID, true);
+    BOOST_CHECK(forged.Check(mnList.GetMNByCollateral(mns[1].collateralOutpoint)) == VOTE_CHECK_INVALID);
+
+    governance.StartVoteWorker();
+    for (const auto& vote : {validFunding, invalidFunding, validDelete, invalidDelete, validFunding}) {
+        GovernanceTestAccess::QueueVote(vote);
+    }
+    BOOST_CHECK_EQUAL(GovernanceTestAccess::GetPendingVoteCount(), 5);
+    GovernanceTestAccess::ProcessPendingVotes(mnList);
+    governance.StopVoteWorker();
+    BOOST_CHECK_EQUAL(GovernanceTestAccess::GetPendingVoteCount(), 0);
+
+    BOOST_CHECK(governance.HaveVoteForHash(validFunding.GetHash()));
+    BOOST_CHECK(governance.HaveVoteForHash(validDelete.GetHash()));
+    BOOST_CHECK(GovernanceTestAccess::IsInvalidVote(invalidFunding));
+    BOOST_CHECK(GovernanceTestAccess::IsInvalidVote(invalidDelete));
+    BOOST_CHECK(!GovernanceTestAccess::IsInvalidVote(validFunding));
+
+    CGovernanceObject* pGovobj = governance.FindGovernanceObject(govobj.GetHash());
+    BOOST_REQUIRE(pGovobj != nullptr);
+    BOOST_CHECK_EQUAL(pGovobj->GetAbsoluteYesCount(VOTE_SIGNAL_FUNDING), 1);
+    BOOST_CHECK_EQUAL(pGovobj->GetAbsoluteYesCount(VOTE_SIGNAL_DELETE), 1);
+
+    // votes which were processed already are not queued again
+    GovernanceTestAccess::QueueVote(validFunding);
+    GovernanceTestAccess::QueueVote(invalidDelete);
+    BOOST_CHECK_EQUAL(GovernanceTestAccess::GetPendingVoteCount(), 0);
+
+    governance.Clear();
+}
+
+BOOST_AUTO_TEST_CASE(vote_batch_flush)
+{
+    BOOST_REQUIRE(!masternodeSync.IsSynced());
+
+    // votes of unknown masternodes for an unknown object end up as orphans, which is enough to see them leave the queue
+    auto makeVote = []() {
+        return CGovernanceVote(COutPoint(GetRandHash(), 0), GetRandHash(), VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES);
+    };
+
+    // while syncing, votes are queued until the batch is full
+    size_t nBatchSize = GovernanceTestAccess::GetVoteBatchSize();
+    for (size_t i = 0; i < nBatchSize - 1; i++) {
+        GovernanceTestAccess::QueueVote(makeVote());
+    }
+    BOOST_CHECK_EQUAL(GovernanceTestAccess::GetPendingVoteCount(), nBatchSize - 1);
+    GovernanceTestAccess::QueueVote(makeVote());
+    BOOST_CHECK_EQUAL(GovernanceTestAccess::GetPendingVoteCount(), 0);
+
+    // incomplete batches are processed by the scheduler
+    GovernanceTestAccess::QueueVote(makeVote());
+    BOOST_CHECK_EQUAL(GovernanceTestAccess::GetPendingVoteCount(), 1);
+    governance.ProcessPendingVotes(*g_connman);
+    BOOST_CHECK_EQUAL(GovernanceTestAccess::GetPendingVoteCount(), 0);
+
+    governance.Clear();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,123 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "governance-object.h"
+#include "governance-votedb.h"
+#include "random.h"
+#include "timedata.h"
+
+#include "test/test_epmcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(governance_votedb_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(votedb_tests)
+{
+    CGovernanceDB db(1 << 20, true);
+    governanceDb = &db;
+
+    uint256 nParentHash = GetRandHash();
+    COutPoint outpoint1(GetRandHash(), 0);
+    COutPoint outpoint2(GetRandHash(), 1);
+
+    CGovernanceVote vote1(outpoint1, nParentHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES);
+    CGovernanceVote vote2(outpoint1, nParentHash, VOTE_SIGNAL_DELETE, VOTE_OUTCOME_NO);
+    CGovernanceVote vote3(outpoint2, nParentHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_NO);
+    CGovernanceVote otherVote(outpoint1, GetRandHash(), VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES);
+
+    // votes are written through to the DB
+    {
+        CGovernanceObjectVoteFile fileVotes;
+        fileVotes.AddVote(vote1);
+        fileVotes.AddVote(vote2);
+        fileVotes.AddVote(vote3);
+        BOOST_CHECK_EQUAL(fileVotes.GetVoteCount(), 3);
+    }
+    db.WriteVote(otherVote);
+    db.WriteVote(otherVote);
+    BOOST_CHECK_EQUAL(db.GetVoteCount(), 4);
+    BOOST_CHECK_EQUAL(db.ReadVotes(nParentHash).size(), 3);
+    BOOST_CHECK_EQUAL(db.ReadVotesFromMasternode(nParentHash, outpoint1).size(), 2);
+    BOOST_CHECK_EQUAL(db.ReadVotesFromMasternode(nParentHash, outpoint2).size(), 1);
+
+    CGovernanceVote vote;
+    BOOST_CHECK(db.ReadVote(vote3.GetHash(), vote) && vote == vote3);
+
+    // lazily loaded vote files only read the DB when accessed
+    CGovernanceObjectVoteFile fileVotes;
+    fileVotes.SetLazyLoad(nParentHash);
+    BOOST_CHECK(!fileVotes.IsLoaded());
+    BOOST_CHECK(fileVotes.HasVote(vote2.GetHash()));
+    BOOST_CHECK(fileVotes.IsLoaded());
+    BOOST_CHECK_EQUAL(fileVotes.GetVoteCount(), 3);
+
+    // removal without loading goes through the per masternode index
+    fileVotes.SetLazyLoad(nParentHash);
+    fileVotes.RemoveVotesFromMasternode(outpoint1);
+    BOOST_CHECK(!fileVotes.IsLoaded());
+    BOOST_CHECK(!db.ReadVote(vote1.GetHash(), vote));
+    BOOST_CHECK_EQUAL(fileVotes.GetVoteCount(), 1);
+    BOOST_CHECK_EQUAL(db.GetVoteCount(), 2);
+
+    // erasing an object erases its votes, but not the votes of other objects
+    db.EraseObject(nParentHash);
+    BOOST_CHECK(db.ReadVotes(nParentHash).empty());
+    BOOST_CHECK(db.ReadVotesFromMasternode(nParentHash, outpoint2).empty());
+    BOOST_CHECK(!db.ReadVote(vote3.GetHash(), vote));
+    BOOST_CHECK(db.ReadVote(otherVote.GetHash(), vote));
+    BOOST_CHECK_EQUAL(db.GetVoteCount(), 1);
+
+    // erasing unknown votes doesn't change the count
+    db.EraseVote(vote1);
+    BOOST_CHECK_EQUAL(db.GetVoteCount(), 1);
+
+    governanceDb = nullptr;
+}
+
+BOOST_AUTO_TEST_CASE(votedb_outdated_objects)
+{
+    CGovernanceDB db(1 << 20, true);
+    governanceDb = &db;
+
+    CGovernanceObject govobj = CreateTestProposal(GetAdjustedTime());
+    uint256 nHash = govobj.GetHash();
+    db.WriteObject(govobj);
+
+    // votes are written right away, but their object only on the next flush. When loaded before that, e.g. after a
+    // crash, the current votes of the object are rebuilt from its votes
+    CGovernanceVote vote1(COutPoint(GetRandHash(), 0), nHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES);
+    CGovernanceVote vote2(COutPoint(GetRandHash(), 0), nHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_NO);
+    CGovernanceVote vote3(COutPoint(GetRandHash(), 0), nHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES);
+    db.WriteVote(vote1);
+    db.WriteVote(vote2);
+    db.WriteVote(vote3);
+
+    std::map<uint256, CGovernanceObject> mapObjects;
+    db.LoadObjects(mapObjects);
+    BOOST_REQUIRE(mapObjects.count(nHash));
+    BOOST_CHECK_EQUAL(mapObjects.at(nHash).GetYesCount(VOTE_SIGNAL_FUNDING), 2);
+    BOOST_CHECK_EQUAL(mapObjects.at(nHash).GetNoCount(VOTE_SIGNAL_FUNDING), 1);
+    BOOST_CHECK(!mapObjects.at(nHash).GetVoteFile().IsLoaded());
+
+    // erased votes outdate the object as well
+    db.EraseVote(vote3);
+    mapObjects.clear();
+    db.LoadObjects(mapObjects);
+    BOOST_CHECK_EQUAL(mapObjects.at(nHash).GetYesCount(VOTE_SIGNAL_FUNDING), 1);
+    BOOST_CHECK_EQUAL(mapObjects.at(nHash).GetNoCount(VOTE_SIGNAL_FUNDING), 1);
+
+    // once written, the object is up to date and loaded as stored
+    std::map<uint256, CGovernanceObject> mapWrite;
+    mapWrite.emplace(nHash, govobj);
+    db.WriteObjects(mapWrite);
+    mapObjects.clear();
+    db.LoadObjects(mapObjects);
+    BOOST_CHECK_EQUAL(mapObjects.at(nHash).GetYesCount(VOTE_SIGNAL_FUNDING), 0);
+    BOOST_CHECK_EQUAL(mapObjects.at(nHash).GetNoCount(VOTE_SIGNAL_FUNDING), 0);
+
+    governanceDb = nullptr;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
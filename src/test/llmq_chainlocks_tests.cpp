@@ -0,0 +1,136 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "test/test_epmcoin.h"
+
+#include "random.h"
+
+#include "llmq/quorums_chainlocks.h"
+
+#include <boost/test/unit_test.hpp>
+
+using namespace llmq;
+
+static const int64_t MAX_AGE = 10 * 60;
+// a bucket expires when it is more than MAX_AGE + one bucket old
+static const int64_t EXPIRE_AGE = MAX_AGE + 2 * CTxFirstSeenTimes::BUCKET_SECONDS;
+static const int64_t START_TIME = 100000 * CTxFirstSeenTimes::BUCKET_SECONDS;
+
+BOOST_FIXTURE_TEST_SUITE(llmq_chainlocks_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(tx_first_seen_times_age)
+{
+    CTxFirstSeenTimes times(MAX_AGE, 1000);
+
+    uint256 txid = GetRandHash();
+    BOOST_CHECK(!times.IsKnown(txid));
+    BOOST_CHECK_EQUAL(times.GetAge(txid, START_TIME), 0);
+
+    times.Add(txid, START_TIME, START_TIME, false);
+    BOOST_CHECK(times.IsKnown(txid));
+    BOOST_CHECK_EQUAL(times.GetAge(txid, START_TIME), 0);
+    BOOST_CHECK_EQUAL(times.GetAge(txid, START_TIME + 30), 30);
+
+    // the first time wins
+    times.Add(txid, START_TIME + 10, START_TIME + 10, true);
+    BOOST_CHECK_EQUAL(times.GetAge(txid, START_TIME + 30), 30);
+    BOOST_CHECK_EQUAL(times.size(), 1U);
+
+    // TXs which are old already are only remembered in the bloom filter, unless they are in the mempool
+    uint256 oldTxid = GetRandHash();
+    times.Add(oldTxid, START_TIME - MAX_AGE, START_TIME, false);
+    BOOST_CHECK(times.IsKnown(oldTxid));
+    BOOST_CHECK_EQUAL(times.GetAge(oldTxid, START_TIME + 100), MAX_AGE);
+    BOOST_CHECK_EQUAL(times.size(), 1U);
+
+    uint256 oldMempoolTxid = GetRandHash();
+    times.Add(oldMempoolTxid, START_TIME - 1000, START_TIME, true);
+    BOOST_CHECK_EQUAL(times.GetAge(oldMempoolTxid, START_TIME + 100), 1100);
+    BOOST_CHECK_EQUAL(times.size(), 2U);
+    times.RemovedFromMempool(oldMempoolTxid);
+    BOOST_CHECK_EQUAL(times.size(), 1U);
+    BOOST_CHECK_EQUAL(times.GetAge(oldMempoolTxid, START_TIME + 100), MAX_AGE);
+
+    // a TX which is only known to the bloom filter and then enters the mempool is still old
+    times.Add(oldTxid, START_TIME + 100, START_TIME + 100, true);
+    BOOST_CHECK_EQUAL(times.GetAge(oldTxid, START_TIME + 100), MAX_AGE);
+    BOOST_CHECK_EQUAL(times.GetAge(oldTxid, START_TIME + 200), MAX_AGE + 100);
+}
+
+BOOST_AUTO_TEST_CASE(tx_first_seen_times_expiry)
+{
+    CTxFirstSeenTimes times(MAX_AGE, 1000);
+
+    uint256 txid = GetRandHash();
+    uint256 mempoolTxid = GetRandHash();
+    times.Add(txid, START_TIME, START_TIME, false);
+    times.Add(mempoolTxid, START_TIME, START_TIME, true);
+
+    // exact times are kept while the bucket is young enough
+    times.Expire(START_TIME + EXPIRE_AGE - 1);
+    BOOST_CHECK_EQUAL(times.size(), 2U);
+    BOOST_CHECK_EQUAL(times.GetAge(txid, START_TIME + EXPIRE_AGE - 1), EXPIRE_AGE - 1);
+
+    // only TXs which are still in the mempool keep their exact times when their bucket expires
+    times.Expire(START_TIME + EXPIRE_AGE);
+    BOOST_CHECK_EQUAL(times.size(), 1U);
+    BOOST_CHECK(times.IsKnown(txid));
+    BOOST_CHECK_EQUAL(times.GetAge(txid, START_TIME + EXPIRE_AGE), MAX_AGE);
+    BOOST_CHECK_EQUAL(times.GetAge(mempoolTxid, START_TIME + EXPIRE_AGE), EXPIRE_AGE);
+    BOOST_CHECK_EQUAL(times.GetAge(mempoolTxid, START_TIME + 10 * EXPIRE_AGE), 10 * EXPIRE_AGE);
+
+    times.RemovedFromMempool(mempoolTxid);
+    BOOST_CHECK_EQUAL(times.size(), 0U);
+    BOOST_CHECK(times.IsKnown(mempoolTxid));
+    BOOST_CHECK_EQUAL(times.GetAge(mempoolTxid, START_TIME + EXPIRE_AGE), MAX_AGE);
+
+    // a young TX which leaves the mempool is kept until its bucket expires
+    int64_t nTime = START_TIME + EXPIRE_AGE;
+    uint256 youngTxid = GetRandHash();
+    times.Add(youngTxid, nTime, nTime, true);
+    times.RemovedFromMempool(youngTxid);
+    BOOST_CHECK_EQUAL(times.size(), 1U);
+    BOOST_CHECK_EQUAL(times.GetAge(youngTxid, nTime + 100), 100);
+    times.Expire(nTime + EXPIRE_AGE);
+    BOOST_CHECK_EQUAL(times.size(), 0U);
+    BOOST_CHECK_EQUAL(times.GetAge(youngTxid, nTime + EXPIRE_AGE), MAX_AGE);
+
+    // expiring many buckets at once
+    nTime += EXPIRE_AGE;
+    for (int64_t i = 0; i < MAX_AGE; i += 10) {
+        times.Add(GetRandHash(), nTime + i, nTime + i, false);
+    }
+    BOOST_CHECK_EQUAL(times.size(), (size_t)(MAX_AGE / 10));
+    times.Expire(nTime + 100 * EXPIRE_AGE);
+    BOOST_CHECK_EQUAL(times.size(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(tx_first_seen_times_mempool_outlives_bloom)
+{
+    // the bloom filter only remembers the last few expired TXs
+    CTxFirstSeenTimes times(MAX_AGE, 10);
+
+    uint256 mempoolTxid = GetRandHash();
+    std::vector<uint256> txids;
+    times.Add(mempoolTxid, START_TIME, START_TIME, true);
+    for (size_t i = 0; i < 100; i++) {
+        txids.emplace_back(GetRandHash());
+        times.Add(txids.back(), START_TIME, START_TIME, false);
+    }
+    times.Expire(START_TIME + EXPIRE_AGE);
+    for (size_t i = 0; i < 1000; i++) {
+        times.Add(GetRandHash(), START_TIME, START_TIME + EXPIRE_AGE, false);
+    }
+
+    size_t forgotten = 0;
+    for (const auto& txid : txids) {
+        forgotten += times.GetAge(txid, START_TIME + EXPIRE_AGE) == 0;
+    }
+    BOOST_CHECK(forgotten != 0);
+
+    // a long-lived mempool TX must never look like an unseen one
+    BOOST_CHECK_EQUAL(times.GetAge(mempoolTxid, START_TIME + EXPIRE_AGE), EXPIRE_AGE);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,169 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "test/test_epmcoin.h"
+
+#include "primitives/transaction.h"
+#include "random.h"
+
+#include "llmq/quorums_instantsend.h"
+
+#include <boost/test/unit_test.hpp>
+
+using namespace llmq;
+
+static CTransactionRef MakeTx(const std::vector<COutPoint>& prevouts, size_t outputs = 2)
+{
+    CMutableTransaction tx;
+    for (const auto& prevout : prevouts) {
+        tx.vin.emplace_back(prevout);
+    }
+    tx.vout.resize(outputs);
+    for (auto& out : tx.vout) {
+        out.nValue = 1;
+    }
+    // make sure that all TXs are unique
+    tx.nLockTime = (uint32_t)GetRand(std::numeric_limits<uint32_t>::max());
+    return MakeTransactionRef(tx);
+}
+
+static std::set<uint256> GetSpenders(const CNonLockedTxsIndex& index, const COutPoint& outpoint)
+{
+    std::set<uint256> ret;
+    index.ForEachSpender(outpoint, [&](const CNonLockedTxsIndex::Entry& e) {
+        BOOST_CHECK(ret.emplace(e.txid).second);
+    });
+    return ret;
+}
+
+static std::set<uint256> GetChildren(const CNonLockedTxsIndex& index, const uint256& txid)
+{
+    // Remove is the only way to get the txids of the children, so do it on a copy
+    CNonLockedTxsIndex copy = index;
+    std::vector<uint256> children;
+    BOOST_CHECK(copy.Remove(txid, &children));
+    std::set<uint256> ret(children.begin(), children.end());
+    BOOST_CHECK_EQUAL(ret.size(), children.size());
+    return ret;
+}
+
+BOOST_FIXTURE_TEST_SUITE(llmq_instantsend_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(nonlocked_txs_index)
+{
+    CNonLockedTxsIndex index;
+
+    COutPoint external(GetRandHash(), 0);
+    auto parent = MakeTx({external});
+    auto a = MakeTx({COutPoint(parent->GetHash(), 0)});
+    auto b = MakeTx({COutPoint(parent->GetHash(), 0), COutPoint(parent->GetHash(), 1)});
+    auto c = MakeTx({COutPoint(parent->GetHash(), 1)});
+
+    index.Add(parent, 1);
+    index.Add(a, 2);
+    index.Add(b, 3);
+    index.Add(c, 4);
+    // adding a TX again does not change anything
+    index.Add(a, 5);
+
+    // the external parent only exists as a placeholder for its child
+    BOOST_CHECK_EQUAL(index.size(), 5U);
+    auto* externalEntry = index.Get(external.hash);
+    BOOST_REQUIRE(externalEntry != nullptr);
+    BOOST_CHECK(!externalEntry->tx);
+    BOOST_CHECK(GetChildren(index, external.hash) == std::set<uint256>({parent->GetHash()}));
+    BOOST_CHECK_EQUAL(index.Get(a->GetHash())->nTimeFirstSeen, 2);
+
+    BOOST_CHECK(GetChildren(index, parent->GetHash()) == std::set<uint256>({a->GetHash(), b->GetHash(), c->GetHash()}));
+    BOOST_CHECK(GetSpenders(index, external) == std::set<uint256>({parent->GetHash()}));
+    BOOST_CHECK(GetSpenders(index, COutPoint(parent->GetHash(), 0)) == std::set<uint256>({a->GetHash(), b->GetHash()}));
+    BOOST_CHECK(GetSpenders(index, COutPoint(parent->GetHash(), 1)) == std::set<uint256>({b->GetHash(), c->GetHash()}));
+    BOOST_CHECK(GetSpenders(index, COutPoint(parent->GetHash(), 2)).empty());
+
+    // b is the head of one spender chain and the tail of the other one
+    auto* bEntry = index.Get(b->GetHash());
+    BOOST_CHECK(index.Remove(b->GetHash(), nullptr));
+    BOOST_CHECK(!index.Remove(b->GetHash(), nullptr));
+    BOOST_CHECK(index.Get(b->GetHash()) == nullptr);
+    BOOST_CHECK_EQUAL(index.size(), 4U);
+    BOOST_CHECK(GetChildren(index, parent->GetHash()) == std::set<uint256>({a->GetHash(), c->GetHash()}));
+    BOOST_CHECK(GetSpenders(index, COutPoint(parent->GetHash(), 0)) == std::set<uint256>({a->GetHash()}));
+    BOOST_CHECK(GetSpenders(index, COutPoint(parent->GetHash(), 1)) == std::set<uint256>({c->GetHash()}));
+
+    // the slot of b is reused without growing the arena, so the old entry pointer stays valid
+    auto d = MakeTx({COutPoint(parent->GetHash(), 1)}, 1);
+    index.Add(d, 6);
+    BOOST_CHECK(index.Get(d->GetHash()) == bEntry);
+    BOOST_CHECK(bEntry->txid == d->GetHash());
+    BOOST_CHECK(bEntry->tx == d);
+    BOOST_CHECK_EQUAL(bEntry->nTimeFirstSeen, 6);
+    BOOST_CHECK(bEntry->pindexMined == nullptr);
+    BOOST_CHECK(bEntry->children.empty());
+    BOOST_CHECK_EQUAL(bEntry->nextSpender.size(), 1U);
+    BOOST_CHECK(GetSpenders(index, COutPoint(parent->GetHash(), 0)) == std::set<uint256>({a->GetHash()}));
+    BOOST_CHECK(GetSpenders(index, COutPoint(parent->GetHash(), 1)) == std::set<uint256>({c->GetHash(), d->GetHash()}));
+
+    // removing the parent returns its children and frees the placeholder of the external parent
+    std::vector<uint256> children;
+    BOOST_CHECK(index.Remove(parent->GetHash(), &children));
+    BOOST_CHECK(std::set<uint256>(children.begin(), children.end()) == std::set<uint256>({a->GetHash(), c->GetHash(), d->GetHash()}));
+    BOOST_CHECK(index.Get(parent->GetHash()) == nullptr);
+    BOOST_CHECK(index.Get(external.hash) == nullptr);
+    BOOST_CHECK(GetSpenders(index, external).empty());
+    BOOST_CHECK_EQUAL(index.size(), 3U);
+
+    // the children still know what they spend
+    BOOST_CHECK(GetSpenders(index, COutPoint(parent->GetHash(), 1)) == std::set<uint256>({c->GetHash(), d->GetHash()}));
+    BOOST_CHECK(index.Remove(a->GetHash(), nullptr));
+    BOOST_CHECK(index.Remove(c->GetHash(), nullptr));
+    BOOST_CHECK(index.Remove(d->GetHash(), nullptr));
+    BOOST_CHECK_EQUAL(index.size(), 0U);
+    BOOST_CHECK(GetSpenders(index, COutPoint(parent->GetHash(), 0)).empty());
+    BOOST_CHECK(GetSpenders(index, COutPoint(parent->GetHash(), 1)).empty());
+}
+
+BOOST_AUTO_TEST_CASE(nonlocked_txs_index_spender_chains)
+{
+    CNonLockedTxsIndex index;
+
+    COutPoint outpoint(GetRandHash(), 0);
+    std::vector<CTransactionRef> spenders;
+    for (size_t i = 0; i < 5; i++) {
+        // every spender also spends a unique outpoint, so that the spent outpoint is at different input indexes
+        std::vector<COutPoint> prevouts{COutPoint(GetRandHash(), 0)};
+        prevouts.insert(prevouts.begin() + (i % 2), outpoint);
+        spenders.emplace_back(MakeTx(prevouts));
+        index.Add(spenders.back(), 0);
+    }
+
+    std::set<uint256> expected;
+    for (const auto& tx : spenders) {
+        expected.emplace(tx->GetHash());
+    }
+    BOOST_CHECK(GetSpenders(index, outpoint) == expected);
+
+    // remove from the middle, the tail (first added) and the head (last added) of the chain
+    for (size_t i : {2, 0, 4}) {
+        BOOST_CHECK(index.Remove(spenders[i]->GetHash(), nullptr));
+        expected.erase(spenders[i]->GetHash());
+        BOOST_CHECK(GetSpenders(index, outpoint) == expected);
+    }
+
+    // the freed slots get reused and the new spenders are linked into the remaining chain
+    for (size_t i = 0; i < 3; i++) {
+        auto tx = MakeTx({outpoint});
+        index.Add(tx, 0);
+        expected.emplace(tx->GetHash());
+        BOOST_CHECK(GetSpenders(index, outpoint) == expected);
+    }
+
+    for (const auto& txid : std::set<uint256>(expected)) {
+        BOOST_CHECK(index.Remove(txid, nullptr));
+        expected.erase(txid);
+        BOOST_CHECK(GetSpenders(index, outpoint) == expected);
+    }
+    BOOST_CHECK_EQUAL(index.size(), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
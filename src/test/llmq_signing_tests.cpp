@@ -0,0 +1,223 @@
+// Copyright (c) 2019 The Extreme Private MasternodeCoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "test/test_epmcoin.h"
+
+#include "dbwrapper.h"
+#include "random.h"
+#include "utiltime.h"
+
+#include "llmq/quorums_signing.h"
+#include "llmq/quorums_utils.h"
+
+#include <boost/test/unit_test.hpp>
+
+using namespace llmq;
+
+// CRecoveredSigsDb puts recSigs and votes into one hour time buckets
+static const int64_t TIME_BUCKET = 60 * 60;
+
+static CRecoveredSig MakeRecoveredSig()
+{
+    CRecoveredSig recSig;
+    recSig.llmqType = Consensus::LLMQ_50_60;
+    recSig.quorumHash = GetRandHash();
+    recSig.id = GetRandHash();
+    recSig.msgHash = GetRandHash();
+    recSig.UpdateHash();
+    return recSig;
+}
+
+static bool HasRecSig(CRecoveredSigsDb& sigsDb, const CRecoveredSig& recSig)
+{
+    auto llmqType = (Consensus::LLMQType)recSig.llmqType;
+    CRecoveredSig tmp;
+    bool ret = sigsDb.HasRecoveredSigForId(llmqType, recSig.id);
+    BOOST_CHECK_EQUAL(sigsDb.HasRecoveredSig(llmqType, recSig.id, recSig.msgHash), ret);
+    BOOST_CHECK_EQUAL(sigsDb.HasRecoveredSigForSession(CLLMQUtils::BuildSignHash(recSig)), ret);
+    BOOST_CHECK_EQUAL(sigsDb.HasRecoveredSigForHash(recSig.GetHash()), ret);
+    BOOST_CHECK_EQUAL(sigsDb.GetRecoveredSigById(llmqType, recSig.id, tmp), ret);
+    BOOST_CHECK(!ret || tmp.GetHash() == recSig.GetHash());
+    BOOST_CHECK_EQUAL(sigsDb.GetRecoveredSigByHash(recSig.GetHash(), tmp), ret);
+    BOOST_CHECK(!ret || tmp.GetHash() == recSig.GetHash());
+    return ret;
+}
+
+BOOST_FIXTURE_TEST_SUITE(llmq_signing_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(hash_bloom_filter)
+{
+    CHashBloomFilter filter(1 << 16);
+    std::vector<uint256> hashes;
+    for (size_t i = 0; i < 1000; i++) {
+        hashes.emplace_back(GetRandHash());
+        filter.insert(hashes.back(), 1);
+    }
+    BOOST_CHECK_EQUAL(filter.inserted(), 1000U);
+
+    // no false negatives, and the tweak is part of the element
+    size_t falsePositives = 0;
+    for (const auto& hash : hashes) {
+        BOOST_CHECK(filter.contains(hash, 1));
+        falsePositives += filter.contains(hash, 2);
+    }
+    BOOST_CHECK(falsePositives < 10);
+
+    filter.clear();
+    BOOST_CHECK_EQUAL(filter.inserted(), 0U);
+    BOOST_CHECK(!filter.contains(hashes[0], 1));
+}
+
+BOOST_AUTO_TEST_CASE(pending_writes)
+{
+    CDBWrapper db("llmq_signing_tests", 1 << 20, true, true);
+    CRecoveredSigsDb sigsDb(db);
+
+    auto recSig = MakeRecoveredSig();
+    auto llmqType = (Consensus::LLMQType)recSig.llmqType;
+    BOOST_CHECK(!HasRecSig(sigsDb, recSig));
+
+    uint256 voteId = GetRandHash();
+    uint256 voteMsgHash = GetRandHash();
+    uint256 msgHash;
+    BOOST_CHECK(!sigsDb.HasVotedOnId(llmqType, voteId));
+
+    // reads are served from the pending writes before they reach the DB
+    sigsDb.WriteRecoveredSig(recSig);
+    sigsDb.WriteVoteForId(llmqType, voteId, voteMsgHash);
+    BOOST_CHECK(HasRecSig(sigsDb, recSig));
+    BOOST_CHECK(sigsDb.HasVotedOnId(llmqType, voteId));
+    BOOST_CHECK(sigsDb.GetVoteForId(llmqType, voteId, msgHash) && msgHash == voteMsgHash);
+    BOOST_CHECK(!db.Exists(std::make_tuple(std::string("rs_h"), recSig.GetHash())));
+    BOOST_CHECK(!db.Exists(std::make_tuple(std::string("rs_v"), (uint8_t)llmqType, voteId)));
+
+    sigsDb.FlushPendingWrites();
+    BOOST_CHECK(db.Exists(std::make_tuple(std::string("rs_h"), recSig.GetHash())));
+    BOOST_CHECK(db.Exists(std::make_tuple(std::string("rs_v"), (uint8_t)llmqType, voteId)));
+    BOOST_CHECK(HasRecSig(sigsDb, recSig));
+    BOOST_CHECK(sigsDb.GetVoteForId(llmqType, voteId, msgHash) && msgHash == voteMsgHash);
+
+    // removing a pending recSig must not leave anything behind after the next flush
+    auto recSig2 = MakeRecoveredSig();
+    sigsDb.WriteRecoveredSig(recSig2);
+    sigsDb.RemoveRecoveredSig((Consensus::LLMQType)recSig2.llmqType, recSig2.id);
+    BOOST_CHECK(!HasRecSig(sigsDb, recSig2));
+    sigsDb.FlushPendingWrites();
+    BOOST_CHECK(!HasRecSig(sigsDb, recSig2));
+
+    // a fresh instance loads everything from the DB
+    CRecoveredSigsDb sigsDb2(db);
+    BOOST_CHECK(HasRecSig(sigsDb2, recSig));
+    BOOST_CHECK(sigsDb2.HasVotedOnId(llmqType, voteId));
+}
+
+BOOST_AUTO_TEST_CASE(time_bucket_cleanup)
+{
+    CDBWrapper db("llmq_signing_tests", 1 << 20, true, true);
+    CRecoveredSigsDb sigsDb(db);
+
+    int64_t nStartTime = (GetTime() / TIME_BUCKET) * TIME_BUCKET;
+    SetMockTime(nStartTime);
+    auto oldRecSig = MakeRecoveredSig();
+    uint256 oldVoteId = GetRandHash();
+    sigsDb.WriteRecoveredSig(oldRecSig);
+    sigsDb.WriteVoteForId(Consensus::LLMQ_50_60, oldVoteId, GetRandHash());
+    sigsDb.FlushPendingWrites();
+
+    // same bucket, but a separate flush
+    SetMockTime(nStartTime + TIME_BUCKET - 1);
+    auto oldRecSig2 = MakeRecoveredSig();
+    sigsDb.WriteRecoveredSig(oldRecSig2);
+    sigsDb.FlushPendingWrites();
+
+    SetMockTime(nStartTime + 2 * TIME_BUCKET);
+    auto newRecSig = MakeRecoveredSig();
+    uint256 newVoteId = GetRandHash();
+    sigsDb.WriteRecoveredSig(newRecSig);
+    sigsDb.WriteVoteForId(Consensus::LLMQ_50_60, newVoteId, GetRandHash());
+    sigsDb.FlushPendingWrites();
+
+    // nothing is old enough yet
+    sigsDb.CleanupOldRecoveredSigs(2 * TIME_BUCKET);
+    sigsDb.CleanupOldVotes(2 * TIME_BUCKET);
+    BOOST_CHECK(HasRecSig(sigsDb, oldRecSig));
+    BOOST_CHECK(HasRecSig(sigsDb, oldRecSig2));
+    BOOST_CHECK(sigsDb.HasVotedOnId(Consensus::LLMQ_50_60, oldVoteId));
+
+    // whole buckets which are older than maxAge are removed, including all their keys
+    sigsDb.CleanupOldRecoveredSigs(TIME_BUCKET);
+    sigsDb.CleanupOldVotes(TIME_BUCKET);
+    BOOST_CHECK(!HasRecSig(sigsDb, oldRecSig));
+    BOOST_CHECK(!HasRecSig(sigsDb, oldRecSig2));
+    BOOST_CHECK(HasRecSig(sigsDb, newRecSig));
+    BOOST_CHECK(!sigsDb.HasVotedOnId(Consensus::LLMQ_50_60, oldVoteId));
+    BOOST_CHECK(sigsDb.HasVotedOnId(Consensus::LLMQ_50_60, newVoteId));
+    BOOST_CHECK(!db.Exists(std::make_tuple(std::string("rs_r"), oldRecSig.llmqType, oldRecSig.id, oldRecSig.msgHash)));
+    BOOST_CHECK(!db.Exists(std::make_tuple(std::string("rs_s"), CLLMQUtils::BuildSignHash(oldRecSig))));
+
+    // a recSig which was written again after its bucket was created survives the cleanup of that bucket
+    SetMockTime(nStartTime + 4 * TIME_BUCKET);
+    auto rewrittenRecSig = MakeRecoveredSig();
+    sigsDb.WriteRecoveredSig(rewrittenRecSig);
+    sigsDb.FlushPendingWrites();
+    SetMockTime(nStartTime + 6 * TIME_BUCKET);
+    sigsDb.RemoveRecoveredSig((Consensus::LLMQType)rewrittenRecSig.llmqType, rewrittenRecSig.id);
+    sigsDb.WriteRecoveredSig(rewrittenRecSig);
+    sigsDb.FlushPendingWrites();
+    sigsDb.CleanupOldRecoveredSigs(TIME_BUCKET);
+    BOOST_CHECK(HasRecSig(sigsDb, rewrittenRecSig));
+
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_CASE(bloom_filter_rebuild)
+{
+    CDBWrapper db("llmq_signing_tests", 1 << 20, true, true);
+    CRecoveredSigsDb sigsDb(db, 8);
+
+    int64_t nStartTime = (GetTime() / TIME_BUCKET) * TIME_BUCKET;
+    SetMockTime(nStartTime);
+    std::vector<CRecoveredSig> oldRecSigs;
+    for (size_t i = 0; i < 10; i++) {
+        oldRecSigs.emplace_back(MakeRecoveredSig());
+        sigsDb.WriteRecoveredSig(oldRecSigs.back());
+    }
+    sigsDb.FlushPendingWrites();
+    BOOST_CHECK_EQUAL(sigsDb.GetBloomFilterElementCount(), 10U);
+
+    SetMockTime(nStartTime + 2 * TIME_BUCKET);
+    std::vector<CRecoveredSig> newRecSigs;
+    for (size_t i = 0; i < 3; i++) {
+        newRecSigs.emplace_back(MakeRecoveredSig());
+        sigsDb.WriteRecoveredSig(newRecSigs.back());
+    }
+    BOOST_CHECK_EQUAL(sigsDb.GetBloomFilterElementCount(), 13U);
+
+    // removed recSigs stay in the filters until the cleanup rebuilds them, which also flushes pending writes
+    sigsDb.CleanupOldRecoveredSigs(TIME_BUCKET);
+    BOOST_CHECK_EQUAL(sigsDb.GetBloomFilterElementCount(), 3U);
+    for (const auto& recSig : oldRecSigs) {
+        BOOST_CHECK(!HasRecSig(sigsDb, recSig));
+    }
+    for (const auto& recSig : newRecSigs) {
+        BOOST_CHECK(HasRecSig(sigsDb, recSig));
+    }
+
+    // each recSig is only loaded once into each filter, even though it has two "rs_r" keys
+    CRecoveredSigsDb sigsDb2(db, 8);
+    BOOST_CHECK_EQUAL(sigsDb2.GetBloomFilterElementCount(), 3U);
+
+    // no rebuild while the filters are below their limit
+    SetMockTime(nStartTime + 4 * TIME_BUCKET);
+    sigsDb2.WriteRecoveredSig(MakeRecoveredSig());
+    sigsDb2.FlushPendingWrites();
+    sigsDb2.RemoveRecoveredSig((Consensus::LLMQType)newRecSigs[0].llmqType, newRecSigs[0].id);
+    sigsDb2.CleanupOldRecoveredSigs(TIME_BUCKET);
+    BOOST_CHECK_EQUAL(sigsDb2.GetBloomFilterElementCount(), 4U);
+    BOOST_CHECK(!HasRecSig(sigsDb2, newRecSigs[0]));
+
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -9,6 +9,8 @@
 #include "chainparams.h"
 #include "consensus/consensus.h"
 #include "consensus/validation.h"
+#include "governance.h"
+#include "governance-object.h"
 #include "key.h"
 #include "validation.h"
 #include "miner.h"
@@ -18,6 +20,7 @@
 #include "txdb.h"
 #include "txmempool.h"
 #include "ui_interface.h"
+#include "utilstrencodings.h"
 #include "rpc/server.h"
 #include "rpc/register.h"
 #include "script/sigcache.h"
@@ -28,6 +31,7 @@
 #include "evo/specialtx.h"
 #include "evo/deterministicmns.h"
 #include "evo/cbtx.h"
+#include "evo/simplifiedmns.h"
 #include "llmq/quorums_init.h"
 
 #include <memory>
@@ -55,11 +59,13 @@ BasicTestingSetup::BasicTestingSetup(const std::string& chainName)
         SelectParams(chainName);
         evoDb = new CEvoDB(1 << 20, true, true);
         deterministicMNManager = new CDeterministicMNManager(*evoDb);
+        mnListDiffCache = new CSimplifiedMNListDiffCache(nullptr);
         noui_connect();
 }
 
 BasicTestingSetup::~BasicTestingSetup()
 {
+        delete mnListDiffCache;
         delete deterministicMNManager;
         delete evoDb;
 
@@ -216,6 +222,91 @@ CTxMemPoolEntry TestMemPoolEntryHelper::FromTx(const CTransaction &txn) {
                            spendsCoinbase, sigOpCount, lp);
 }
 
+CDeterministicMNList CreateTestMNList(std::vector<TestMasternode>& mnsRet, size_t count)
+{
+    CDeterministicMNList mnList(uint256(), 0, 0);
+    for (size_t i = 0; i < count; i++) {
+        TestMasternode mn;
+        mn.votingKey.MakeNewKey(true);
+        mn.operatorKey.MakeNewKey();
+        mn.collateralOutpoint = COutPoint(GetRandHash(), 0);
+
+        auto dmnState = std::make_shared<CDeterministicMNState>();
+        dmnState->keyIDVoting = mn.votingKey.GetPubKey().GetID();
+        dmnState->pubKeyOperator.Set(mn.operatorKey.GetPublicKey());
+
+        auto dmn = std::make_shared<CDeterministicMN>();
+        dmn->proTxHash = GetRandHash();
+        dmn->internalId = i;
+        dmn->collateralOutpoint = mn.collateralOutpoint;
+        dmn->pdmnState = dmnState;
+        mnList.AddMN(dmn);
+        mnsRet.emplace_back(mn);
+    }
+    return mnList;
+}
+
+CGovernanceObject CreateTestProposal(int64_t nTime)
+{
+    std::string strData = "{\"type\":1,\"name\":\"test\",\"payment_address\":\"\",\"payment_amount\":1}";
+    return CGovernanceObject(uint256(), 1, nTime, GetRandHash(), HexStr(strData));
+}
+
+bool GovernanceTestAccess::ProcessVote(CGovernanceObject& govobj, const CGovernanceVote& vote, const CDeterministicMNList& mnList)
+{
+    bool fVotingKey = govobj.GetObjectType() == GOVERNANCE_OBJECT_PROPOSAL && vote.GetSignal() == VOTE_SIGNAL_FUNDING;
+    CGovernanceException exception;
+    return govobj.ProcessVote(nullptr, vote, exception, *g_connman, mnList, fVotingKey ? VOTE_CHECK_VOTING_KEY : VOTE_CHECK_OPERATOR_KEY);
+}
+
+void GovernanceTestAccess::ClearMasternodeVotes(CGovernanceObject& govobj)
+{
+    govobj.ClearMasternodeVotes();
+}
+
+std::set<uint256> GovernanceTestAccess::RemoveInvalidVotes(CGovernanceObject& govobj, const COutPoint& mnOutpoint)
+{
+    return govobj.RemoveInvalidVotes(mnOutpoint);
+}
+
+void GovernanceTestAccess::AddObject(const CGovernanceObject& govobj)
+{
+    LOCK(governance.cs);
+    governance.mapObjects.emplace(govobj.GetHash(), govobj);
+}
+
+void GovernanceTestAccess::QueueVote(const CGovernanceVote& vote)
+{
+    governance.QueueVote(0, vote, *g_connman);
+}
+
+size_t GovernanceTestAccess::GetPendingVoteCount()
+{
+    LOCK(governance.cs_pendingVotes);
+    return governance.pendingVotes.size();
+}
+
+void GovernanceTestAccess::ProcessPendingVotes(const CDeterministicMNList& mnList)
+{
+    std::vector<std::pair<NodeId, CGovernanceVote>> votes;
+    {
+        LOCK(governance.cs_pendingVotes);
+        votes.swap(governance.pendingVotes);
+    }
+    governance.ProcessVotes(votes, *g_connman, mnList);
+}
+
+bool GovernanceTestAccess::IsInvalidVote(const CGovernanceVote& vote)
+{
+    LOCK(governance.cs);
+    return governance.cmapInvalidVotes.HasKey(vote.GetHash());
+}
+
+size_t GovernanceTestAccess::GetVoteBatchSize()
+{
+    return CGovernanceManager::VOTE_BATCH_SIZE;
+}
+
 void Shutdown(void* parg)
 {
   exit(EXIT_SUCCESS);
@@ -9,11 +9,14 @@
 #define BITCOIN_TEST_TEST_EPM_H
 
 #include "chainparamsbase.h"
+#include "governance-vote.h"
 #include "key.h"
 #include "pubkey.h"
 #include "txdb.h"
 #include "txmempool.h"
 
+#include "bls/bls.h"
+
 #include <boost/filesystem.hpp>
 #include <boost/thread.hpp>
 
@@ -109,4 +112,36 @@ struct TestMemPoolEntryHelper
     TestMemPoolEntryHelper &SpendsCoinbase(bool _flag) { spendsCoinbase = _flag; return *this; }
     TestMemPoolEntryHelper &SigOps(unsigned int _sigops) { sigOpCount = _sigops; return *this; }
 };
+
+class CDeterministicMNList;
+class CGovernanceObject;
+
+struct TestMasternode
+{
+    CKey votingKey;
+    CBLSSecretKey operatorKey;
+    COutPoint collateralOutpoint;
+};
+
+// Creates a masternode list with count masternodes with random voting and operator keys
+CDeterministicMNList CreateTestMNList(std::vector<TestMasternode>& mnsRet, size_t count);
+// Creates a proposal which is valid apart from its collateral
+CGovernanceObject CreateTestProposal(int64_t nTime);
+
+/** Test access to the vote processing of governance objects and the governance manager */
+struct GovernanceTestAccess
+{
+    // processes the vote as if it was verified with the key that is required for its signal
+    static bool ProcessVote(CGovernanceObject& govobj, const CGovernanceVote& vote, const CDeterministicMNList& mnList);
+    static void ClearMasternodeVotes(CGovernanceObject& govobj);
+    static std::set<uint256> RemoveInvalidVotes(CGovernanceObject& govobj, const COutPoint& mnOutpoint);
+
+    static void AddObject(const CGovernanceObject& govobj);
+    static void QueueVote(const CGovernanceVote& vote);
+    static size_t GetPendingVoteCount();
+    // same as ProcessPendingVotes, but with the given masternode list instead of the one at the chain tip
+    static void ProcessPendingVotes(const CDeterministicMNList& mnList);
+    static bool IsInvalidVote(const CGovernanceVote& vote);
+    static size_t GetVoteBatchSize();
+};
 #endif
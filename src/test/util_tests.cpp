@@ -7,12 +7,14 @@
 #include "clientversion.h"
 #include "primitives/transaction.h"
 #include "sync.h"
+#include "threadinterrupt.h"
 #include "utilstrencodings.h"
 #include "utilmoneystr.h"
 #include "test/test_epmcoin.h"
 #include "test/test_random.h"
 
 #include <stdint.h>
+#include <thread>
 #include <vector>
 
 #include <boost/test/unit_test.hpp>
@@ -581,4 +583,33 @@ BOOST_AUTO_TEST_CASE(version_info_helper)
     BOOST_CHECK_THROW(IntVersionToString(0), std::bad_cast);
 }
 
+BOOST_AUTO_TEST_CASE(thread_wakeup)
+{
+    CThreadInterrupt interrupt;
+    interrupt.reset();
+    CThreadWakeup wakeup;
+
+    // nothing signalled, so we run into the timeout
+    BOOST_CHECK(!wakeup.WaitFor(interrupt, std::chrono::milliseconds(1)));
+
+    // a wakeup before waiting is not lost, but is only consumed once
+    wakeup.Wakeup();
+    BOOST_CHECK(wakeup.WaitFor(interrupt, std::chrono::minutes(1)));
+    BOOST_CHECK(!wakeup.WaitFor(interrupt, std::chrono::milliseconds(1)));
+
+    // wakeup from another thread while waiting
+    std::thread t([&]() {
+        MilliSleep(10);
+        wakeup.Wakeup();
+    });
+    BOOST_CHECK(wakeup.WaitFor(interrupt, std::chrono::minutes(1)));
+    t.join();
+
+    // interrupting also ends the wait
+    interrupt();
+    wakeup.Wakeup();
+    BOOST_CHECK(wakeup.WaitFor(interrupt, std::chrono::minutes(1)));
+    BOOST_CHECK(wakeup.WaitFor(interrupt, std::chrono::minutes(1)));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -39,3 +39,20 @@ bool CThreadInterrupt::sleep_for(std::chrono::minutes rel_time)
 {
     return sleep_for(std::chrono::duration_cast<std::chrono::milliseconds>(rel_time));
 }
+
+void CThreadWakeup::Wakeup()
+{
+    {
+        std::unique_lock<std::mutex> lock(mut);
+        fWakeup = true;
+    }
+    cond.notify_all();
+}
+
+bool CThreadWakeup::WaitFor(const CThreadInterrupt& interrupt, std::chrono::milliseconds rel_time)
+{
+    std::unique_lock<std::mutex> lock(mut);
+    bool ret = cond.wait_for(lock, rel_time, [&]() { return fWakeup || (bool)interrupt; });
+    fWakeup = false;
+    return ret;
+}
@@ -31,4 +31,23 @@ private:
     std::atomic<bool> flag;
 };
 
+/*
+    A helper class for worker threads which should sleep until new work is
+    signalled instead of polling. Calling Wakeup() makes a current or the next
+    call to WaitFor() return immediately. As the interrupt uses its own
+    condition variable, Wakeup() must be called after interrupting the thread.
+*/
+class CThreadWakeup
+{
+public:
+    void Wakeup();
+    // returns false if the full timeout elapsed without a wakeup or interrupt
+    bool WaitFor(const CThreadInterrupt& interrupt, std::chrono::milliseconds rel_time);
+
+private:
+    std::condition_variable cond;
+    std::mutex mut;
+    bool fWakeup{false};
+};
+
 #endif //BITCOIN_THREADINTERRUPT_H
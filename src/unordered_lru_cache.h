@@ -7,6 +7,8 @@
 #ifndef EPMCOIN_UNORDERED_LRU_CACHE_H
 #define EPMCOIN_UNORDERED_LRU_CACHE_H
 
+#include "memusage.h"
+
 #include <unordered_map>
 
 template<typename Key, typename Value, typename Hasher, size_t MaxSize = 0, size_t TruncateThreshold = 0>
@@ -84,6 +86,27 @@ public:
         cacheMap.clear();
     }
 
+    size_t size() const
+    {
+        return cacheMap.size();
+    }
+
+    // memory used by the map and the dynamic memory of the cached values
+    size_t DynamicMemoryUsage() const
+    {
+        size_t nUsage = memusage::DynamicUsage(cacheMap);
+        for (const auto& p : cacheMap) {
+            nUsage += memusage::DynamicUsage(p.second.first);
+        }
+        return nUsage;
+    }
+
+    // memory used by a single entry with the given value, including its share of the bucket array
+    static size_t EntryMemoryUsage(const Value& v)
+    {
+        return memusage::MallocUsage(sizeof(memusage::unordered_node<typename MapType::value_type>)) + sizeof(void*) + memusage::DynamicUsage(v);
+    }
+
 private:
     void truncate_if_needed()
     {
@@ -1368,6 +1368,9 @@ void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, int nHeight)
 }
 
 bool CScriptCheck::operator()() {
+    if (specialTxCheck) {
+        return specialTxCheck();
+    }
     const CScript &scriptSig = ptxTo->vin[nIn].scriptSig;
     if (!VerifyScript(scriptSig, scriptPubKey, nFlags, CachingTransactionSignatureChecker(ptxTo, nIn, cacheStore), &error)) {
         return false;
@@ -2058,6 +2061,14 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
 
     CCheckQueueControl<CScriptCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : NULL);
 
+    // the payload signatures of special txs are verified on the script check queue as well
+    {
+        std::vector<CScriptCheck> vChecks;
+        if (!CheckSpecialTxsInBlock(block, pindex->pprev, deterministicMNManager->GetListForBlock(pindex->pprev), state, fScriptChecks && nScriptCheckThreads ? &vChecks : NULL))
+            return error("ConnectBlock(EPM): CheckSpecialTxsInBlock for block failed with %s", FormatStateMessage(state));
+        control.Add(vChecks);
+    }
+
     std::vector<int> prevheights;
     CAmount nFees = 0;
     int nInputs = 0;